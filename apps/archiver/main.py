@@ -3,12 +3,20 @@ Archiver - Export monitoring data to S3 for long-term storage.
 
 Periodically exports job, subjob, and event data from TimescaleDB to S3.
 Supports 10-year archival with efficient Parquet format.
+
+Usage:
+    python main.py [run]                    Archive continuously
+    python main.py once                     Catch up once and exit
+    python main.py backfill --from T --to T [--tables job,event] [--force]
 """
-import os
+import argparse
 import asyncio
 import asyncpg
-import pandas as pd
+import json
+import time
+import pyarrow.parquet as pq
 from datetime import datetime, timedelta, timezone
+from typing import Any, Dict, List, Optional, Sequence, Tuple
 import boto3
 from botocore.exceptions import ClientError
 
@@ -18,6 +26,10 @@ from pathlib import Path
 sys.path.insert(0, str(Path(__file__).parent.parent))
 from shared_utils import setup_logging, get_logger, trace_async
 from shared_utils import ArchiverConfig
+from shared_utils.archive import (
+    TIME_COLUMNS, S3MultipartWriter, arrow_schema, rows_to_batch, partition_key, manifest_key,
+    build_manifest, plan_units, next_watermark, stale_hours, hours, floor_hour, ceil_hour
+)
 
 # Configuration
 config = ArchiverConfig()
@@ -26,20 +38,90 @@ config = ArchiverConfig()
 setup_logging(config.service_name, level=config.log_level, json_logs=config.json_logs)
 logger = get_logger(__name__)
 
+TABLES = ('job', 'subjob', 'event')
+
+_s3 = None
+
+# Row counts of the manifests written or read by this process, by manifest key
+_archived_rows: Dict[str, int] = {}
+
+
+def s3_client():
+    """Shared boto3 S3 client (clients are thread-safe; creating one is not cheap)."""
+    global _s3
+    if _s3 is None:
+        _s3 = boto3.client('s3')
+    return _s3
+
+
+async def create_pool() -> asyncpg.Pool:
+    """Connection pool sized for the configured export concurrency."""
+    return await asyncpg.create_pool(
+        config.database_url,
+        min_size=1,
+        max_size=config.archive_max_concurrency + 1
+    )
+
+
+def _load_manifest(key: str) -> Optional[Dict[str, Any]]:
+    try:
+        body = s3_client().get_object(Bucket=config.s3_bucket, Key=key)['Body'].read()
+    except ClientError as e:
+        if e.response['Error']['Code'] in ('NoSuchKey', '404'):
+            return None
+        raise
+    return json.loads(body)
+
+
+def _put_manifest(key: str, manifest: Dict[str, Any]) -> None:
+    s3_client().put_object(
+        Bucket=config.s3_bucket,
+        Key=key,
+        Body=json.dumps(manifest).encode('utf-8'),
+        ContentType='application/json'
+    )
+
 
 @trace_async("export_partition")
-async def export_partition(table: str, start: datetime, end: datetime) -> int:
+async def export_partition(
+    pool: asyncpg.Pool,
+    table: str,
+    start: datetime,
+    end: datetime,
+    force: bool = False
+) -> int:
     """
     Export a time partition of data to S3.
     
+    Rows are read from a server-side cursor in chunks of
+    `config.export_chunk_rows`. Each chunk becomes one Parquet row group,
+    streamed into an S3 multipart upload, so memory use is bounded by one
+    row group and one upload part whatever the partition size. A failed
+    export aborts the upload and leaves no object behind.
+    
+    A manifest (row count, min/max time, size, SHA-256) is written after
+    the data file, also for empty partitions. A partition that already has
+    a manifest is skipped unless `force` is set, which makes re-runs
+    idempotent.
+    
     Args:
+        pool: Database pool
         table: Table name (job, subjob, or event)
         start: Start timestamp
         end: End timestamp
-        
+        force: Re-export even if a manifest exists
+    
     Returns:
-        Number of rows exported
+        Number of rows in the partition
     """
+    mkey = manifest_key(config.s3_prefix, config.site_id, table, start)
+    if not force:
+        existing = await asyncio.to_thread(_load_manifest, mkey)
+        if existing is not None:
+            _archived_rows[mkey] = existing['rows']
+            logger.debug("partition_already_archived", table=table, start=start.isoformat(), rows=existing['rows'])
+            return existing['rows']
+    
     logger.info(
         "export_partition_started",
         table=table,
@@ -47,19 +129,57 @@ async def export_partition(table: str, start: datetime, end: datetime) -> int:
         end=end.isoformat()
     )
     
+    time_col = TIME_COLUMNS[table]
+    key = partition_key(config.s3_prefix, config.site_id, table, start)
+    sink = None
+    writer = None
+    total = 0
+    min_time = max_time = None
+    
     try:
-        # Connect to database
-        con = await asyncpg.connect(config.database_url)
+        async with pool.acquire() as con:
+            # Server-side cursors need a transaction
+            async with con.transaction(readonly=True):
+                stmt = await con.prepare(
+                    f"SELECT * FROM {table} WHERE {time_col} >= $1 AND {time_col} < $2 ORDER BY {time_col}"
+                )
+                schema = arrow_schema((a.name, a.type.name) for a in stmt.get_attributes())
+                time_idx = schema.get_field_index(time_col)
+                cursor = await stmt.cursor(start, end)
+                
+                while True:
+                    rows = await cursor.fetch(config.export_chunk_rows)
+                    if not rows:
+                        break
+                    # Rows are ordered by time
+                    min_time = min_time or rows[0][time_idx]
+                    max_time = rows[-1][time_idx]
+                    batch = rows_to_batch(rows, schema)
+                    del rows
+                    
+                    if writer is None:
+                        sink = S3MultipartWriter(
+                            s3_client(), config.s3_bucket, key, config.s3_part_size_mb * 1024 * 1024
+                        )
+                        writer = pq.ParquetWriter(sink, schema, compression=config.parquet_compression)
+                    
+                    # Encoding and part uploads block; keep them off the event loop
+                    await asyncio.to_thread(writer.write_batch, batch, row_group_size=batch.num_rows)
+                    total += batch.num_rows
         
-        # Fetch data
-        rows = await con.fetch(
-            f"SELECT * FROM {table} WHERE inserted_at >= $1 AND inserted_at < $2",
-            start,
-            end
-        )
-        await con.close()
+        if writer is not None:
+            await asyncio.to_thread(writer.close)
+            await asyncio.to_thread(sink.close)
+            manifest = build_manifest(
+                table, config.site_id, start, end, total, key=key, size_bytes=sink.tell(),
+                sha256=sink.sha256.hexdigest(), min_time=min_time, max_time=max_time
+            )
+        else:
+            manifest = build_manifest(table, config.site_id, start, end, 0)
+        await asyncio.to_thread(_put_manifest, mkey, manifest)
+        _archived_rows[mkey] = total
         
-        if not rows:
+        if writer is None:
             logger.info(
                 "export_partition_empty",
                 table=table,
@@ -67,41 +187,21 @@ async def export_partition(table: str, start: datetime, end: datetime) -> int:
             )
             return 0
         
-        # Convert to DataFrame
-        df = pd.DataFrame([dict(r) for r in rows])
-        
-        # Write to local Parquet file
-        tmp_path = f"/tmp/{table}-{start:%Y%m%d%H}-{end:%Y%m%d%H}.parquet"
-        df.to_parquet(tmp_path, engine='pyarrow', compression='snappy')
-        
-        logger.info(
-            "parquet_file_created",
-            table=table,
-            path=tmp_path,
-            size_bytes=os.path.getsize(tmp_path),
-            rows=len(df)
-        )
-        
-        # Upload to S3
-        s3 = boto3.client('s3')
-        key = f"{config.s3_prefix}{config.site_id}/{table}/dt={start:%Y/%m/%d/%H}/part.parquet"
-        
-        s3.upload_file(tmp_path, config.s3_bucket, key)
-        
         logger.info(
             "export_partition_completed",
             table=table,
             bucket=config.s3_bucket,
             key=key,
-            rows=len(df)
+            rows=total,
+            size_bytes=sink.tell(),
+            parts=sink.parts
         )
         
-        # Clean up temp file
-        os.remove(tmp_path)
-        
-        return len(df)
+        return total
     
     except ClientError as e:
+        if sink is not None:
+            await asyncio.to_thread(sink.abort)
         logger.error(
             "s3_upload_failed",
             table=table,
@@ -111,6 +211,8 @@ async def export_partition(table: str, start: datetime, end: datetime) -> int:
         raise
     
     except Exception as e:
+        if sink is not None:
+            await asyncio.to_thread(sink.abort)
         logger.error(
             "export_partition_failed",
             table=table,
@@ -120,44 +222,268 @@ async def export_partition(table: str, start: datetime, end: datetime) -> int:
         raise
 
 
-async def archive_cycle() -> None:
+async def get_watermark(pool: asyncpg.Pool, table: str) -> Optional[datetime]:
+    """Time up to which `table` is fully archived, or None if never archived."""
+    async with pool.acquire() as con:
+        return await con.fetchval('SELECT archived_until FROM archive_watermark WHERE table_name = $1', table)
+
+
+async def set_watermark(pool: asyncpg.Pool, table: str, archived_until: datetime) -> None:
+    """Persist a watermark; it never moves backwards."""
+    async with pool.acquire() as con:
+        await con.execute(
+            '''
+            INSERT INTO archive_watermark (table_name, archived_until, updated_at)
+            VALUES ($1, $2, now())
+            ON CONFLICT (table_name) DO UPDATE
+            SET archived_until = GREATEST(archive_watermark.archived_until, EXCLUDED.archived_until),
+                updated_at = now()
+            ''',
+            table, archived_until
+        )
+
+
+async def chunk_ranges(
+    pool: asyncpg.Pool,
+    table: str,
+    start: Optional[datetime] = None,
+    end: Optional[datetime] = None
+) -> List[Tuple[datetime, datetime]]:
+    """Time ranges of the hypertable's chunks overlapping [start, end)."""
+    async with pool.acquire() as con:
+        rows = await con.fetch(
+            '''
+            SELECT range_start, range_end FROM timescaledb_information.chunks
+            WHERE hypertable_name = $1
+              AND ($2::timestamptz IS NULL OR range_end > $2)
+              AND ($3::timestamptz IS NULL OR range_start < $3)
+            ORDER BY range_start
+            ''',
+            table, start, end
+        )
+    return [(r['range_start'], r['range_end']) for r in rows]
+
+
+async def export_unit(
+    pool: asyncpg.Pool,
+    slots: asyncio.Semaphore,
+    table: str,
+    unit: Tuple[datetime, datetime],
+    force: bool = False
+) -> Tuple[bool, int]:
+    """
+    Export one work unit (an hourly partition) within the concurrency limit.
+    
+    Returns:
+        (exported, rows)
+    """
+    async with slots:
+        try:
+            return True, await export_partition(pool, table, *unit, force=force)
+        except Exception as e:
+            logger.error(
+                "archive_unit_failed",
+                table=table,
+                unit_start=unit[0].isoformat(),
+                error=str(e)
+            )
+            return False, 0
+
+
+async def manifest_rows(table: str, start: datetime) -> int:
+    """Rows recorded in the manifest of an hourly partition (0 without one)."""
+    mkey = manifest_key(config.s3_prefix, config.site_id, table, start)
+    if mkey not in _archived_rows:
+        manifest = await asyncio.to_thread(_load_manifest, mkey)
+        _archived_rows[mkey] = manifest['rows'] if manifest is not None else 0
+    return _archived_rows[mkey]
+
+
+async def live_hour_counts(pool: asyncpg.Pool, table: str, start: datetime, end: datetime) -> Dict[datetime, int]:
+    """Rows per hour currently stored in `table` for [start, end)."""
+    time_col = TIME_COLUMNS[table]
+    async with pool.acquire() as con:
+        rows = await con.fetch(
+            f"SELECT time_bucket('1 hour', {time_col}) AS hour, count(*) AS n FROM {table} "
+            f"WHERE {time_col} >= $1 AND {time_col} < $2 GROUP BY 1",
+            start, end
+        )
+    return {r['hour']: r['n'] for r in rows}
+
+
+async def reconcile_table(pool: asyncpg.Pool, slots: asyncio.Semaphore, table: str, watermark: datetime) -> int:
+    """
+    Re-export archived hours that changed after their export.
+    
+    Rows can land in an hour behind the watermark, e.g. events with an old
+    `at` replayed from a sidecar spool after an outage. The watermark alone
+    would never look at that hour again, so the row count of every archived
+    hour still in hot storage is compared with its manifest, and hours that
+    differ are exported again (including hours that had no rows before).
+    The oldest hour is left out, since retention may be dropping it.
+    
+    Returns:
+        Number of rows in the re-exported partitions
+    """
+    start = ceil_hour(datetime.now(timezone.utc) - timedelta(hours=config.retention_hours)) + timedelta(hours=1)
+    if start >= watermark:
+        return 0
+    live = await live_hour_counts(pool, table, start, watermark)
+    archived = {h: await manifest_rows(table, h) for h in live}
+    stale = stale_hours(live, archived)
+    
+    # Forget manifests that have left hot storage
+    prefix = f"{config.s3_prefix}{config.site_id}/{table}/"
+    oldest = manifest_key(config.s3_prefix, config.site_id, table, start)
+    for mkey in [k for k in _archived_rows if k.startswith(prefix) and k < oldest]:
+        del _archived_rows[mkey]
+    
+    if not stale:
+        return 0
+    logger.info(
+        "archive_late_rows_found",
+        table=table,
+        hours=len(stale),
+        rows=sum(live[h] - archived.get(h, 0) for h in stale)
+    )
+    results = await asyncio.gather(
+        *(export_unit(pool, slots, table, (h, h + timedelta(hours=1)), force=True) for h in stale)
+    )
+    return sum(n for _, n in results)
+
+
+async def archive_table(pool: asyncpg.Pool, slots: asyncio.Semaphore, table: str, end: datetime) -> int:
+    """
+    Archive everything in `table` between its watermark and `end`.
+    
+    Pending hours that hold chunks are exported in parallel as hourly
+    work units (bounded by `slots`). The watermark then advances over the
+    completed prefix, so a failed hour is retried on the next cycle while
+    the hours after it skip via their manifests. Hours behind the
+    watermark that gained rows since are exported again (see
+    reconcile_table).
+    
+    Returns:
+        Number of rows in the archived partitions
+    """
+    stored = watermark = await get_watermark(pool, table)
+    chunks = await chunk_ranges(pool, table, watermark, end)
+    if watermark is None:
+        # First run: start with the oldest data still in hot storage
+        watermark = floor_hour(chunks[0][0]) if chunks else end
+    
+    retention_edge = datetime.now(timezone.utc) - timedelta(hours=config.retention_hours)
+    if watermark < retention_edge + timedelta(hours=config.archive_interval_hours):
+        logger.warning(
+            "archive_watermark_near_retention",
+            table=table,
+            watermark=watermark.isoformat(),
+            retention_edge=retention_edge.isoformat()
+        )
+    
+    units = plan_units(chunks, watermark, end)
+    results = await asyncio.gather(*(export_unit(pool, slots, table, u) for u in units))
+    
+    new_watermark = next_watermark(watermark, units, [ok for ok, _ in results], end)
+    if stored is None or new_watermark > stored:
+        await set_watermark(pool, table, new_watermark)
+    
+    rows = sum(n for _, n in results)
+    if config.archive_reconcile_enabled:
+        # Hours exported by earlier cycles; this cycle's manifests are current
+        rows += await reconcile_table(pool, slots, table, watermark)
+    logger.info(
+        "table_archived",
+        table=table,
+        units=len(units),
+        failed_units=sum(1 for ok, _ in results if not ok),
+        rows=rows,
+        watermark=new_watermark.isoformat(),
+        lag_s=round((end - new_watermark).total_seconds(), 1)
+    )
+    return rows
+
+
+async def archive_cycle(pool: asyncpg.Pool) -> int:
     """
     Run one archival cycle.
     
-    Exports data from the previous hour for all tables.
+    Catches every table up from its watermark to the last settled hour;
+    tables and chunks are processed in parallel with at most
+    `config.archive_max_concurrency` exports at a time.
+    
+    Returns:
+        Number of rows in the archived partitions
     """
-    now = datetime.now(timezone.utc)
-    # Archive the previous complete hour
-    end = now.replace(minute=0, second=0, microsecond=0)
-    start = end - timedelta(hours=1)
+    start_time = time.time()
+    # Hours are archived once late events (clock skew) have settled
+    end = floor_hour(datetime.now(timezone.utc) - timedelta(minutes=config.archive_settle_minutes))
     
     logger.info(
         "archive_cycle_started",
-        start=start.isoformat(),
         end=end.isoformat()
     )
     
-    total_rows = 0
+    slots = asyncio.Semaphore(config.archive_max_concurrency)
+    results = await asyncio.gather(*(archive_table(pool, slots, t, end) for t in TABLES), return_exceptions=True)
     
-    for table in ['job', 'subjob', 'event']:
-        try:
-            rows = await export_partition(table, start, end)
-            total_rows += rows
-        except Exception as e:
+    total_rows = 0
+    for table, result in zip(TABLES, results):
+        if isinstance(result, Exception):
             logger.error(
                 "table_export_failed",
                 table=table,
-                error=str(e)
+                error=str(result)
             )
+        else:
+            total_rows += result
     
     logger.info(
         "archive_cycle_completed",
         total_rows=total_rows,
-        duration_s=(datetime.now(timezone.utc) - now).total_seconds()
+        duration_s=round(time.time() - start_time, 3)
     )
+    return total_rows
+
 
+async def backfill(
+    pool: asyncpg.Pool,
+    start: datetime,
+    end: datetime,
+    tables: Sequence[str] = TABLES,
+    force: bool = False
+) -> int:
+    """
+    Export an arbitrary time range, e.g. to repair or re-export partitions.
+    
+    Partitions with a manifest are skipped unless `force` is set. Only data
+    still in hot storage can be exported. Watermarks are not changed.
+    
+    Returns:
+        Number of rows in the exported partitions
+    """
+    slots = asyncio.Semaphore(config.archive_max_concurrency)
+    total_rows = 0
+    for table in tables:
+        units = plan_units(await chunk_ranges(pool, table, start, end), start, end)
+        covered = len(units)
+        requested = len(hours(start, end))
+        if covered < requested:
+            logger.warning("backfill_hours_not_in_hot_storage", table=table, hours=requested - covered)
+        results = await asyncio.gather(*(export_unit(pool, slots, table, u, force=force) for u in units))
+        rows = sum(n for _, n in results)
+        total_rows += rows
+        logger.info(
+            "backfill_table_completed",
+            table=table,
+            units=len(units),
+            failed_units=sum(1 for ok, _ in results if not ok),
+            rows=rows
+        )
+    return total_rows
 
-async def continuous_archiver() -> None:
+
+async def continuous_archiver(pool: asyncpg.Pool) -> None:
     """
     Continuously run archival cycles.
     
@@ -168,12 +494,13 @@ async def continuous_archiver() -> None:
         site_id=config.site_id,
         s3_bucket=config.s3_bucket,
         s3_prefix=config.s3_prefix,
-        interval_hours=config.archive_interval_hours
+        interval_hours=config.archive_interval_hours,
+        max_concurrency=config.archive_max_concurrency
     )
     
     while True:
         try:
-            await archive_cycle()
+            await archive_cycle(pool)
         except Exception as e:
             logger.error("archive_cycle_error", error=str(e))
         
@@ -183,15 +510,50 @@ async def continuous_archiver() -> None:
         await asyncio.sleep(sleep_seconds)
 
 
-async def main() -> None:
+def _utc(value: str) -> datetime:
+    ts = datetime.fromisoformat(value.replace('Z', '+00:00'))
+    return ts if ts.tzinfo else ts.replace(tzinfo=timezone.utc)
+
+
+def parse_args(argv: Optional[Sequence[str]] = None) -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description='Archive monitoring data to S3')
+    sub = parser.add_subparsers(dest='command')
+    sub.add_parser('run', help='Archive continuously (default)')
+    sub.add_parser('once', help='Catch up all tables once and exit')
+    bf = sub.add_parser('backfill', help='Export an arbitrary time range')
+    bf.add_argument('--from', dest='frm', type=_utc, required=True, help='Range start (ISO 8601)')
+    bf.add_argument('--to', type=_utc, required=True, help='Range end (ISO 8601)')
+    bf.add_argument('--tables', default=','.join(TABLES), help='Comma-separated tables')
+    bf.add_argument('--force', action='store_true', help='Re-export partitions that have a manifest')
+    args = parser.parse_args(argv)
+    if args.command == 'backfill':
+        args.tables = [t.strip() for t in args.tables.split(',') if t.strip()]
+        unknown = [t for t in args.tables if t not in TABLES]
+        if unknown:
+            parser.error(f"unknown tables: {', '.join(unknown)}")
+        if args.frm >= args.to:
+            parser.error('--from must be before --to')
+    return args
+
+
+async def main(argv: Optional[Sequence[str]] = None) -> None:
     """Main entry point."""
+    args = parse_args(argv)
+    pool = await create_pool()
     try:
-        await continuous_archiver()
+        if args.command == 'once':
+            await archive_cycle(pool)
+        elif args.command == 'backfill':
+            await backfill(pool, args.frm, args.to, args.tables, force=args.force)
+        else:
+            await continuous_archiver(pool)
     except KeyboardInterrupt:
         logger.info("archiver_stopped_by_user")
     except Exception as e:
         logger.error("archiver_fatal_error", error=str(e))
         raise
+    finally:
+        await pool.close()
 
 
 if __name__ == '__main__':
@@ -5,12 +5,13 @@ Federates queries across multiple Local API instances.
 Provides a unified interface for cross-site monitoring.
 """
 import os
+import asyncio
 import httpx
 import time
 from fastapi import FastAPI, HTTPException, Query, Request, Response
-from fastapi.responses import JSONResponse
-from typing import Optional
-from datetime import datetime, timedelta
+from fastapi.responses import JSONResponse, StreamingResponse
+from typing import Any, Callable, Dict, List, Optional
+from datetime import datetime, timedelta, timezone
 
 # Import shared utilities
 import sys
@@ -19,6 +20,15 @@ sys.path.insert(0, str(Path(__file__).parent.parent))
 from shared_utils import setup_logging, get_logger, setup_tracing, instrument_fastapi
 from shared_utils import MetricsCollector, get_metrics_collector, trace_async
 from shared_utils import CentralAPIConfig
+from shared_utils.metrics import route_template
+from shared_utils.serialization import CursorError
+from shared_utils.response_cache import ResponseCache, NOT_MODIFIED, cache_key
+from shared_utils.stats import (
+    choose_granularity, parse_group_by, merge_job_buckets, merge_event_buckets, merge_failures, histogram_layout
+)
+from shared_utils.federation import (
+    SITE_DONE, merge_pages, next_site_cursors, encode_federated_cursor, decode_federated_cursor
+)
 
 # Configuration
 config = CentralAPIConfig()
@@ -62,7 +72,7 @@ async def metrics_middleware(request: Request, call_next):
     
     metrics.record_http_request(
         method=request.method,
-        endpoint=request.url.path,
+        endpoint=route_template(request),
         status=response.status_code,
         duration=duration
     )
@@ -70,6 +80,85 @@ async def metrics_middleware(request: Request, call_next):
     return response
 
 
+# Shared pooled client for all site requests (created on startup)
+_client: Optional[httpx.AsyncClient] = None
+
+# Responses from sites, keyed by (site, path, normalized params)
+response_cache = ResponseCache(config.cache_ttl_s, config.cache_stale_s, config.cache_max_entries)
+
+
+def get_client() -> httpx.AsyncClient:
+    """Return the shared HTTP client, creating it on first use."""
+    global _client
+    if _client is None or _client.is_closed:
+        _client = httpx.AsyncClient(
+            timeout=config.request_timeout_s,
+            limits=httpx.Limits(
+                max_connections=config.max_connections,
+                max_keepalive_connections=config.max_connections
+            )
+        )
+    return _client
+
+
+@app.on_event('startup')
+async def startup() -> None:
+    """Startup handler - create the shared HTTP client."""
+    get_client()
+    logger.info("service_started", sites=list(config.sites))
+
+
+@app.on_event('shutdown')
+async def shutdown() -> None:
+    """Shutdown handler - close the shared HTTP client."""
+    if _client is not None:
+        await _client.aclose()
+
+
+async def site_get(site: str, path: str, params: dict, use_cache: bool = True) -> dict:
+    """
+    GET `path` from a site's Local API over the shared client.
+    
+    Responses are served from `response_cache` when possible; expired
+    entries are revalidated with If-None-Match so unchanged results cost
+    the site a 304 instead of a query.
+    
+    Raises:
+        HTTPException: If the site is unknown
+        httpx.HTTPError: If the request fails
+    """
+    base = config.sites.get(site)
+    if not base:
+        logger.warning("unknown_site_requested", site=site)
+        raise HTTPException(404, f'Unknown site: {site}')
+    
+    async def fetch(etag: Optional[str]) -> Any:
+        logger.debug("forwarding_request", site=site, path=path, revalidate=etag is not None)
+        headers = {'If-None-Match': etag} if etag else None
+        r = await get_client().get(base + path, params=params, headers=headers,
+                                   timeout=max(config.request_timeout_s, site_deadline(params)))
+        if r.status_code == 304:
+            return NOT_MODIFIED
+        r.raise_for_status()
+        logger.info(
+            "request_forwarded",
+            site=site,
+            path=path,
+            status_code=r.status_code
+        )
+        return r.json(), r.headers.get('etag')
+    
+    # Delta tokens change on every poll, so deltas are never served twice
+    if not use_cache or params.get('format', 'json') != 'json' or 'since' in params:
+        data, _ = await fetch(None)
+        return data
+    
+    data, status = await response_cache.get(cache_key(site, path, params=params), fetch)
+    metrics.record_cache_lookup('site_response', status != 'miss')
+    metrics.update_cache_size('site_response', len(response_cache))
+    return data
+
+
 @trace_async("pass_get")
 async def pass_get(site: str, path: str, params: dict) -> dict:
     """
@@ -86,28 +175,8 @@ async def pass_get(site: str, path: str, params: dict) -> dict:
     Raises:
         HTTPException: If site is unknown or request fails
     """
-    base = config.sites.get(site)
-    if not base:
-        logger.warning("unknown_site_requested", site=site)
-        raise HTTPException(404, f'Unknown site: {site}')
-    
     try:
-        logger.debug("forwarding_request", site=site, path=path)
-        async with httpx.AsyncClient() as client:
-            r = await client.get(
-                base + path,
-                params=params,
-                timeout=config.request_timeout_s
-            )
-            r.raise_for_status()
-            
-            logger.info(
-                "request_forwarded",
-                site=site,
-                path=path,
-                status_code=r.status_code
-            )
-            return r.json()
+        return await site_get(site, path, params)
     
     except httpx.HTTPError as e:
         logger.error(
@@ -120,44 +189,483 @@ async def pass_get(site: str, path: str, params: dict) -> dict:
         raise HTTPException(502, f'Failed to reach site {site}: {str(e)}')
 
 
+@trace_async("pass_stream")
+async def pass_stream(site: str, path: str, params: dict) -> StreamingResponse:
+    """
+    Forward a `format=ndjson` export from one site's Local API.
+    
+    The body is streamed through as it arrives, without parsing or
+    buffering it, so exports larger than a page do not pile up here.
+    
+    Raises:
+        HTTPException: If the site is unknown, cannot be reached or rejects
+            the request (its 4xx status is passed on)
+    """
+    base = config.sites.get(site)
+    if not base:
+        logger.warning("unknown_site_requested", site=site)
+        raise HTTPException(404, f'Unknown site: {site}')
+    
+    client = get_client()
+    request = client.build_request('GET', base + path, params=params,
+                                   timeout=max(config.request_timeout_s, site_deadline(params)))
+    try:
+        r = await client.send(request, stream=True)
+    except httpx.HTTPError as e:
+        logger.error("forward_failed", site=site, path=path, error=str(e), error_type=type(e).__name__)
+        raise HTTPException(502, f'Failed to reach site {site}: {str(e)}')
+    
+    if r.status_code >= 400:
+        detail = (await r.aread()).decode('utf-8', 'replace')
+        await r.aclose()
+        logger.error("forward_failed", site=site, path=path, status_code=r.status_code)
+        raise HTTPException(r.status_code if r.status_code < 500 else 502, detail or f'Site {site} answered {r.status_code}')
+    
+    logger.info("stream_forwarded", site=site, path=path, status_code=r.status_code)
+    
+    async def body():
+        try:
+            async for chunk in r.aiter_raw():
+                yield chunk
+        finally:
+            await r.aclose()
+    
+    return StreamingResponse(body(), media_type=r.headers.get('content-type', 'application/x-ndjson'))
+
+
+def resolve_sites(site: str) -> List[str]:
+    """Expand a `site` parameter ('*', 'fab1' or 'fab1,fab2') to configured site ids."""
+    if site.strip() == '*':
+        return list(config.sites)
+    sites = [s.strip() for s in site.split(',') if s.strip()]
+    unknown = [s for s in sites if s not in config.sites]
+    if unknown or not sites:
+        raise HTTPException(404, f"Unknown site: {','.join(unknown) or site}")
+    return sites
+
+
+def is_federated(site: str) -> bool:
+    """True if the `site` parameter addresses more than one site."""
+    return site.strip() == '*' or ',' in site
+
+
+def site_deadline(params: dict) -> float:
+    """
+    Per-site deadline for a query.
+    
+    Ranges starting before the sites' hot retention are partly served from
+    the S3 archive, which takes longer than a database query.
+    """
+    try:
+        start = _parse_ts(params.get('from'))
+    except ValueError:
+        start = None
+    if start is not None and start < datetime.now(timezone.utc) - timedelta(hours=config.hot_retention_hours):
+        return max(config.site_deadline_s, config.cold_site_deadline_s)
+    return config.site_deadline_s
+
+
+async def fetch_site(site: str, path: str, params: dict) -> Dict[str, Any]:
+    """
+    Query one site within the per-site deadline, never raising.
+    
+    Returns:
+        Dict with 'status' ('ok', 'timeout' or 'error'), 'duration_s' and
+        either 'data' or 'error'
+    """
+    start = time.time()
+    deadline = site_deadline(params)
+    try:
+        data = await asyncio.wait_for(site_get(site, path, params), deadline)
+        return {'status': 'ok', 'data': data, 'duration_s': round(time.time() - start, 4)}
+    except asyncio.TimeoutError:
+        logger.warning("site_deadline_exceeded", site=site, path=path, deadline_s=deadline)
+        return {'status': 'timeout', 'error': f'No response within {deadline}s',
+                'duration_s': round(time.time() - start, 4)}
+    except Exception as e:
+        logger.error("site_query_failed", site=site, path=path, error=str(e), error_type=type(e).__name__)
+        return {'status': 'error', 'error': str(e), 'duration_s': round(time.time() - start, 4)}
+
+
+async def federated_query(sites: List[str], path: str, id_col: str, params: dict) -> Dict[str, Any]:
+    """
+    Fan a paginated query out to several sites and merge the results.
+    
+    Every site is asked for at most `limit` rows after its own cursor; the
+    pages are k-way merged on (inserted_at, id) so the merged page is
+    globally ordered. The returned `next` token carries one cursor per site,
+    so each site resumes exactly after its last row that made it into a
+    page. Sites that fail or miss the deadline are reported in `sites` and
+    `partial` is set; they are retried from the same position on the next
+    page.
+    
+    Raises:
+        HTTPException: On invalid parameters or if no site answered
+    """
+    start_time = time.time()
+    params = dict(params)
+    if params.get('format', 'json') != 'json':
+        raise HTTPException(400, 'format=ndjson is only supported for a single site')
+    try:
+        limit = int(params.pop('limit', None) or config.query_default_limit)
+    except ValueError:
+        raise HTTPException(422, 'limit must be an integer')
+    if limit < 1 or limit > config.query_max_limit:
+        raise HTTPException(422, f'limit must be between 1 and {config.query_max_limit}')
+    
+    cursors: Dict[str, Optional[str]] = {}
+    token = params.pop('cursor', None)
+    if token:
+        try:
+            cursors = decode_federated_cursor(token)
+        except CursorError as e:
+            raise HTTPException(400, str(e))
+    
+    active = [s for s in sites if cursors.get(s) != SITE_DONE]
+    
+    def site_params(site: str) -> dict:
+        p = dict(params, limit=limit)
+        if cursors.get(site):
+            p['cursor'] = cursors[site]
+        return p
+    
+    results = await asyncio.gather(*(fetch_site(s, path, site_params(s)) for s in active))
+    by_site = dict(zip(active, results))
+    
+    ok = {s: r for s, r in by_site.items() if r['status'] == 'ok'}
+    if active and not ok:
+        raise HTTPException(502, 'No site answered: ' + '; '.join(f"{s}: {r['error']}" for s, r in by_site.items()))
+    
+    pages = {s: r['data'].get('items', []) for s, r in ok.items()}
+    has_more = {s: r['data'].get('next') is not None for s, r in ok.items()}
+    items, consumed = merge_pages(pages, id_col, limit)
+    
+    next_cursors = {s: SITE_DONE for s in sites if s not in active}
+    next_cursors.update(next_site_cursors(pages, consumed, has_more, cursors, id_col))
+    for s in active:
+        if s not in ok:
+            next_cursors[s] = cursors.get(s)
+    
+    site_report = {}
+    for s in active:
+        r = by_site[s]
+        entry = {'status': r['status'], 'duration_s': r['duration_s']}
+        if s in ok:
+            entry.update(returned=len(pages[s]), used=consumed[s])
+        else:
+            entry['error'] = r['error']
+        site_report[s] = entry
+    
+    duration = time.time() - start_time
+    logger.info(
+        "federated_query_completed",
+        path=path,
+        sites=len(active),
+        failed=len(active) - len(ok),
+        count=len(items),
+        duration_s=round(duration, 4)
+    )
+    
+    return {
+        'items': items,
+        'count': len(items),
+        'next': encode_federated_cursor(next_cursors),
+        # Sites that did not answer start over with a full page on the first delta
+        'since': encode_federated_cursor({s: r['data'].get('since') for s, r in ok.items()}),
+        'partial': len(ok) < len(active),
+        'sites': site_report,
+        'duration_s': round(duration, 4)
+    }
+
+
+async def federated_delta(sites: List[str], path: str, params: dict) -> Dict[str, Any]:
+    """
+    Fan a `since` delta out to several sites.
+    
+    The `since` token carries one site token per site. Each site returns its
+    own changes and tombstones; they are concatenated (ids are unique across
+    sites, and clients merge by id, so no ordering is needed). A site without
+    a token, e.g. one that failed before, gets a regular first page instead.
+    Failing sites keep their token and are reported as for federated queries.
+    `more` is set if any site has more changes.
+    
+    Raises:
+        HTTPException: On invalid parameters or if no site answered
+    """
+    start_time = time.time()
+    params = dict(params)
+    try:
+        limit = int(params.pop('limit', None) or config.query_default_limit)
+    except ValueError:
+        raise HTTPException(422, 'limit must be an integer')
+    if limit < 1 or limit > config.query_max_limit:
+        raise HTTPException(422, f'limit must be between 1 and {config.query_max_limit}')
+    try:
+        tokens = decode_federated_cursor(params.pop('since'))
+    except CursorError as e:
+        raise HTTPException(400, str(e))
+    
+    def site_params(site: str) -> dict:
+        p = dict(params, limit=limit)
+        if tokens.get(site):
+            p['since'] = tokens[site]
+        return p
+    
+    results = await asyncio.gather(*(fetch_site(s, path, site_params(s)) for s in sites))
+    by_site = dict(zip(sites, results))
+    ok = {s: r for s, r in by_site.items() if r['status'] == 'ok'}
+    if sites and not ok:
+        raise HTTPException(502, 'No site answered: ' + '; '.join(f"{s}: {r['error']}" for s, r in by_site.items()))
+    
+    items: List[Dict[str, Any]] = []
+    tombstones: List[Any] = []
+    next_tokens: Dict[str, Optional[str]] = {}
+    site_report = {}
+    for s, r in by_site.items():
+        entry = {'status': r['status'], 'duration_s': r['duration_s']}
+        if s in ok:
+            data = r['data']
+            items.extend(data.get('items', []))
+            tombstones.extend(data.get('tombstones', []))
+            next_tokens[s] = data.get('since')
+            entry.update(returned=len(data.get('items', [])), more=bool(data.get('more')))
+        else:
+            next_tokens[s] = tokens.get(s)
+            entry['error'] = r['error']
+        site_report[s] = entry
+    
+    duration = time.time() - start_time
+    logger.info(
+        "federated_delta_completed",
+        path=path,
+        sites=len(sites),
+        failed=len(sites) - len(ok),
+        count=len(items),
+        tombstones=len(tombstones),
+        duration_s=round(duration, 4)
+    )
+    
+    return {
+        'items': items,
+        'tombstones': tombstones,
+        'count': len(items),
+        'since': encode_federated_cursor(next_tokens),
+        'more': any(e.get('more') for e in site_report.values()),
+        'partial': len(ok) < len(sites),
+        'sites': site_report,
+        'duration_s': round(duration, 4)
+    }
+
+
+async def query_sites(request: Request, site: str, path: str, id_col: str) -> Response:
+    """Serve a query endpoint for one site (pass-through) or several (federated)."""
+    params = {k: v for k, v in request.query_params.items() if k != 'site'}
+    if is_federated(site):
+        if 'since' in params:
+            return JSONResponse(await federated_delta(resolve_sites(site), path, params))
+        return JSONResponse(await federated_query(resolve_sites(site), path, id_col, params))
+    if params.get('format', 'json') == 'ndjson':
+        return await pass_stream(site.strip(), path, params)
+    return JSONResponse(await pass_get(site.strip(), path, params))
+
+
 @app.get('/v1/jobs')
 @trace_async("get_jobs")
 async def jobs(
-    site: str = Query(..., description="Site identifier"),
-    **params
-) -> JSONResponse:
+    request: Request,
+    site: str = Query(..., description="Site identifier, comma-separated list or '*' for all sites")
+) -> Response:
     """
-    Query jobs from a specific site.
+    Query jobs from one site, or from several sites merged by recency.
     
     Args:
-        site: Site identifier
-        **params: Additional query parameters passed to the local site
+        request: Incoming request; other query parameters are passed to the sites
+        site: Site identifier, comma-separated list or '*'
         
     Returns:
-        Jobs from the specified site
+        Jobs from the specified site(s)
     """
-    result = await pass_get(site, '/v1/jobs', params)
-    return JSONResponse(result)
+    return await query_sites(request, site, '/v1/jobs', 'job_id')
 
 
 @app.get('/v1/subjobs')
 @trace_async("get_subjobs")
 async def subjobs(
-    site: str = Query(..., description="Site identifier"),
-    **params
-) -> JSONResponse:
+    request: Request,
+    site: str = Query(..., description="Site identifier, comma-separated list or '*' for all sites")
+) -> Response:
     """
-    Query subjobs from a specific site.
+    Query subjobs from one site, or from several sites merged by recency.
     
     Args:
-        site: Site identifier
-        **params: Additional query parameters passed to the local site
+        request: Incoming request; other query parameters are passed to the sites
+        site: Site identifier, comma-separated list or '*'
         
     Returns:
-        Subjobs from the specified site
+        Subjobs from the specified site(s)
     """
-    result = await pass_get(site, '/v1/subjobs', params)
-    return JSONResponse(result)
+    return await query_sites(request, site, '/v1/subjobs', 'subjob_id')
+
+
+def _parse_ts(value: Optional[str]) -> Optional[datetime]:
+    """Parse an optional ISO 8601 timestamp as UTC-aware (accepts a trailing 'Z')."""
+    if not value:
+        return None
+    ts = datetime.fromisoformat(value.replace('Z', '+00:00'))
+    return ts if ts.tzinfo else ts.replace(tzinfo=timezone.utc)
+
+
+async def federated_stats(
+    sites: List[str],
+    path: str,
+    params: dict,
+    merge: Callable[[List[Dict[str, Any]], List[str]], List[Dict[str, Any]]],
+    group_fields: tuple,
+    rows_key: str = 'buckets'
+) -> Dict[str, Any]:
+    """
+    Fan a stats query out to several sites and re-aggregate the results.
+    
+    The granularity is resolved here so that every site buckets alike.
+    Sites return mergeable buckets (counts, sums, min/max and duration
+    histograms) which are combined with `merge`; rates, averages and
+    percentiles are recomputed from the combined parts rather than averaged.
+    `group_by=site_id` keeps sites apart. Failing sites are reported as for
+    federated queries.
+    
+    Raises:
+        HTTPException: On invalid parameters or if no site answered
+    """
+    start_time = time.time()
+    params = dict(params)
+    bucketed = rows_key == 'buckets'
+    groups: List[str] = []
+    if bucketed:
+        try:
+            groups = parse_group_by(params.pop('group_by', None), group_fields + ('site_id',))
+            end = _parse_ts(params.get('to')) or datetime.now(timezone.utc)
+            start = _parse_ts(params.get('from')) or end - timedelta(hours=24)
+            params['granularity'] = choose_granularity(
+                start, end, params.get('granularity', 'auto'), config.stats_hourly_max_hours
+            )
+        except ValueError as e:
+            raise HTTPException(422, str(e))
+        site_groups = [g for g in groups if g != 'site_id']
+        if site_groups:
+            params['group_by'] = ','.join(site_groups)
+    
+    results = await asyncio.gather(*(fetch_site(s, path, params) for s in sites))
+    by_site = dict(zip(sites, results))
+    ok = {s: r for s, r in by_site.items() if r['status'] == 'ok'}
+    if sites and not ok:
+        raise HTTPException(502, 'No site answered: ' + '; '.join(f"{s}: {r['error']}" for s, r in by_site.items()))
+    
+    rows = [dict(row, site_id=s) for s, r in ok.items() for row in r['data'].get(rows_key, [])]
+    merged = merge(rows, groups) if bucketed else merge(rows)
+    
+    site_report = {}
+    for s, r in by_site.items():
+        entry = {'status': r['status'], 'duration_s': r['duration_s']}
+        if s in ok:
+            entry['returned'] = len(r['data'].get(rows_key, []))
+        else:
+            entry['error'] = r['error']
+        site_report[s] = entry
+    
+    duration = time.time() - start_time
+    logger.info(
+        "federated_stats_completed",
+        path=path,
+        sites=len(sites),
+        failed=len(sites) - len(ok),
+        count=len(merged),
+        duration_s=round(duration, 4)
+    )
+    
+    body: Dict[str, Any] = {}
+    if bucketed:
+        body.update(granularity=params['granularity'], group_by=groups)
+        if path == '/v1/stats/jobs':
+            body['histogram'] = histogram_layout()
+    else:
+        body['hours'] = int(params.get('hours', 24))
+    body.update({
+        rows_key: merged,
+        'count': len(merged),
+        'partial': len(ok) < len(sites),
+        'sites': site_report,
+        'duration_s': round(duration, 4)
+    })
+    return body
+
+
+@app.get('/v1/stats/jobs')
+@trace_async("get_job_stats")
+async def job_stats(
+    request: Request,
+    site: str = Query('*', description="Site identifier, comma-separated list or '*' for all sites")
+) -> JSONResponse:
+    """
+    Time-bucketed job statistics re-aggregated across sites.
+    
+    Accepts the Local API parameters (from, to, granularity, app_name,
+    status) plus `group_by`, which may also include `site_id`.
+    
+    Args:
+        request: Incoming request; other query parameters are passed to the sites
+        site: Site identifier, comma-separated list or '*'
+    
+    Returns:
+        Buckets ordered by time, with a per-site report
+    """
+    params = {k: v for k, v in request.query_params.items() if k != 'site'}
+    return JSONResponse(await federated_stats(
+        resolve_sites(site), '/v1/stats/jobs', params, merge_job_buckets, ('app_name', 'status')
+    ))
+
+
+@app.get('/v1/stats/events')
+@trace_async("get_event_stats")
+async def event_stats(
+    request: Request,
+    site: str = Query('*', description="Site identifier, comma-separated list or '*' for all sites")
+) -> JSONResponse:
+    """
+    Time-bucketed event counts summed across sites.
+    
+    Args:
+        request: Incoming request; other query parameters are passed to the sites
+        site: Site identifier, comma-separated list or '*'
+    
+    Returns:
+        Buckets ordered by time, with a per-site report
+    """
+    params = {k: v for k, v in request.query_params.items() if k != 'site'}
+    return JSONResponse(await federated_stats(
+        resolve_sites(site), '/v1/stats/events', params, merge_event_buckets, ('entity_type', 'kind')
+    ))
+
+
+@app.get('/v1/stats/failures')
+@trace_async("get_failure_stats")
+async def failure_stats(
+    request: Request,
+    site: str = Query('*', description="Site identifier, comma-separated list or '*' for all sites")
+) -> JSONResponse:
+    """
+    Failure counts per app and error type, combined across sites.
+    
+    Args:
+        request: Incoming request; other query parameters are passed to the sites
+        site: Site identifier, comma-separated list or '*'
+    
+    Returns:
+        Rows ordered by failure count, with a per-site report
+    """
+    params = {k: v for k, v in request.query_params.items() if k != 'site'}
+    return JSONResponse(await federated_stats(
+        resolve_sites(site), '/v1/stats/failures', params, merge_failures, (), rows_key='items'
+    ))
 
 
 @app.get('/v1/sites')
@@ -182,44 +690,43 @@ async def healthz() -> JSONResponse:
     """
     Health check endpoint.
     
-    Also checks connectivity to all configured sites.
+    Also checks connectivity to all configured sites (concurrently).
     """
-    site_health = {}
-    
-    for site_id, base_url in config.sites.items():
+    async def check(site_id: str, base_url: str) -> Dict[str, Any]:
         try:
-            async with httpx.AsyncClient() as client:
-                r = await client.get(
-                    f"{base_url}/v1/healthz",
-                    timeout=2.0
-                )
-                site_health[site_id] = {
-                    'status': 'ok' if r.status_code == 200 else 'degraded',
-                    'endpoint': base_url
-                }
+            r = await get_client().get(f"{base_url}/v1/healthz", timeout=2.0)
+            return {
+                'status': 'ok' if r.status_code == 200 else 'degraded',
+                'endpoint': base_url
+            }
         except Exception as e:
-            site_health[site_id] = {
+            return {
                 'status': 'unreachable',
                 'endpoint': base_url,
                 'error': str(e)
             }
     
+    checks = await asyncio.gather(*(check(s, u) for s, u in config.sites.items()))
+    site_health = dict(zip(config.sites, checks))
+    
     all_ok = all(s['status'] == 'ok' for s in site_health.values())
     
     return JSONResponse({
         'status': 'ok' if all_ok else 'degraded',
         'service': config.service_name,
         'version': '2.0.0',
-        'sites': site_health
+        'sites': site_health,
+        'cache': dict(response_cache.stats, entries=len(response_cache))
     })
 
 
 @app.get('/metrics')
-async def metrics_endpoint() -> Response:
-    """Prometheus metrics endpoint."""
+async def metrics_endpoint(request: Request) -> Response:
+    """Prometheus metrics endpoint (OpenMetrics with exemplars if requested)."""
+    accept = request.headers.get('accept')
     return Response(
-        content=metrics.get_metrics(),
-        media_type=metrics.get_content_type()
+        content=metrics.get_metrics(accept),
+        media_type=metrics.get_content_type(accept)
     )
 
 
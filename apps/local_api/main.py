@@ -9,11 +9,13 @@ import asyncio
 import asyncpg
 import json
 import time
+import hashlib
 from fastapi import FastAPI, HTTPException, Query, Request, Response
 from fastapi.responses import StreamingResponse, JSONResponse
 from pydantic import BaseModel, Field
-from typing import List, Optional
+from typing import Any, Iterable, List, Optional
 from datetime import datetime, timezone, timedelta
+from uuid import UUID
 
 # Import shared utilities
 import sys
@@ -21,7 +23,20 @@ from pathlib import Path
 sys.path.insert(0, str(Path(__file__).parent.parent))
 from shared_utils import setup_logging, get_logger, setup_tracing, instrument_fastapi
 from shared_utils import MetricsCollector, get_metrics_collector, trace_async
-from shared_utils import LocalAPIConfig
+from shared_utils import LocalAPIConfig, KnownAppCache, DedupFilter, AlertManager, first_occurrences
+from shared_utils.metrics import route_template, StageTimer, NULL_STAGE_TIMER
+from shared_utils.profiler import SamplingProfiler
+from shared_utils.workers import serve_workers, pool_sizes, worker_index
+from shared_utils.serialization import dumps, ndjson_lines, encode_cursor, decode_cursor, CursorError
+from shared_utils.wire import read_batch, validate_items
+from shared_utils.event_hub import EventHub, EventFilter, PgEventListener, batch_notification
+from shared_utils.cold_store import ColdStore, cold_window
+from shared_utils.archive import ceil_hour
+from shared_utils.current_state import latest_per_entity
+from shared_utils.stats import (
+    choose_granularity, parse_group_by, job_partial_from_row,
+    merge_job_buckets, merge_event_buckets, merge_failures, histogram_layout
+)
 
 # Configuration
 config = LocalAPIConfig()
@@ -30,14 +45,33 @@ config = LocalAPIConfig()
 setup_logging(config.service_name, level=config.log_level, json_logs=config.json_logs)
 logger = get_logger(__name__)
 
-if config.enable_tracing:
-    tracer = setup_tracing(config.service_name, config.otlp_endpoint)
-else:
-    tracer = None
+tracer = None
 
 # Initialize metrics collector
 metrics = get_metrics_collector(config.service_name)
 
+# Apps already stored in the `app` table, used to skip redundant upserts
+app_cache = KnownAppCache(config.app_cache_max_size)
+
+# Idempotency keys stored recently; retries of those are answered without a round trip
+dedup = DedupFilter(config.dedup_max_keys, config.dedup_window_s) if config.dedup_enabled else None
+
+# SSE fan-out: one LISTEN connection per process feeds all /v1/stream clients.
+# Event ids carry the event's `at`, so any worker can resume a stream from the database.
+event_hub = EventHub(config.stream_replay_size, config.stream_subscriber_buffer, cursor=lambda ev: ev.get('ingested_at'))
+event_listener: Optional[PgEventListener] = None
+
+# Streaming alert evaluation over the same event feed
+alert_manager = AlertManager(
+    history_size=config.alerts_history_size,
+    window_s=config.alerts_window_s,
+    min_jobs=config.alerts_min_jobs
+)
+alert_task: Optional[asyncio.Task] = None
+# Raised alerts wait here for the sender, so slow channels never stall evaluation
+alert_outbox: Optional[asyncio.Queue] = None
+alert_sender_task: Optional[asyncio.Task] = None
+
 # FastAPI app
 app = FastAPI(
     title='Local Site API',
@@ -45,9 +79,20 @@ app = FastAPI(
     description='Event ingestion and query service with TimescaleDB'
 )
 
-# Instrument with tracing
-if config.enable_tracing:
-    instrument_fastapi(app)
+
+def init_worker(index: int) -> None:
+    """
+    Per-process setup, run in each worker after the fork (see serve_workers).
+    
+    The span exporter's thread and connection do not survive a fork, and
+    the metrics collector is replaced by the multiprocess one, so neither
+    can be set up at import time.
+    """
+    global metrics, tracer
+    metrics = get_metrics_collector()
+    if config.enable_tracing:
+        tracer = setup_tracing(config.service_name, config.otlp_endpoint)
+        instrument_fastapi(app)
 
 
 class IngestEvent(BaseModel):
@@ -80,7 +125,7 @@ async def metrics_middleware(request: Request, call_next):
     
     metrics.record_http_request(
         method=request.method,
-        endpoint=request.url.path,
+        endpoint=route_template(request),
         status=response.status_code,
         duration=duration
     )
@@ -96,15 +141,23 @@ async def get_pool() -> asyncpg.Pool:
         Connection pool instance
     """
     if not hasattr(app.state, 'pool'):
+        # DB_POOL_MAX_SIZE is the budget of the whole service, split across workers
+        min_size, max_size = pool_sizes(config.db_pool_min_size, config.db_pool_max_size, config.workers)
         logger.info(
             "creating_db_pool",
-            min_size=config.db_pool_min_size,
-            max_size=config.db_pool_max_size
+            min_size=min_size,
+            max_size=max_size,
+            worker=worker_index(),
+            pgbouncer=config.db_pgbouncer
         )
+        warm = config.db_statement_cache_size > 0 and not config.db_pgbouncer
+        # create_pool opens and initializes min_size connections before returning
         app.state.pool = await asyncpg.create_pool(
             config.database_url,
-            min_size=config.db_pool_min_size,
-            max_size=config.db_pool_max_size
+            min_size=min_size,
+            max_size=max_size,
+            statement_cache_size=config.db_statement_cache_size,
+            init=prepare_connection if warm else None
         )
         logger.info("db_pool_created")
     
@@ -115,11 +168,229 @@ async def get_pool() -> asyncpg.Pool:
     return app.state.pool
 
 
+async def prepare_connection(con: asyncpg.Connection) -> None:
+    """
+    Pool `init` callback: prepare the ingest statements on a new connection.
+    
+    Each statement runs once with empty arrays (no rows) in a transaction
+    that is rolled back, which leaves it in the connection's statement
+    cache; later ingests skip the parse/plan round trip.
+    """
+    start = time.time()
+    tr = con.transaction()
+    await tr.start()
+    try:
+        for sql, params in PREPARED_STATEMENTS:
+            await con.execute(sql, *([[]] * params))
+    finally:
+        await tr.rollback()
+    logger.debug("db_connection_prepared", statements=len(PREPARED_STATEMENTS),
+                 duration_s=round(time.time() - start, 4))
+
+
+async def notify_inserted(con: asyncpg.Connection, rows: List[tuple], inserted: List[asyncpg.Record]) -> None:
+    """
+    Announce inserted events on the `evt` channel for /v1/stream listeners.
+    
+    Runs inside the ingest transaction, so the notification is delivered
+    on commit and only then. Ingest-only nodes (STREAM_NOTIFY_ENABLED=false)
+    send nothing.
+    """
+    if not config.stream_notify_enabled or not inserted:
+        return
+    ingested = max(r['ingested_at'] for r in inserted)
+    payload = batch_notification(rows, ingested=ingested)
+    if payload is not None:
+        await con.execute(NOTIFY_EVENTS, payload)
+
+
+async def warm_app_cache(pool: asyncpg.Pool) -> None:
+    """Pre-load the known-app cache with the most recently created apps."""
+    try:
+        async with pool.acquire() as con:
+            rows = await con.fetch(
+                'SELECT app_id, name, version FROM app ORDER BY created_at DESC LIMIT $1',
+                config.app_cache_max_size
+            )
+        # Oldest first so the newest apps end up most recently used
+        size = app_cache.warm((r['app_id'], r['name'], r['version']) for r in reversed(rows))
+        metrics.update_cache_size('app', size)
+        logger.info("app_cache_warmed", entries=size)
+    except Exception as e:
+        logger.warning("app_cache_warm_failed", error=str(e))
+
+
+def app_needs_write(ev: IngestEvent) -> bool:
+    """Check the known-app cache; True if the `app` row must be upserted."""
+    hit = app_cache.is_current(ev.app['app_id'], ev.app.get('name', ''), ev.app.get('version', ''))
+    metrics.record_cache_lookup('app', hit)
+    return not hit
+
+
+def remember_app(ev: IngestEvent) -> None:
+    """Record a committed `app` write in the known-app cache."""
+    app_cache.add(ev.app['app_id'], ev.app.get('name', ''), ev.app.get('version', ''))
+    metrics.update_cache_size('app', len(app_cache))
+
+
+def is_duplicate(key: str) -> bool:
+    """Check the dedup filter; True if an event with `key` was stored recently."""
+    if dedup is None or not dedup.seen(key):
+        return False
+    metrics.record_duplicates('filter')
+    return True
+
+
+def remember_keys(keys: Iterable[str]) -> None:
+    """Record committed (or already stored) idempotency keys in the dedup filter."""
+    if dedup is not None:
+        dedup.add_many(keys)
+        metrics.update_cache_size('dedup', len(dedup))
+
+
+# Upsert that only touches the row when name/version actually changed
+APP_UPSERT_CONFLICT = """
+    ON CONFLICT (app_id) DO UPDATE SET name = EXCLUDED.name, version = EXCLUDED.version
+    WHERE app.name IS DISTINCT FROM EXCLUDED.name OR app.version IS DISTINCT FROM EXCLUDED.version
+"""
+
+# Set-based inserts used for single events and batches alike, so each table
+# has one statement text that every connection prepares once and reuses.
+APP_BULK_INSERT = """
+    INSERT INTO app(app_id, name, version, site_id)
+    SELECT * FROM unnest($1::uuid[], $2::text[], $3::text[], $4::text[])
+""" + APP_UPSERT_CONFLICT
+
+EVENT_BULK_INSERT = """
+    INSERT INTO event(at, entity_type, entity_id, app_id, site_id, kind, payload, idempotency_key)
+    SELECT at, entity_type, entity_id, app_id, site_id, kind, payload::jsonb, idempotency_key
+    FROM unnest($1::timestamptz[], $2::text[], $3::uuid[], $4::uuid[], $5::text[],
+                $6::text[], $7::text[], $8::text[])
+         AS t(at, entity_type, entity_id, app_id, site_id, kind, payload, idempotency_key)
+    ON CONFLICT (idempotency_key) DO NOTHING
+    RETURNING idempotency_key, ingested_at
+"""
+
+# History rows are keyed by (id, inserted_at); offset inserted_at by the
+# row's position so several events for one entity in a batch stay distinct
+JOB_BULK_INSERT = """
+    INSERT INTO job(job_id, app_id, site_id, job_key, status, started_at, ended_at, duration_s,
+                     cpu_user_s, cpu_system_s, mem_max_mb, metadata, inserted_at)
+    SELECT job_id, app_id, site_id, job_key, status, started_at, ended_at, duration_s,
+           cpu_user_s, cpu_system_s, mem_max_mb, metadata::jsonb,
+           now() + ord * INTERVAL '1 microsecond'
+    FROM unnest($1::uuid[], $2::uuid[], $3::text[], $4::text[], $5::text[],
+                $6::timestamptz[], $7::timestamptz[], $8::float8[], $9::float8[],
+                $10::float8[], $11::float8[], $12::text[]) WITH ORDINALITY
+         AS t(job_id, app_id, site_id, job_key, status, started_at, ended_at, duration_s,
+              cpu_user_s, cpu_system_s, mem_max_mb, metadata, ord)
+"""
+
+SUBJOB_BULK_INSERT = """
+    INSERT INTO subjob(subjob_id, job_id, app_id, site_id, sub_key, status, started_at, ended_at,
+                       duration_s, cpu_user_s, cpu_system_s, mem_max_mb, metadata, inserted_at)
+    SELECT subjob_id, job_id, app_id, site_id, sub_key, status, started_at, ended_at,
+           duration_s, cpu_user_s, cpu_system_s, mem_max_mb, metadata::jsonb,
+           now() + ord * INTERVAL '1 microsecond'
+    FROM unnest($1::uuid[], $2::uuid[], $3::uuid[], $4::text[], $5::text[], $6::text[],
+                $7::timestamptz[], $8::timestamptz[], $9::float8[], $10::float8[],
+                $11::float8[], $12::float8[], $13::text[]) WITH ORDINALITY
+         AS t(subjob_id, job_id, app_id, site_id, sub_key, status, started_at, ended_at,
+              duration_s, cpu_user_s, cpu_system_s, mem_max_mb, metadata, ord)
+"""
+
+# Current-state upserts. Rows are keyed by entity id; an event only replaces
+# the stored state if it is at least as recent, so replayed/out-of-order
+# events cannot roll a job back. A missing started_at keeps the known one.
+JOB_CURRENT_UPSERT = """
+    INSERT INTO job_current(job_id, app_id, site_id, job_key, status, started_at, ended_at, duration_s,
+                            cpu_user_s, cpu_system_s, mem_max_mb, metadata, event_at)
+    SELECT job_id, app_id, site_id, job_key, status, started_at, ended_at, duration_s,
+           cpu_user_s, cpu_system_s, mem_max_mb, metadata::jsonb, event_at
+    FROM unnest($1::uuid[], $2::uuid[], $3::text[], $4::text[], $5::text[],
+                $6::timestamptz[], $7::timestamptz[], $8::float8[], $9::float8[],
+                $10::float8[], $11::float8[], $12::text[], $13::timestamptz[])
+         AS t(job_id, app_id, site_id, job_key, status, started_at, ended_at, duration_s,
+              cpu_user_s, cpu_system_s, mem_max_mb, metadata, event_at)
+    ON CONFLICT (job_id) DO UPDATE SET
+        app_id = EXCLUDED.app_id, site_id = EXCLUDED.site_id, job_key = EXCLUDED.job_key,
+        status = EXCLUDED.status,
+        started_at = COALESCE(EXCLUDED.started_at, job_current.started_at),
+        ended_at = EXCLUDED.ended_at, duration_s = EXCLUDED.duration_s,
+        cpu_user_s = EXCLUDED.cpu_user_s, cpu_system_s = EXCLUDED.cpu_system_s,
+        mem_max_mb = EXCLUDED.mem_max_mb, metadata = EXCLUDED.metadata,
+        event_at = EXCLUDED.event_at, inserted_at = now()
+    WHERE job_current.event_at <= EXCLUDED.event_at
+"""
+
+SUBJOB_CURRENT_UPSERT = """
+    INSERT INTO subjob_current(subjob_id, job_id, app_id, site_id, sub_key, status, started_at, ended_at,
+                               duration_s, cpu_user_s, cpu_system_s, mem_max_mb, metadata, event_at)
+    SELECT subjob_id, job_id, app_id, site_id, sub_key, status, started_at, ended_at,
+           duration_s, cpu_user_s, cpu_system_s, mem_max_mb, metadata::jsonb, event_at
+    FROM unnest($1::uuid[], $2::uuid[], $3::uuid[], $4::text[], $5::text[], $6::text[],
+                $7::timestamptz[], $8::timestamptz[], $9::float8[], $10::float8[],
+                $11::float8[], $12::float8[], $13::text[], $14::timestamptz[])
+         AS t(subjob_id, job_id, app_id, site_id, sub_key, status, started_at, ended_at,
+              duration_s, cpu_user_s, cpu_system_s, mem_max_mb, metadata, event_at)
+    ON CONFLICT (subjob_id) DO UPDATE SET
+        job_id = EXCLUDED.job_id, app_id = EXCLUDED.app_id, site_id = EXCLUDED.site_id,
+        sub_key = EXCLUDED.sub_key, status = EXCLUDED.status,
+        started_at = COALESCE(EXCLUDED.started_at, subjob_current.started_at),
+        ended_at = EXCLUDED.ended_at, duration_s = EXCLUDED.duration_s,
+        cpu_user_s = EXCLUDED.cpu_user_s, cpu_system_s = EXCLUDED.cpu_system_s,
+        mem_max_mb = EXCLUDED.mem_max_mb, metadata = EXCLUDED.metadata,
+        event_at = EXCLUDED.event_at, inserted_at = now()
+    WHERE subjob_current.event_at <= EXCLUDED.event_at
+"""
+
+NOTIFY_EVENTS = "SELECT pg_notify('evt', $1)"
+
+# Statements prepared on every new pool connection, with their parameter counts
+PREPARED_STATEMENTS = [
+    (APP_BULK_INSERT, 4),
+    (EVENT_BULK_INSERT, 8),
+    (JOB_BULK_INSERT, 12),
+    (SUBJOB_BULK_INSERT, 13),
+    (JOB_CURRENT_UPSERT, 13),
+    (SUBJOB_CURRENT_UPSERT, 14),
+]
+
+
 @app.on_event('startup')
 async def startup() -> None:
     """Startup handler - initialize database pool."""
     logger.info("service_starting", database_url=config.database_url.split('@')[-1])
-    await get_pool()
+    await warm_app_cache(await get_pool())
+    
+    global cold_store
+    if config.cold_enabled:
+        cold_store = ColdStore(
+            config.archive_s3_bucket,
+            config.archive_s3_prefix,
+            config.site_id,
+            config.cold_cache_dir,
+            config.cold_cache_max_mb * 1024 * 1024
+        )
+    
+    global event_listener
+    event_listener = PgEventListener(
+        # LISTEN needs a session, which pgbouncer transaction pooling does not keep
+        config.listen_database_url or config.database_url,
+        event_hub,
+        channel='evt',
+        backfill=_backfill_events,
+        fetch=_fetch_events,
+        dedupe_size=max(10000, config.stream_replay_size)
+    )
+    event_listener.start()
+    
+    global alert_task, alert_outbox, alert_sender_task
+    # Every worker sees every event; one of them evaluates and sends alerts
+    if config.alerts_stream_enabled and worker_index() == 0:
+        alert_outbox = asyncio.Queue(maxsize=config.alerts_queue_size)
+        alert_sender_task = asyncio.create_task(_alert_sender(alert_outbox))
+        alert_task = asyncio.create_task(_alert_loop(alert_outbox))
     logger.info("service_started")
 
 
@@ -127,11 +398,114 @@ async def startup() -> None:
 async def shutdown() -> None:
     """Shutdown handler - close database pool."""
     logger.info("service_shutting_down")
+    for task in (alert_task, alert_sender_task):
+        if task is not None:
+            task.cancel()
+            await asyncio.gather(task, return_exceptions=True)
+    if event_listener is not None:
+        await event_listener.stop()
     if hasattr(app.state, 'pool'):
         await app.state.pool.close()
         logger.info("db_pool_closed")
 
 
+async def _alert_loop(outbox: asyncio.Queue) -> None:
+    """
+    Feed stored events to the alert manager and queue the alerts it raises.
+    
+    Sending happens in `_alert_sender`; if the outbox is full (the channels
+    are down or slower than alerts are raised) new alerts are dropped and
+    logged rather than holding up evaluation.
+    """
+    sub = event_hub.subscribe(EventFilter())
+    next_tick = time.monotonic() + config.alerts_tick_s
+    try:
+        while True:
+            item = await sub.get(timeout=config.alerts_tick_s)
+            try:
+                new_alerts = alert_manager.observe(item[1]) if item is not None else []
+                if time.monotonic() >= next_tick:
+                    next_tick = time.monotonic() + config.alerts_tick_s
+                    new_alerts.extend(alert_manager.tick())
+                for alert in new_alerts:
+                    try:
+                        outbox.put_nowait(alert)
+                    except asyncio.QueueFull:
+                        logger.warning("alert_dropped", alert_name=alert.name, queued=outbox.qsize())
+            except Exception as e:
+                logger.error("alert_evaluation_failed", error=str(e))
+    finally:
+        sub.close()
+
+
+async def _alert_sender(outbox: asyncio.Queue) -> None:
+    """Send queued alerts to the notification channels, one at a time."""
+    while True:
+        alert = await outbox.get()
+        try:
+            await alert_manager.send_alert(alert)
+        except Exception as e:
+            logger.error("alert_send_failed", alert_name=alert.name, error=str(e))
+
+
+class EventValidationError(ValueError):
+    """Raised when an incoming event fails validation."""
+
+
+def _parse_ts(value: Optional[str]) -> Optional[datetime]:
+    """Parse an optional ISO 8601 timestamp (accepts a trailing 'Z')."""
+    if value is None or isinstance(value, datetime):
+        return value
+    return datetime.fromisoformat(str(value).replace('Z', '+00:00'))
+
+
+def validate_event(ev: IngestEvent, now: datetime, timer: StageTimer = NULL_STAGE_TIMER) -> datetime:
+    """
+    Validate an event and return its parsed timestamp.
+    
+    Args:
+        ev: Event to validate
+        now: Reference time for the skew check
+        timer: Records the 'parse', 'skew_check' and 'validate' stages
+        
+    Returns:
+        Parsed event timestamp
+        
+    Raises:
+        EventValidationError: If the event is malformed or too skewed
+    """
+    try:
+        ev_at = _parse_ts(ev.event['at'])
+    except (KeyError, TypeError, ValueError) as e:
+        logger.error("invalid_event_timestamp", error=str(e))
+        raise EventValidationError('Invalid event timestamp')
+    
+    if ev_at.tzinfo is None:
+        ev_at = ev_at.replace(tzinfo=timezone.utc)
+    timer.mark('parse')
+    
+    # Validate time skew
+    skew = abs((now - ev_at).total_seconds())
+    if skew > config.max_skew_s:
+        logger.warning(
+            "event_time_skew_exceeded",
+            skew_s=skew,
+            max_skew_s=config.max_skew_s
+        )
+        raise EventValidationError(f'Event time skew too large: {skew}s')
+    timer.mark('skew_check')
+    
+    if ev.entity.get('type') not in ('job', 'subjob'):
+        raise EventValidationError(f"Invalid entity type: {ev.entity.get('type')}")
+    
+    for section, key in (('entity', 'id'), ('app', 'app_id'), ('event', 'kind')):
+        if not getattr(ev, section).get(key):
+            raise EventValidationError(f'Missing {section}.{key}')
+    timer.mark('validate')
+    
+    return ev_at
+
+
 @app.post('/v1/ingest/events', response_model=dict)
 @trace_async("ingest_event")
 async def ingest(ev: IngestEvent) -> JSONResponse:
@@ -152,36 +526,29 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
     """
     start_time = time.time()
     now = datetime.now(timezone.utc)
+    timer = metrics.stage_timer('single')
     
-    try:
-        ev_at = datetime.fromisoformat(ev.event['at'])
-    except (KeyError, ValueError) as e:
-        logger.error("invalid_event_timestamp", error=str(e))
-        raise HTTPException(status_code=422, detail='Invalid event timestamp')
+    if is_duplicate(ev.idempotency_key):
+        return JSONResponse({'ok': True, 'duplicate': True, 'duration_s': round(time.time() - start_time, 4)})
     
-    # Validate time skew
-    skew = abs((now - ev_at).total_seconds())
-    if skew > config.max_skew_s:
-        logger.warning(
-            "event_time_skew_exceeded",
-            skew_s=skew,
-            max_skew_s=config.max_skew_s
-        )
-        raise HTTPException(status_code=422, detail=f'Event time skew too large: {skew}s')
+    try:
+        ev_at = validate_event(ev, now, timer)
+    except EventValidationError as e:
+        raise HTTPException(status_code=422, detail=str(e))
     
     pool = await get_pool()
     
     try:
         async with pool.acquire() as con:
+            timer.mark('pool_acquire')
             async with con.transaction():
+                timer.mark('begin')
                 # Insert event
                 db_start = time.time()
-                await con.execute("""
-                    INSERT INTO event(at, entity_type, entity_id, app_id, site_id, kind, payload, idempotency_key)
-                    VALUES($1,$2,$3,$4,$5,$6,$7,$8)
-                    ON CONFLICT (idempotency_key) DO NOTHING
-                """, ev_at, ev.entity['type'], ev.entity['id'], ev.app['app_id'], ev.site_id,
-                     ev.event['kind'], json.dumps(ev.event), ev.idempotency_key)
+                rows = await con.fetch(EVENT_BULK_INSERT, *_columns([_event_row(ev, ev_at)]))
+                timer.mark('insert_event')
+                if rows:
+                    await notify_inserted(con, [(ev.idempotency_key, ev_at)], rows)
                 
                 metrics.record_db_operation(
                     'insert',
@@ -190,36 +557,31 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
                     time.time() - db_start
                 )
                 
-                # Insert app
-                db_start = time.time()
-                await con.execute("""
-                    INSERT INTO app(app_id, name, version, site_id)
-                    VALUES($1,$2,$3,$4)
-                    ON CONFLICT (app_id) DO NOTHING
-                """, ev.app['app_id'], ev.app.get('name', ''), ev.app.get('version', ''), ev.site_id)
+                # A duplicate was stored with its app, history row and current state
+                inserted = bool(rows)
                 
-                metrics.record_db_operation(
-                    'insert',
-                    'app',
-                    'success',
-                    time.time() - db_start
-                )
+                # Insert app (skipped when the cache says it is already current)
+                write_app = inserted and app_needs_write(ev)
+                if write_app:
+                    db_start = time.time()
+                    await con.execute(APP_BULK_INSERT, *_columns(
+                        [(ev.app['app_id'], ev.app.get('name', ''), ev.app.get('version', ''), ev.site_id)]))
+                    timer.mark('insert_app')
+                    
+                    metrics.record_db_operation(
+                        'insert',
+                        'app',
+                        'success',
+                        time.time() - db_start
+                    )
                 
                 # Insert job or subjob
-                if ev.entity['type'] == 'job':
+                if not inserted:
+                    metrics.record_duplicates('database')
+                elif ev.entity['type'] == 'job':
                     db_start = time.time()
-                    await con.execute("""
-                        INSERT INTO job(job_id, app_id, site_id, job_key, status, started_at, ended_at, duration_s,
-                                         cpu_user_s, cpu_system_s, mem_max_mb, metadata)
-                        VALUES($1,$2,$3,$4,$5,$6,$7,$8,$9,$10,$11,$12)
-                    """, ev.entity['id'], ev.app['app_id'], ev.site_id, ev.entity.get('business_key', ''),
-                         ev.event.get('status', 'running'),
-                         ev.event.get('started_at'), ev.event.get('ended_at'),
-                         (ev.event.get('metrics') or {}).get('duration_s'),
-                         (ev.event.get('metrics') or {}).get('cpu_user_s', 0.0),
-                         (ev.event.get('metrics') or {}).get('cpu_system_s', 0.0),
-                         (ev.event.get('metrics') or {}).get('mem_max_mb', 0.0),
-                         json.dumps(ev.event.get('metadata', {})))
+                    await con.execute(JOB_BULK_INSERT, *_columns([_job_row(ev)]))
+                    timer.mark('insert_job')
                     
                     metrics.record_db_operation(
                         'insert',
@@ -229,18 +591,8 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
                     )
                 else:
                     db_start = time.time()
-                    await con.execute("""
-                        INSERT INTO subjob(subjob_id, job_id, app_id, site_id, sub_key, status, started_at, ended_at, duration_s,
-                                           cpu_user_s, cpu_system_s, mem_max_mb, metadata)
-                        VALUES($1,$2,$3,$4,$5,$6,$7,$8,$9,$10,$11,$12,$13)
-                    """, ev.entity['id'], ev.entity.get('parent_id'), ev.app['app_id'], ev.site_id,
-                         ev.entity.get('sub_key', ''),
-                         ev.event.get('status', 'running'), ev.event.get('started_at'), ev.event.get('ended_at'),
-                         (ev.event.get('metrics') or {}).get('duration_s'),
-                         (ev.event.get('metrics') or {}).get('cpu_user_s', 0.0),
-                         (ev.event.get('metrics') or {}).get('cpu_system_s', 0.0),
-                         (ev.event.get('metrics') or {}).get('mem_max_mb', 0.0),
-                         json.dumps(ev.event.get('metadata', {})))
+                    await con.execute(SUBJOB_BULK_INSERT, *_columns([_subjob_row(ev)]))
+                    timer.mark('insert_subjob')
                     
                     metrics.record_db_operation(
                         'insert',
@@ -248,6 +600,15 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
                         'success',
                         time.time() - db_start
                     )
+                
+                if inserted:
+                    await _upsert_current(con, [(ev, ev_at)], timer)
+            timer.mark('commit')
+        
+        if write_app:
+            remember_app(ev)
+        remember_keys([ev.idempotency_key])
+        invalidate_watermarks()
         
         duration = time.time() - start_time
         logger.info(
@@ -258,7 +619,7 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
             duration_s=round(duration, 4)
         )
         
-        return JSONResponse({'ok': True, 'duration_s': round(duration, 4)})
+        return JSONResponse({'ok': True, 'duplicate': not inserted, 'duration_s': round(duration, 4)})
     
     except Exception as e:
         logger.error(
@@ -271,251 +632,1250 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
         raise HTTPException(status_code=500, detail=f'Ingestion failed: {str(e)}')
 
 
+def _event_row(ev: IngestEvent, ev_at: datetime) -> tuple:
+    """Build the `event` column values for an event."""
+    return (ev_at, ev.entity['type'], ev.entity['id'], ev.app['app_id'], ev.site_id,
+            ev.event['kind'], json.dumps(ev.event), ev.idempotency_key)
+
+
+def _job_row(ev: IngestEvent) -> tuple:
+    """Build the `job` column values for an event."""
+    m = ev.event.get('metrics') or {}
+    return (
+        ev.entity['id'], ev.app['app_id'], ev.site_id, ev.entity.get('business_key') or '',
+        ev.event.get('status', 'running'),
+        _parse_ts(ev.event.get('started_at')), _parse_ts(ev.event.get('ended_at')),
+        m.get('duration_s'), m.get('cpu_user_s', 0.0), m.get('cpu_system_s', 0.0),
+        m.get('mem_max_mb', 0.0),
+        json.dumps(ev.event.get('metadata', {}))
+    )
+
+
+def _subjob_row(ev: IngestEvent) -> tuple:
+    """Build the `subjob` column values for an event."""
+    m = ev.event.get('metrics') or {}
+    return (
+        ev.entity['id'], ev.entity.get('parent_id'), ev.app['app_id'], ev.site_id,
+        ev.entity.get('sub_key') or '',
+        ev.event.get('status', 'running'),
+        _parse_ts(ev.event.get('started_at')), _parse_ts(ev.event.get('ended_at')),
+        m.get('duration_s'), m.get('cpu_user_s', 0.0), m.get('cpu_system_s', 0.0),
+        m.get('mem_max_mb', 0.0),
+        json.dumps(ev.event.get('metadata', {}))
+    )
+
+
+def _columns(rows: List[tuple]) -> List[list]:
+    """Transpose row tuples into per-column lists for `unnest`."""
+    return [list(col) for col in zip(*rows)]
+
+
+async def _upsert_current(
+    con: asyncpg.Connection,
+    valid: List[tuple],
+    timer: StageTimer = NULL_STAGE_TIMER
+) -> None:
+    """
+    Apply events to the `job_current` / `subjob_current` state tables.
+    
+    Args:
+        con: Connection with an open transaction
+        valid: List of (event, parsed_at) pairs that were newly stored
+        timer: Records the 'upsert_current' stage
+    """
+    # One row per entity: ON CONFLICT DO UPDATE cannot touch a row twice
+    jobs = [_job_row(ev) + (ev_at,) for ev, ev_at in latest_per_entity(valid, 'job')]
+    if jobs:
+        db_start = time.time()
+        await con.execute(JOB_CURRENT_UPSERT, *_columns(jobs))
+        metrics.record_db_operation('upsert', 'job_current', 'success', time.time() - db_start)
+    
+    subjobs = [_subjob_row(ev) + (ev_at,) for ev, ev_at in latest_per_entity(valid, 'subjob')]
+    if subjobs:
+        db_start = time.time()
+        await con.execute(SUBJOB_CURRENT_UPSERT, *_columns(subjobs))
+        metrics.record_db_operation('upsert', 'subjob_current', 'success', time.time() - db_start)
+    timer.mark('upsert_current')
+
+
+async def _bulk_insert(
+    con: asyncpg.Connection,
+    valid: List[tuple],
+    timer: StageTimer = NULL_STAGE_TIMER
+) -> tuple:
+    """
+    Write a validated batch with one set-based statement per table.
+    
+    Args:
+        con: Connection with an open transaction
+        valid: List of (event, parsed_at) pairs
+        timer: Records one stage per statement
+        
+    Returns:
+        Tuple of (idempotency keys newly inserted into `event`,
+        app rows written that should be added to the cache once committed)
+    """
+    # Apps first: job rows reference app(app_id). Dedupe so each app is sent
+    # once, and skip apps the cache already knows to be current.
+    seen = set()
+    apps = {}
+    for ev, _ in valid:
+        key = str(ev.app['app_id']).lower()
+        if key in seen:
+            continue
+        seen.add(key)
+        if app_needs_write(ev):
+            apps[key] = (ev.app['app_id'], ev.app.get('name', ''), ev.app.get('version', ''), ev.site_id)
+    
+    if apps:
+        db_start = time.time()
+        await con.execute(APP_BULK_INSERT, *_columns(list(apps.values())))
+        metrics.record_db_operation('insert_batch', 'app', 'success', time.time() - db_start)
+    timer.mark('insert_app')
+    
+    db_start = time.time()
+    inserted = await con.fetch(EVENT_BULK_INSERT, *_columns([_event_row(ev, ev_at) for ev, ev_at in valid]))
+    metrics.record_db_operation('insert_batch', 'event', 'success', time.time() - db_start)
+    timer.mark('insert_event')
+    
+    # Duplicates already have their history and current-state rows
+    inserted_keys = {r['idempotency_key'] for r in inserted}
+    valid = [(ev, ev_at) for ev, ev_at in valid if ev.idempotency_key in inserted_keys]
+    await notify_inserted(con, [(ev.idempotency_key, ev_at) for ev, ev_at in valid], inserted)
+    
+    jobs = [_job_row(ev) for ev, _ in valid if ev.entity['type'] == 'job']
+    if jobs:
+        db_start = time.time()
+        await con.execute(JOB_BULK_INSERT, *_columns(jobs))
+        metrics.record_db_operation('insert_batch', 'job', 'success', time.time() - db_start)
+        timer.mark('insert_job')
+    
+    subjobs = [_subjob_row(ev) for ev, _ in valid if ev.entity['type'] == 'subjob']
+    if subjobs:
+        db_start = time.time()
+        await con.execute(SUBJOB_BULK_INSERT, *_columns(subjobs))
+        metrics.record_db_operation('insert_batch', 'subjob', 'success', time.time() - db_start)
+        timer.mark('insert_subjob')
+    
+    await _upsert_current(con, valid, timer)
+    
+    return inserted_keys, list(apps.values())
+
+
 @app.post('/v1/ingest/events:batch', response_model=dict)
 @trace_async("ingest_batch")
-async def ingest_batch(events: List[IngestEvent]) -> JSONResponse:
+async def ingest_batch(request: Request) -> JSONResponse:
     """
     Ingest a batch of events.
     
+    The body is a JSON array of events, or the same array as msgpack
+    (Content-Type: application/msgpack), optionally zstd-compressed
+    (Content-Encoding: zstd).
+    
+    The whole batch is validated up front, then written with one set-based
+    INSERT per table inside a single transaction. If the bulk write fails
+    (e.g. one row violates a constraint), the valid events are retried one
+    by one so that a single bad row cannot reject the whole batch.
+    
     Args:
-        events: List of events to ingest
+        request: Request whose body holds the events to ingest
         
     Returns:
-        Response with ingestion statistics
+        Response with ingestion statistics and per-item results
     """
-    logger.info("batch_ingestion_started", count=len(events))
+    start_time = time.time()
+    now = datetime.now(timezone.utc)
+    batch = await read_batch(request)
+    logger.info("batch_ingestion_started", count=len(batch.items), content_type=batch.content_type)
     
-    success = 0
-    failed = 0
+    if len(batch.items) > config.max_batch_size:
+        raise HTTPException(
+            status_code=413,
+            detail=f'Batch too large: {len(batch.items)} > {config.max_batch_size}'
+        )
+    events: List[IngestEvent] = validate_items(batch.items, IngestEvent)
+    
+    timer = metrics.stage_timer('batch')
+    # Repeats within the batch and keys stored recently are dropped up front
+    fresh = first_occurrences([ev.idempotency_key for ev in events], is_duplicate)
+    fresh_set = set(fresh)
+    results: List[dict] = [
+        {'index': i, 'idempotency_key': ev.idempotency_key,
+         'status': 'accepted' if i in fresh_set else 'duplicate'}
+        for i, ev in enumerate(events)
+    ]
+    valid: List[tuple] = []
+    valid_idx: List[int] = []
     
-    for ev in events:
+    for i in fresh:
+        ev = events[i]
         try:
-            await ingest(ev)
-            success += 1
-        except HTTPException:
-            failed += 1
+            valid.append((ev, validate_event(ev, now)))
+            valid_idx.append(i)
+        except EventValidationError as e:
+            results[i].update(status='rejected', error=str(e))
+    timer.mark('validate')
+    
+    if valid:
+        pool = await get_pool()
+        try:
+            async with pool.acquire() as con:
+                timer.mark('pool_acquire')
+                async with con.transaction():
+                    timer.mark('begin')
+                    inserted, written_apps = await _bulk_insert(con, valid, timer)
+                timer.mark('commit')
+            invalidate_watermarks()
+            for app_id, name, version, _ in written_apps:
+                app_cache.add(app_id, name, version)
+            metrics.update_cache_size('app', len(app_cache))
+            remember_keys(ev.idempotency_key for ev, _ in valid)
+            metrics.record_duplicates('database', len(valid) - len(inserted))
+            for i in valid_idx:
+                if events[i].idempotency_key not in inserted:
+                    results[i]['status'] = 'duplicate'
+        except Exception as e:
+            logger.warning(
+                "batch_bulk_insert_failed_falling_back",
+                error=str(e),
+                error_type=type(e).__name__,
+                count=len(valid)
+            )
+            metrics.record_db_operation('insert_batch', 'event', 'failed', 0)
+            for i in valid_idx:
+                try:
+                    response = await ingest(events[i])
+                    if json.loads(response.body).get('duplicate'):
+                        results[i]['status'] = 'duplicate'
+                except HTTPException as he:
+                    results[i].update(status='rejected', error=str(he.detail))
+    
+    failed = sum(1 for r in results if r['status'] == 'rejected')
+    duplicates = sum(1 for r in results if r['status'] == 'duplicate')
+    duration = time.time() - start_time
     
     logger.info(
         "batch_ingestion_completed",
         total=len(events),
-        success=success,
-        failed=failed
+        success=len(events) - failed,
+        failed=failed,
+        duplicates=duplicates,
+        duration_s=round(duration, 4)
     )
     
     return JSONResponse({
-        'ok': True,
+        'ok': failed == 0,
         'total': len(events),
-        'success': success,
-        'failed': failed
+        'success': len(events) - failed,
+        'failed': failed,
+        'duplicates': duplicates,
+        'results': results,
+        'duration_s': round(duration, 4)
     })
 
 
+# Latest inserted_at per current-state table, memoized briefly so that
+# conditional requests cost at most one index lookup per interval
+_watermarks: dict = {}
+
+
+def invalidate_watermarks() -> None:
+    """Forget memoized watermarks after this process wrote new state."""
+    _watermarks.clear()
+
+
+async def _table_watermark(pool: asyncpg.Pool, table: str) -> Optional[datetime]:
+    """Latest `inserted_at` in a current-state table (memoized for `etag_watermark_ttl_s`)."""
+    cached = _watermarks.get(table)
+    if cached and time.monotonic() - cached[0] < config.etag_watermark_ttl_s:
+        return cached[1]
+    async with pool.acquire() as con:
+        value = await con.fetchval(f'SELECT max(inserted_at) FROM {table}')
+    _watermarks[table] = (time.monotonic(), value)
+    return value
+
+
+async def _page_etag(pool: asyncpg.Pool, table: str, request: Request) -> str:
+    """
+    Weak ETag for a query page: the table watermark, the retention cut and
+    the normalized query string.
+    
+    The cut changes the result without a new write (rows age out of the
+    current-state tables), so it is part of the tag.
+    """
+    watermark = await _table_watermark(pool, table)
+    query = '&'.join(f'{k}={v}' for k, v in sorted(request.query_params.multi_items()))
+    cut = _cold_cutoff().isoformat()
+    digest = hashlib.sha1(f'{table}|{watermark}|{cut}|{query}'.encode('utf-8')).hexdigest()[:20]
+    return f'W/"{digest}"'
+
+
+def _if_none_match(request: Request) -> List[str]:
+    header = request.headers.get('if-none-match', '')
+    return [tag.strip() for tag in header.split(',') if tag.strip()]
+
+
+# Archived (cold) tier: ranges older than the hot retention are read from
+# the archiver's Parquet partitions
+cold_store: Optional[ColdStore] = None
+
+
+def _cold_cutoff() -> datetime:
+    """Boundary between the tiers: older rows are served from the archive."""
+    return ceil_hour(datetime.now(timezone.utc) - timedelta(hours=config.hot_retention_hours))
+
+
+def _cold_range(
+    frm: Optional[str],
+    to: Optional[str],
+    status: Optional[str],
+    app_name: Optional[str] = None
+) -> Optional[dict]:
+    """
+    Describe the cold part of a query, or None if it stays in hot storage.
+    
+    Raises:
+        HTTPException: If the cold range exceeds `cold_max_scan_hours`, or
+            lies entirely past the hot retention while the archive tier is
+            disabled (it would otherwise silently return nothing)
+    """
+    if not frm:
+        return None
+    try:
+        start = _parse_ts(frm)
+        end = _parse_ts(to)
+    except ValueError as e:
+        raise HTTPException(status_code=422, detail=f'Invalid timestamp: {e}')
+    if start.tzinfo is None:
+        start = start.replace(tzinfo=timezone.utc)
+    if end is not None and end.tzinfo is None:
+        end = end.replace(tzinfo=timezone.utc)
+    if cold_store is None:
+        retained = datetime.now(timezone.utc) - timedelta(hours=config.hot_retention_hours)
+        if end is not None and end < retained:
+            raise HTTPException(
+                status_code=422,
+                detail=f'Range is older than the {config.hot_retention_hours}h hot retention '
+                       'and the archive tier is disabled (COLD_ENABLED)'
+            )
+        return None
+    cut = _cold_cutoff()
+    window = cold_window(start, end, cut)
+    if window is None:
+        return None
+    start, end = window
+    if end - start > timedelta(hours=config.cold_max_scan_hours):
+        raise HTTPException(
+            status_code=422,
+            detail=f'Archived range is limited to {config.cold_max_scan_hours} hours per query; narrow from/to'
+        )
+    return {
+        'cut': cut,
+        'start': start,
+        'end': end,
+        'status': [s.strip() for s in status.split(',') if s.strip()] if status else None,
+        'app_name': app_name
+    }
+
+
+def _take(it, n: int) -> List[dict]:
+    return [row for _, row in zip(range(n), it)]
+
+
+async def _cold_batches(
+    pool: asyncpg.Pool,
+    entity: str,
+    id_col: str,
+    cold: dict,
+    before: Optional[tuple],
+    batch_rows: int
+):
+    """
+    Yield archived rows in (inserted_at, id) DESC order, in batches.
+    
+    Entities that have newer state in hot storage are skipped, so each
+    entity appears once across both tiers. Job rows get the app name and
+    version joined in like the hot query.
+    """
+    app_ids = None
+    async with pool.acquire() as con:
+        if cold['app_name']:
+            app_ids = {str(r['app_id']) for r in await con.fetch(
+                'SELECT app_id FROM app WHERE name ILIKE $1', f"%{cold['app_name']}%")}
+    
+    it = cold_store.scan_latest(
+        entity, id_col, cold['start'], cold['end'],
+        before=before, status=cold['status'], app_ids=app_ids
+    )
+    apps: dict = {}
+    while True:
+        scan_start = time.time()
+        batch = await asyncio.to_thread(_take, it, batch_rows)
+        if not batch:
+            return
+        ids = [r[id_col] for r in batch]
+        async with pool.acquire() as con:
+            newer = {str(r['id']) for r in await con.fetch(
+                f'SELECT {id_col} AS id FROM {entity}_current WHERE {id_col} = ANY($1::uuid[]) AND inserted_at >= $2',
+                ids, cold['cut'])}
+            if entity == 'job':
+                missing = list({r['app_id'] for r in batch} - apps.keys())
+                if missing:
+                    for r in await con.fetch(
+                            'SELECT app_id, name, version FROM app WHERE app_id = ANY($1::uuid[])', missing):
+                        apps[str(r['app_id'])] = (r['name'], r['version'])
+        rows = []
+        for r in batch:
+            if r[id_col] in newer:
+                continue
+            # History rows carry no event time
+            r.setdefault('event_at', None)
+            if entity == 'job':
+                r['app_name'], r['app_version'] = apps.get(r['app_id'], (None, None))
+            rows.append(r)
+        metrics.record_db_operation('select', f'{entity}_archive', 'success', time.time() - scan_start)
+        yield rows
+
+
 @app.get('/v1/jobs', response_model=dict)
 @trace_async("get_jobs")
 async def get_jobs(
+    request: Request,
     frm: Optional[str] = Query(None, alias='from', description="Start timestamp (ISO 8601)"),
     to: Optional[str] = Query(None, alias='to', description="End timestamp (ISO 8601)"),
     status: Optional[str] = Query(None, description="Comma-separated status values"),
     app_name: Optional[str] = Query(None, description="Filter by app name (contains)"),
-    limit: int = Query(config.query_default_limit, ge=1, le=config.query_max_limit, description="Result limit")
-) -> JSONResponse:
+    limit: Optional[int] = Query(None, ge=1, description="Result limit (page size)"),
+    cursor: Optional[str] = Query(None, description="Opaque `next` token from a previous page"),
+    since: Optional[str] = Query(None, description="`since` token from a previous response: only rows changed after it"),
+    format: str = Query('json', pattern='^(json|ndjson)$', description="'json' page or streamed 'ndjson'")
+) -> Response:
     """
     Query jobs with filtering.
     
+    Reads the latest state per job from `job_current`; time filters apply
+    to the time of the job's last update. Results are ordered by
+    (inserted_at, job_id) descending and paginated by keyset: pass the
+    returned `next` token as `cursor` to get the following page.
+    With `format=ndjson` rows are streamed from a server-side cursor, one
+    JSON object per line, and `limit` is optional.
+    JSON pages carry an ETag; a matching If-None-Match gets a 304.
+    Pages also return a `since` token; passing it back as `since` returns
+    only the jobs changed in the meantime (see `_query_delta`).
+    
     Args:
+        request: Incoming request (for conditional GET)
         frm: Start timestamp filter
         to: End timestamp filter
         status: Status filter (comma-separated)
         app_name: App name filter (contains match)
         limit: Result limit
+        cursor: Keyset cursor
+        since: Delta token
+        format: Response format
         
     Returns:
-        List of matching jobs
+        Page of matching jobs, a delta, or an NDJSON stream
     """
-    start_time = time.time()
-    pool = await get_pool()
+    select = ('SELECT j.*, a.name AS app_name, a.version AS app_version '
+              'FROM job_current j JOIN app a ON a.app_id = j.app_id')
+    if since is not None:
+        _check_delta_params(to, cursor, format)
+        clauses, params = _current_filters('j', frm, None, None)
+        if app_name:
+            clauses.append(f"a.name ILIKE ${len(params) + 1}")
+            params.append(f"%{app_name}%")
+        return await _query_delta('job', select, 'j', 'job_id', clauses, params,
+                                  _status_list(status), since, limit, request)
     
-    clauses: List[str] = []
-    params: List[any] = []
+    clauses, params = _current_filters('j', frm, to, status)
+    if app_name:
+        clauses.append(f"a.name ILIKE ${len(params) + 1}")
+        params.append(f"%{app_name}%")
     
-    if frm:
-        clauses.append(f"j.inserted_at >= ${len(params) + 1}")
-        params.append(datetime.fromisoformat(frm.replace('Z', '+00:00')))
+    return await _query_current(
+        entity='job',
+        select=select,
+        alias='j',
+        id_col='job_id',
+        clauses=clauses,
+        params=params,
+        limit=limit,
+        cursor=cursor,
+        fmt=format,
+        request=request,
+        cold=_cold_range(frm, to, status, app_name)
+    )
+
+
+@app.get('/v1/subjobs', response_model=dict)
+@trace_async("get_subjobs")
+async def get_subjobs(
+    request: Request,
+    frm: Optional[str] = Query(None, alias='from', description="Start timestamp (ISO 8601)"),
+    to: Optional[str] = Query(None, alias='to', description="End timestamp (ISO 8601)"),
+    status: Optional[str] = Query(None, description="Comma-separated status values"),
+    limit: Optional[int] = Query(None, ge=1, description="Result limit (page size)"),
+    cursor: Optional[str] = Query(None, description="Opaque `next` token from a previous page"),
+    since: Optional[str] = Query(None, description="`since` token from a previous response: only rows changed after it"),
+    format: str = Query('json', pattern='^(json|ndjson)$', description="'json' page or streamed 'ndjson'")
+) -> Response:
+    """
+    Query subjobs with filtering.
     
-    if to:
-        clauses.append(f"j.inserted_at <= ${len(params) + 1}")
-        params.append(datetime.fromisoformat(to.replace('Z', '+00:00')))
+    Reads the latest state per subjob from `subjob_current`; time filters
+    apply to the time of the subjob's last update. Pagination, formats and
+    `since` deltas are the same as for /v1/jobs, keyed on
+    (inserted_at, subjob_id).
     
-    if status:
-        sts = [s.strip() for s in status.split(',') if s.strip()]
-        clauses.append(f"j.status = ANY(${len(params) + 1})")
+    Args:
+        request: Incoming request (for conditional GET)
+        frm: Start timestamp filter
+        to: End timestamp filter
+        status: Status filter (comma-separated)
+        limit: Result limit
+        cursor: Keyset cursor
+        since: Delta token
+        format: Response format
+        
+    Returns:
+        Page of matching subjobs, a delta, or an NDJSON stream
+    """
+    if since is not None:
+        _check_delta_params(to, cursor, format)
+        clauses, params = _current_filters('s', frm, None, None)
+        return await _query_delta('subjob', 'SELECT s.* FROM subjob_current s', 's', 'subjob_id',
+                                  clauses, params, _status_list(status), since, limit, request)
+    
+    clauses, params = _current_filters('s', frm, to, status)
+    
+    return await _query_current(
+        entity='subjob',
+        select='SELECT s.* FROM subjob_current s',
+        alias='s',
+        id_col='subjob_id',
+        clauses=clauses,
+        params=params,
+        limit=limit,
+        cursor=cursor,
+        fmt=format,
+        request=request,
+        cold=_cold_range(frm, to, status)
+    )
+
+
+def _current_filters(
+    alias: str,
+    frm: Optional[str],
+    to: Optional[str],
+    status: Optional[str]
+) -> tuple:
+    """Build the time/status WHERE clauses shared by the current-state queries."""
+    clauses: List[str] = []
+    params: List[Any] = []
+    
+    try:
+        if frm:
+            clauses.append(f"{alias}.inserted_at >= ${len(params) + 1}")
+            params.append(datetime.fromisoformat(frm.replace('Z', '+00:00')))
+        
+        if to:
+            clauses.append(f"{alias}.inserted_at <= ${len(params) + 1}")
+            params.append(datetime.fromisoformat(to.replace('Z', '+00:00')))
+    except ValueError as e:
+        raise HTTPException(status_code=422, detail=f'Invalid timestamp: {e}')
+    
+    sts = _status_list(status)
+    if sts:
+        clauses.append(f"{alias}.status = ANY(${len(params) + 1})")
         params.append(sts)
     
-    where = ("WHERE " + " AND ".join(clauses)) if clauses else ""
+    return clauses, params
+
+
+def _status_list(status: Optional[str]) -> List[str]:
+    """Split a comma-separated status filter."""
+    return [s.strip() for s in status.split(',') if s.strip()] if status else []
+
+
+async def _query_current(
+    entity: str,
+    select: str,
+    alias: str,
+    id_col: str,
+    clauses: List[str],
+    params: List[Any],
+    limit: Optional[int],
+    cursor: Optional[str],
+    fmt: str,
+    request: Optional[Request] = None,
+    cold: Optional[dict] = None
+) -> Response:
+    """
+    Run a keyset-paginated query over a current-state table.
+    
+    With a cold range (see `_cold_range`) the hot query is limited to rows
+    newer than the tier cut-off and continues into the archive: archived
+    rows follow the hot ones in the same order, so pages and cursors work
+    across the boundary.
+    
+    Args:
+        entity: 'job' or 'subjob' (metrics/log label)
+        select: SELECT ... FROM ... part of the query
+        alias: Table alias used in `select`
+        id_col: Id column used as the keyset tie-breaker
+        clauses: WHERE clauses (parameters already in `params`)
+        params: Query parameters
+        limit: Requested page size (None: default for pages, unbounded for streams)
+        cursor: Keyset cursor from a previous page
+        fmt: 'json' for a page, 'ndjson' for a stream
+        request: Incoming request, used for If-None-Match
+        cold: Archived part of the range, if any
+    """
+    start_time = time.time()
+    streaming = fmt == 'ndjson'
+    since = encode_cursor(_delta_horizon(), _MIN_UUID)
+    
+    if not streaming:
+        limit = limit or config.query_default_limit
+        if limit > config.query_max_limit:
+            raise HTTPException(
+                status_code=422,
+                detail=f'limit must be <= {config.query_max_limit}; use format=ndjson for larger exports'
+            )
+    
+    if cursor:
+        try:
+            after_at, after_id = decode_cursor(cursor)
+        except CursorError as e:
+            raise HTTPException(status_code=400, detail=str(e))
+        clauses = clauses + [f"({alias}.inserted_at, {alias}.{id_col}) < (${len(params) + 1}, ${len(params) + 2})"]
+        params = params + [after_at, after_id]
+    
+    # Cursor already past the hot rows: only the archive is left
+    skip_hot = False
+    before_cold = None
+    if cold is not None:
+        clauses = clauses + [f"{alias}.inserted_at >= ${len(params) + 1}"]
+        params = params + [cold['cut']]
+        if cursor and after_at < cold['cut']:
+            skip_hot = True
+            before_cold = (after_at, str(after_id))
     
+    if streaming:
+        limit_sql = f'LIMIT {int(limit)}' if limit else ''
+    else:
+        # One extra row tells whether there is a next page
+        limit_sql = f'LIMIT {int(limit) + 1}'
+    
+    where = ("WHERE " + " AND ".join(clauses)) if clauses else ""
     sql = f'''
-    WITH latest AS (
-      SELECT j.*, ROW_NUMBER() OVER (PARTITION BY j.job_id ORDER BY j.inserted_at DESC) rn
-      FROM job j
-      {where}
-    )
-    SELECT l.*, a.name AS app_name, a.version AS app_version
-    FROM latest l
-    JOIN app a ON a.app_id = l.app_id
-    WHERE l.rn = 1
-    {'AND a.name ILIKE $' + str(len(params) + 1) if app_name else ''}
-    ORDER BY l.inserted_at DESC
-    LIMIT {int(limit)}
+    {select}
+    {where}
+    ORDER BY {alias}.inserted_at DESC, {alias}.{id_col} DESC
+    {limit_sql}
     '''
     
-    if app_name:
-        params.append(f"%{app_name}%")
+    pool = await get_pool()
+    
+    if streaming:
+        async def row_stream():
+            count = 0
+            try:
+                if not skip_hot:
+                    async with pool.acquire() as con:
+                        async with con.transaction(readonly=True):
+                            buf: List[dict] = []
+                            async for r in con.cursor(sql, *params, prefetch=config.query_stream_prefetch):
+                                buf.append(dict(r))
+                                if len(buf) >= config.query_stream_chunk_rows:
+                                    count += len(buf)
+                                    yield ndjson_lines(buf)
+                                    buf = []
+                            if buf:
+                                count += len(buf)
+                                yield ndjson_lines(buf)
+                if cold is not None and not (limit and count >= limit):
+                    async for rows in _cold_batches(pool, entity, id_col, cold, before_cold,
+                                                    config.query_stream_chunk_rows):
+                        if limit:
+                            rows = rows[:limit - count]
+                        count += len(rows)
+                        yield ndjson_lines(rows)
+                        if limit and count >= limit:
+                            break
+                metrics.record_db_operation('stream', entity, 'success', time.time() - start_time)
+                logger.info(f"{entity}s_stream_completed", count=count,
+                            duration_s=round(time.time() - start_time, 4))
+            except Exception as e:
+                # Headers are already sent; the client sees a truncated stream
+                logger.error(f"{entity}s_stream_failed", error=str(e), count=count)
+                metrics.record_db_operation('stream', entity, 'failed', 0)
+                raise
+        
+        return StreamingResponse(row_stream(), media_type='application/x-ndjson')
     
     try:
+        etag = None
+        # Archived partitions can be re-exported without a hot-table write,
+        # so pages that read them carry no validator
+        if request is not None and cold is None:
+            etag = await _page_etag(pool, f'{entity}_current', request)
+            if etag in _if_none_match(request):
+                metrics.record_cache_lookup('etag', True)
+                return Response(status_code=304, headers={'ETag': etag})
+            metrics.record_cache_lookup('etag', False)
+        
         db_start = time.time()
-        async with pool.acquire() as con:
-            rows = await con.fetch(sql, *params)
+        rows: List[Any] = []
+        if not skip_hot:
+            async with pool.acquire() as con:
+                rows = await con.fetch(sql, *params)
         
         metrics.record_db_operation(
             'select',
-            'job',
+            entity,
             'success',
             time.time() - db_start
         )
         
+        hot_count = len(rows)
+        if cold is not None and len(rows) <= limit:
+            rows = list(rows)
+            async for batch in _cold_batches(pool, entity, id_col, cold, before_cold, limit + 1 - len(rows)):
+                rows.extend(batch)
+                if len(rows) > limit:
+                    break
+        
+        next_token = None
+        if len(rows) > limit:
+            rows = rows[:limit]
+            last = rows[-1]
+            next_token = encode_cursor(last['inserted_at'], last[id_col])
         items = [dict(r) for r in rows]
         
         duration = time.time() - start_time
         logger.info(
-            "jobs_query_completed",
+            f"{entity}s_query_completed",
             count=len(items),
+            archived=max(len(items) - hot_count, 0),
             duration_s=round(duration, 4)
         )
         
-        return JSONResponse({
-            'items': items,
-            'count': len(items),
-            'duration_s': round(duration, 4)
-        })
+        return Response(
+            dumps({
+                'items': items,
+                'count': len(items),
+                'next': next_token,
+                'since': since,
+                'duration_s': round(duration, 4)
+            }),
+            media_type='application/json',
+            headers={'ETag': etag} if etag else None
+        )
     
     except Exception as e:
-        logger.error("jobs_query_failed", error=str(e))
-        metrics.record_db_operation('select', 'job', 'failed', 0)
+        logger.error(f"{entity}s_query_failed", error=str(e))
+        metrics.record_db_operation('select', entity, 'failed', 0)
         raise HTTPException(status_code=500, detail=f'Query failed: {str(e)}')
 
 
-@app.get('/v1/subjobs', response_model=dict)
-@trace_async("get_subjobs")
-async def get_subjobs(
-    frm: Optional[str] = Query(None, alias='from', description="Start timestamp (ISO 8601)"),
-    to: Optional[str] = Query(None, alias='to', description="End timestamp (ISO 8601)"),
-    status: Optional[str] = Query(None, description="Comma-separated status values"),
-    limit: int = Query(config.query_default_limit, ge=1, le=config.query_max_limit, description="Result limit")
-) -> JSONResponse:
+# Sorts before every real id: a token at a bare timestamp includes all rows at it
+_MIN_UUID = UUID(int=0)
+
+
+def _delta_horizon() -> datetime:
     """
-    Query subjobs with filtering.
+    Start of the changes a `since` token issued now covers: now minus `query_delta_overlap_s`.
     
-    Args:
-        frm: Start timestamp filter
-        to: End timestamp filter
-        status: Status filter (comma-separated)
-        limit: Result limit
-        
-    Returns:
-        List of matching subjobs
+    `inserted_at` is the start time of the writing transaction, so a row can
+    become visible after rows with a later `inserted_at`. Holding the token
+    back by more than the longest ingest transaction means such rows are
+    still returned by the next delta; the rows already seen are re-sent.
     """
-    start_time = time.time()
-    pool = await get_pool()
-    
-    clauses: List[str] = []
-    params: List[any] = []
-    
-    if frm:
-        clauses.append(f"s.inserted_at >= ${len(params) + 1}")
-        params.append(datetime.fromisoformat(frm.replace('Z', '+00:00')))
-    
-    if to:
-        clauses.append(f"s.inserted_at <= ${len(params) + 1}")
-        params.append(datetime.fromisoformat(to.replace('Z', '+00:00')))
+    return datetime.now(timezone.utc) - timedelta(seconds=config.query_delta_overlap_s)
+
+
+def _check_delta_params(to: Optional[str], cursor: Optional[str], fmt: str) -> None:
+    if to or cursor or fmt != 'json':
+        raise HTTPException(status_code=422, detail="'since' cannot be combined with 'to', 'cursor' or format=ndjson")
+
+
+async def _query_delta(
+    entity: str,
+    select: str,
+    alias: str,
+    id_col: str,
+    clauses: List[str],
+    params: List[Any],
+    statuses: List[str],
+    since: str,
+    limit: Optional[int],
+    request: Optional[Request] = None
+) -> Response:
+    """
+    Return the rows of a current-state table changed after a `since` token.
     
-    if status:
-        sts = [s.strip() for s in status.split(',') if s.strip()]
-        clauses.append(f"s.status = ANY(${len(params) + 1})")
-        params.append(sts)
+    Rows are ordered by (inserted_at, id) ascending, oldest change first.
+    The status filter is applied per row: changed rows that no longer match
+    it are returned as `tombstones` (ids only) so clients can drop them.
+    With `more` set, the returned `since` continues right after the last
+    row and should be requested at once. Otherwise it is the delta horizon
+    (or the last row, if older), so rows near the end may be sent again;
+    clients merge by id. Archived rows never change and are not consulted.
     
-    where = ("WHERE " + " AND ".join(clauses)) if clauses else ""
+    Args:
+        entity: 'job' or 'subjob' (metrics/log label)
+        select: SELECT ... FROM ... part of the query
+        alias: Table alias used in `select`
+        id_col: Id column used as the keyset tie-breaker
+        clauses: WHERE clauses without the status filter
+        params: Query parameters
+        statuses: Status filter (empty: all)
+        since: Token from a previous page or delta
+        limit: Most rows (items plus tombstones) to return
+        request: Incoming request, used for If-None-Match
+    """
+    start_time = time.time()
+    horizon = _delta_horizon()
+    limit = limit or config.query_default_limit
+    if limit > config.query_max_limit:
+        raise HTTPException(status_code=422, detail=f'limit must be <= {config.query_max_limit}')
+    try:
+        after_at, after_id = decode_cursor(since)
+    except CursorError as e:
+        raise HTTPException(status_code=400, detail=str(e))
     
+    clauses = clauses + [f"({alias}.inserted_at, {alias}.{id_col}) > (${len(params) + 1}, ${len(params) + 2})"]
+    params = params + [after_at, after_id]
     sql = f'''
-    WITH latest AS (
-      SELECT s.*, ROW_NUMBER() OVER (PARTITION BY s.subjob_id ORDER BY s.inserted_at DESC) rn
-      FROM subjob s
-      {where}
-    )
-    SELECT * FROM latest WHERE rn = 1
-    ORDER BY inserted_at DESC
-    LIMIT {int(limit)}
+    {select}
+    WHERE {" AND ".join(clauses)}
+    ORDER BY {alias}.inserted_at, {alias}.{id_col}
+    LIMIT {int(limit) + 1}
     '''
     
+    pool = await get_pool()
     try:
+        etag = None
+        if request is not None:
+            etag = await _page_etag(pool, f'{entity}_current', request)
+            if etag in _if_none_match(request):
+                metrics.record_cache_lookup('etag', True)
+                return Response(status_code=304, headers={'ETag': etag})
+            metrics.record_cache_lookup('etag', False)
+        
         db_start = time.time()
         async with pool.acquire() as con:
             rows = await con.fetch(sql, *params)
+        metrics.record_db_operation('select_delta', entity, 'success', time.time() - db_start)
         
-        metrics.record_db_operation(
-            'select',
-            'subjob',
-            'success',
-            time.time() - db_start
-        )
+        more = len(rows) > limit
+        rows = rows[:limit]
+        items: List[dict] = []
+        tombstones: List[Any] = []
+        for r in rows:
+            if statuses and r['status'] not in statuses:
+                tombstones.append(r[id_col])
+            else:
+                items.append(dict(r))
         
-        items = [dict(r) for r in rows]
+        next_since = encode_cursor(horizon, _MIN_UUID)
+        if rows and (more or rows[-1]['inserted_at'] < horizon):
+            next_since = encode_cursor(rows[-1]['inserted_at'], rows[-1][id_col])
         
         duration = time.time() - start_time
         logger.info(
-            "subjobs_query_completed",
+            f"{entity}s_delta_completed",
             count=len(items),
+            tombstones=len(tombstones),
+            more=more,
             duration_s=round(duration, 4)
         )
         
-        return JSONResponse({'items': items, 'count': len(items), 'duration_s': round(duration, 4)})
+        return Response(
+            dumps({
+                'items': items,
+                'tombstones': tombstones,
+                'count': len(items),
+                'since': next_since,
+                'more': more,
+                'duration_s': round(duration, 4)
+            }),
+            media_type='application/json',
+            headers={'ETag': etag} if etag else None
+        )
     
     except Exception as e:
-        logger.error("subjobs_query_failed", error=str(e))
-        metrics.record_db_operation('select', 'subjob', 'failed', 0)
+        logger.error(f"{entity}s_delta_failed", error=str(e))
+        metrics.record_db_operation('select_delta', entity, 'failed', 0)
         raise HTTPException(status_code=500, detail=f'Query failed: {str(e)}')
 
 
+# Continuous aggregate read for each granularity: (view, time column, CPU column)
+JOB_STATS_VIEWS = {
+    'hour': ('job_stats_hourly', 'hour', 'avg_cpu_total_s'),
+    'day': ('job_stats_daily', 'day', 'avg_cpu_s'),
+}
+
+
+def _stats_window(frm: Optional[str], to: Optional[str], granularity: str) -> tuple:
+    """
+    Resolve the time range and granularity of a stats query.
+    
+    Defaults to the last 24 hours. The start is aligned down to its bucket
+    so the first bucket is complete.
+    
+    Raises:
+        HTTPException: On invalid timestamps or granularity
+    """
+    try:
+        end = _parse_ts(to) or datetime.now(timezone.utc)
+        start = _parse_ts(frm) or end - timedelta(hours=24)
+    except ValueError as e:
+        raise HTTPException(status_code=422, detail=f'Invalid timestamp: {e}')
+    if start.tzinfo is None:
+        start = start.replace(tzinfo=timezone.utc)
+    if end.tzinfo is None:
+        end = end.replace(tzinfo=timezone.utc)
+    if start >= end:
+        raise HTTPException(status_code=422, detail="'from' must be before 'to'")
+    try:
+        gran = choose_granularity(start, end, granularity, config.stats_hourly_max_hours)
+    except ValueError as e:
+        raise HTTPException(status_code=422, detail=str(e))
+    start = start.astimezone(timezone.utc).replace(minute=0, second=0, microsecond=0)
+    if gran == 'day':
+        start = start.replace(hour=0)
+    return start, end, gran
+
+
+def _stats_group_by(value: Optional[str], allowed: tuple) -> List[str]:
+    try:
+        return parse_group_by(value, allowed)
+    except ValueError as e:
+        raise HTTPException(status_code=422, detail=str(e))
+
+
+async def _stats_fetch(entity: str, sql: str, params: List[Any]) -> List[dict]:
+    """Run a stats query, recording metrics and mapping failures to 500."""
+    db_start = time.time()
+    try:
+        pool = await get_pool()
+        async with pool.acquire() as con:
+            rows = await con.fetch(sql, *params)
+    except Exception as e:
+        logger.error("stats_query_failed", entity=entity, error=str(e))
+        metrics.record_db_operation('select', entity, 'failed', 0)
+        raise HTTPException(status_code=500, detail=f'Query failed: {str(e)}')
+    metrics.record_db_operation('select', entity, 'success', time.time() - db_start)
+    return [dict(r) for r in rows]
+
+
+@app.get('/v1/stats/jobs', response_model=dict)
+@trace_async("get_job_stats")
+async def get_job_stats(
+    frm: Optional[str] = Query(None, alias='from', description="Start timestamp (ISO 8601, default: 24h ago)"),
+    to: Optional[str] = Query(None, alias='to', description="End timestamp (ISO 8601, default: now)"),
+    granularity: str = Query('auto', pattern='^(auto|hour|day)$', description="Bucket size; 'auto' picks by range"),
+    group_by: Optional[str] = Query(None, description="Comma-separated: app_name, status"),
+    app_name: Optional[str] = Query(None, description="Filter by app name (contains)"),
+    status: Optional[str] = Query(None, description="Comma-separated status values")
+) -> Response:
+    """
+    Time-bucketed job statistics from the job_stats_hourly/daily aggregates.
+    
+    Each bucket has counts, success rate, duration average/min/max and
+    percentiles, and CPU/memory usage. Buckets also carry their mergeable
+    parts (sums and a log-scale duration histogram) so that Central API
+    can combine buckets from several sites exactly.
+    
+    Args:
+        frm: Range start
+        to: Range end
+        granularity: 'hour', 'day' or 'auto'
+        group_by: Extra bucket dimensions
+        app_name: App name filter (contains match)
+        status: Status filter (comma-separated)
+    
+    Returns:
+        Buckets ordered by time
+    """
+    start_time = time.time()
+    start, end, gran = _stats_window(frm, to, granularity)
+    groups = _stats_group_by(group_by, ('app_name', 'status'))
+    view, time_col, cpu_col = JOB_STATS_VIEWS[gran]
+    
+    clauses = [f"s.{time_col} >= $1", f"s.{time_col} < $2"]
+    params: List[Any] = [start, end]
+    if app_name:
+        clauses.append(f"a.name ILIKE ${len(params) + 1}")
+        params.append(f"%{app_name}%")
+    if status:
+        clauses.append(f"s.status = ANY(${len(params) + 1})")
+        params.append([x.strip() for x in status.split(',') if x.strip()])
+    
+    rows = await _stats_fetch('job_stats', f"""
+    SELECT s.{time_col} AS bucket, s.status, a.name AS app_name, s.job_count,
+           s.avg_duration_s, s.min_duration_s, s.max_duration_s,
+           s.{cpu_col} AS avg_cpu_s, s.avg_mem_mb, s.max_mem_mb, s.duration_hist
+    FROM {view} s JOIN app a ON a.app_id = s.app_id
+    WHERE {' AND '.join(clauses)}
+    """, params)
+    
+    buckets = merge_job_buckets(
+        ({'bucket': r['bucket'], 'app_name': r['app_name'], 'status': r['status'], **job_partial_from_row(r)}
+         for r in rows),
+        groups
+    )
+    
+    duration = time.time() - start_time
+    logger.info("job_stats_completed", granularity=gran, buckets=len(buckets), duration_s=round(duration, 4))
+    return Response(dumps({
+        'granularity': gran,
+        'from': start,
+        'to': end,
+        'group_by': groups,
+        'histogram': histogram_layout(),
+        'buckets': buckets,
+        'count': len(buckets),
+        'duration_s': round(duration, 4)
+    }), media_type='application/json')
+
+
+@app.get('/v1/stats/events', response_model=dict)
+@trace_async("get_event_stats")
+async def get_event_stats(
+    frm: Optional[str] = Query(None, alias='from', description="Start timestamp (ISO 8601, default: 24h ago)"),
+    to: Optional[str] = Query(None, alias='to', description="End timestamp (ISO 8601, default: now)"),
+    granularity: str = Query('auto', pattern='^(auto|hour|day)$', description="Bucket size; 'auto' picks by range"),
+    group_by: Optional[str] = Query(None, description="Comma-separated: entity_type, kind"),
+    kind: Optional[str] = Query(None, description="Comma-separated event kinds"),
+    entity_type: Optional[str] = Query(None, description="'job' or 'subjob'")
+) -> Response:
+    """
+    Time-bucketed event counts from the event_stats_hourly aggregate.
+    
+    Daily buckets are rolled up from the hourly aggregate.
+    
+    Returns:
+        Buckets ordered by time
+    """
+    start_time = time.time()
+    start, end, gran = _stats_window(frm, to, granularity)
+    groups = _stats_group_by(group_by, ('entity_type', 'kind'))
+    
+    clauses = ["hour >= $1", "hour < $2"]
+    params: List[Any] = [start, end]
+    if kind:
+        clauses.append(f"kind = ANY(${len(params) + 1})")
+        params.append([x.strip() for x in kind.split(',') if x.strip()])
+    if entity_type:
+        clauses.append(f"entity_type = ${len(params) + 1}")
+        params.append(entity_type)
+    
+    rows = await _stats_fetch('event_stats', f"""
+    SELECT time_bucket('1 {gran}', hour) AS bucket, entity_type, kind,
+           SUM(event_count)::BIGINT AS event_count
+    FROM event_stats_hourly
+    WHERE {' AND '.join(clauses)}
+    GROUP BY 1, 2, 3
+    """, params)
+    
+    buckets = merge_event_buckets(rows, groups)
+    
+    duration = time.time() - start_time
+    logger.info("event_stats_completed", granularity=gran, buckets=len(buckets), duration_s=round(duration, 4))
+    return Response(dumps({
+        'granularity': gran,
+        'from': start,
+        'to': end,
+        'group_by': groups,
+        'buckets': buckets,
+        'count': len(buckets),
+        'duration_s': round(duration, 4)
+    }), media_type='application/json')
+
+
+@app.get('/v1/stats/failures', response_model=dict)
+@trace_async("get_failure_stats")
+async def get_failure_stats(
+    hours: int = Query(24, ge=1, le=24 * 90, description="Look-back window in hours")
+) -> Response:
+    """
+    Failure counts per app and `metadata.error_type` (get_failure_analysis).
+    
+    Returns:
+        Rows ordered by failure count
+    """
+    start_time = time.time()
+    rows = await _stats_fetch('failure_stats', 'SELECT * FROM get_failure_analysis(NULL, $1)', [hours])
+    items = merge_failures(rows)
+    
+    duration = time.time() - start_time
+    return Response(dumps({
+        'hours': hours,
+        'items': items,
+        'count': len(items),
+        'duration_s': round(duration, 4)
+    }), media_type='application/json')
+
+
+EVENT_COLUMNS = 'at, entity_type, entity_id, app_id, site_id, kind, payload, idempotency_key, ingested_at'
+
+
+def _stream_events(rows: List[asyncpg.Record]) -> List[dict]:
+    """Event rows shaped for the event hub (JSON-compatible values, parsed payload)."""
+    events = []
+    for r in rows:
+        ev = json.loads(dumps(dict(r)))
+        ev['payload'] = json.loads(ev['payload']) if isinstance(ev['payload'], str) else ev['payload']
+        events.append(ev)
+    return events
+
+
+async def _backfill_events(since: str) -> List[dict]:
+    """
+    Events stored at or after the ingest position `since` (used after a
+    LISTEN reconnect and to resume a stream), at most STREAM_BACKFILL_MAX_ROWS.
+    
+    Reads by `ingested_at` rather than `at`, so events that arrive late
+    (spooled, or sent by a sidecar that was offline) are not skipped. All
+    rows of one ingest transaction share an `ingested_at`, and a transaction
+    can commit after rows with a later one were read, so the position is
+    held back by `stream_backfill_overlap_s` and events near it are read
+    again; callers drop the idempotency keys they already sent. Rows are
+    ordered by (ingested_at, idempotency_key), which is unique.
+    """
+    start = _parse_ts(since)
+    if start.tzinfo is None:
+        start = start.replace(tzinfo=timezone.utc)
+    start -= timedelta(seconds=config.stream_backfill_overlap_s)
+    pool = await get_pool()
+    async with pool.acquire() as con:
+        rows = await con.fetch(
+            f'SELECT {EVENT_COLUMNS} FROM event WHERE ingested_at >= $1 '
+            'ORDER BY ingested_at, idempotency_key LIMIT $2',
+            start, config.stream_backfill_max_rows
+        )
+    if len(rows) == config.stream_backfill_max_rows:
+        logger.warning("event_backfill_truncated", since=since, rows=len(rows))
+    return _stream_events(rows)
+
+
+async def _resume_events(cursor: str) -> Optional[List[dict]]:
+    """
+    Events after the cursor of a Last-Event-ID this worker cannot replay
+    (issued by another worker or evicted from the replay buffer).
+    
+    Events within the backfill overlap before the cursor are included, so
+    the client may receive some of them again.
+    
+    Returns:
+        The missed events, or None if the cursor is invalid or more than
+        STREAM_BACKFILL_MAX_ROWS events would have to be read back
+    """
+    try:
+        missed = await _backfill_events(cursor)
+    except ValueError:
+        return None
+    except Exception as e:
+        logger.error("event_stream_resume_failed", error=str(e))
+        return None
+    if len(missed) >= config.stream_backfill_max_rows:
+        return None
+    return missed
+
+
+async def _fetch_events(keys: Optional[List[str]], frm: str, to: str) -> List[dict]:
+    """Rows announced by change notifications: by idempotency key, or every row in [frm, to]."""
+    pool = await get_pool()
+    async with pool.acquire() as con:
+        if keys is not None:
+            rows = await con.fetch(
+                f'SELECT {EVENT_COLUMNS} FROM event '
+                'WHERE at >= $2 AND at <= $3 AND idempotency_key = ANY($1::text[])',
+                keys, _parse_ts(frm), _parse_ts(to)
+            )
+        else:
+            rows = await con.fetch(
+                f'SELECT {EVENT_COLUMNS} FROM event WHERE at >= $1 AND at <= $2 ORDER BY at LIMIT $3',
+                _parse_ts(frm), _parse_ts(to), config.stream_fetch_max_rows
+            )
+            if len(rows) == config.stream_fetch_max_rows:
+                logger.warning("event_fetch_truncated", range_from=frm, range_to=to, rows=len(rows))
+    return _stream_events(rows)
+
+
 @app.get('/v1/stream')
-async def stream() -> StreamingResponse:
+async def stream(
+    request: Request,
+    site: Optional[str] = Query(None, description="Comma-separated site ids"),
+    app_id: Optional[str] = Query(None, description="Comma-separated app ids"),
+    kind: Optional[str] = Query(None, description="Comma-separated event kinds"),
+    entity_type: Optional[str] = Query(None, description="'job' or 'subjob'"),
+    entity_id: Optional[str] = Query(None, description="Single job/subjob id"),
+    last_event_id: Optional[str] = Query(None, description="Resume after this event id (fallback for the Last-Event-ID header)")
+) -> StreamingResponse:
     """
     Stream events in real-time using Server-Sent Events.
     
+    Events come from the process-wide LISTEN connection via the event hub,
+    so open streams do not poll the database or hold pool connections.
+    Filters are applied server-side. Each message carries an `id`; a client
+    reconnecting with `Last-Event-ID` resumes from the short replay buffer.
+    If the id is not buffered here (it came from another worker, or is too
+    old) the missed events are read back from the database, including some
+    just before the id (see _backfill_events); if that is more than
+    STREAM_BACKFILL_MAX_ROWS the client receives an `event: reset` message.
+    A slow client whose buffer overflowed gets an `event: dropped` message
+    with the number of events it missed.
+    
     Returns:
         SSE stream of new events
     """
+    flt = EventFilter.parse(site, app_id, kind, entity_type, entity_id)
+    resume_from = request.headers.get('last-event-id') or last_event_id
+    sub = event_hub.subscribe(flt, resume_from)
+    
     async def event_gen():
-        pool = await get_pool()
-        last = datetime.now(timezone.utc)
-        logger.info("event_stream_started")
-        
+        logger.info("event_stream_started", subscribers=event_hub.subscriber_count, resumed=bool(resume_from))
+        # Keys sent from the database; live events buffered meanwhile may repeat them
+        backfilled: set = set()
         try:
+            if sub.gap:
+                missed = await _resume_events(sub.cursor) if sub.cursor else None
+                if missed is None:
+                    yield "event: reset\ndata: {}\n\n"
+                else:
+                    for ev in missed:
+                        backfilled.add(ev.get('idempotency_key'))
+                        if flt.matches(ev):
+                            yield f"id: {event_hub.backfill_id(ev)}\ndata: {dumps(ev).decode()}\n\n"
             while True:
-                async with pool.acquire() as con:
-                    rows = await con.fetch(
-                        'SELECT at, entity_type, entity_id, site_id, kind, payload '
-                        'FROM event WHERE at > $1 ORDER BY at',
-                        last
-                    )
-                    if rows:
-                        last = max(r['at'] for r in rows)
-                        for r in rows:
-                            yield f"data: {json.dumps(dict(r), default=str)}\n\n"
-                
-                await asyncio.sleep(1.0)
+                item = await sub.get(timeout=config.stream_heartbeat_s)
+                if item is None:
+                    if await request.is_disconnected():
+                        break
+                    yield ": keepalive\n\n"
+                    continue
+                if sub.dropped:
+                    yield f"event: dropped\ndata: {{\"count\": {sub.dropped}}}\n\n"
+                    sub.dropped = 0
+                event_id, ev = item
+                if backfilled and ev.get('idempotency_key') in backfilled:
+                    continue
+                yield f"id: {event_id}\ndata: {dumps(ev).decode()}\n\n"
         except asyncio.CancelledError:
             logger.info("event_stream_cancelled")
+        finally:
+            sub.close()
     
-    return StreamingResponse(event_gen(), media_type='text/event-stream')
+    return StreamingResponse(
+        event_gen(),
+        media_type='text/event-stream',
+        headers={'Cache-Control': 'no-cache', 'X-Accel-Buffering': 'no'}
+    )
 
 
 @app.get('/v1/healthz')
@@ -527,19 +1887,56 @@ async def healthz() -> JSONResponse:
         'status': 'ok' if pool_ok else 'degraded',
         'service': config.service_name,
         'version': '2.0.0',
-        'database_pool': 'connected' if pool_ok else 'disconnected'
+        'worker': {'index': worker_index(), 'pid': os.getpid(), 'workers': max(1, config.workers)},
+        'database_pool': 'connected' if pool_ok else 'disconnected',
+        'stream': {
+            'listener': 'connected' if event_listener and event_listener.connected else 'disconnected',
+            'subscribers': event_hub.subscriber_count,
+            'published': event_hub.published,
+            'fetched': event_listener.fetched if event_listener else 0,
+            'notify': 'enabled' if config.stream_notify_enabled else 'disabled'
+        },
+        'dedup': dedup.stats() if dedup else 'disabled',
+        'cold_store': cold_store.stats() if cold_store else 'disabled'
     })
 
 
 @app.get('/metrics')
-async def metrics_endpoint() -> Response:
-    """Prometheus metrics endpoint."""
+async def metrics_endpoint(request: Request) -> Response:
+    """Prometheus metrics endpoint (OpenMetrics with exemplars if requested)."""
+    accept = request.headers.get('accept')
     return Response(
-        content=metrics.get_metrics(),
-        media_type=metrics.get_content_type()
+        content=metrics.get_metrics(accept),
+        media_type=metrics.get_content_type(accept)
     )
 
 
+if config.profiling_enabled:
+    # Samples the event loop thread; created on first use, from that thread
+    profiler: Optional[SamplingProfiler] = None
+    
+    @app.get('/debug/profile')
+    async def profile_endpoint(
+        seconds: float = Query(10.0, gt=0),
+        interval_ms: float = Query(5.0, ge=1.0, le=1000.0)
+    ) -> Response:
+        """
+        Sample the event loop's Python stacks for `seconds` and return them
+        in collapsed-stack format (input for flame graph tools).
+        
+        Only registered with PROFILING_ENABLED=true.
+        """
+        global profiler
+        if profiler is None:
+            profiler = SamplingProfiler()
+        seconds = min(seconds, config.profile_max_seconds)
+        try:
+            counts = await asyncio.to_thread(profiler.sample, seconds, interval_ms / 1000.0)
+        except RuntimeError as e:
+            raise HTTPException(status_code=409, detail=str(e))
+        logger.info("profile_completed", seconds=seconds, samples=sum(counts.values()))
+        return Response(content=SamplingProfiler.collapsed(counts), media_type='text/plain')
+
+
 if __name__ == '__main__':
-    import uvicorn
-    uvicorn.run(app, host='0.0.0.0', port=18000, log_config=None)
+    sys.exit(serve_workers(app, config.host, config.port, config.workers, post_fork=init_worker, log_config=None))
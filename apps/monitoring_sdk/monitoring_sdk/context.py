@@ -4,7 +4,7 @@ from contextlib import ContextDecorator
 from uuid import uuid4, UUID
 from typing import Optional, Dict, Any
 from .models import AppRef, EntityRef, JobEvent
-from .emitter import SidecarEmitter
+from .emitter import SidecarEmitter, default_emitter
 
 try:
     import structlog
@@ -14,6 +14,21 @@ except ImportError:
     logger = logging.getLogger(__name__)  # type: ignore
 
 
+def _meta_changed(old: Dict[str, Any], new: Dict[str, Any], threshold: float) -> bool:
+    """True if any key in `new` differs from `old` (numbers: by more than `threshold`)."""
+    for key, value in new.items():
+        if key not in old:
+            return True
+        prev = old[key]
+        if isinstance(value, (int, float)) and isinstance(prev, (int, float)) \
+                and not isinstance(value, bool) and not isinstance(prev, bool):
+            if abs(value - prev) > threshold:
+                return True
+        elif value != prev:
+            return True
+    return False
+
+
 class Monitored(ContextDecorator):
     """
     Context manager to instrument a job/subjob with automatic metrics collection.
@@ -23,6 +38,13 @@ class Monitored(ContextDecorator):
     - Memory usage (RSS peak)
     - Duration
     - Success/failure status
+
+    Progress ticks can be coalesced for use in tight loops: ticks closer than
+    `tick_min_interval_s` to the last emitted progress event are suppressed,
+    and with `tick_mem_delta_mb` / `tick_meta_delta` set a tick is only emitted
+    if memory or metadata moved by more than the threshold. Suppressed ticks
+    merge their `extra_meta` into the next emitted event, which carries their
+    count as `suppressed_ticks`; pending state is always flushed on exit.
     
     Example:
         >>> app = AppRef(app_id=uuid4(), name='my-app', version='1.0')
@@ -41,7 +63,10 @@ class Monitored(ContextDecorator):
         parent_id: Optional[UUID] = None,
         emitter: Optional[SidecarEmitter] = None,
         metadata: Optional[Dict[str, Any]] = None,
-        enable_logging: bool = True
+        enable_logging: bool = True,
+        tick_min_interval_s: float = 0.0,
+        tick_mem_delta_mb: Optional[float] = None,
+        tick_meta_delta: Optional[float] = None
     ):
         """
         Initialize the monitored context.
@@ -53,9 +78,16 @@ class Monitored(ContextDecorator):
             business_key: Optional business key for correlation
             sub_key: Optional sub-key for subjobs
             parent_id: Optional parent job ID for subjobs
-            emitter: Optional custom emitter (defaults to new SidecarEmitter)
+            emitter: Optional custom emitter (defaults to the process-wide
+                default_emitter())
             metadata: Optional metadata dict to include in events
             enable_logging: Whether to log operations
+            tick_min_interval_s: Minimum time between emitted progress events
+                (0 emits every tick)
+            tick_mem_delta_mb: Only emit a tick if RSS moved by more than this
+                since the last emitted progress event
+            tick_meta_delta: Only emit a tick if metadata changed (numeric
+                values by more than this) since the last emitted progress event
         """
         self.site_id = site_id
         self.app = app
@@ -69,11 +101,21 @@ class Monitored(ContextDecorator):
         )
         self.metadata = metadata or {}
         self.proc = psutil.Process()
-        self.emitter = emitter or SidecarEmitter()
+        self.emitter = emitter or default_emitter()
         self._t0: Optional[float] = None
         self._cpu_t0: Optional[tuple[float, float]] = None
         self.mem_max_mb = 0.0
         self.enable_logging = enable_logging
+
+        self.tick_min_interval_s = tick_min_interval_s
+        self.tick_mem_delta_mb = tick_mem_delta_mb
+        self.tick_meta_delta = tick_meta_delta
+        self.suppressed_ticks_total = 0
+        self._last_tick_at: Optional[float] = None
+        self._last_tick_mem_mb = 0.0
+        self._last_tick_meta: Dict[str, Any] = {}
+        self._pending_meta: Dict[str, Any] = {}
+        self._suppressed_ticks = 0
     
     def __enter__(self) -> 'Monitored':
         """Enter the monitored context and send 'started' event."""
@@ -82,6 +124,7 @@ class Monitored(ContextDecorator):
         self._cpu_t0 = (cpu.user, cpu.system)
         rss = self.proc.memory_info().rss / (1024 * 1024)
         self.mem_max_mb = max(self.mem_max_mb, rss)
+        self._last_tick_mem_mb = rss
         
         try:
             self.emitter.send(
@@ -119,13 +162,51 @@ class Monitored(ContextDecorator):
     
     def tick(self, extra_meta: Optional[Dict[str, Any]] = None) -> None:
         """
-        Send a progress update event.
+        Send a progress update event, subject to tick coalescing.
         
         Args:
             extra_meta: Optional additional metadata for this tick
         """
+        if extra_meta:
+            self._pending_meta.update(extra_meta)
+
+        now = time.monotonic()
+        if self._last_tick_at is not None and now - self._last_tick_at < self.tick_min_interval_s:
+            # Within the minimum interval: suppress without sampling psutil
+            self._suppress_tick()
+            return
+
         rss = self.proc.memory_info().rss / (1024 * 1024)
         self.mem_max_mb = max(self.mem_max_mb, rss)
+
+        if self.tick_mem_delta_mb is not None or self.tick_meta_delta is not None:
+            changed = (
+                self.tick_mem_delta_mb is not None
+                and abs(rss - self._last_tick_mem_mb) > self.tick_mem_delta_mb
+            ) or (
+                self.tick_meta_delta is not None
+                and _meta_changed(self._last_tick_meta, self._pending_meta, self.tick_meta_delta)
+            )
+            if not changed:
+                self._suppress_tick()
+                return
+
+        self._last_tick_at = now
+        self._last_tick_mem_mb = rss
+        self._emit_progress()
+
+    def _suppress_tick(self) -> None:
+        self._suppressed_ticks += 1
+        self.suppressed_ticks_total += 1
+
+    def _emit_progress(self) -> None:
+        """Send a progress event with the merged metadata of all pending ticks."""
+        metadata = dict(self._pending_meta)
+        if self._suppressed_ticks:
+            metadata['suppressed_ticks'] = self._suppressed_ticks
+        self._last_tick_meta.update(self._pending_meta)
+        self._pending_meta = {}
+        self._suppressed_ticks = 0
         
         try:
             self.emitter.send(
@@ -136,7 +217,7 @@ class Monitored(ContextDecorator):
                     self.entity,
                     status='running',
                     metrics={'mem_max_mb': self.mem_max_mb},
-                    metadata=extra_meta or {}
+                    metadata=metadata
                 )
             )
             if self.enable_logging:
@@ -155,6 +236,10 @@ class Monitored(ContextDecorator):
     
     def __exit__(self, exc_type, exc, tb):  # type: ignore
         """Exit the monitored context and send 'finished' event."""
+        if self._suppressed_ticks:
+            # Flush the latest coalesced progress state before finishing
+            self._emit_progress()
+
         cpu = self.proc.cpu_times()
         cpu_user = cpu.user - self._cpu_t0[0] if self._cpu_t0 else 0.0
         cpu_sys = cpu.system - self._cpu_t0[1] if self._cpu_t0 else 0.0
@@ -1,6 +1,13 @@
 import os
+import json
+import time
+import atexit
+import functools
+import threading
 import httpx
-from typing import Iterable, Optional
+from collections import deque
+from pathlib import Path
+from typing import Callable, Deque, Dict, Iterable, List, Optional, Tuple
 from tenacity import retry, stop_after_attempt, wait_exponential, retry_if_exception_type
 from .models import JobEvent
 
@@ -16,6 +23,61 @@ MAX_RETRIES = 3
 RETRY_MIN_WAIT = 0.1
 RETRY_MAX_WAIT = 2.0
 
+# Background delivery defaults
+DEFAULT_QUEUE_SIZE = 10000
+DEFAULT_BATCH_SIZE = 100
+DEFAULT_FLUSH_INTERVAL = 0.2
+DEFAULT_CLOSE_TIMEOUT = 5.0
+MAX_RETRY_AFTER = 30.0
+OVERFLOW_POLICIES = ('drop_oldest', 'block', 'spill')
+
+# Batch request body formats; msgpack needs the msgpack package, +zstd zstandard
+WIRE_FORMATS = ('json', 'json+zstd', 'msgpack', 'msgpack+zstd')
+
+
+def _env_flag(name: str) -> bool:
+    return os.getenv(name, '').strip().lower() in ('1', 'true', 'yes', 'on')
+
+
+BatchEncoder = Callable[[List[Dict[str, object]]], Tuple[bytes, Dict[str, str]]]
+
+
+def _batch_encoder(wire_format: str) -> Optional[BatchEncoder]:
+    """
+    Return a function encoding a batch payload as (body, headers), or None
+    for plain JSON (sent with httpx's own encoder).
+
+    Imports the optional packages up front, so a missing one fails when the
+    emitter is created rather than on the first send.
+    """
+    if wire_format not in WIRE_FORMATS:
+        raise ValueError(f"wire_format must be one of {WIRE_FORMATS}, got {wire_format!r}")
+    if wire_format == 'json':
+        return None
+    encoding, _, compression = wire_format.partition('+')
+    if encoding == 'msgpack':
+        import msgpack
+        pack = functools.partial(msgpack.packb, use_bin_type=True)
+        content_type = 'application/msgpack'
+    else:
+        def pack(payload: List[Dict[str, object]]) -> bytes:
+            return json.dumps(payload, separators=(',', ':')).encode('utf-8')
+        content_type = 'application/json'
+    zstandard = None
+    if compression:
+        import zstandard
+
+    def encode(payload: List[Dict[str, object]]) -> Tuple[bytes, Dict[str, str]]:
+        body = pack(payload)
+        headers = {'Content-Type': content_type}
+        if zstandard is not None:
+            # Compressors are not thread-safe; sync sends and the worker share this
+            body = zstandard.ZstdCompressor().compress(body)
+            headers['Content-Encoding'] = 'zstd'
+        return body, headers
+
+    return encode
+
 
 class SidecarEmitter:
     """
@@ -27,6 +89,8 @@ class SidecarEmitter:
     - Structured logging of all operations
     - Connection pooling for better performance
     - Graceful error handling with fallback options
+    - Optional background delivery: `send()` only enqueues, a worker thread
+      batches events through the batch endpoint
     """
     
     def __init__(
@@ -34,7 +98,15 @@ class SidecarEmitter:
         base_url: Optional[str] = None,
         timeout: float = DEFAULT_TIMEOUT,
         max_retries: int = MAX_RETRIES,
-        enable_retries: bool = True
+        enable_retries: bool = True,
+        async_delivery: Optional[bool] = None,
+        queue_size: int = DEFAULT_QUEUE_SIZE,
+        batch_size: int = DEFAULT_BATCH_SIZE,
+        flush_interval: float = DEFAULT_FLUSH_INTERVAL,
+        overflow: str = 'drop_oldest',
+        spill_path: Optional[str] = None,
+        close_timeout: float = DEFAULT_CLOSE_TIMEOUT,
+        wire_format: Optional[str] = None
     ):
         """
         Initialize the emitter.
@@ -44,6 +116,19 @@ class SidecarEmitter:
             timeout: Request timeout in seconds
             max_retries: Maximum number of retry attempts
             enable_retries: Whether to enable automatic retries
+            async_delivery: Deliver from a background thread (defaults to
+                SIDECAR_ASYNC_DELIVERY env var)
+            queue_size: Maximum events buffered in background mode
+            batch_size: Maximum events per background batch request
+            flush_interval: Maximum time an event waits before its batch is sent
+            overflow: What to do when the queue is full: 'drop_oldest',
+                'block' (caller waits for space) or 'spill' (append to spill_path)
+            spill_path: JSONL file for spilled/undeliverable events (defaults to
+                SIDECAR_SPILL_PATH env var); replayed when the emitter starts
+            close_timeout: Maximum time `close()` waits for the queue to drain
+            wire_format: Body format of batch requests: 'json', 'json+zstd',
+                'msgpack' or 'msgpack+zstd' (defaults to SIDECAR_WIRE_FORMAT
+                env var, else 'json')
         """
         self.base_url = base_url or os.getenv('SIDECAR_URL', 'http://localhost:8000')
         self.timeout = timeout
@@ -53,24 +138,90 @@ class SidecarEmitter:
             timeout=timeout,
             limits=httpx.Limits(max_keepalive_connections=5, max_connections=10)
         )
-        logger.info("emitter_initialized", base_url=self.base_url, timeout=timeout)
+
+        if async_delivery is None:
+            async_delivery = _env_flag('SIDECAR_ASYNC_DELIVERY')
+        if overflow not in OVERFLOW_POLICIES:
+            raise ValueError(f"overflow must be one of {OVERFLOW_POLICIES}, got {overflow!r}")
+
+        self.async_delivery = async_delivery
+        self.queue_size = max(1, queue_size)
+        self.batch_size = max(1, batch_size)
+        self.flush_interval = flush_interval
+        self.overflow = overflow
+        spill_path = spill_path or os.getenv('SIDECAR_SPILL_PATH')
+        self.spill_path = Path(spill_path) if spill_path else None
+        if overflow == 'spill' and self.spill_path is None:
+            raise ValueError("overflow='spill' requires spill_path or SIDECAR_SPILL_PATH")
+        self.close_timeout = close_timeout
+        self.wire_format = wire_format or os.getenv('SIDECAR_WIRE_FORMAT') or 'json'
+        self._encode_batch = _batch_encoder(self.wire_format)
+        self.stats: Dict[str, int] = {'enqueued': 0, 'sent': 0, 'dropped': 0, 'spilled': 0}
+
+        self._queue: Deque[Dict[str, object]] = deque()
+        self._cond = threading.Condition()
+        self._inflight = 0
+        self._closing = False
+        self._closed = False
+        self._worker: Optional[threading.Thread] = None
+        self._worker_done = False
+
+        if self.async_delivery:
+            self._worker = threading.Thread(
+                target=self._run, name='sidecar-emitter', daemon=True
+            )
+            self._worker.start()
+            atexit.register(self.close)
+
+        logger.info(
+            "emitter_initialized",
+            base_url=self.base_url,
+            timeout=timeout,
+            async_delivery=self.async_delivery,
+            wire_format=self.wire_format
+        )
     
-    @retry(
-        stop=stop_after_attempt(MAX_RETRIES),
-        wait=wait_exponential(min=RETRY_MIN_WAIT, max=RETRY_MAX_WAIT),
-        retry=retry_if_exception_type((httpx.TimeoutException, httpx.NetworkError)),
-        reraise=True
-    )
     def send(self, ev: JobEvent) -> None:
         """
         Send a single event to the sidecar agent.
         
+        In background mode this only enqueues the event and returns.
+        
         Args:
             ev: JobEvent to send
             
         Raises:
-            httpx.HTTPError: If the request fails after retries
+            httpx.HTTPError: If the request fails after retries (sync mode only)
+        """
+        if self.async_delivery:
+            self._enqueue([ev.to_json()])
+            return
+        self._send_now(ev)
+    
+    def send_batch(self, events: Iterable[JobEvent]) -> None:
+        """
+        Send a batch of events to the sidecar agent.
+        
+        In background mode this only enqueues the events and returns.
+        
+        Args:
+            events: Iterable of JobEvents to send
+            
+        Raises:
+            httpx.HTTPError: If the request fails after retries (sync mode only)
         """
+        if self.async_delivery:
+            self._enqueue([e.to_json() for e in events])
+            return
+        self._send_batch_now(list(events))
+    
+    @retry(
+        stop=stop_after_attempt(MAX_RETRIES),
+        wait=wait_exponential(min=RETRY_MIN_WAIT, max=RETRY_MAX_WAIT),
+        retry=retry_if_exception_type((httpx.TimeoutException, httpx.NetworkError)),
+        reraise=True
+    )
+    def _send_now(self, ev: JobEvent) -> None:
         try:
             logger.debug(
                 "sending_event",
@@ -96,46 +247,203 @@ class SidecarEmitter:
             )
             raise
     
+    def _send_batch_now(self, event_list: List[JobEvent]) -> None:
+        self._post_batch([e.to_json() for e in event_list])
+
     @retry(
         stop=stop_after_attempt(MAX_RETRIES),
         wait=wait_exponential(min=RETRY_MIN_WAIT, max=RETRY_MAX_WAIT),
         retry=retry_if_exception_type((httpx.TimeoutException, httpx.NetworkError)),
         reraise=True
     )
-    def send_batch(self, events: Iterable[JobEvent]) -> None:
-        """
-        Send a batch of events to the sidecar agent.
-        
-        Args:
-            events: Iterable of JobEvents to send
-            
-        Raises:
-            httpx.HTTPError: If the request fails after retries
-        """
-        event_list = list(events)
+    def _post_batch(self, payload: List[Dict[str, object]]) -> None:
         try:
-            logger.debug("sending_batch", count=len(event_list))
-            payload = [e.to_json() for e in event_list]
-            r = self._client.post('/v1/ingest/events:batch', json=payload)
+            logger.debug("sending_batch", count=len(payload))
+            if self._encode_batch is None:
+                r = self._client.post('/v1/ingest/events:batch', json=payload)
+            else:
+                body, headers = self._encode_batch(payload)
+                r = self._client.post('/v1/ingest/events:batch', content=body, headers=headers)
             r.raise_for_status()
             logger.info(
                 "batch_sent",
-                count=len(event_list),
+                count=len(payload),
                 status_code=r.status_code
             )
         except httpx.HTTPError as e:
             logger.error(
                 "batch_send_failed",
-                count=len(event_list),
+                count=len(payload),
                 error=str(e),
                 error_type=type(e).__name__
             )
             raise
     
+    # ------------------------------------------------------------------
+    # Background delivery
+    # ------------------------------------------------------------------
+
+    def _enqueue(self, items: List[Dict[str, object]]) -> None:
+        spilled: List[Dict[str, object]] = []
+        with self._cond:
+            if self._closed:
+                raise RuntimeError('emitter is closed')
+            for item in items:
+                if len(self._queue) >= self.queue_size:
+                    if self.overflow == 'block':
+                        while len(self._queue) >= self.queue_size and not self._closing:
+                            self._cond.wait()
+                    elif self.overflow == 'spill':
+                        spilled.append(item)
+                        continue
+                    else:
+                        self._queue.popleft()
+                        self.stats['dropped'] += 1
+                self._queue.append(item)
+                self.stats['enqueued'] += 1
+            self._cond.notify_all()
+        if spilled:
+            self._spill(spilled)
+
+    def _take_batch(self) -> List[Dict[str, object]]:
+        """Wait for a full batch or the flush interval, whichever comes first."""
+        with self._cond:
+            while not self._queue and not self._closing:
+                self._cond.wait()
+            deadline = time.monotonic() + self.flush_interval
+            while len(self._queue) < self.batch_size and not self._closing:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    break
+                self._cond.wait(remaining)
+            batch = [self._queue.popleft() for _ in range(min(self.batch_size, len(self._queue)))]
+            self._inflight = len(batch)
+            # Wake producers blocked on a full queue
+            self._cond.notify_all()
+            return batch
+
+    def _deliver(self, batch: List[Dict[str, object]]) -> None:
+        """Send one batch, honouring 429 Retry-After; spill or drop on failure."""
+        while True:
+            try:
+                self._post_batch(batch)
+                self.stats['sent'] += len(batch)
+                return
+            except httpx.HTTPStatusError as e:
+                if e.response.status_code == 429 and not self._closing:
+                    try:
+                        delay = float(e.response.headers.get('Retry-After', '1'))
+                    except ValueError:
+                        delay = 1.0
+                    time.sleep(min(max(delay, 0.1), MAX_RETRY_AFTER))
+                    continue
+                self._undeliverable(batch, e)
+                return
+            except Exception as e:
+                self._undeliverable(batch, e)
+                return
+
+    def _undeliverable(self, batch: List[Dict[str, object]], e: Exception) -> None:
+        if self.spill_path is not None:
+            self._spill(batch)
+        else:
+            self.stats['dropped'] += len(batch)
+            logger.warning("background_batch_dropped", count=len(batch), error=str(e))
+
+    def _spill(self, items: List[Dict[str, object]]) -> None:
+        try:
+            self.spill_path.parent.mkdir(parents=True, exist_ok=True)
+            with open(self.spill_path, 'a', encoding='utf-8') as f:
+                for item in items:
+                    f.write(json.dumps(item) + '\n')
+            self.stats['spilled'] += len(items)
+            logger.warning("events_spilled", count=len(items), path=str(self.spill_path))
+        except Exception as e:
+            self.stats['dropped'] += len(items)
+            logger.error("spill_failed", count=len(items), error=str(e))
+
+    def _replay_spill(self) -> None:
+        """Queue events spilled by a previous run, then remove the spill file."""
+        if self.spill_path is None or not self.spill_path.exists():
+            return
+        try:
+            replay = self.spill_path.with_suffix(self.spill_path.suffix + '.replay')
+            self.spill_path.replace(replay)
+            items = [json.loads(line) for line in replay.read_text(encoding='utf-8').splitlines() if line]
+            for i in range(0, len(items), self.batch_size):
+                self._deliver(items[i:i + self.batch_size])
+            replay.unlink(missing_ok=True)
+            logger.info("spill_replayed", count=len(items))
+        except Exception as e:
+            logger.error("spill_replay_failed", error=str(e))
+
+    def _run(self) -> None:
+        self._replay_spill()
+        while True:
+            batch = self._take_batch()
+            if batch:
+                self._deliver(batch)
+            with self._cond:
+                self._inflight = 0
+                self._cond.notify_all()
+                if self._closing and not self._queue:
+                    break
+        # A close() that timed out left the client to the worker
+        with self._cond:
+            self._worker_done = True
+            release = self._closed
+        if release:
+            self._client.close()
+
+    def flush(self, timeout: Optional[float] = None) -> bool:
+        """
+        Wait until all queued events have been handed to the sidecar.
+
+        Returns:
+            True if the queue drained within `timeout`
+        """
+        if not self.async_delivery:
+            return True
+        deadline = None if timeout is None else time.monotonic() + timeout
+        with self._cond:
+            self._cond.notify_all()
+            while self._queue or self._inflight:
+                remaining = None if deadline is None else deadline - time.monotonic()
+                if remaining is not None and remaining <= 0:
+                    return False
+                self._cond.wait(remaining)
+        return True
+
     def close(self) -> None:
-        """Close the HTTP client and release resources."""
-        self._client.close()
-        logger.info("emitter_closed")
+        """Flush queued events (background mode), close the HTTP client and release resources."""
+        if self._closed:
+            return
+        if self._worker is not None:
+            with self._cond:
+                self._closing = True
+                self._cond.notify_all()
+            self._worker.join(self.close_timeout)
+            with self._cond:
+                leftover = list(self._queue)
+                self._queue.clear()
+                self._closed = True
+                # The worker may still be inside a request: it keeps the
+                # client and closes it when that batch is sent or spilled
+                release = self._worker_done
+            if leftover:
+                self._undeliverable(leftover, TimeoutError('close timeout'))
+            if not release:
+                logger.warning("emitter_close_timeout", inflight=self._inflight, alive=self._worker.is_alive())
+            try:
+                atexit.unregister(self.close)
+            except Exception:
+                pass
+        else:
+            self._closed = True
+            release = True
+        if release:
+            self._client.close()
+        logger.info("emitter_closed", **self.stats)
     
     def __enter__(self) -> 'SidecarEmitter':
         """Context manager entry."""
@@ -145,3 +453,25 @@ class SidecarEmitter:
         """Context manager exit."""
         self.close()
         return False
+
+
+_default: Optional[SidecarEmitter] = None
+_default_pid: Optional[int] = None
+_default_lock = threading.Lock()
+
+
+def default_emitter() -> SidecarEmitter:
+    """
+    The process-wide emitter used by `Monitored` when none is given.
+
+    Created on first use from the SIDECAR_* environment variables, so every
+    job shares one HTTP client (and, in background mode, one worker thread)
+    instead of leaking one per context. A forked child or a closed default
+    gets a new one.
+    """
+    global _default, _default_pid
+    with _default_lock:
+        if _default is None or _default._closed or _default_pid != os.getpid():
+            _default = SidecarEmitter()
+            _default_pid = os.getpid()
+        return _default
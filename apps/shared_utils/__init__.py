@@ -3,6 +3,12 @@ from .logging import setup_logging, get_logger
 from .tracing import setup_tracing, trace_async, trace_sync, instrument_fastapi
 from .metrics import MetricsCollector, get_metrics_collector
 from .config import BaseServiceConfig, SidecarAgentConfig, LocalAPIConfig, CentralAPIConfig, ArchiverConfig
+from .app_cache import KnownAppCache
+from .dedup import DedupFilter, RotatingBloomFilter, first_occurrences
+from .delta import DeltaFrame
+from .coalescer import BatchCoalescer
+from .spool import SegmentedSpool, SpoolEntry, SpoolPosition
+from .drain import SpoolDrainer, PriorityGate
 from .alerts import AlertManager, Alert, AlertRule, AlertSeverity, AlertState, get_alert_manager
 
 __all__ = [
@@ -19,6 +25,17 @@ __all__ = [
     'LocalAPIConfig',
     'CentralAPIConfig',
     'ArchiverConfig',
+    'KnownAppCache',
+    'DedupFilter',
+    'first_occurrences',
+    'RotatingBloomFilter',
+    'DeltaFrame',
+    'BatchCoalescer',
+    'SegmentedSpool',
+    'SpoolEntry',
+    'SpoolPosition',
+    'SpoolDrainer',
+    'PriorityGate',
     'AlertManager',
     'Alert',
     'AlertRule',
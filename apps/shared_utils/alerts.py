@@ -1,7 +1,9 @@
 """Alerting system with configurable thresholds and notifications."""
 import os
 import json
-from typing import Dict, List, Optional, Callable, Any
+import time
+from collections import OrderedDict, deque
+from typing import Deque, Dict, List, Optional, Callable, Any, Tuple
 from dataclasses import dataclass
 from datetime import datetime, timedelta
 from enum import Enum
@@ -64,6 +66,107 @@ class AlertRule:
     message_template: str
     labels: Optional[Dict[str, str]] = None
     cooldown_minutes: int = 5
+    # Also evaluated per (site, app) on the event stream (see AlertManager.observe)
+    streaming: bool = False
+
+
+# Event kinds that end a job or subjob
+TERMINAL_KINDS = frozenset({'finished', 'error', 'canceled'})
+
+
+class WindowStats:
+    """
+    Sliding-window counters for one (site, app) key.
+    
+    A ring of `2 * slots` time slots covers the current window and the one
+    before it (for the expected rate); each slot holds counts and the
+    duration/memory summaries of the jobs that ended in it, so memory is
+    constant per key. Running jobs are tracked in a bounded insertion-
+    ordered map (oldest first) to detect long runners before they end.
+    """
+    
+    __slots__ = ('window_s', 'slots', 'slot_s', 'max_open', '_epoch', '_ended', '_failed',
+                 '_dur_sum', '_dur_max', '_mem_max', 'running', 'last_seen', 'dropped_open')
+    
+    def __init__(self, window_s: float = 3600.0, slots: int = 12, max_open: int = 1000):
+        self.window_s = window_s
+        self.slots = max(1, slots)
+        self.slot_s = window_s / self.slots
+        self.max_open = max_open
+        n = 2 * self.slots
+        self._epoch = [-1] * n
+        self._ended = [0] * n
+        self._failed = [0] * n
+        self._dur_sum = [0.0] * n
+        self._dur_max = [0.0] * n
+        self._mem_max = [0.0] * n
+        self.running: 'OrderedDict[str, float]' = OrderedDict()
+        self.last_seen = 0.0
+        self.dropped_open = 0
+    
+    def _slot(self, now: float) -> int:
+        idx = int(now // self.slot_s)
+        pos = idx % len(self._epoch)
+        if self._epoch[pos] != idx:
+            self._epoch[pos] = idx
+            self._ended[pos] = self._failed[pos] = 0
+            self._dur_sum[pos] = self._dur_max[pos] = self._mem_max[pos] = 0.0
+        return pos
+    
+    def add(self, entity_id: str, kind: str, failed: bool, duration_s: Optional[float],
+            mem_mb: Optional[float], now: float) -> None:
+        """Count one event."""
+        self.last_seen = now
+        if kind == 'started':
+            self.running[entity_id] = now
+            self.running.move_to_end(entity_id)
+            if len(self.running) > self.max_open:
+                self.running.popitem(last=False)
+                self.dropped_open += 1
+            return
+        if kind not in TERMINAL_KINDS:
+            return
+        self.running.pop(entity_id, None)
+        pos = self._slot(now)
+        self._ended[pos] += 1
+        if failed:
+            self._failed[pos] += 1
+        if duration_s is not None:
+            self._dur_sum[pos] += duration_s
+            self._dur_max[pos] = max(self._dur_max[pos], duration_s)
+        if mem_mb is not None:
+            self._mem_max[pos] = max(self._mem_max[pos], mem_mb)
+    
+    def snapshot(self, now: float) -> Dict[str, Any]:
+        """Aggregates of the current window (and the job count of the previous one)."""
+        cur = int(now // self.slot_s)
+        ended = failed = previous = 0
+        dur_sum = dur_max = mem_max = 0.0
+        for pos, idx in enumerate(self._epoch):
+            age = cur - idx
+            if 0 <= age < self.slots:
+                ended += self._ended[pos]
+                failed += self._failed[pos]
+                dur_sum += self._dur_sum[pos]
+                dur_max = max(dur_max, self._dur_max[pos])
+                mem_max = max(mem_max, self._mem_max[pos])
+            elif self.slots <= age < 2 * self.slots:
+                previous += self._ended[pos]
+        oldest_running_s = now - next(iter(self.running.values())) if self.running else 0.0
+        per_hour = 3600.0 / self.window_s
+        return {
+            'total_jobs': ended,
+            'failed_jobs': failed,
+            'rate': 100.0 * failed / ended if ended else 0.0,
+            'avg_duration_s': dur_sum / ended if ended else 0.0,
+            'max_duration_s': max(dur_max, oldest_running_s),
+            'max_memory_mb': mem_max,
+            'running_jobs': len(self.running),
+            'oldest_running_s': oldest_running_s,
+            'jobs_last_hour': ended * per_hour,
+            'expected_jobs_per_hour': previous * per_hour,
+            'idle_s': now - self.last_seen,
+        }
 
 
 class AlertManager:
@@ -74,14 +177,40 @@ class AlertManager:
     - Configurable alert rules
     - Multiple notification channels (webhook, email, Slack)
     - Alert cooldown to prevent spam
-    - Alert history tracking
+    - Alert history tracking (bounded ring buffer)
+    - Streaming evaluation: `observe()` consumes ingested events and keeps
+      sliding-window stats per (site, app) (see WindowStats), evaluating
+      the `streaming` rules for that key as events arrive; `tick()`
+      re-evaluates every key on a timer for time-driven rules such as
+      no activity. Scoped alerts are keyed `<rule>[<site>/<app>]`.
     """
     
-    def __init__(self):
-        """Initialize alert manager."""
+    def __init__(
+        self,
+        history_size: int = 1000,
+        window_s: float = 3600.0,
+        min_jobs: int = 10,
+        max_keys: int = 10000
+    ):
+        """
+        Initialize alert manager.
+        
+        Args:
+            history_size: Resolved alerts kept in the history
+            window_s: Sliding window of the streaming stats
+            min_jobs: Ended jobs a key needs in the window before failure
+                rate rules apply
+            max_keys: (site, app) keys tracked; the least recently seen is
+                dropped beyond this
+        """
         self.rules: List[AlertRule] = []
         self.active_alerts: Dict[str, Alert] = {}
-        self.alert_history: List[Alert] = []
+        self.alert_history: Deque[Alert] = deque(maxlen=max(1, history_size))
+        self.window_s = window_s
+        self.min_jobs = min_jobs
+        self.max_keys = max_keys
+        self.windows: 'OrderedDict[Tuple[str, str], WindowStats]' = OrderedDict()
+        self.events_observed = 0
         self.webhook_url: Optional[str] = os.getenv('ALERT_WEBHOOK_URL')
         self.slack_webhook: Optional[str] = os.getenv('SLACK_WEBHOOK_URL')
         self.email_api: Optional[str] = os.getenv('EMAIL_API_URL')
@@ -95,12 +224,14 @@ class AlertManager:
         self.add_rule(AlertRule(
             name='high_failure_rate',
             condition=lambda metrics: (
+                metrics.get('total_jobs', 0) >= metrics.get('min_jobs', 0) and
                 metrics.get('failed_jobs', 0) / max(metrics.get('total_jobs', 1), 1) > 0.1
             ),
             severity=AlertSeverity.ERROR,
             message_template='High job failure rate: {failed_jobs}/{total_jobs} ({rate:.1f}%)',
             labels={'category': 'reliability'},
-            cooldown_minutes=15
+            cooldown_minutes=15,
+            streaming=True
         ))
         
         # Long running jobs
@@ -110,7 +241,8 @@ class AlertManager:
             severity=AlertSeverity.WARNING,
             message_template='Job running for {max_duration_s:.0f}s (>1h)',
             labels={'category': 'performance'},
-            cooldown_minutes=30
+            cooldown_minutes=30,
+            streaming=True
         ))
         
         # High memory usage
@@ -120,7 +252,8 @@ class AlertManager:
             severity=AlertSeverity.WARNING,
             message_template='High memory usage: {max_memory_mb:.0f}MB',
             labels={'category': 'resources'},
-            cooldown_minutes=10
+            cooldown_minutes=10,
+            streaming=True
         ))
         
         # No jobs received
@@ -133,7 +266,8 @@ class AlertManager:
             severity=AlertSeverity.WARNING,
             message_template='No jobs received in the last hour (expected {expected_jobs_per_hour})',
             labels={'category': 'availability'},
-            cooldown_minutes=60
+            cooldown_minutes=60,
+            streaming=True
         ))
         
         # Event ingestion lag
@@ -176,16 +310,26 @@ class AlertManager:
         Returns:
             List of new alerts
         """
+        return self._evaluate(self.rules, metrics)
+    
+    def _evaluate(
+        self,
+        rules: List[AlertRule],
+        metrics: Dict[str, Any],
+        scope: Optional[str] = None,
+        scope_labels: Optional[Dict[str, str]] = None
+    ) -> List[Alert]:
         new_alerts = []
         now = datetime.utcnow()
         
-        for rule in self.rules:
+        for rule in rules:
+            alert_key = rule.name if scope is None else f'{rule.name}[{scope}]'
             try:
                 # Check if condition is met
                 if rule.condition(metrics):
                     # Check cooldown
-                    if rule.name in self.active_alerts:
-                        alert = self.active_alerts[rule.name]
+                    if alert_key in self.active_alerts:
+                        alert = self.active_alerts[alert_key]
                         if (now - alert.started_at).total_seconds() < rule.cooldown_minutes * 60:
                             continue  # Still in cooldown
                     
@@ -197,34 +341,35 @@ class AlertManager:
                         severity=rule.severity,
                         state=AlertState.FIRING,
                         message=message,
-                        labels=rule.labels or {},
-                        annotations={'metrics': json.dumps(metrics)},
+                        labels={**(rule.labels or {}), **(scope_labels or {})},
+                        annotations={'metrics': json.dumps(metrics, default=str)},
                         started_at=now
                     )
                     
-                    self.active_alerts[rule.name] = alert
+                    self.active_alerts[alert_key] = alert
                     new_alerts.append(alert)
                     
                     logger.warning(
                         "alert_triggered",
                         alert_name=rule.name,
+                        scope=scope,
                         severity=rule.severity,
                         message=message
                     )
                 
                 else:
                     # Resolve alert if it was active
-                    if rule.name in self.active_alerts:
-                        alert = self.active_alerts[rule.name]
+                    if alert_key in self.active_alerts:
+                        alert = self.active_alerts.pop(alert_key)
                         alert.state = AlertState.RESOLVED
                         alert.resolved_at = now
                         
                         self.alert_history.append(alert)
-                        del self.active_alerts[rule.name]
                         
                         logger.info(
                             "alert_resolved",
                             alert_name=rule.name,
+                            scope=scope,
                             duration_s=(now - alert.started_at).total_seconds()
                         )
             
@@ -237,6 +382,78 @@ class AlertManager:
         
         return new_alerts
     
+    @staticmethod
+    def _event_fields(event: Dict[str, Any]) -> Tuple[str, str, str, str, Dict[str, Any]]:
+        """(site, app, entity id, kind, event payload) of a stored or wire-format event."""
+        if 'payload' in event:
+            # Row of the event table (as published on the event hub)
+            payload = event.get('payload') or {}
+            if isinstance(payload, str):
+                payload = json.loads(payload)
+            return (str(event.get('site_id')), str(event.get('app_id')), str(event.get('entity_id')),
+                    event.get('kind') or payload.get('kind', ''), payload)
+        payload = event.get('event', {})
+        return (str(event.get('site_id')), str(event.get('app', {}).get('app_id')),
+                str(event.get('entity', {}).get('id')), payload.get('kind', ''), payload)
+    
+    def _window(self, key: Tuple[str, str]) -> WindowStats:
+        stats = self.windows.get(key)
+        if stats is None:
+            stats = self.windows[key] = WindowStats(self.window_s)
+            if len(self.windows) > self.max_keys:
+                self.windows.popitem(last=False)
+        else:
+            self.windows.move_to_end(key)
+        return stats
+    
+    def _evaluate_key(self, key: Tuple[str, str], stats: WindowStats, now: float) -> List[Alert]:
+        metrics = stats.snapshot(now)
+        metrics.update(site_id=key[0], app_id=key[1], min_jobs=self.min_jobs)
+        rules = [r for r in self.rules if r.streaming]
+        return self._evaluate(rules, metrics, f'{key[0]}/{key[1]}', {'site_id': key[0], 'app_id': key[1]})
+    
+    def observe(self, event: Dict[str, Any], now: Optional[float] = None) -> List[Alert]:
+        """
+        Update the sliding-window stats with one ingested event and evaluate
+        the streaming rules for its (site, app).
+        
+        Args:
+            event: Event table row (as published on the event hub) or wire-format event
+            now: Arrival time (epoch seconds, defaults to the current time)
+            
+        Returns:
+            List of new alerts
+        """
+        now = time.time() if now is None else now
+        site, app, entity_id, kind, payload = self._event_fields(event)
+        metrics = payload.get('metrics') or {}
+        failed = kind == 'error' or payload.get('status') == 'failed'
+        stats = self._window((site, app))
+        stats.add(entity_id, kind, failed, metrics.get('duration_s'), metrics.get('mem_max_mb'), now)
+        self.events_observed += 1
+        if kind not in TERMINAL_KINDS and kind != 'started':
+            return []
+        return self._evaluate_key((site, app), stats, now)
+    
+    def tick(self, now: Optional[float] = None) -> List[Alert]:
+        """
+        Re-evaluate every tracked key, for rules driven by the passage of
+        time (no activity, jobs still running). Keys idle for two windows
+        without running jobs or active alerts are forgotten.
+        
+        Returns:
+            List of new alerts
+        """
+        now = time.time() if now is None else now
+        new_alerts = []
+        for key, stats in list(self.windows.items()):
+            new_alerts.extend(self._evaluate_key(key, stats, now))
+            scope = f'[{key[0]}/{key[1]}]'
+            if (now - stats.last_seen > 2 * self.window_s and not stats.running
+                    and not any(k.endswith(scope) for k in self.active_alerts)):
+                del self.windows[key]
+        return new_alerts
+    
     async def send_alert(self, alert: Alert) -> None:
         """
         Send alert to configured notification channels.
@@ -0,0 +1,84 @@
+"""Bounded in-process cache of applications already stored in the `app` table."""
+from collections import OrderedDict
+from typing import Any, Iterable, Optional, Tuple
+
+
+class KnownAppCache:
+    """
+    LRU cache mapping app_id to the (name, version) last written for it.
+
+    Used on the ingest hot path to skip the `app` upsert when the row is
+    already known to be current. Entries must only be added once the write
+    that created them has committed, otherwise a rolled-back transaction
+    would leave a stale entry behind.
+
+    Not thread-safe; intended to be used from a single event loop.
+    """
+
+    def __init__(self, max_size: int = 10000):
+        """
+        Initialize the cache.
+
+        Args:
+            max_size: Maximum number of app_ids to remember
+        """
+        self.max_size = max(1, max_size)
+        self._entries: "OrderedDict[str, Tuple[str, str]]" = OrderedDict()
+        self.hits = 0
+        self.misses = 0
+
+    @staticmethod
+    def _key(app_id: Any) -> str:
+        return str(app_id).lower()
+
+    def is_current(self, app_id: Any, name: str, version: str) -> bool:
+        """
+        Check whether the stored row for `app_id` already matches.
+
+        Counts a hit when the app is known with the same name and version,
+        and a miss otherwise (unknown app or changed name/version).
+
+        Returns:
+            True if the `app` write can be skipped
+        """
+        key = self._key(app_id)
+        cached = self._entries.get(key)
+        if cached is not None and cached == (name, version):
+            self._entries.move_to_end(key)
+            self.hits += 1
+            return True
+        self.misses += 1
+        return False
+
+    def add(self, app_id: Any, name: str, version: str) -> None:
+        """Record that `app_id` is stored with the given name and version."""
+        key = self._key(app_id)
+        self._entries[key] = (name, version)
+        self._entries.move_to_end(key)
+        while len(self._entries) > self.max_size:
+            self._entries.popitem(last=False)
+
+    def warm(self, rows: Iterable[Tuple[Any, str, str]]) -> int:
+        """
+        Bulk-load (app_id, name, version) rows, e.g. from the `app` table.
+
+        Returns:
+            Number of entries now cached
+        """
+        for app_id, name, version in rows:
+            self.add(app_id, name, version)
+        return len(self._entries)
+
+    def get(self, app_id: Any) -> Optional[Tuple[str, str]]:
+        """Return the cached (name, version) for `app_id` without counting a lookup."""
+        return self._entries.get(self._key(app_id))
+
+    def clear(self) -> None:
+        """Drop all entries."""
+        self._entries.clear()
+
+    def __len__(self) -> int:
+        return len(self._entries)
+
+    def __contains__(self, app_id: Any) -> bool:
+        return self._key(app_id) in self._entries
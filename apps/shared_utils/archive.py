@@ -0,0 +1,320 @@
+"""Streaming Parquet export helpers for the archiver: Arrow conversion and S3 multipart upload."""
+import hashlib
+import json
+from datetime import datetime, timedelta, timezone
+from typing import Any, Dict, Iterable, List, Optional, Sequence, Tuple
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
+
+# Hypertable time column per archived table
+TIME_COLUMNS = {'job': 'inserted_at', 'subjob': 'inserted_at', 'event': 'at'}
+
+# S3 rejects multipart parts smaller than this (except the last one)
+MIN_PART_SIZE = 5 * 1024 * 1024
+
+
+# Bumped when the manifest layout changes
+MANIFEST_VERSION = 1
+
+HOUR = timedelta(hours=1)
+
+
+def partition_key(prefix: str, site_id: str, table: str, start: datetime) -> str:
+    """S3 key of the Parquet file holding one hourly partition."""
+    return f"{prefix}{site_id}/{table}/dt={start:%Y/%m/%d/%H}/part.parquet"
+
+
+def manifest_key(prefix: str, site_id: str, table: str, start: datetime) -> str:
+    """S3 key of the manifest describing one hourly partition."""
+    return f"{prefix}{site_id}/{table}/dt={start:%Y/%m/%d/%H}/_manifest.json"
+
+
+def floor_hour(ts: datetime) -> datetime:
+    return ts.replace(minute=0, second=0, microsecond=0)
+
+
+def ceil_hour(ts: datetime) -> datetime:
+    floored = floor_hour(ts)
+    return floored if floored == ts else floored + HOUR
+
+
+def hours(start: datetime, end: datetime) -> List[Tuple[datetime, datetime]]:
+    """Hourly partitions covering [start, end), aligned to whole hours."""
+    out = []
+    t = floor_hour(start)
+    while t < end:
+        out.append((t, t + HOUR))
+        t += HOUR
+    return out
+
+
+def plan_units(
+    chunks: Iterable[Tuple[datetime, datetime]],
+    start: datetime,
+    end: datetime
+) -> List[Tuple[datetime, datetime]]:
+    """
+    Work units for archiving [start, end): the hourly partitions of the
+    hypertable chunks overlapping it.
+
+    Every unit is one hour, so a chunk's hours are exported in parallel and
+    a failed hour only holds the watermark back from that hour. Hours not
+    covered by any chunk hold no rows and need no work. Units are returned
+    in time order without duplicates.
+    """
+    units: List[Tuple[datetime, datetime]] = []
+    for lo, hi in sorted(chunks):
+        for unit in hours(max(lo, start), min(hi, end)):
+            if not units or unit[0] >= units[-1][1]:
+                units.append(unit)
+    return units
+
+
+def stale_hours(live: Dict[datetime, int], archived: Dict[datetime, int]) -> List[datetime]:
+    """
+    Archived hours whose row count in hot storage no longer matches the manifest.
+
+    Late rows (events whose `at` lies in an hour that was already exported,
+    possibly one that had no rows, and so no manifest, back then) show up
+    as a different count; those hours need to be exported again.
+
+    Args:
+        live: Rows per hour currently in the table
+        archived: Rows per hour recorded in the manifests (missing: none)
+    """
+    return sorted(h for h, n in live.items() if archived.get(h, 0) != n)
+
+
+def next_watermark(
+    watermark: datetime,
+    units: Sequence[Tuple[datetime, datetime]],
+    succeeded: Sequence[bool],
+    end: datetime
+) -> datetime:
+    """
+    Advance a watermark over the completed prefix of `units`.
+
+    Everything before the first failed unit is archived (gaps between units
+    had no data); without failures the watermark moves to `end`.
+    """
+    for unit, ok in zip(units, succeeded):
+        if not ok:
+            return max(watermark, unit[0])
+    return max(watermark, end)
+
+
+def build_manifest(
+    table: str,
+    site_id: str,
+    start: datetime,
+    end: datetime,
+    rows: int,
+    key: Optional[str] = None,
+    size_bytes: int = 0,
+    sha256: Optional[str] = None,
+    min_time: Optional[datetime] = None,
+    max_time: Optional[datetime] = None
+) -> Dict[str, Any]:
+    """Manifest written next to each partition; an empty hour has rows=0 and no file."""
+    def iso(ts: Optional[datetime]) -> Optional[str]:
+        return ts.isoformat() if ts is not None else None
+
+    return {
+        'version': MANIFEST_VERSION,
+        'table': table,
+        'site_id': site_id,
+        'start': iso(start),
+        'end': iso(end),
+        'rows': rows,
+        'min_time': iso(min_time),
+        'max_time': iso(max_time),
+        'key': key,
+        'size_bytes': size_bytes,
+        'sha256': sha256,
+        'exported_at': datetime.now(timezone.utc).isoformat(),
+    }
+
+
+def _arrow_type(pg_type: str) -> Any:
+    import pyarrow as pa
+
+    mapping = {
+        'bool': pa.bool_(),
+        'int2': pa.int16(),
+        'int4': pa.int32(),
+        'int8': pa.int64(),
+        'float4': pa.float32(),
+        'float8': pa.float64(),
+        'numeric': pa.float64(),
+        'date': pa.date32(),
+        'timestamp': pa.timestamp('us'),
+        'timestamptz': pa.timestamp('us', tz='UTC'),
+    }
+    # uuid, text, json/jsonb and anything unknown are stored as strings
+    return mapping.get(pg_type, pa.string())
+
+
+def arrow_schema(columns: Iterable[Tuple[str, str]]) -> Any:
+    """
+    Build a fixed Arrow schema from (column name, Postgres type name) pairs.
+
+    Deriving the schema from the query rather than from the data keeps it
+    identical across row groups, even for chunks where a column is all NULL.
+    """
+    import pyarrow as pa
+
+    return pa.schema([pa.field(name, _arrow_type(pg_type)) for name, pg_type in columns])
+
+
+def _as_string(value: Any) -> Optional[str]:
+    if value is None or isinstance(value, str):
+        return value
+    if isinstance(value, (dict, list)):
+        return json.dumps(value, default=str)
+    return str(value)
+
+
+def rows_to_batch(rows: Sequence[Sequence[Any]], schema: Any) -> Any:
+    """
+    Convert a chunk of records (asyncpg Records or tuples) to an Arrow record batch.
+
+    Columns are converted one at a time so only the chunk itself and the
+    resulting batch are held in memory.
+    """
+    import pyarrow as pa
+
+    arrays = []
+    for i, field in enumerate(schema):
+        values: List[Any] = [r[i] for r in rows]
+        if pa.types.is_string(field.type):
+            values = [_as_string(v) for v in values]
+        elif pa.types.is_floating(field.type):
+            values = [None if v is None else float(v) for v in values]
+        arrays.append(pa.array(values, type=field.type))
+    return pa.RecordBatch.from_arrays(arrays, schema=schema)
+
+
+class S3MultipartWriter:
+    """
+    Write-only file object that streams into an S3 object.
+
+    Bytes are buffered until `part_size` is reached and then sent as one
+    multipart upload part, so memory use is bounded by one part whatever the
+    total size. Output smaller than one part is sent with a single
+    put_object instead. A SHA-256 of everything written is kept in
+    `sha256`. `close()` completes the upload and `abort()`
+    discards it; both are idempotent, and closing an aborted writer does
+    nothing.
+    """
+
+    def __init__(self, s3: Any, bucket: str, key: str, part_size: int = 16 * 1024 * 1024):
+        """
+        Args:
+            s3: boto3 S3 client
+            bucket: Target bucket
+            key: Target key
+            part_size: Multipart part size in bytes (at least 5 MiB)
+        """
+        self.s3 = s3
+        self.bucket = bucket
+        self.key = key
+        self.part_size = max(MIN_PART_SIZE, part_size)
+        self._buffer = bytearray()
+        self._upload_id: Optional[str] = None
+        self._parts: List[Dict[str, Any]] = []
+        self._position = 0
+        self._closed = False
+        self.aborted = False
+        self.sha256 = hashlib.sha256()
+
+    # File-object protocol used by pyarrow
+
+    @property
+    def closed(self) -> bool:
+        return self._closed
+
+    def writable(self) -> bool:
+        return True
+
+    def readable(self) -> bool:
+        return False
+
+    def seekable(self) -> bool:
+        return False
+
+    def tell(self) -> int:
+        return self._position
+
+    def flush(self) -> None:
+        pass
+
+    def write(self, data: Any) -> int:
+        if self._closed:
+            raise ValueError('write to closed S3MultipartWriter')
+        data = memoryview(data).cast('B')
+        self.sha256.update(data)
+        self._buffer += data
+        self._position += len(data)
+        while len(self._buffer) >= self.part_size:
+            self._upload_part(self.part_size)
+        return len(data)
+
+    def _upload_part(self, size: int) -> None:
+        if self._upload_id is None:
+            self._upload_id = self.s3.create_multipart_upload(Bucket=self.bucket, Key=self.key)['UploadId']
+        body = bytes(self._buffer[:size])
+        del self._buffer[:size]
+        number = len(self._parts) + 1
+        r = self.s3.upload_part(
+            Bucket=self.bucket, Key=self.key, UploadId=self._upload_id, PartNumber=number, Body=body
+        )
+        self._parts.append({'ETag': r['ETag'], 'PartNumber': number})
+
+    @property
+    def parts(self) -> int:
+        """Number of multipart parts uploaded so far."""
+        return len(self._parts)
+
+    def close(self) -> None:
+        """Upload what is left and complete the object."""
+        if self._closed:
+            return
+        self._closed = True
+        if self._upload_id is None:
+            self.s3.put_object(Bucket=self.bucket, Key=self.key, Body=bytes(self._buffer))
+        else:
+            if self._buffer:
+                self._upload_part(len(self._buffer))
+            self.s3.complete_multipart_upload(
+                Bucket=self.bucket, Key=self.key, UploadId=self._upload_id,
+                MultipartUpload={'Parts': self._parts}
+            )
+        self._buffer = bytearray()
+
+    def abort(self) -> None:
+        """Discard the upload; nothing becomes visible under the key."""
+        if self._closed:
+            return
+        self._closed = True
+        self.aborted = True
+        self._buffer = bytearray()
+        if self._upload_id is not None:
+            try:
+                self.s3.abort_multipart_upload(Bucket=self.bucket, Key=self.key, UploadId=self._upload_id)
+            except Exception as e:
+                # Leftover parts stay billable until aborted, e.g. by a bucket lifecycle rule
+                logger.warning("multipart_abort_failed", key=self.key, error=str(e))
+
+    def __enter__(self) -> 'S3MultipartWriter':
+        return self
+
+    def __exit__(self, exc_type, exc, tb) -> None:
+        if exc_type is None:
+            self.close()
+        else:
+            self.abort()
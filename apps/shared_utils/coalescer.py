@@ -0,0 +1,112 @@
+"""Micro-batching coalescer that turns many single submissions into batch calls."""
+import asyncio
+from typing import Any, Awaitable, Callable, List, Optional, Set, Tuple
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
+
+# flush(items) -> one result per item; an item's result may be an exception instance
+FlushFn = Callable[[List[Any]], Awaitable[List[Any]]]
+
+
+class BatchCoalescer:
+    """
+    Collect items for up to `linger_s` seconds or `max_items` items, then
+    hand them to `flush` as one batch.
+
+    Each `submit()` call waits for and returns its own item's result, so
+    callers keep per-item acknowledgement semantics. If `flush` raises, every
+    item in that batch fails with the same exception.
+    """
+
+    def __init__(self, flush: FlushFn, max_items: int = 100, linger_s: float = 0.005,
+                 name: str = 'coalescer'):
+        """
+        Initialize the coalescer.
+
+        Args:
+            flush: Async callable sending a batch and returning per-item results
+            max_items: Flush as soon as this many items are pending
+            linger_s: Maximum time an item waits for companions before flushing
+            name: Name used in log events
+        """
+        self._flush_fn = flush
+        self.max_items = max(1, max_items)
+        self.linger_s = max(0.0, linger_s)
+        self.name = name
+        self._pending: List[Tuple[Any, asyncio.Future]] = []
+        self._timer: Optional[asyncio.TimerHandle] = None
+        self._inflight: Set[asyncio.Task] = set()
+        self._closed = False
+
+    @property
+    def pending(self) -> int:
+        """Number of items waiting for the next flush."""
+        return len(self._pending)
+
+    async def submit(self, item: Any) -> Any:
+        """
+        Queue an item and wait for its result.
+
+        Raises:
+            RuntimeError: If the coalescer has been closed
+            Exception: Whatever the flush reported for this item
+        """
+        if self._closed:
+            raise RuntimeError(f'{self.name} is closed')
+
+        loop = asyncio.get_running_loop()
+        fut = loop.create_future()
+        self._pending.append((item, fut))
+
+        if len(self._pending) >= self.max_items:
+            self._flush_now()
+        elif self._timer is None:
+            self._timer = loop.call_later(self.linger_s, self._flush_now)
+
+        return await fut
+
+    def _flush_now(self) -> None:
+        if self._timer is not None:
+            self._timer.cancel()
+            self._timer = None
+        if not self._pending:
+            return
+        batch, self._pending = self._pending, []
+        task = asyncio.get_running_loop().create_task(self._run(batch))
+        self._inflight.add(task)
+        task.add_done_callback(self._inflight.discard)
+
+    async def _run(self, batch: List[Tuple[Any, asyncio.Future]]) -> None:
+        try:
+            results = await self._flush_fn([item for item, _ in batch])
+            if len(results) != len(batch):
+                raise RuntimeError(
+                    f'{self.name} flush returned {len(results)} results for {len(batch)} items'
+                )
+        except Exception as e:
+            logger.warning("coalesced_flush_failed", coalescer=self.name,
+                           count=len(batch), error=str(e))
+            for _, fut in batch:
+                if not fut.done():
+                    fut.set_exception(e)
+            return
+
+        for (_, fut), res in zip(batch, results):
+            if fut.done():
+                continue
+            if isinstance(res, BaseException):
+                fut.set_exception(res)
+            else:
+                fut.set_result(res)
+
+    async def close(self) -> None:
+        """Flush anything pending and wait for in-flight batches to finish."""
+        self._closed = True
+        self._flush_now()
+        if self._inflight:
+            await asyncio.gather(*self._inflight, return_exceptions=True)
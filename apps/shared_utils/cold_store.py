@@ -0,0 +1,249 @@
+"""Read-side of the S3 Parquet archive: partition pruning, local file cache and latest-state scans."""
+import hashlib
+import os
+import threading
+import time
+from collections import OrderedDict
+from datetime import datetime, timedelta, timezone
+from typing import Any, Dict, Iterator, List, Optional, Sequence, Tuple
+
+from .archive import TIME_COLUMNS, floor_hour
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
+
+
+def key_hour(key: str) -> Optional[datetime]:
+    """Partition hour of a `.../dt=YYYY/MM/DD/HH/part.parquet` key, or None."""
+    marker = key.rfind('/dt=')
+    if marker < 0:
+        return None
+    try:
+        y, m, d, h = key[marker + 4:].split('/')[:4]
+        return datetime(int(y), int(m), int(d), int(h), tzinfo=timezone.utc)
+    except ValueError:
+        return None
+
+
+def cold_window(
+    start: datetime,
+    end: Optional[datetime],
+    cut: datetime
+) -> Optional[Tuple[datetime, datetime]]:
+    """
+    The archived part [start, end) of a query range whose `end` is inclusive.
+
+    Naive timestamps are taken as UTC, matching the hot query.
+
+    Returns:
+        None if the range starts at or after `cut` (hot storage only)
+    """
+    if start.tzinfo is None:
+        start = start.replace(tzinfo=timezone.utc)
+    if end is not None and end.tzinfo is None:
+        end = end.replace(tzinfo=timezone.utc)
+    if start >= cut:
+        return None
+    return start, min(end + timedelta(microseconds=1), cut) if end else cut
+
+
+class FileCache:
+    """
+    Size-bounded local cache of downloaded objects (least recently used evicted).
+
+    Archived partitions never change after their manifest is written, so
+    cached files need no revalidation.
+    """
+
+    def __init__(self, directory: str, max_bytes: int):
+        self.directory = directory
+        self.max_bytes = max_bytes
+        self._files: 'OrderedDict[str, int]' = OrderedDict()
+        self._lock = threading.Lock()
+        os.makedirs(directory, exist_ok=True)
+        for name in sorted(os.listdir(directory), key=lambda n: os.path.getmtime(os.path.join(directory, n))):
+            if name.endswith('.parquet'):
+                self._files[name] = os.path.getsize(os.path.join(directory, name))
+        self.hits = 0
+        self.misses = 0
+
+    @property
+    def size_bytes(self) -> int:
+        return sum(self._files.values())
+
+    def _name(self, key: str) -> str:
+        return hashlib.sha1(key.encode('utf-8')).hexdigest() + '.parquet'
+
+    def get(self, key: str, download) -> str:
+        """
+        Local path of `key`, calling `download(key, path)` on a miss.
+
+        Downloads go to a temporary file first, so a failed download never
+        leaves a truncated file in the cache.
+        """
+        name = self._name(key)
+        path = os.path.join(self.directory, name)
+        with self._lock:
+            if name in self._files and os.path.exists(path):
+                self._files.move_to_end(name)
+                self.hits += 1
+                return path
+        tmp = f"{path}.{threading.get_ident()}.tmp"
+        try:
+            download(key, tmp)
+            os.replace(tmp, path)
+        except BaseException:
+            if os.path.exists(tmp):
+                os.remove(tmp)
+            raise
+        with self._lock:
+            self.misses += 1
+            self._files[name] = os.path.getsize(path)
+            self._files.move_to_end(name)
+            while self.size_bytes > self.max_bytes and len(self._files) > 1:
+                old, _ = self._files.popitem(last=False)
+                try:
+                    os.remove(os.path.join(self.directory, old))
+                except FileNotFoundError:
+                    pass
+        return path
+
+
+class ColdStore:
+    """
+    Queries the Parquet archive written by the archiver.
+
+    Partitions are pruned by their `dt=` path before anything is read:
+    only hours inside the requested range are listed and downloaded.
+    Scans go newest hour first and stop as soon as the caller has enough
+    rows. All methods block, so async callers should run them in a thread.
+    """
+
+    def __init__(
+        self,
+        bucket: str,
+        prefix: str,
+        site_id: str,
+        cache_dir: str,
+        cache_max_bytes: int = 1024 * 1024 * 1024,
+        listing_ttl_s: float = 300.0,
+        s3: Any = None
+    ):
+        """
+        Args:
+            bucket: Archive bucket
+            prefix: Archive key prefix (the archiver's S3_PREFIX)
+            site_id: Site whose partitions are read
+            cache_dir: Directory for cached Parquet files
+            cache_max_bytes: Size bound of the file cache
+            listing_ttl_s: How long a day's partition listing is reused
+            s3: boto3 S3 client (created on first use if omitted)
+        """
+        self.bucket = bucket
+        self.prefix = prefix
+        self.site_id = site_id
+        self.cache = FileCache(cache_dir, cache_max_bytes)
+        self.listing_ttl_s = listing_ttl_s
+        self._s3 = s3
+        self._listings: Dict[str, Tuple[float, List[str]]] = {}
+
+    @property
+    def s3(self) -> Any:
+        if self._s3 is None:
+            import boto3
+            self._s3 = boto3.client('s3')
+        return self._s3
+
+    def _list_day(self, table: str, day: datetime) -> List[str]:
+        prefix = f"{self.prefix}{self.site_id}/{table}/dt={day:%Y/%m/%d}/"
+        cached = self._listings.get(prefix)
+        if cached and time.monotonic() - cached[0] < self.listing_ttl_s:
+            return cached[1]
+        keys: List[str] = []
+        for page in self.s3.get_paginator('list_objects_v2').paginate(Bucket=self.bucket, Prefix=prefix):
+            keys.extend(o['Key'] for o in page.get('Contents', []) if o['Key'].endswith('/part.parquet'))
+        self._listings[prefix] = (time.monotonic(), keys)
+        return keys
+
+    def partitions(self, table: str, start: datetime, end: datetime) -> List[Tuple[datetime, str]]:
+        """(hour, key) of archived partitions overlapping [start, end), newest first."""
+        first = floor_hour(start)
+        found: List[Tuple[datetime, str]] = []
+        day = first.replace(hour=0)
+        while day < end:
+            for key in self._list_day(table, day):
+                hour = key_hour(key)
+                if hour is not None and first <= hour < end:
+                    found.append((hour, key))
+            day += timedelta(days=1)
+        found.sort(reverse=True)
+        return found
+
+    def _download(self, key: str, path: str) -> None:
+        self.s3.download_file(self.bucket, key, path)
+
+    def scan_latest(
+        self,
+        table: str,
+        id_col: str,
+        start: datetime,
+        end: datetime,
+        before: Optional[Tuple[datetime, str]] = None,
+        status: Optional[Sequence[str]] = None,
+        app_ids: Optional[Sequence[str]] = None
+    ) -> Iterator[Dict[str, Any]]:
+        """
+        Latest archived version of each entity in [start, end), newest first.
+
+        Rows are ordered by (time, id) descending, like the current-state
+        queries, and `before` is an exclusive keyset bound in that order.
+        Status and app filters apply to the latest version. Partitions
+        newer than `before` are still read (ids only) so that an entity
+        already returned on an earlier page is not returned again with an
+        older version. Only the ids seen so far and one filtered partition
+        are kept in memory.
+        """
+        import pyarrow.dataset as ds
+
+        time_col = TIME_COLUMNS[table]
+        before_hour = floor_hour(before[0]) if before else None
+        seen = set()
+        for hour, key in self.partitions(table, start, end):
+            expr = (ds.field(time_col) >= max(start, hour)) & (ds.field(time_col) < min(end, hour + timedelta(hours=1)))
+            try:
+                dataset = ds.dataset(self.cache.get(key, self._download), format='parquet')
+            except FileNotFoundError:
+                # Evicted by a concurrent scan between lookup and open
+                dataset = ds.dataset(self.cache.get(key, self._download), format='parquet')
+            if before_hour is not None and hour > before_hour:
+                seen.update(dataset.to_table(columns=[id_col], filter=expr).column(id_col).to_pylist())
+                continue
+            data = dataset.to_table(filter=expr)
+            if data.num_rows == 0:
+                continue
+            rows = data.sort_by([(time_col, 'descending'), (id_col, 'descending')]).to_pylist()
+            del data
+            for row in rows:
+                entity = row[id_col]
+                if entity in seen:
+                    continue
+                seen.add(entity)
+                if before is not None and (row[time_col], entity) >= (before[0], str(before[1])):
+                    continue
+                if status and row.get('status') not in status:
+                    continue
+                if app_ids is not None and row.get('app_id') not in app_ids:
+                    continue
+                yield row
+
+    def stats(self) -> Dict[str, Any]:
+        return {
+            'cache_files': len(self.cache._files),
+            'cache_bytes': self.cache.size_bytes,
+            'cache_hits': self.cache.hits,
+            'cache_misses': self.cache.misses,
+        }
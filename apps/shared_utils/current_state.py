@@ -0,0 +1,20 @@
+"""Reduction of ingested events to the per-entity rows of the current-state tables."""
+from typing import Any, List, Tuple
+
+
+def latest_per_entity(valid: List[Tuple[Any, Any]], entity_type: str) -> List[Tuple[Any, Any]]:
+    """
+    Keep the most recent (event, at) pair per entity of `entity_type`.
+
+    ON CONFLICT DO UPDATE cannot touch the same row twice in one statement,
+    so a batch holding several events for one entity must be reduced to a
+    single row first. Later items win ties; ids compare case-insensitively.
+    """
+    latest = {}
+    for ev, ev_at in valid:
+        if ev.entity['type'] != entity_type:
+            continue
+        key = str(ev.entity['id']).lower()
+        if key not in latest or latest[key][1] <= ev_at:
+            latest[key] = (ev, ev_at)
+    return list(latest.values())
@@ -0,0 +1,174 @@
+"""Time-bounded idempotency-key filter used to drop duplicate events before any I/O."""
+import hashlib
+import math
+import time
+from collections import OrderedDict
+from typing import Callable, Iterable, List, Optional
+
+
+class RotatingBloomFilter:
+    """
+    Two-generation Bloom filter over a sliding time window.
+
+    Keys are added to the current generation; lookups consult both. Every
+    `window_s` the previous generation is discarded and the current one
+    takes its place, so a key is remembered for between one and two
+    windows. Each generation is sized for `capacity` keys at the given
+    false positive rate.
+    """
+
+    def __init__(
+        self,
+        capacity: int = 100000,
+        error_rate: float = 0.001,
+        window_s: float = 600.0,
+        clock: Callable[[], float] = time.monotonic
+    ):
+        """
+        Args:
+            capacity: Keys per generation the false positive rate is sized for
+            error_rate: Target false positive rate per generation
+            window_s: Lifetime of a generation
+            clock: Monotonic time source
+        """
+        capacity = max(1, capacity)
+        self.bits = max(8, int(-capacity * math.log(error_rate) / (math.log(2) ** 2)))
+        self.hashes = max(1, round(self.bits / capacity * math.log(2)))
+        self.window_s = window_s
+        self._clock = clock
+        self._current = bytearray((self.bits + 7) // 8)
+        self._previous = bytearray(len(self._current))
+        self._rotated_at = clock()
+
+    def _positions(self, key: str) -> List[int]:
+        # Double hashing (Kirsch-Mitzenmacher) over one 128-bit digest
+        digest = hashlib.blake2b(key.encode('utf-8'), digest_size=16).digest()
+        h1 = int.from_bytes(digest[:8], 'little')
+        h2 = int.from_bytes(digest[8:], 'little') | 1
+        return [(h1 + i * h2) % self.bits for i in range(self.hashes)]
+
+    def _maybe_rotate(self) -> None:
+        now = self._clock()
+        elapsed = now - self._rotated_at
+        if elapsed < self.window_s:
+            return
+        if elapsed >= 2 * self.window_s:
+            self._previous = bytearray(len(self._current))
+        else:
+            self._previous = self._current
+        self._current = bytearray(len(self._previous))
+        self._rotated_at = now
+
+    def add(self, key: str) -> None:
+        self._maybe_rotate()
+        for p in self._positions(key):
+            self._current[p >> 3] |= 1 << (p & 7)
+
+    def __contains__(self, key: str) -> bool:
+        self._maybe_rotate()
+        positions = self._positions(key)
+        for gen in (self._current, self._previous):
+            if all(gen[p >> 3] & (1 << (p & 7)) for p in positions):
+                return True
+        return False
+
+
+class DedupFilter:
+    """
+    Recently accepted idempotency keys: a rotating Bloom filter plus an exact LRU.
+
+    `seen(key)` is True only for keys in the LRU that were accepted less
+    than `window_s` ago, so a Bloom false positive never drops an event.
+    The Bloom filter answers "definitely new" for most keys and, for keys
+    that have already left the LRU, counts them as `suspected` duplicates
+    (sent on to the next stage, which decides).
+
+    Keys must only be added once the event is safely stored or spooled;
+    adding them earlier would drop the retry of a write that failed.
+
+    Not thread-safe; intended to be used from a single event loop.
+    """
+
+    def __init__(
+        self,
+        max_size: int = 100000,
+        window_s: float = 600.0,
+        error_rate: float = 0.001,
+        clock: Callable[[], float] = time.monotonic
+    ):
+        """
+        Args:
+            max_size: Maximum number of keys kept exactly
+            window_s: How long an accepted key counts as a duplicate
+            error_rate: Bloom filter false positive rate
+            clock: Monotonic time source
+        """
+        self.max_size = max(1, max_size)
+        self.window_s = window_s
+        self._clock = clock
+        self._bloom = RotatingBloomFilter(self.max_size, error_rate, window_s, clock)
+        self._keys: "OrderedDict[str, float]" = OrderedDict()
+        self.duplicates = 0
+        self.suspected = 0
+
+    def seen(self, key: str) -> bool:
+        """
+        Check whether `key` was accepted within the window; counts duplicates.
+
+        Returns:
+            True if the event is a duplicate and can be dropped
+        """
+        if key not in self._bloom:
+            return False
+        added = self._keys.get(key)
+        if added is not None and self._clock() - added < self.window_s:
+            self.duplicates += 1
+            return True
+        self.suspected += 1
+        return False
+
+    def add(self, key: str) -> None:
+        """Record that the event with `key` was accepted."""
+        now = self._clock()
+        self._bloom.add(key)
+        self._keys[key] = now
+        self._keys.move_to_end(key)
+        cutoff = now - self.window_s
+        while self._keys and (len(self._keys) > self.max_size or next(iter(self._keys.values())) < cutoff):
+            self._keys.popitem(last=False)
+
+    def add_many(self, keys: Iterable[str]) -> None:
+        for key in keys:
+            self.add(key)
+
+    def __len__(self) -> int:
+        return len(self._keys)
+
+    def __contains__(self, key: str) -> bool:
+        added = self._keys.get(key)
+        return added is not None and self._clock() - added < self.window_s
+
+    def stats(self) -> dict:
+        return {
+            'size': len(self._keys),
+            'duplicates': self.duplicates,
+            'suspected': self.suspected,
+        }
+
+
+def first_occurrences(keys: Iterable[str], seen: Optional[Callable[[str], bool]] = None) -> List[int]:
+    """
+    Positions of the events of a batch that need processing.
+
+    A key repeated within the batch is kept at its first position only, and
+    keys `seen` reports as recently accepted are skipped; every position
+    not returned is a duplicate.
+    """
+    positions = []
+    batch_keys = set()
+    for i, key in enumerate(keys):
+        if key in batch_keys or (seen is not None and seen(key)):
+            continue
+        batch_keys.add(key)
+        positions.append(i)
+    return positions
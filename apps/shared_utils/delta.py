@@ -0,0 +1,153 @@
+"""Client-side result set kept current from `since` deltas of the query endpoints."""
+import threading
+import time
+from datetime import datetime, timedelta, timezone
+from typing import Any, Callable, Dict, List, Optional, Tuple
+
+from .federation import row_sort_key
+
+
+class DeltaFrame:
+    """
+    Latest rows of one /v1/jobs or /v1/subjobs query, updated incrementally.
+
+    The first refresh loads a regular page (the newest `max_rows` rows) and
+    keeps the `since` token of the response. Later refreshes request only
+    rows changed after it, merge them by id (the most recent update wins)
+    and drop the ids listed as tombstones. Rows whose last update falls out
+    of the time window are pruned locally, and at most `max_rows` rows are
+    kept, most recently updated first.
+
+    Thread-safe, so one frame can back every dashboard session: `refresh`
+    queries the API at most once per `min_interval_s`, and callers that
+    find another refresh running use the rows as they are.
+    """
+
+    def __init__(
+        self,
+        fetch: Callable[[Dict[str, Any]], Dict[str, Any]],
+        id_col: str,
+        params: Optional[Dict[str, Any]] = None,
+        window: Optional[timedelta] = None,
+        max_rows: int = 1000,
+        min_interval_s: float = 5.0,
+        max_pages: int = 10,
+        clock: Callable[[], float] = time.monotonic
+    ):
+        """
+        Args:
+            fetch: GETs the query endpoint with the given parameters and
+                returns the decoded response (raises on failure)
+            id_col: Row id column ('job_id' or 'subjob_id')
+            params: Fixed query parameters (filters), without from/to/limit
+            window: Only keep rows updated within this long ago
+            max_rows: Most rows kept (also the size of the first page)
+            min_interval_s: Minimum time between two API requests
+            max_pages: Most delta pages fetched by one refresh
+            clock: Monotonic time source
+        """
+        self.fetch = fetch
+        self.id_col = id_col
+        self.params = dict(params or {})
+        self.window = window
+        self.max_rows = max_rows
+        self.min_interval_s = min_interval_s
+        self.max_pages = max_pages
+        self._clock = clock
+        self._lock = threading.Lock()
+        self._rows: Dict[str, Dict[str, Any]] = {}
+        self._keys: Dict[str, Tuple[datetime, str]] = {}
+        self._since: Optional[str] = None
+        self._refreshed_at: Optional[float] = None
+        self.requests = 0
+        self.error: Optional[str] = None
+        self.updated_at: Optional[datetime] = None
+
+    def _window_start(self) -> Optional[datetime]:
+        return datetime.now(timezone.utc) - self.window if self.window else None
+
+    def _request(self, extra: Dict[str, Any]) -> Dict[str, Any]:
+        params = dict(self.params, **extra)
+        start = self._window_start()
+        if start is not None:
+            params['from'] = start.isoformat()
+        self.requests += 1
+        return self.fetch(params)
+
+    def _merge(self, items: List[Dict[str, Any]], tombstones: List[Any]) -> None:
+        for row in items:
+            row_id = str(row.get(self.id_col))
+            key = row_sort_key(row, self.id_col)
+            known = self._keys.get(row_id)
+            if known is None or known <= key:
+                self._rows[row_id] = row
+                self._keys[row_id] = key
+        for row_id in tombstones:
+            self._rows.pop(str(row_id), None)
+            self._keys.pop(str(row_id), None)
+
+    def _prune(self) -> None:
+        start = self._window_start()
+        if start is not None:
+            for row_id in [r for r, (at, _) in self._keys.items() if at < start]:
+                del self._rows[row_id], self._keys[row_id]
+        if len(self._keys) > self.max_rows:
+            keep = sorted(self._keys, key=self._keys.__getitem__, reverse=True)[:self.max_rows]
+            self._rows = {r: self._rows[r] for r in keep}
+            self._keys = {r: self._keys[r] for r in keep}
+
+    def refresh(self, force: bool = False) -> bool:
+        """
+        Bring the rows up to date if the last refresh is old enough.
+
+        Failures are recorded in `error`; the rows are left as they were and
+        the same delta is requested again next time.
+
+        Returns:
+            True if the API was queried successfully
+        """
+        if not self._lock.acquire(blocking=False):
+            return False
+        try:
+            now = self._clock()
+            if not force and self._refreshed_at is not None and now - self._refreshed_at < self.min_interval_s:
+                return False
+            self._refreshed_at = now
+            try:
+                if self._since is None:
+                    data = self._request({'limit': self.max_rows})
+                    self._rows, self._keys = {}, {}
+                    self._merge(data.get('items', []), [])
+                    self._since = data.get('since')
+                else:
+                    for _ in range(self.max_pages):
+                        data = self._request({'since': self._since, 'limit': self.max_rows})
+                        self._merge(data.get('items', []), data.get('tombstones', []))
+                        self._since = data.get('since') or self._since
+                        if not data.get('more'):
+                            break
+            except Exception as e:
+                self.error = str(e)
+                return False
+            self._prune()
+            self.error = None
+            self.updated_at = datetime.now(timezone.utc)
+            return True
+        finally:
+            self._lock.release()
+
+    def reset(self) -> None:
+        """Drop the rows and the token; the next refresh loads a full page."""
+        with self._lock:
+            self._rows, self._keys = {}, {}
+            self._since = None
+            self._refreshed_at = None
+
+    def rows(self) -> List[Dict[str, Any]]:
+        """Rows ordered by last update, newest first."""
+        with self._lock:
+            order = sorted(self._keys, key=self._keys.__getitem__, reverse=True)
+            return [self._rows[r] for r in order]
+
+    def __len__(self) -> int:
+        return len(self._rows)
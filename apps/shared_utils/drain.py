@@ -0,0 +1,316 @@
+"""Adaptive, concurrent spool drainer and live-first concurrency gate for the sidecar."""
+import asyncio
+import time
+from collections import deque
+from contextlib import asynccontextmanager
+from typing import Any, AsyncIterator, Awaitable, Callable, Deque, Dict, List, Optional, Tuple
+
+from .spool import SegmentedSpool, SpoolEntry
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
+
+# send(records) -> one outcome per record: None if delivered, else the exception
+SendBatchFn = Callable[[List[Dict[str, Any]]], Awaitable[List[Optional[Exception]]]]
+
+
+class PriorityGate:
+    """
+    Concurrency limiter with two priorities.
+
+    Live (high-priority) acquirers are always woken before replay
+    (low-priority) ones, and replay never takes a free slot while a live
+    acquirer is waiting.
+    """
+
+    def __init__(self, slots: int):
+        """
+        Args:
+            slots: Number of concurrent holders allowed
+        """
+        self._free = max(1, slots)
+        self._live: Deque[asyncio.Future] = deque()
+        self._replay: Deque[asyncio.Future] = deque()
+
+    @property
+    def live_waiting(self) -> int:
+        """Number of live acquirers currently waiting for a slot."""
+        return len(self._live)
+
+    async def acquire(self, live: bool = True) -> None:
+        """Wait for a slot."""
+        if self._free > 0 and (live or not self._live):
+            self._free -= 1
+            return
+        fut = asyncio.get_running_loop().create_future()
+        queue = self._live if live else self._replay
+        queue.append(fut)
+        try:
+            await fut
+        except asyncio.CancelledError:
+            if fut.done() and not fut.cancelled():
+                # Slot was handed over just as we were cancelled; pass it on
+                self.release()
+            else:
+                try:
+                    queue.remove(fut)
+                except ValueError:
+                    pass
+            raise
+
+    def release(self) -> None:
+        """Return a slot, handing it to the next waiter (live first)."""
+        for queue in (self._live, self._replay):
+            while queue:
+                fut = queue.popleft()
+                if not fut.done():
+                    fut.set_result(None)
+                    return
+        self._free += 1
+
+    @asynccontextmanager
+    async def slot(self, live: bool = True) -> AsyncIterator[None]:
+        """Hold a slot for the duration of the block."""
+        await self.acquire(live)
+        try:
+            yield
+        finally:
+            self.release()
+
+
+def retry_after_seconds(e: Exception) -> Optional[float]:
+    """Extract a Retry-After delay (seconds) from an HTTP 429/503 error, if any."""
+    response = getattr(e, 'response', None)
+    if response is None or getattr(response, 'status_code', None) not in (429, 503):
+        return None
+    try:
+        return float(response.headers.get('Retry-After', ''))
+    except (TypeError, ValueError):
+        return None
+
+
+class SpoolDrainer:
+    """
+    Replays a SegmentedSpool in batches with adaptive concurrency.
+
+    - Up to `limit` batches are in flight at once. The limit grows
+      additively while batches succeed within `target_latency_s` and is cut
+      multiplicatively on slow batches or errors (AIMD).
+    - The checkpoint only advances over the contiguous prefix of delivered
+      entries, so order is preserved. Batches after a failed one may be sent
+      again on the next pass; idempotency keys make that safe downstream.
+    - After failures the drainer backs off exponentially, honouring any
+      Retry-After returned by the backend.
+    - `check_backpressure()` reports when the spool is above the high-water
+      mark (with hysteresis down to the low-water mark) so ingest endpoints
+      can push back on clients instead of spooling more.
+    """
+
+    def __init__(
+        self,
+        spool: SegmentedSpool,
+        send_batch: SendBatchFn,
+        batch_size: int = 100,
+        max_concurrency: int = 4,
+        target_latency_s: float = 0.5,
+        high_water: int = 100000,
+        low_water: int = 50000,
+        is_permanent: Optional[Callable[[Exception], bool]] = None,
+        on_outcome: Optional[Callable[[str, int], None]] = None,
+        name: str = 'spool'
+    ):
+        """
+        Args:
+            spool: Spool to drain
+            send_batch: Async callable delivering records, with per-record outcomes
+            batch_size: Records per batch request
+            max_concurrency: Upper bound for concurrent batches
+            target_latency_s: Batch latency above which concurrency is reduced
+            high_water: Pending count at which backpressure engages
+            low_water: Pending count at which backpressure releases
+            is_permanent: Classifies per-record failures that should be dead-lettered
+            on_outcome: Callback(status, count) for metrics ('delivered', 'failed', 'dead_letter')
+            name: Name used in log events
+        """
+        self.spool = spool
+        self._send = send_batch
+        self.batch_size = max(1, batch_size)
+        self.max_concurrency = max(1, max_concurrency)
+        self.target_latency_s = target_latency_s
+        self.high_water = high_water
+        self.low_water = min(low_water, high_water)
+        self._is_permanent = is_permanent or (lambda e: False)
+        self._on_outcome = on_outcome or (lambda status, count: None)
+        self.name = name
+
+        self.limit = 1.0
+        self._backoff_s = 0.0
+        self._resume_at = 0.0
+        self._backpressure = False
+        self.last_latency_s: Optional[float] = None
+
+    # ------------------------------------------------------------ backpressure
+
+    def check_backpressure(self) -> bool:
+        """True while clients should be told to back off."""
+        pending = self.spool.pending
+        if self._backpressure and pending <= self.low_water:
+            self._backpressure = False
+            logger.info("spool_backpressure_released", spool=self.name, pending=pending)
+        elif not self._backpressure and pending >= self.high_water:
+            self._backpressure = True
+            logger.warning("spool_backpressure_engaged", spool=self.name, pending=pending)
+        return self._backpressure
+
+    def retry_after_s(self) -> int:
+        """Suggested Retry-After for rejected clients, from the current drain state."""
+        return max(1, int(round(max(self._backoff_s, self._resume_at - time.monotonic(), 1.0))))
+
+    # ---------------------------------------------------------------- control
+
+    def _on_batch_ok(self, latency_s: float) -> None:
+        self.last_latency_s = latency_s
+        self._backoff_s = 0.0
+        if latency_s <= self.target_latency_s:
+            self.limit = min(float(self.max_concurrency), self.limit + 1.0 / self.limit)
+        else:
+            self.limit = max(1.0, self.limit * 0.7)
+
+    def _on_batch_error(self, e: Optional[Exception]) -> None:
+        self.limit = max(1.0, self.limit / 2.0)
+        self._backoff_s = min(30.0, max(0.5, self._backoff_s * 2.0))
+        delay = retry_after_seconds(e) if e is not None else None
+        self._resume_at = time.monotonic() + max(self._backoff_s, delay or 0.0)
+
+    def stats(self) -> Dict[str, Any]:
+        """Drainer state for health endpoints."""
+        return {
+            'pending': self.spool.pending,
+            'concurrency_limit': round(self.limit, 2),
+            'last_batch_latency_s': round(self.last_latency_s, 4) if self.last_latency_s else None,
+            'backoff_s': round(self._backoff_s, 2),
+            'backpressure': self._backpressure,
+        }
+
+    # ------------------------------------------------------------------ drain
+
+    async def _send_chunk(self, chunk: List[SpoolEntry]) -> Tuple[int, List[Tuple[SpoolEntry, Exception]]]:
+        """
+        Send one batch.
+
+        Returns:
+            (number of leading entries that are done, the permanently failed
+            entries among them with their errors)
+        """
+        t0 = time.monotonic()
+        try:
+            outcomes = await self._send([e.record for e in chunk])
+        except Exception as e:
+            logger.warning("spool_batch_failed", spool=self.name, count=len(chunk), error=str(e))
+            self._on_outcome('failed', len(chunk))
+            self._on_batch_error(e)
+            return 0, []
+
+        if outcomes is None or len(outcomes) != len(chunk):
+            # Outcomes are matched to entries by position; a short or long list
+            # would commit entries that were never confirmed
+            logger.warning(
+                "spool_batch_outcome_mismatch",
+                spool=self.name,
+                count=len(chunk),
+                outcomes=len(outcomes) if outcomes is not None else None
+            )
+            self._on_outcome('failed', len(chunk))
+            self._on_batch_error(None)
+            return 0, []
+
+        done = 0
+        dead: List[Tuple[SpoolEntry, Exception]] = []
+        for entry, outcome in zip(chunk, outcomes):
+            if outcome is not None:
+                if not self._is_permanent(outcome):
+                    break
+                dead.append((entry, outcome))
+            done += 1
+
+        self._on_outcome('delivered', done - len(dead))
+        if done < len(chunk):
+            self._on_outcome('failed', len(chunk) - done)
+            self._on_batch_error(outcomes[done])
+        else:
+            self._on_batch_ok(time.monotonic() - t0)
+        return done, dead
+
+    def _dead_letter(self, dead: List[Tuple[SpoolEntry, Exception]]) -> None:
+        for entry, outcome in dead:
+            self.spool.dead_letter(entry.record, str(outcome))
+        self._on_outcome('dead_letter', len(dead))
+        logger.error("spool_items_dead_lettered", spool=self.name, count=len(dead))
+
+    async def drain_once(self) -> int:
+        """
+        Drain until the spool is empty or a batch fails.
+
+        Permanent failures are dead-lettered only within the committed
+        prefix; those of batches after a failed one are sent again on the
+        next pass, and set aside then.
+
+        Returns:
+            Number of entries committed
+        """
+        total = 0
+        while self.spool.pending and time.monotonic() >= self._resume_at:
+            concurrency = max(1, int(self.limit))
+            entries = self.spool.read(self.batch_size * concurrency)
+            if not entries:
+                break
+            chunks = [entries[i:i + self.batch_size] for i in range(0, len(entries), self.batch_size)]
+            results = await asyncio.gather(*(self._send_chunk(c) for c in chunks))
+
+            committed = 0
+            last = None
+            dead: List[Tuple[SpoolEntry, Exception]] = []
+            for chunk, (done, chunk_dead) in zip(chunks, results):
+                if done:
+                    last = chunk[done - 1].position
+                    committed += done
+                    dead.extend(chunk_dead)
+                if done < len(chunk):
+                    break
+
+            if dead:
+                self._dead_letter(dead)
+            if last is not None:
+                self.spool.commit(last, committed)
+                total += committed
+            if committed < len(entries):
+                break
+
+        if total:
+            logger.debug("spool_drained", spool=self.name, committed=total, pending=self.spool.pending)
+        return total
+
+    async def run(self, interval_s: float, on_cycle: Optional[Callable[[], None]] = None) -> None:
+        """
+        Drain forever, pausing `interval_s` between passes (longer while backing off).
+
+        Args:
+            interval_s: Pause between passes
+            on_cycle: Optional callback invoked at the start of every pass
+        """
+        logger.info("spool_drainer_started", spool=self.name, interval_s=interval_s)
+        while True:
+            try:
+                self.spool.sync()
+                if on_cycle:
+                    on_cycle()
+                self.check_backpressure()
+                if self.spool.pending:
+                    await self.drain_once()
+            except Exception as e:
+                logger.error("spool_drain_error", spool=self.name, error=str(e))
+            await asyncio.sleep(max(interval_s, self._resume_at - time.monotonic()))
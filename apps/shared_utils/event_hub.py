@@ -0,0 +1,407 @@
+"""In-process broadcast hub fed by Postgres LISTEN/NOTIFY, used for SSE fan-out."""
+import asyncio
+import json
+import uuid
+from collections import OrderedDict, deque
+from dataclasses import dataclass
+from itertools import count
+from typing import Any, Awaitable, Callable, Deque, Dict, List, Optional, Set, Tuple
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
+
+
+@dataclass(frozen=True)
+class EventFilter:
+    """Server-side subscription filter; unset fields match everything."""
+    site_ids: Optional[frozenset] = None
+    app_ids: Optional[frozenset] = None
+    kinds: Optional[frozenset] = None
+    entity_type: Optional[str] = None
+    entity_id: Optional[str] = None
+
+    @staticmethod
+    def parse(
+        site: Optional[str] = None,
+        app_id: Optional[str] = None,
+        kind: Optional[str] = None,
+        entity_type: Optional[str] = None,
+        entity_id: Optional[str] = None
+    ) -> 'EventFilter':
+        """Build a filter from comma-separated query parameters."""
+        def split(value: Optional[str], lower: bool = False) -> Optional[frozenset]:
+            if not value:
+                return None
+            items = [v.strip().lower() if lower else v.strip() for v in value.split(',')]
+            return frozenset(v for v in items if v) or None
+
+        return EventFilter(
+            site_ids=split(site),
+            app_ids=split(app_id, lower=True),
+            kinds=split(kind),
+            entity_type=entity_type or None,
+            entity_id=entity_id.lower() if entity_id else None
+        )
+
+    def matches(self, ev: Dict[str, Any]) -> bool:
+        if self.site_ids is not None and ev.get('site_id') not in self.site_ids:
+            return False
+        if self.app_ids is not None and str(ev.get('app_id', '')).lower() not in self.app_ids:
+            return False
+        if self.kinds is not None and ev.get('kind') not in self.kinds:
+            return False
+        if self.entity_type is not None and ev.get('entity_type') != self.entity_type:
+            return False
+        if self.entity_id is not None and str(ev.get('entity_id', '')).lower() != self.entity_id:
+            return False
+        return True
+
+
+class Subscription:
+    """
+    One subscriber's view of the hub.
+
+    Events are kept in a bounded ring buffer; if the subscriber falls behind
+    the oldest events are dropped (and counted) rather than blocking the hub.
+    """
+
+    def __init__(self, hub: 'EventHub', flt: EventFilter, buffer_size: int):
+        self._hub = hub
+        self.filter = flt
+        self._buffer: Deque[Tuple[str, Dict[str, Any]]] = deque(maxlen=max(1, buffer_size))
+        self._ready = asyncio.Event()
+        self.dropped = 0
+        # True when Last-Event-ID was older than the replay buffer
+        self.gap = False
+        # Database position carried by that Last-Event-ID, to backfill the gap from
+        self.cursor: Optional[str] = None
+
+    def push(self, event_id: str, ev: Dict[str, Any]) -> None:
+        if len(self._buffer) == self._buffer.maxlen:
+            self.dropped += 1
+        self._buffer.append((event_id, ev))
+        self._ready.set()
+
+    async def get(self, timeout: Optional[float] = None) -> Optional[Tuple[str, Dict[str, Any]]]:
+        """
+        Wait for the next event.
+
+        Returns:
+            (event_id, event) or None if `timeout` expired
+        """
+        while not self._buffer:
+            self._ready.clear()
+            try:
+                await asyncio.wait_for(self._ready.wait(), timeout)
+            except asyncio.TimeoutError:
+                return None
+        return self._buffer.popleft()
+
+    def close(self) -> None:
+        self._hub.unsubscribe(self)
+
+
+class EventHub:
+    """
+    Fans one stream of events out to many subscribers.
+
+    Every published event gets an id `<epoch>-<seq>`, where the epoch is
+    unique per hub instance, followed by `@<cursor>` if a `cursor` function
+    is given. The last `replay_size` events are kept so a reconnecting
+    client can resume after its `Last-Event-ID`. Ids from another epoch
+    (another worker, or before a restart) or evicted from the buffer are
+    flagged as a gap; the subscription then carries the id's cursor so the
+    caller can backfill the gap from the database.
+    """
+
+    def __init__(
+        self,
+        replay_size: int = 1000,
+        buffer_size: int = 1000,
+        cursor: Optional[Callable[[Dict[str, Any]], Optional[str]]] = None
+    ):
+        """
+        Args:
+            replay_size: Number of recent events kept for Last-Event-ID resume
+            buffer_size: Per-subscriber ring buffer size
+            cursor: Database position of an event, embedded in its id
+        """
+        self.epoch = uuid.uuid4().hex[:8]
+        self.buffer_size = buffer_size
+        self._cursor = cursor
+        self._seq = count(1)
+        self._replay: Deque[Tuple[int, str, Dict[str, Any]]] = deque(maxlen=max(1, replay_size))
+        self._subscribers: Set[Subscription] = set()
+        self.published = 0
+
+    def _event_id(self, seq: int, ev: Dict[str, Any]) -> str:
+        cursor = self._cursor(ev) if self._cursor is not None else None
+        if cursor is None:
+            return f"{self.epoch}-{seq}"
+        return f"{self.epoch}-{seq}@{cursor}"
+
+    def backfill_id(self, ev: Dict[str, Any]) -> str:
+        """Id for an event read back from the database rather than published."""
+        return self._event_id(0, ev)
+
+    @property
+    def subscriber_count(self) -> int:
+        return len(self._subscribers)
+
+    def publish(self, ev: Dict[str, Any]) -> str:
+        """Publish an event to all matching subscribers; returns its id."""
+        seq = next(self._seq)
+        event_id = self._event_id(seq, ev)
+        self._replay.append((seq, event_id, ev))
+        self.published += 1
+        for sub in self._subscribers:
+            if sub.filter.matches(ev):
+                sub.push(event_id, ev)
+        return event_id
+
+    def subscribe(
+        self,
+        flt: Optional[EventFilter] = None,
+        last_event_id: Optional[str] = None,
+        buffer_size: Optional[int] = None
+    ) -> Subscription:
+        """
+        Register a subscriber, replaying buffered events after `last_event_id`.
+
+        Args:
+            flt: Event filter (default: everything)
+            last_event_id: Id of the last event the client received
+            buffer_size: Override the per-subscriber buffer size
+        """
+        sub = Subscription(self, flt or EventFilter(), buffer_size or self.buffer_size)
+        if last_event_id:
+            after = self._parse_id(last_event_id)
+            oldest = self._replay[0][0] if self._replay else None
+            if after is None or (oldest is not None and after < oldest - 1):
+                sub.gap = True
+                sub.cursor = last_event_id.partition('@')[2] or None
+            else:
+                for seq, event_id, ev in self._replay:
+                    if seq > after and sub.filter.matches(ev):
+                        sub.push(event_id, ev)
+        self._subscribers.add(sub)
+        return sub
+
+    def unsubscribe(self, sub: Subscription) -> None:
+        self._subscribers.discard(sub)
+
+    def _parse_id(self, event_id: str) -> Optional[int]:
+        epoch, _, seq = event_id.partition('@')[0].partition('-')
+        if epoch != self.epoch:
+            return None
+        try:
+            seq_no = int(seq)
+        except ValueError:
+            return None
+        # Backfilled events (seq 0) are not in the replay buffer
+        return seq_no or None
+
+
+# NOTIFY payloads are limited to 8000 bytes; above this the keys are left out
+NOTIFY_MAX_BYTES = 7900
+
+
+def batch_notification(
+    rows: List[Tuple[str, Any]],
+    max_bytes: int = NOTIFY_MAX_BYTES,
+    ingested: Any = None
+) -> Optional[str]:
+    """
+    Compact notification (as read by PgEventListener) for one INSERT statement.
+
+    Args:
+        rows: (idempotency_key, at datetime) of each inserted event
+        max_bytes: Payload size above which the keys are left out
+        ingested: `ingested_at` of the inserted rows (the listener's position)
+
+    Returns:
+        JSON with the row count, the `at` range, the ingest position and, if
+        they fit, the keys; None if nothing was inserted
+    """
+    if not rows:
+        return None
+    ats = [at for _, at in rows]
+    msg = {'n': len(rows), 'from': min(ats).isoformat(), 'to': max(ats).isoformat()}
+    if ingested is not None:
+        msg['ingested'] = ingested.isoformat()
+    payload = json.dumps({**msg, 'keys': [key for key, _ in rows]}, separators=(',', ':'))
+    if len(payload.encode('utf-8')) > max_bytes:
+        payload = json.dumps(msg, separators=(',', ':'))
+    return payload
+
+
+class PgEventListener:
+    """
+    Feeds an EventHub from a single dedicated LISTEN connection.
+
+    Notifications are compact (`{"n", "from", "to", "ingested", "keys"?}`,
+    one per INSERT statement); the rows they announce are fetched with
+    `fetch(keys, from, to)` - by key when the keys fit the payload, by `at`
+    range otherwise. Pending notifications are fetched together, and only
+    while the hub has subscribers. Full-row payloads (older schemas) are
+    published as they are. Recently published idempotency keys are
+    remembered so range fetches and backfills do not publish an event twice.
+
+    Reconnects with backoff if the connection drops, and on reconnect
+    optionally backfills events missed in between via `backfill(since)`.
+    The position is the `ingested_at` of the last event seen, not its `at`:
+    events may be stored long after they happened, and a backfill by `at`
+    would skip such late rows.
+    """
+
+    def __init__(
+        self,
+        dsn: str,
+        hub: EventHub,
+        channel: str = 'evt',
+        backfill: Optional[Callable[[Any], Awaitable[List[Dict[str, Any]]]]] = None,
+        fetch: Optional[Callable[[Optional[List[str]], Any, Any], Awaitable[List[Dict[str, Any]]]]] = None,
+        max_backoff_s: float = 30.0,
+        dedupe_size: int = 10000
+    ):
+        """
+        Args:
+            dsn: Postgres connection string
+            hub: Hub to publish notifications to
+            channel: NOTIFY channel
+            backfill: Async callable returning events with `ingested_at` after
+                the given value
+            fetch: Async callable returning the events with the given keys (or all,
+                if None) with `at` in [from, to]
+            max_backoff_s: Upper bound for the reconnect delay
+            dedupe_size: Number of recently published idempotency keys remembered
+        """
+        self.dsn = dsn
+        self.hub = hub
+        self.channel = channel
+        self._backfill = backfill
+        self._fetch = fetch
+        self.max_backoff_s = max_backoff_s
+        self.connected = False
+        self.position: Any = None
+        self.fetched = 0
+        self.skipped = 0
+        self._task: Optional[asyncio.Task] = None
+        self._fetch_task: Optional[asyncio.Task] = None
+        self._pending: Optional[asyncio.Queue] = None
+        self._seen: 'OrderedDict[str, None]' = OrderedDict()
+        self._dedupe_size = max(1, dedupe_size)
+
+    def _on_notify(self, con: Any, pid: int, channel: str, payload: str) -> None:
+        try:
+            ev = json.loads(payload)
+        except ValueError as e:
+            logger.warning("notify_payload_invalid", channel=channel, error=str(e))
+            return
+        if 'n' in ev and 'from' in ev:
+            if self._pending is not None:
+                self._pending.put_nowait(ev)
+            return
+        self._publish(ev)
+
+    def _publish(self, ev: Dict[str, Any]) -> None:
+        key = ev.get('idempotency_key')
+        if key is not None:
+            if key in self._seen:
+                return
+            self._seen[key] = None
+            if len(self._seen) > self._dedupe_size:
+                self._seen.popitem(last=False)
+        self.position = ev.get('ingested_at', self.position)
+        self.hub.publish(ev)
+
+    async def _fetch_batch(self, notes: List[Dict[str, Any]]) -> None:
+        """Fetch and publish the rows announced by a batch of notifications."""
+        if self.hub.subscriber_count == 0:
+            self.skipped += sum(int(n.get('n', 0)) for n in notes)
+            self.position = notes[-1].get('ingested', self.position)
+            return
+        keyed = [n for n in notes if n.get('keys')]
+        calls: List[Tuple[Optional[List[str]], Any, Any]] = [(None, n['from'], n['to']) for n in notes if not n.get('keys')]
+        if keyed:
+            keys = [k for n in keyed for k in n['keys']]
+            calls.append((keys, min(n['from'] for n in keyed), max(n['to'] for n in keyed)))
+        events: List[Dict[str, Any]] = []
+        for keys, frm, to in calls:
+            events.extend(await self._fetch(keys, frm, to))  # type: ignore[misc]
+        events.sort(key=lambda e: str(e.get('at', '')))
+        self.fetched += len(events)
+        for ev in events:
+            self._publish(ev)
+        self.position = notes[-1].get('ingested', self.position)
+
+    async def _run_fetch(self) -> None:
+        assert self._pending is not None
+        while True:
+            notes = [await self._pending.get()]
+            while not self._pending.empty():
+                notes.append(self._pending.get_nowait())
+            try:
+                await self._fetch_batch(notes)
+            except asyncio.CancelledError:
+                raise
+            except Exception as e:
+                logger.error("event_fetch_failed", notifications=len(notes), error=str(e))
+
+    async def _run(self) -> None:
+        import asyncpg
+
+        backoff = 0.5
+        while True:
+            con = None
+            lost = asyncio.Event()
+            try:
+                con = await asyncpg.connect(self.dsn)
+                con.add_termination_listener(lambda c: lost.set())
+                await con.add_listener(self.channel, self._on_notify)
+                self.connected = True
+                logger.info("event_listener_connected", channel=self.channel)
+
+                if self.position is not None and self._backfill is not None:
+                    missed = await self._backfill(self.position)
+                    for ev in missed:
+                        self._publish(ev)
+                    logger.info("event_listener_backfilled", count=len(missed))
+
+                backoff = 0.5
+                await lost.wait()
+                logger.warning("event_listener_connection_lost", channel=self.channel)
+            except asyncio.CancelledError:
+                if con is not None and not con.is_closed():
+                    await con.close()
+                raise
+            except Exception as e:
+                logger.error("event_listener_error", error=str(e), retry_in_s=backoff)
+            finally:
+                self.connected = False
+            await asyncio.sleep(backoff)
+            backoff = min(self.max_backoff_s, backoff * 2)
+
+    def start(self) -> None:
+        """Start listening (and fetching announced rows) in background tasks."""
+        if self._task is None:
+            if self._fetch is not None:
+                self._pending = asyncio.Queue()
+                self._fetch_task = asyncio.create_task(self._run_fetch())
+            self._task = asyncio.create_task(self._run())
+
+    async def stop(self) -> None:
+        """Stop listening and close the connection."""
+        for task in (self._task, self._fetch_task):
+            if task is not None:
+                task.cancel()
+                try:
+                    await task
+                except asyncio.CancelledError:
+                    pass
+        self._task = self._fetch_task = None
+        self._pending = None
@@ -0,0 +1,99 @@
+"""Helpers for merging paginated query results from several sites."""
+import base64
+import heapq
+from datetime import datetime
+from typing import Any, Dict, Iterator, List, Optional, Tuple
+
+from .serialization import dumps, loads, encode_cursor, CursorError
+
+# Marker stored in a federated cursor for sites with no rows left
+SITE_DONE = '.'
+
+
+def row_sort_key(row: Dict[str, Any], id_col: str) -> Tuple[datetime, str]:
+    """(inserted_at, id) key of a row as returned by a Local API query endpoint."""
+    at = row.get('inserted_at')
+    if isinstance(at, str):
+        at = datetime.fromisoformat(at.replace('Z', '+00:00'))
+    return at, str(row.get(id_col, ''))
+
+
+def merge_pages(
+    pages: Dict[str, List[Dict[str, Any]]],
+    id_col: str,
+    limit: int
+) -> Tuple[List[Dict[str, Any]], Dict[str, int]]:
+    """
+    Lazily k-way merge per-site pages, each sorted by (inserted_at, id) DESC.
+
+    Args:
+        pages: Site id -> rows in descending order
+        id_col: Id column used as tie-breaker
+        limit: Maximum number of rows to return
+
+    Returns:
+        (merged rows, number of rows consumed from each site)
+    """
+    def tagged(site: str, rows: List[Dict[str, Any]]) -> Iterator[Tuple[Tuple[datetime, str], str, Dict[str, Any]]]:
+        for row in rows:
+            yield row_sort_key(row, id_col), site, row
+
+    merged = heapq.merge(*(tagged(s, rows) for s, rows in pages.items()), key=lambda t: t[0], reverse=True)
+    items: List[Dict[str, Any]] = []
+    consumed = {site: 0 for site in pages}
+    for _, site, row in merged:
+        if len(items) >= limit:
+            break
+        items.append(row)
+        consumed[site] += 1
+    return items, consumed
+
+
+def next_site_cursors(
+    pages: Dict[str, List[Dict[str, Any]]],
+    consumed: Dict[str, int],
+    has_more: Dict[str, bool],
+    previous: Dict[str, Optional[str]],
+    id_col: str
+) -> Dict[str, Optional[str]]:
+    """
+    Work out where each site should resume after a merged page.
+
+    A site resumes after its last consumed row; if none of its rows were
+    used it resumes where it did before. Sites that returned everything
+    they had and were fully consumed are marked done.
+    """
+    cursors: Dict[str, Optional[str]] = {}
+    for site, rows in pages.items():
+        used = consumed.get(site, 0)
+        if used == len(rows) and not has_more.get(site):
+            cursors[site] = SITE_DONE
+        elif used:
+            at, entity_id = row_sort_key(rows[used - 1], id_col)
+            cursors[site] = encode_cursor(at, entity_id)
+        else:
+            cursors[site] = previous.get(site)
+    return cursors
+
+
+def encode_federated_cursor(cursors: Dict[str, Optional[str]]) -> Optional[str]:
+    """Pack per-site cursors into one opaque token; None when every site is done."""
+    if all(c == SITE_DONE for c in cursors.values()):
+        return None
+    return base64.urlsafe_b64encode(dumps(cursors)).rstrip(b'=').decode('ascii')
+
+
+def decode_federated_cursor(token: str) -> Dict[str, Optional[str]]:
+    """
+    Unpack a token produced by `encode_federated_cursor`.
+
+    Raises:
+        CursorError: If the token is malformed
+    """
+    try:
+        data = loads(base64.urlsafe_b64decode(token + '=' * (-len(token) % 4)))
+    except Exception as e:
+        raise CursorError(f'Invalid cursor: {token!r}') from e
+    if not isinstance(data, dict):
+        raise CursorError(f'Invalid cursor: {token!r}')
+    return data
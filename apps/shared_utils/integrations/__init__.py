@@ -1,5 +1,5 @@
 """Integration adapters for multiple monitoring backends."""
-from .base import BaseIntegration, IntegrationConfig
+from .base import BaseIntegration, IntegrationConfig, IntegrationType
 from .local_api import LocalAPIIntegration
 from .zabbix import ZabbixIntegration
 from .elk import ELKIntegration
@@ -8,11 +8,13 @@ from .json_export import JSONExportIntegration
 from .webhook import WebhookIntegration
 from .aws_cloudwatch import AWSCloudWatchIntegration
 from .aws_xray import AWSXRayIntegration
+from .dispatch import IntegrationQueue
 from .container import IntegrationContainer, get_container
 
 __all__ = [
     'BaseIntegration',
     'IntegrationConfig',
+    'IntegrationType',
     'LocalAPIIntegration',
     'ZabbixIntegration',
     'ELKIntegration',
@@ -21,6 +23,7 @@ __all__ = [
     'WebhookIntegration',
     'AWSCloudWatchIntegration',
     'AWSXRayIntegration',
+    'IntegrationQueue',
     'IntegrationContainer',
     'get_container',
 ]
@@ -1,6 +1,11 @@
 """AWS CloudWatch integration for monitoring compute jobs."""
+import asyncio
+import json
 import boto3
-from typing import Dict, Any, List
+from collections import OrderedDict
+from concurrent.futures import ThreadPoolExecutor
+from functools import partial
+from typing import Dict, Any, Callable, Iterator, List, Optional
 from datetime import datetime
 from .base import BaseIntegration, IntegrationConfig
 
@@ -11,6 +16,41 @@ except ImportError:
     import logging
     logger = logging.getLogger(__name__)  # type: ignore
 
+# CloudWatch Logs PutLogEvents limits
+LOG_BATCH_MAX_EVENTS = 10000
+LOG_BATCH_MAX_BYTES = 1048576
+LOG_EVENT_OVERHEAD_BYTES = 26
+LOG_EVENT_MAX_BYTES = 262144
+LOG_BATCH_MAX_SPAN_MS = 24 * 3600 * 1000
+
+# CloudWatch PutMetricData limits (1 MB request payload, kept with margin)
+METRIC_BATCH_MAX_ITEMS = 1000
+METRIC_BATCH_MAX_BYTES = 900 * 1024
+
+# Events whose metrics or logs (not both) were delivered, remembered so a
+# redelivery only sends the missing part
+PARTIAL_MAX_EVENTS = 10000
+
+
+def chunked(
+    items: List[Any],
+    max_items: int,
+    max_bytes: int,
+    size: Callable[[Any], int]
+) -> Iterator[List[Any]]:
+    """Split items into consecutive chunks within a count and a byte limit."""
+    chunk: List[Any] = []
+    chunk_bytes = 0
+    for item in items:
+        n = size(item)
+        if chunk and (len(chunk) >= max_items or chunk_bytes + n > max_bytes):
+            yield chunk
+            chunk, chunk_bytes = [], 0
+        chunk.append(item)
+        chunk_bytes += n
+    if chunk:
+        yield chunk
+
 
 class AWSCloudWatchIntegration(BaseIntegration):
     """
@@ -30,8 +70,20 @@ class AWSCloudWatchIntegration(BaseIntegration):
         - aws_secret_access_key: Optional AWS secret key
         - compute_platform: ec2, ecs, or lambda
         - instance_id: EC2 instance ID or ECS task ID (optional)
+        - emf: Send metrics as Embedded Metric Format inside the log events
+          instead of PutMetricData (default: false)
+        - max_workers: Threads (and pooled connections) for AWS calls (default: 4)
+    
+    boto3 is blocking, so every AWS call runs on a dedicated thread pool
+    sized to the clients' connection pool; the event loop never waits on
+    a round trip. Log events are written to one stream in timestamp order,
+    one PutLogEvents call at a time, split by the service's count, byte
+    and 24-hour span limits.
     """
     
+    # Queued events are coalesced into send_batch calls
+    DEFAULT_BATCHING = True
+    
     def __init__(self, config: IntegrationConfig):
         """Initialize AWS CloudWatch integration."""
         super().__init__(config)
@@ -45,9 +97,25 @@ class AWSCloudWatchIntegration(BaseIntegration):
         self.aws_access_key = self.get_config('aws_access_key_id')
         self.aws_secret_key = self.get_config('aws_secret_access_key')
         
+        self.emf = bool(self.get_config('emf', False))
+        self.max_workers = int(self.get_config('max_workers', 4))
+        
         self.cloudwatch_client = None
         self.logs_client = None
         self.log_stream_name = None
+        self._executor: Optional[ThreadPoolExecutor] = None
+        self._log_lock = asyncio.Lock()
+        self._sequence_token: Optional[str] = None
+        self._partial: 'OrderedDict[str, str]' = OrderedDict()
+    
+    async def _call(self, fn: Callable, **kwargs) -> Any:
+        """Run a blocking boto3 call on the integration's thread pool."""
+        if self._executor is None:
+            self._executor = ThreadPoolExecutor(
+                max_workers=self.max_workers,
+                thread_name_prefix=f'cloudwatch-{self.name}'
+            )
+        return await asyncio.get_running_loop().run_in_executor(self._executor, partial(fn, **kwargs))
     
     async def initialize(self) -> None:
         """Initialize AWS clients."""
@@ -59,23 +127,28 @@ class AWSCloudWatchIntegration(BaseIntegration):
         
         session = boto3.Session(**session_params)
         
-        # Create clients
-        self.cloudwatch_client = session.client('cloudwatch')
-        self.logs_client = session.client('logs')
+        # Create clients; one pooled connection per worker thread
+        try:
+            from botocore.config import Config
+            client_config = Config(max_pool_connections=self.max_workers, retries={'mode': 'standard'})
+        except ImportError:
+            client_config = None
+        self.cloudwatch_client = session.client('cloudwatch', config=client_config)
+        self.logs_client = session.client('logs', config=client_config)
         
         # Create log group if it doesn't exist
         try:
-            self.logs_client.create_log_group(logGroupName=self.log_group_name)
+            await self._call(self.logs_client.create_log_group, logGroupName=self.log_group_name)
             logger.info("cloudwatch_log_group_created", log_group=self.log_group_name)
-        except self.logs_client.exceptions.ResourceAlreadyExistsException:
-            pass
         except Exception as e:
-            logger.warning("failed_to_create_log_group", error=str(e))
+            if self._error_code(e) != 'ResourceAlreadyExistsException':
+                logger.warning("failed_to_create_log_group", error=str(e))
         
         # Create log stream
         self.log_stream_name = f"{self.compute_platform}-{datetime.utcnow().strftime('%Y%m%d-%H%M%S')}"
         try:
-            self.logs_client.create_log_stream(
+            await self._call(
+                self.logs_client.create_log_stream,
                 logGroupName=self.log_group_name,
                 logStreamName=self.log_stream_name
             )
@@ -88,9 +161,15 @@ class AWSCloudWatchIntegration(BaseIntegration):
             name=self.name,
             region=self.aws_region,
             namespace=self.namespace,
-            platform=self.compute_platform
+            platform=self.compute_platform,
+            emf=self.emf
         )
     
+    @staticmethod
+    def _error_code(e: Exception) -> Optional[str]:
+        response = getattr(e, 'response', None)
+        return response.get('Error', {}).get('Code') if isinstance(response, dict) else None
+    
     def _event_to_cloudwatch_metrics(self, event: Dict[str, Any]) -> List[Dict[str, Any]]:
         """
         Convert monitoring event to CloudWatch metrics.
@@ -173,21 +252,12 @@ class AWSCloudWatchIntegration(BaseIntegration):
         
         return cw_metrics
     
-    def _event_to_log_message(self, event: Dict[str, Any]) -> Dict[str, Any]:
-        """
-        Convert monitoring event to CloudWatch log message.
-        
-        Args:
-            event: Monitoring event
-            
-        Returns:
-            CloudWatch log event
-        """
+    def _log_record(self, event: Dict[str, Any]) -> Dict[str, Any]:
+        """Structured log message for a monitoring event."""
         entity = event.get('entity', {})
         event_data = event.get('event', {})
         
-        # Create structured log message
-        log_message = {
+        return {
             'timestamp': event_data.get('at'),
             'level': 'INFO' if event_data.get('status') in ['succeeded', 'running'] else 'ERROR',
             'site_id': event.get('site_id'),
@@ -201,143 +271,247 @@ class AWSCloudWatchIntegration(BaseIntegration):
             'compute_platform': self.compute_platform,
             'instance_id': self.instance_id
         }
+    
+    def _event_to_log_message(self, event: Dict[str, Any]) -> Dict[str, Any]:
+        """
+        Convert monitoring event to CloudWatch log message.
         
-        import json
+        Args:
+            event: Monitoring event
+            
+        Returns:
+            CloudWatch log event
+        """
+        event_data = event.get('event', {})
         return {
             'timestamp': int(datetime.fromisoformat(event_data.get('at')).timestamp() * 1000),
-            'message': json.dumps(log_message)
+            'message': json.dumps(self._log_record(event), default=str)
         }
     
+    def _event_to_emf_log(self, event: Dict[str, Any]) -> Dict[str, Any]:
+        """
+        Convert monitoring event to a log event in Embedded Metric Format.
+        
+        The event's metrics and their dimensions become root properties
+        of the structured log message, described by an `_aws` directive,
+        so CloudWatch extracts them as metrics without PutMetricData.
+        Metrics with the same dimensions share one directive.
+        
+        Args:
+            event: Monitoring event
+            
+        Returns:
+            CloudWatch log event
+        """
+        record = self._log_record(event)
+        timestamp = int(datetime.fromisoformat(event.get('event', {}).get('at')).timestamp() * 1000)
+        directives: Dict[tuple, Dict[str, Any]] = {}
+        for metric in self._event_to_cloudwatch_metrics(event):
+            names = tuple(d['Name'] for d in metric['Dimensions'])
+            for d in metric['Dimensions']:
+                record[d['Name']] = d['Value']
+            record[metric['MetricName']] = metric['Value']
+            directive = directives.setdefault(names, {
+                'Namespace': self.namespace,
+                'Dimensions': [list(names)],
+                'Metrics': []
+            })
+            directive['Metrics'].append({'Name': metric['MetricName'], 'Unit': metric['Unit']})
+        record['_aws'] = {'Timestamp': timestamp, 'CloudWatchMetrics': list(directives.values())}
+        return {'timestamp': timestamp, 'message': json.dumps(record, default=str)}
+    
     async def send_event(self, event: Dict[str, Any]) -> bool:
         """Send event to CloudWatch metrics and logs."""
-        try:
-            # Send metrics
-            metrics = self._event_to_cloudwatch_metrics(event)
-            if metrics:
-                self.cloudwatch_client.put_metric_data(
-                    Namespace=self.namespace,
-                    MetricData=metrics
-                )
-                logger.debug(
-                    "metrics_sent_to_cloudwatch",
-                    count=len(metrics),
-                    namespace=self.namespace
-                )
-            
-            # Send log event
-            log_event = self._event_to_log_message(event)
+        return (await self.send_batch([event]))['failed'] == 0
+    
+    async def _put_metrics(self, metrics: List[Dict[str, Any]]) -> List[Dict[str, Any]]:
+        """
+        Send metrics with PutMetricData; stops at the first failed request.
+        
+        Returns:
+            The metrics that were not sent
+        """
+        chunks = list(chunked(metrics, METRIC_BATCH_MAX_ITEMS, METRIC_BATCH_MAX_BYTES,
+                              lambda m: len(json.dumps(m, default=str))))
+        for n, chunk in enumerate(chunks):
             try:
-                self.logs_client.put_log_events(
-                    logGroupName=self.log_group_name,
-                    logStreamName=self.log_stream_name,
-                    logEvents=[log_event]
-                )
-                logger.debug(
-                    "log_sent_to_cloudwatch",
-                    log_group=self.log_group_name,
-                    log_stream=self.log_stream_name
-                )
-            except self.logs_client.exceptions.InvalidSequenceTokenException as e:
-                # Retry with correct sequence token
-                token = e.response['Error']['Message'].split('sequenceToken: ')[-1]
-                self.logs_client.put_log_events(
-                    logGroupName=self.log_group_name,
-                    logStreamName=self.log_stream_name,
-                    logEvents=[log_event],
-                    sequenceToken=token
-                )
-            
-            logger.info(
-                "event_sent_to_cloudwatch",
-                metrics_count=len(metrics),
-                namespace=self.namespace
-            )
-            return True
+                await self._call(self.cloudwatch_client.put_metric_data, Namespace=self.namespace, MetricData=chunk)
+            except Exception as e:
+                logger.error("cloudwatch_metrics_batch_failed", error=str(e), error_type=type(e).__name__)
+                return [m for c in chunks[n:] for m in c]
+        return []
+    
+    def _log_batches(self, log_events: List[Dict[str, Any]]) -> Iterator[List[Dict[str, Any]]]:
+        """
+        Split log events into valid PutLogEvents batches, in timestamp order.
         
+        Oversized events are dropped with a warning; a batch never holds
+        more than 10,000 events or 1 MiB (message bytes plus 26 per event),
+        nor spans more than 24 hours.
+        """
+        batch: List[Dict[str, Any]] = []
+        batch_bytes = 0
+        for log_event in sorted(log_events, key=lambda x: x['timestamp']):
+            size = len(log_event['message'].encode('utf-8')) + LOG_EVENT_OVERHEAD_BYTES
+            if size > LOG_EVENT_MAX_BYTES:
+                logger.warning("cloudwatch_log_event_too_large", size_bytes=size)
+                continue
+            if batch and (
+                len(batch) >= LOG_BATCH_MAX_EVENTS
+                or batch_bytes + size > LOG_BATCH_MAX_BYTES
+                or log_event['timestamp'] - batch[0]['timestamp'] >= LOG_BATCH_MAX_SPAN_MS
+            ):
+                yield batch
+                batch, batch_bytes = [], 0
+            batch.append(log_event)
+            batch_bytes += size
+        if batch:
+            yield batch
+    
+    async def _put_logs(self, log_events: List[Dict[str, Any]]) -> List[Dict[str, Any]]:
+        """
+        Send log events with PutLogEvents; stops at the first failed request.
+        
+        Returns:
+            The log events that were not sent
+        """
+        # One writer per stream keeps batches in order (and sequence tokens valid
+        # where the service still checks them)
+        async with self._log_lock:
+            batches = list(self._log_batches(log_events))
+            for n, batch in enumerate(batches):
+                try:
+                    await self._put_log_batch(batch)
+                except Exception as e:
+                    logger.error("cloudwatch_logs_batch_failed", error=str(e), error_type=type(e).__name__)
+                    return [le for b in batches[n:] for le in b]
+        return []
+    
+    async def _put_log_batch(self, batch: List[Dict[str, Any]]) -> None:
+        params = {
+            'logGroupName': self.log_group_name,
+            'logStreamName': self.log_stream_name,
+            'logEvents': batch
+        }
+        if self._sequence_token:
+            params['sequenceToken'] = self._sequence_token
+        try:
+            response = await self._call(self.logs_client.put_log_events, **params)
         except Exception as e:
-            logger.error(
-                "cloudwatch_send_failed",
-                error=str(e),
-                error_type=type(e).__name__
-            )
-            return False
+            if self._error_code(e) not in ('InvalidSequenceTokenException', 'DataAlreadyAcceptedException'):
+                raise
+            expected = e.response.get('expectedSequenceToken') or \
+                e.response['Error'].get('Message', '').split('sequenceToken is: ')[-1].strip()
+            if self._error_code(e) == 'DataAlreadyAcceptedException':
+                self._sequence_token = expected or None
+                return
+            params['sequenceToken'] = expected
+            response = await self._call(self.logs_client.put_log_events, **params)
+        if isinstance(response, dict):
+            self._sequence_token = response.get('nextSequenceToken')
+            rejected = response.get('rejectedLogEventsInfo')
+            if rejected:
+                # Events outside the accepted time window cannot be retried
+                logger.warning("cloudwatch_log_events_rejected", **rejected)
     
-    async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, int]:
-        """Send batch of events to CloudWatch."""
-        success = 0
-        failed = 0
+    def _remember_partial(self, event: Dict[str, Any], part: str) -> None:
+        key = event.get('idempotency_key')
+        if key is None:
+            return
+        self._partial[key] = part
+        self._partial.move_to_end(key)
+        if len(self._partial) > PARTIAL_MAX_EVENTS:
+            self._partial.popitem(last=False)
+    
+    async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, Any]:
+        """
+        Send batch of events to CloudWatch.
+        
+        Without EMF, metrics go out with PutMetricData and the log events
+        with PutLogEvents; with EMF, only the log events are sent.
         
-        # Collect all metrics
+        The two calls succeed or fail independently, so the result reports
+        each ('metrics' and 'logs' counts) and lists in 'failed_indices' the
+        events with a part that was not sent. An event whose metrics went
+        out but whose log did not (or the reverse) is remembered, and its
+        redelivery only sends the missing part. Events that cannot be
+        converted are rejected.
+        """
+        rejected = 0
+        metric_owner: Dict[int, int] = {}
+        log_owner: Dict[int, int] = {}
         all_metrics = []
         log_events = []
         
-        for event in events:
+        for i, event in enumerate(events):
+            sent = self._partial.get(event.get('idempotency_key'))
             try:
-                metrics = self._event_to_cloudwatch_metrics(event)
-                all_metrics.extend(metrics)
-                log_events.append(self._event_to_log_message(event))
+                if self.emf:
+                    log_events.append(self._event_to_emf_log(event))
+                    log_owner[id(log_events[-1])] = i
+                    continue
+                metrics = [] if sent == 'metrics' else self._event_to_cloudwatch_metrics(event)
+                log_event = None if sent == 'logs' else self._event_to_log_message(event)
             except Exception as e:
                 logger.warning("event_conversion_failed", error=str(e))
-                failed += 1
+                rejected += 1
+                continue
+            for metric in metrics:
+                all_metrics.append(metric)
+                metric_owner[id(metric)] = i
+            if log_event is not None:
+                log_events.append(log_event)
+                log_owner[id(log_event)] = i
         
-        # Send metrics in batches (CloudWatch limit: 20 metrics per request)
-        try:
-            for i in range(0, len(all_metrics), 20):
-                batch = all_metrics[i:i+20]
-                self.cloudwatch_client.put_metric_data(
-                    Namespace=self.namespace,
-                    MetricData=batch
-                )
-            
-            logger.info(
-                "metrics_batch_sent_to_cloudwatch",
-                total_metrics=len(all_metrics),
-                namespace=self.namespace
-            )
-        except Exception as e:
-            logger.error("cloudwatch_metrics_batch_failed", error=str(e))
-            failed += len(events)
-            return {'success': 0, 'failed': failed}
+        unsent_metrics = await self._put_metrics(all_metrics) if all_metrics else []
+        unsent_logs = await self._put_logs(log_events) if log_events else []
+        metrics_failed = {metric_owner[id(m)] for m in unsent_metrics}
+        logs_failed = {log_owner[id(le)] for le in unsent_logs}
         
-        # Send log events (CloudWatch limit: 10,000 events per request)
-        try:
-            for i in range(0, len(log_events), 10000):
-                batch = log_events[i:i+10000]
-                # Sort by timestamp
-                batch.sort(key=lambda x: x['timestamp'])
-                
-                self.logs_client.put_log_events(
-                    logGroupName=self.log_group_name,
-                    logStreamName=self.log_stream_name,
-                    logEvents=batch
-                )
-            
-            success = len(events) - failed
-            logger.info(
-                "logs_batch_sent_to_cloudwatch",
-                total_events=success,
-                log_group=self.log_group_name
-            )
-        except Exception as e:
-            logger.error("cloudwatch_logs_batch_failed", error=str(e))
-            failed = len(events)
-            success = 0
+        for i in metrics_failed ^ logs_failed:
+            self._remember_partial(events[i], 'logs' if i in metrics_failed else 'metrics')
+        failed_indices = sorted(metrics_failed | logs_failed)
+        for i, event in enumerate(events):
+            if i not in metrics_failed and i not in logs_failed:
+                self._partial.pop(event.get('idempotency_key'), None)
         
-        return {'success': success, 'failed': failed}
+        metric_events = set(metric_owner.values())
+        log_events_sent = set(log_owner.values())
+        logger.info(
+            "batch_sent_to_cloudwatch",
+            metrics_sent=len(all_metrics) - len(unsent_metrics),
+            metrics_failed=len(unsent_metrics),
+            logs_sent=len(log_events) - len(unsent_logs),
+            logs_failed=len(unsent_logs),
+            log_group=self.log_group_name,
+            emf=self.emf
+        )
+        result: Dict[str, Any] = {
+            'success': len(events) - rejected - len(failed_indices),
+            'failed': len(failed_indices),
+            'metrics': {'success': len(metric_events - metrics_failed), 'failed': len(metrics_failed)},
+            'logs': {'success': len(log_events_sent - logs_failed), 'failed': len(logs_failed)},
+        }
+        if rejected:
+            result['rejected'] = rejected
+        if failed_indices:
+            result['failed_indices'] = failed_indices
+        return result
     
     async def health_check(self) -> Dict[str, Any]:
         """Check CloudWatch connectivity."""
         try:
             # Try to describe log streams
-            response = self.logs_client.describe_log_streams(
+            response = await self._call(
+                self.logs_client.describe_log_streams,
                 logGroupName=self.log_group_name,
                 limit=1
             )
             
             # Try to list metrics
-            metrics_response = self.cloudwatch_client.list_metrics(
-                Namespace=self.namespace,
-                MaxRecords=1
+            metrics_response = await self._call(
+                self.cloudwatch_client.list_metrics,
+                Namespace=self.namespace
             )
             
             return {
@@ -359,6 +533,9 @@ class AWSCloudWatchIntegration(BaseIntegration):
             }
     
     async def close(self) -> None:
-        """Close AWS clients (boto3 handles connection pooling)."""
+        """Shut down the AWS call thread pool (boto3 handles connection pooling)."""
+        if self._executor is not None:
+            self._executor.shutdown(wait=False)
+            self._executor = None
         logger.info("aws_cloudwatch_closed", name=self.name)
 
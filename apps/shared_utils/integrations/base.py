@@ -1,8 +1,17 @@
 """Base integration interface and configuration."""
+import time
 from abc import ABC, abstractmethod
 from typing import Dict, Any, List, Optional
 from dataclasses import dataclass
 from enum import Enum
+from .resilience import AdaptiveBatchSize, CircuitBreaker
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
 
 
 class IntegrationType(str, Enum):
@@ -35,8 +44,21 @@ class BaseIntegration(ABC):
     Abstract base class for all integrations.
     
     All integration adapters must implement this interface.
+    
+    Deliveries made through `deliver()` (as the dispatch queues do) feed a
+    circuit breaker and, with batching on, the adaptive batch size. Config
+    keys: `batching`, `batch_max_events`, `batch_max_bytes`,
+    `batch_linger_ms`, `batch_target_latency_s`,
+    `breaker_failure_threshold` and `breaker_reset_s`.
     """
     
+    # Dispatch queue overflow policy unless configured (see IntegrationQueue)
+    DEFAULT_OVERFLOW = 'drop_oldest'
+    
+    # Whether queued events are coalesced into send_batch calls by default;
+    # on for backends with a cheap bulk API
+    DEFAULT_BATCHING = False
+    
     def __init__(self, config: IntegrationConfig):
         """
         Initialize the integration.
@@ -48,6 +70,17 @@ class BaseIntegration(ABC):
         self.name = config.name
         self.enabled = config.enabled
         self._initialized = False
+        self.batching = bool(self.get_config('batching', self.DEFAULT_BATCHING))
+        self.batch_max_bytes = int(self.get_config('batch_max_bytes', 1024 * 1024))
+        self.batch_linger_s = float(self.get_config('batch_linger_ms', 50)) / 1000.0
+        self.batch_size = AdaptiveBatchSize(
+            max_size=int(self.get_config('batch_max_events', 500)),
+            target_latency_s=float(self.get_config('batch_target_latency_s', 0.5))
+        )
+        self.breaker = CircuitBreaker(
+            failure_threshold=int(self.get_config('breaker_failure_threshold', 5)),
+            reset_timeout_s=float(self.get_config('breaker_reset_s', 30.0))
+        )
     
     @abstractmethod
     async def initialize(self) -> None:
@@ -72,7 +105,7 @@ class BaseIntegration(ABC):
         pass
     
     @abstractmethod
-    async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, int]:
+    async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, Any]:
         """
         Send a batch of events to the integration backend.
         
@@ -80,7 +113,14 @@ class BaseIntegration(ABC):
             events: List of event dictionaries
             
         Returns:
-            Dictionary with 'success' and 'failed' counts
+            Dictionary with 'success' and 'failed' counts. 'failed' counts
+            events worth redelivering (backend unavailable); events the
+            backend refused permanently go in an optional 'rejected' count.
+            An optional 'failed_indices' lists the failed positions in
+            `events`; without it, a batch with failures is redelivered whole.
+            An optional 'deferred' count says how many of the failed events
+            the backend asked to receive later (it is up, so they do not
+            count against the circuit breaker).
         """
         pass
     
@@ -103,6 +143,45 @@ class BaseIntegration(ABC):
         """
         pass
     
+    async def deliver(self, events: List[Dict[str, Any]], single: bool = False) -> List[Dict[str, Any]]:
+        """
+        Deliver events, recording the outcome in the breaker and batch size.
+        
+        Call only after `breaker.allow()` returned True. Only failures
+        count against the breaker; rejected events mean the backend is
+        up and answering.
+        
+        Args:
+            events: Events to deliver
+            single: Use send_event (exactly one event)
+            
+        Returns:
+            The events to keep for redelivery (empty if every event was
+            accepted or rejected)
+        """
+        start = time.monotonic()
+        failed: List[Dict[str, Any]] = []
+        deferred = 0
+        try:
+            if single:
+                if not await self.send_event(events[0]):
+                    failed = list(events)
+            else:
+                result = await self.send_batch(events)
+                if result.get('failed', 0):
+                    indices = result.get('failed_indices')
+                    failed = list(events) if indices is None else [events[i] for i in indices]
+                    deferred = int(result.get('deferred', 0))
+        except Exception as e:
+            logger.error("integration_delivery_failed", integration=self.name, error=str(e),
+                         error_type=type(e).__name__)
+            failed = list(events)
+        ok = len(failed) <= deferred
+        self.breaker.record(ok)
+        if self.batching:
+            self.batch_size.observe(len(events), time.monotonic() - start, ok)
+        return failed
+    
     def is_enabled(self) -> bool:
         """Check if integration is enabled."""
         return self.enabled
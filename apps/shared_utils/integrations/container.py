@@ -1,8 +1,14 @@
 """Dependency injection container for integrations."""
 import os
 import json
-from typing import Dict, List, Optional, Type
+import asyncio
+from pathlib import Path
+from typing import Any, Callable, Dict, List, Optional, Type
+from ..drain import SpoolDrainer
+from ..spool import SegmentedSpool
 from .base import BaseIntegration, IntegrationConfig, IntegrationType
+from .dispatch import IntegrationQueue
+from .resilience import CircuitOpenError
 from .local_api import LocalAPIIntegration
 from .zabbix import ZabbixIntegration
 from .elk import ELKIntegration
@@ -29,6 +35,15 @@ class IntegrationContainer:
     - Configuration from environment or code
     - Lifecycle management (init, close)
     - Health checks across all integrations
+    - Isolated delivery: each initialized integration gets its own bounded
+      queue and workers (see `IntegrationQueue`), so dispatch returns once
+      events are enqueued and one slow backend cannot delay the others.
+      Per-integration config keys: `queue` (false delivers inline),
+      `queue_max_events`, `concurrency`, `overflow` and `block_timeout_s`.
+    - Per-integration spools: with `spool_dir` set, events an integration
+      could not take (failed delivery, open circuit breaker, shutdown) go
+      to its own spool under `spool_dir/<name>` and are replayed only to
+      it, so one dead backend never holds up the others.
     """
     
     # Registry of available integration classes
@@ -43,9 +58,35 @@ class IntegrationContainer:
         IntegrationType.AWS_XRAY: AWSXRayIntegration,
     }
     
-    def __init__(self):
-        """Initialize the container."""
+    def __init__(
+        self,
+        on_outcome: Optional[Callable[[str, str, int], None]] = None,
+        on_failure: Optional[Callable[[str, List[Dict]], None]] = None,
+        spool_dir: Optional[str] = None,
+        spool_options: Optional[Dict[str, Any]] = None,
+        drain_interval_s: float = 2.0
+    ):
+        """
+        Initialize the container.
+        
+        Args:
+            on_outcome: Called with (integration, outcome, count) by the queues
+            on_failure: Called with (integration, events) for undeliverable
+                events when there is no per-integration spool
+            spool_dir: Parent directory of the per-integration spools
+            spool_options: Extra SegmentedSpool arguments
+            drain_interval_s: Pause between spool replay passes
+        """
         self.integrations: Dict[str, BaseIntegration] = {}
+        self.queues: Dict[str, IntegrationQueue] = {}
+        self.spools: Dict[str, SegmentedSpool] = {}
+        self.drainers: Dict[str, SpoolDrainer] = {}
+        self.on_outcome = on_outcome
+        self.on_failure = on_failure
+        self.spool_dir = spool_dir
+        self.spool_options = spool_options or {}
+        self.drain_interval_s = drain_interval_s
+        self._drain_tasks: List[asyncio.Task] = []
         self._initialized = False
     
     def register(self, config: IntegrationConfig) -> None:
@@ -148,67 +189,155 @@ class IntegrationContainer:
                     name=name,
                     error=str(e)
                 )
+                continue
+            
+            if integration.get_config('queue', True):
+                self.queues[name] = self._create_queue(integration)
+                self.queues[name].start()
+                if self.spool_dir:
+                    self._create_spool(integration)
         
         self._initialized = True
         logger.info("all_integrations_initialized")
     
+    def _create_queue(self, integration: BaseIntegration) -> IntegrationQueue:
+        name = integration.name
+        
+        # Callbacks are looked up on use, so they can be set after startup
+        def outcome(kind: str, count: int) -> None:
+            if self.on_outcome is not None:
+                self.on_outcome(name, kind, count)
+        
+        def failure(events: List[Dict]) -> None:
+            spool = self.spools.get(name)
+            if spool is not None:
+                for event in events:
+                    spool.append(event)
+            elif self.on_failure is not None:
+                self.on_failure(name, events)
+        
+        return IntegrationQueue(
+            integration,
+            max_events=int(integration.get_config('queue_max_events', 10000)),
+            concurrency=int(integration.get_config('concurrency', 1)),
+            overflow=integration.get_config('overflow', integration.DEFAULT_OVERFLOW),
+            block_timeout_s=float(integration.get_config('block_timeout_s', 0.5)),
+            on_outcome=outcome,
+            on_failure=failure
+        )
+    
+    def _create_spool(self, integration: BaseIntegration) -> None:
+        name = integration.name
+        queue = self.queues[name]
+        spool = SegmentedSpool(Path(self.spool_dir) / name, **self.spool_options)
+        
+        async def replay(records: List[Dict]) -> List[Optional[Exception]]:
+            # Probes the breaker while it is half-open; live traffic keeps priority
+            if not integration.breaker.allow():
+                raise CircuitOpenError(f'{name}: circuit open')
+            async with queue.gate.slot(live=False):
+                failed = await integration.deliver(records)
+            if len(failed) == len(records):
+                raise RuntimeError(f'{name} did not accept replayed events')
+            failed_ids = {id(record) for record in failed}
+            return [
+                RuntimeError(f'{name} did not accept replayed event') if id(record) in failed_ids else None
+                for record in records
+            ]
+        
+        def outcome(status: str, count: int) -> None:
+            if self.on_outcome is not None and count:
+                self.on_outcome(name, f'replay_{status}', count)
+        
+        self.spools[name] = spool
+        self.drainers[name] = SpoolDrainer(
+            spool,
+            replay,
+            batch_size=integration.batch_size.max_size if integration.batching else 100,
+            max_concurrency=queue.concurrency,
+            on_outcome=outcome,
+            name=f'integration:{name}'
+        )
+        self._drain_tasks.append(asyncio.create_task(self.drainers[name].run(self.drain_interval_s)))
+    
+    def _targets(self, names: Optional[List[str]]) -> List[str]:
+        return [
+            name for name, integration in self.integrations.items()
+            if integration.is_enabled() and (names is None or name in names)
+        ]
+    
     async def send_event(self, event: Dict) -> Dict[str, bool]:
         """
         Send event to all enabled integrations.
         
+        Queued integrations report True once the event is enqueued; the
+        others are called directly, concurrently.
+        
         Args:
             event: Event dictionary
             
         Returns:
             Dictionary mapping integration name to success status
         """
-        results = {}
-        
-        for name, integration in self.integrations.items():
-            if not integration.is_enabled():
-                continue
-            
+        async def one(name: str) -> bool:
+            queue = self.queues.get(name)
             try:
-                success = await integration.send_event(event)
-                results[name] = success
+                if queue is not None:
+                    return await queue.put([event], single=True)
+                return bool(await self.integrations[name].send_event(event))
             except Exception as e:
                 logger.error(
                     "integration_send_failed",
                     integration=name,
                     error=str(e)
                 )
-                results[name] = False
+                return False
         
-        return results
+        names = self._targets(None)
+        return dict(zip(names, await asyncio.gather(*(one(name) for name in names))))
     
-    async def send_batch(self, events: List[Dict]) -> Dict[str, Dict[str, int]]:
+    async def send_batch(
+        self,
+        events: List[Dict],
+        names: Optional[List[str]] = None,
+        live: bool = True
+    ) -> Dict[str, Dict[str, int]]:
         """
-        Send batch of events to all enabled integrations.
+        Send batch of events to all (or the named) enabled integrations.
         
         Args:
             events: List of event dictionaries
+            names: Only deliver to these integrations
+            live: False for spool replay, which only uses free queue capacity
             
         Returns:
-            Dictionary mapping integration name to result stats
+            Dictionary mapping integration name to result stats (for queued
+            integrations, all events count as successful once enqueued)
         """
-        results = {}
-        
-        for name, integration in self.integrations.items():
-            if not integration.is_enabled():
-                continue
-            
+        async def one(name: str) -> Dict[str, int]:
+            queue = self.queues.get(name)
             try:
-                result = await integration.send_batch(events)
-                results[name] = result
+                if queue is not None:
+                    ok = await queue.put(events, live=live)
+                    return {'success': len(events), 'failed': 0} if ok else {'success': 0, 'failed': len(events)}
+                return await self.integrations[name].send_batch(events)
             except Exception as e:
                 logger.error(
                     "integration_batch_failed",
                     integration=name,
                     error=str(e)
                 )
-                results[name] = {'success': 0, 'failed': len(events)}
+                return {'success': 0, 'failed': len(events)}
         
-        return results
+        targets = self._targets(names)
+        return dict(zip(targets, await asyncio.gather(*(one(name) for name in targets))))
+    
+    def queue_stats(self) -> Dict[str, Dict]:
+        """Depth, lag, breaker state and outcome counters of each integration queue."""
+        stats = {name: queue.stats() for name, queue in self.queues.items()}
+        for name, drainer in self.drainers.items():
+            stats[name]['spool'] = drainer.stats()
+        return stats
     
     async def health_check_all(self) -> Dict[str, Dict]:
         """
@@ -232,10 +361,26 @@ class IntegrationContainer:
         
         return results
     
-    async def close_all(self) -> None:
-        """Close all integrations and cleanup resources."""
+    async def close_all(self, drain_timeout_s: float = 5.0) -> None:
+        """
+        Close all integrations and cleanup resources.
+        
+        Queues get up to `drain_timeout_s` to deliver what they hold;
+        anything left is spooled (or passed to `on_failure`).
+        """
         logger.info("closing_integrations", count=len(self.integrations))
         
+        for task in self._drain_tasks:
+            task.cancel()
+        await asyncio.gather(*self._drain_tasks, return_exceptions=True)
+        self._drain_tasks = []
+        await asyncio.gather(*(queue.close(drain_timeout_s) for queue in self.queues.values()))
+        self.queues.clear()
+        for spool in self.spools.values():
+            spool.close()
+        self.spools.clear()
+        self.drainers.clear()
+        
         for name, integration in self.integrations.items():
             try:
                 await integration.close()
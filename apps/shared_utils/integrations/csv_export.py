@@ -1,11 +1,10 @@
 """CSV export integration for local file storage."""
 import csv
-import os
+import io
 from pathlib import Path
 from typing import Dict, Any, List
-from datetime import datetime
-import asyncio
 from .base import BaseIntegration, IntegrationConfig
+from .file_writer import ParquetRotatingWriter, RotatingFileWriter, compression_codec
 
 try:
     import structlog
@@ -14,20 +13,51 @@ except ImportError:
     import logging
     logger = logging.getLogger(__name__)  # type: ignore
 
+CSV_COLUMNS = [
+    'timestamp', 'idempotency_key', 'site_id', 'app_id', 'app_name', 'app_version',
+    'entity_type', 'entity_id', 'parent_id', 'business_key', 'sub_key',
+    'event_kind', 'status', 'duration_s', 'cpu_user_s', 'cpu_system_s',
+    'mem_max_mb', 'metadata_json'
+]
+NUMERIC_COLUMNS = {'duration_s', 'cpu_user_s', 'cpu_system_s', 'mem_max_mb'}
+
+
+def parquet_schema() -> Any:
+    """pyarrow schema of the flattened rows (metrics as float64, the rest strings)."""
+    import pyarrow as pa
+    return pa.schema([(c, pa.float64() if c in NUMERIC_COLUMNS else pa.string()) for c in CSV_COLUMNS])
+
 
 class CSVExportIntegration(BaseIntegration):
     """
     CSV export integration for local file storage.
     
-    Writes events to CSV files with rotation by date.
+    Writes events to CSV files with rotation by date, through one
+    long-lived, buffered writer (see RotatingFileWriter). With
+    `format: parquet` the same flattened rows are written as one Parquet
+    file per rotated file instead.
     
     Configuration:
         - output_dir: Directory for CSV files (default: /var/log/wafer-monitor)
         - rotation: Rotation strategy (daily, hourly, none)
         - include_headers: Include CSV headers (default: True)
         - delimiter: CSV delimiter (default: ,)
+        - format: csv or parquet (default: csv)
+        - compression: false, true/gzip or zstd; Parquet column codec for
+          parquet (default: False, zstd for parquet)
+        - max_file_mb: Also rotate at this file size (default: 0, off)
+        - buffer_kb: Buffered data that triggers a write (default: 256)
+        - flush_interval_s: Longest time rows stay buffered (default: 1.0,
+          60 for parquet)
+        - row_group_rows: Rows per Parquet row group (default: 10000)
+        - max_file_age_s: Also finalize a file this long after it was
+          opened (default: 3600 with rotation none, else 0, off)
+        - fsync: fsync after every write (default: False)
     """
     
+    # Queued events are coalesced into send_batch calls
+    DEFAULT_BATCHING = True
+    
     def __init__(self, config: IntegrationConfig):
         """Initialize CSV export integration."""
         super().__init__(config)
@@ -35,32 +65,56 @@ class CSVExportIntegration(BaseIntegration):
         self.rotation = self.get_config('rotation', 'daily')
         self.include_headers = self.get_config('include_headers', True)
         self.delimiter = self.get_config('delimiter', ',')
-        self._lock = asyncio.Lock()
+        self.format = self.get_config('format', 'csv')
+        max_bytes = int(float(self.get_config('max_file_mb', 0)) * 1024 * 1024)
+        fsync = bool(self.get_config('fsync', False))
+        max_age = self.get_config('max_file_age_s')
+        max_age_s = float(max_age) if max_age is not None else None
+        
+        if self.format == 'parquet':
+            self.compression = self.get_config('compression', 'zstd') or None
+            self.writer = ParquetRotatingWriter(
+                self.output_dir,
+                'wafer_events',
+                parquet_schema(),
+                rotation=self.rotation,
+                max_bytes=max_bytes,
+                compression=self.compression,
+                row_group_rows=int(self.get_config('row_group_rows', 10000)),
+                fsync=fsync,
+                flush_interval_s=float(self.get_config('flush_interval_s', 60.0)),
+                max_age_s=max_age_s
+            )
+        elif self.format == 'csv':
+            self.compression = compression_codec(self.get_config('compression', False))
+            self.writer = RotatingFileWriter(
+                self.output_dir,
+                'wafer_events',
+                '.csv',
+                rotation=self.rotation,
+                max_bytes=max_bytes,
+                compression=self.compression,
+                buffer_bytes=int(self.get_config('buffer_kb', 256)) * 1024,
+                flush_interval_s=float(self.get_config('flush_interval_s', 1.0)),
+                fsync=fsync,
+                max_age_s=max_age_s,
+                header=self._encode_rows([dict(zip(CSV_COLUMNS, CSV_COLUMNS))])[0] if self.include_headers else b''
+            )
+        else:
+            raise ValueError(f"format must be csv or parquet, got {self.format!r}")
     
     async def initialize(self) -> None:
-        """Create output directory if it doesn't exist."""
-        self.output_dir.mkdir(parents=True, exist_ok=True)
+        """Create output directory, finalize leftover files and start flushing."""
+        await self.writer.start()
         self._initialized = True
         logger.info(
             "csv_export_initialized",
             name=self.name,
             output_dir=str(self.output_dir),
-            rotation=self.rotation
+            rotation=self.rotation,
+            format=self.format
         )
     
-    def _get_csv_filename(self) -> Path:
-        """Get current CSV filename based on rotation strategy."""
-        now = datetime.utcnow()
-        
-        if self.rotation == 'hourly':
-            suffix = now.strftime('%Y%m%d_%H')
-        elif self.rotation == 'daily':
-            suffix = now.strftime('%Y%m%d')
-        else:
-            suffix = 'events'
-        
-        return self.output_dir / f'wafer_events_{suffix}.csv'
-    
     def _flatten_event(self, event: Dict[str, Any]) -> Dict[str, Any]:
         """Flatten nested event structure for CSV."""
         entity = event.get('entity', {})
@@ -90,92 +144,45 @@ class CSVExportIntegration(BaseIntegration):
             'metadata_json': str(metadata) if metadata else ''
         }
     
+    def _encode_rows(self, rows: List[Dict[str, Any]]) -> List[bytes]:
+        """CSV lines for flattened rows."""
+        buf = io.StringIO()
+        writer = csv.DictWriter(buf, fieldnames=CSV_COLUMNS, delimiter=self.delimiter)
+        encoded = []
+        for row in rows:
+            writer.writerow(row)
+            encoded.append(buf.getvalue().encode('utf-8'))
+            buf.seek(0)
+            buf.truncate()
+        return encoded
+    
+    @staticmethod
+    def _parquet_row(row: Dict[str, Any]) -> Dict[str, Any]:
+        return {
+            k: (float(v) if v != '' and v is not None else None) if k in NUMERIC_COLUMNS
+            else (None if v is None else str(v))
+            for k, v in row.items()
+        }
+    
     async def send_event(self, event: Dict[str, Any]) -> bool:
         """Append event to CSV file."""
-        try:
-            async with self._lock:
-                filename = self._get_csv_filename()
-                file_exists = filename.exists()
-                
-                flattened = self._flatten_event(event)
-                
-                # Use thread executor for file I/O
-                await asyncio.get_event_loop().run_in_executor(
-                    None,
-                    self._write_csv_sync,
-                    filename,
-                    flattened,
-                    file_exists
-                )
-                
-                logger.debug("event_written_to_csv", filename=filename.name)
-                return True
-        except Exception as e:
-            logger.error("csv_write_failed", error=str(e))
-            return False
-    
-    def _write_csv_sync(self, filename: Path, data: Dict[str, Any], file_exists: bool) -> None:
-        """Synchronous CSV write (called in thread executor)."""
-        mode = 'a' if file_exists else 'w'
-        
-        with open(filename, mode, newline='', encoding='utf-8') as f:
-            writer = csv.DictWriter(f, fieldnames=data.keys(), delimiter=self.delimiter)
-            
-            if not file_exists and self.include_headers:
-                writer.writeheader()
-            
-            writer.writerow(data)
+        return (await self.send_batch([event]))['failed'] == 0
     
     async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, int]:
         """Append batch of events to CSV file."""
         try:
-            async with self._lock:
-                filename = self._get_csv_filename()
-                file_exists = filename.exists()
-                
-                flattened_events = [self._flatten_event(e) for e in events]
-                
-                # Use thread executor for file I/O
-                await asyncio.get_event_loop().run_in_executor(
-                    None,
-                    self._write_csv_batch_sync,
-                    filename,
-                    flattened_events,
-                    file_exists
-                )
-                
-                logger.info(
-                    "batch_written_to_csv",
-                    filename=filename.name,
-                    count=len(events)
-                )
-                return {'success': len(events), 'failed': 0}
+            rows = [self._flatten_event(e) for e in events]
+            if self.format == 'parquet':
+                records = [self._parquet_row(r) for r in rows]
+            else:
+                records = self._encode_rows(rows)
+            await self.writer.write_async(records)
+            logger.debug("batch_written_to_csv", count=len(events))
+            return {'success': len(events), 'failed': 0}
         except Exception as e:
             logger.error("csv_batch_write_failed", error=str(e))
             return {'success': 0, 'failed': len(events)}
     
-    def _write_csv_batch_sync(
-        self,
-        filename: Path,
-        data_list: List[Dict[str, Any]],
-        file_exists: bool
-    ) -> None:
-        """Synchronous CSV batch write."""
-        mode = 'a' if file_exists else 'w'
-        
-        with open(filename, mode, newline='', encoding='utf-8') as f:
-            if data_list:
-                writer = csv.DictWriter(
-                    f,
-                    fieldnames=data_list[0].keys(),
-                    delimiter=self.delimiter
-                )
-                
-                if not file_exists and self.include_headers:
-                    writer.writeheader()
-                
-                writer.writerows(data_list)
-    
     async def health_check(self) -> Dict[str, Any]:
         """Check CSV export health."""
         try:
@@ -189,7 +196,9 @@ class CSVExportIntegration(BaseIntegration):
                 'integration': self.name,
                 'backend': 'csv_export',
                 'output_dir': str(self.output_dir),
-                'writable': True
+                'format': self.format,
+                'writable': True,
+                'writer': self.writer.stats()
             }
         except Exception as e:
             return {
@@ -201,6 +210,7 @@ class CSVExportIntegration(BaseIntegration):
             }
     
     async def close(self) -> None:
-        """Cleanup (nothing to close for CSV)."""
+        """Flush and finalize the active file."""
+        await self.writer.close_async()
         logger.info("csv_export_closed", name=self.name)
 
@@ -0,0 +1,289 @@
+"""Bounded per-integration dispatch queue with its own worker tasks."""
+import asyncio
+import json
+import time
+from collections import deque
+from typing import Any, Callable, Deque, Dict, List, Optional, Tuple
+
+from ..drain import PriorityGate
+from .base import BaseIntegration
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
+
+OVERFLOW_POLICIES = ('drop_oldest', 'drop_newest', 'block')
+
+# on_outcome(outcome, count): 'delivered', 'failed', 'spooled', 'dropped' or 'rejected'
+OutcomeFn = Callable[[str, int], None]
+# on_failure(events): events that could not be delivered
+FailureFn = Callable[[List[Dict[str, Any]]], None]
+
+
+class IntegrationQueue:
+    """
+    Decouples callers from one integration's backend.
+
+    `put()` only appends to an in-memory queue bounded by `max_events`;
+    `concurrency` worker tasks deliver queued items with the integration's
+    `send_event`/`send_batch`. A slow or failing backend therefore only
+    fills its own queue. When the queue is full the overflow policy
+    decides: `drop_oldest` evicts the oldest queued events,
+    `drop_newest` refuses the new ones and `block` waits up to
+    `block_timeout_s` for room before refusing. With `on_failure` set,
+    evicted and refused live events are handed to it (spooled) instead
+    of being lost, and `put()` reports them as kept. Low-priority puts
+    (`live=False`, spool replay) only ever use free capacity and are
+    refused otherwise, since their caller still holds them.
+
+    With `integration.batching`, workers coalesce queued events into one
+    send_batch call until the integration's adaptive batch size or
+    `batch_max_bytes` is reached, waiting at most `batch_linger_s` for more.
+
+    Events that fail in a worker, arrive while the integration's circuit
+    breaker is open, or are still queued when the queue is closed, are
+    handed to `on_failure` so the caller can keep them (the container
+    spools them per integration). Of a partly failed batch only the
+    failed events are handed over, or the whole batch when the
+    integration cannot tell which; delivery is at-least-once. Events
+    the backend rejects permanently are counted, not kept. Deliveries hold a
+    live slot of `gate`; spool replay takes replay slots, so it only runs
+    on capacity live traffic leaves free.
+    """
+
+    def __init__(
+        self,
+        integration: BaseIntegration,
+        max_events: int = 10000,
+        concurrency: int = 1,
+        overflow: str = 'drop_oldest',
+        block_timeout_s: float = 0.5,
+        on_outcome: Optional[OutcomeFn] = None,
+        on_failure: Optional[FailureFn] = None
+    ):
+        """
+        Args:
+            integration: Integration the workers deliver to
+            max_events: Queue bound, in events
+            concurrency: Number of deliveries in flight at once
+            overflow: 'drop_oldest', 'drop_newest' or 'block'
+            block_timeout_s: Longest wait for room with overflow='block'
+            on_outcome: Called with (outcome, count) for every change
+            on_failure: Called with undeliverable events
+        """
+        if overflow not in OVERFLOW_POLICIES:
+            raise ValueError(f"overflow must be one of {', '.join(OVERFLOW_POLICIES)}, got {overflow!r}")
+        self.integration = integration
+        self.name = integration.name
+        self.max_events = max(1, max_events)
+        self.concurrency = max(1, concurrency)
+        self.overflow = overflow
+        self.block_timeout_s = block_timeout_s
+        self.on_outcome = on_outcome
+        self.on_failure = on_failure
+        # (enqueued_at, events, single, size in bytes if batching by size)
+        self._items: Deque[Tuple[float, List[Dict[str, Any]], bool, int]] = deque()
+        self.gate = PriorityGate(self.concurrency)
+        self._depth = 0
+        self._in_flight = 0
+        self._changed = asyncio.Condition()
+        self._workers: List[asyncio.Task] = []
+        self._closing = False
+        self.last_delivery_lag_s = 0.0
+        self.counts = {'enqueued': 0, 'delivered': 0, 'failed': 0, 'spooled': 0, 'dropped': 0, 'rejected': 0}
+
+    @property
+    def depth(self) -> int:
+        """Events waiting in the queue (not yet picked up by a worker)."""
+        return self._depth
+
+    @property
+    def lag_s(self) -> float:
+        """Age of the oldest waiting event."""
+        return time.monotonic() - self._items[0][0] if self._items else 0.0
+
+    def _record(self, outcome: str, count: int) -> None:
+        self.counts[outcome] += count
+        if self.on_outcome is not None and outcome != 'enqueued':
+            self.on_outcome(outcome, count)
+
+    def _hand_over(self, events: List[Dict[str, Any]]) -> None:
+        if self.on_failure is None:
+            return
+        try:
+            self.on_failure(events)
+        except Exception as e:
+            logger.error("integration_failure_handler_failed", integration=self.name, error=str(e))
+
+    def _overflow(self, events: List[Dict[str, Any]], live: bool, outcome: str) -> bool:
+        """Events that do not fit: spool live ones if possible, else count them as `outcome`."""
+        if live and self.on_failure is not None:
+            self._record('spooled', len(events))
+            self._hand_over(events)
+            return True
+        self._record(outcome, len(events))
+        return False
+
+    def start(self) -> None:
+        """Start the worker tasks."""
+        if not self._workers:
+            self._workers = [asyncio.create_task(self._worker()) for _ in range(self.concurrency)]
+
+    async def put(self, events: List[Dict[str, Any]], single: bool = False, live: bool = True) -> bool:
+        """
+        Enqueue events for delivery.
+
+        Args:
+            events: Events to deliver together
+            single: Deliver with send_event (exactly one event)
+            live: False for low-priority traffic that must not displace
+                or wait for live events
+
+        Returns:
+            True if the events were enqueued or handed to `on_failure`,
+            False if they were rejected
+        """
+        n = len(events)
+        if n == 0:
+            return True
+        if self._closing or n > self.max_events:
+            return self._overflow(events, live, 'rejected')
+        if not self.integration.breaker.accepting and self.on_failure is not None:
+            # Backend is known to be down: keep the events instead of queueing
+            self._record('spooled', n)
+            self._hand_over(events)
+            return True
+        nbytes = self._size(events)
+        async with self._changed:
+            if self._depth + n > self.max_events:
+                if not live or self.overflow == 'drop_newest':
+                    return self._overflow(events, live, 'rejected')
+                if self.overflow == 'drop_oldest':
+                    while self._depth + n > self.max_events:
+                        old = self._items.popleft()[1]
+                        self._depth -= len(old)
+                        self._overflow(old, True, 'dropped')
+                    logger.warning("integration_queue_overflow", integration=self.name, depth=self._depth)
+                else:
+                    try:
+                        await asyncio.wait_for(
+                            self._changed.wait_for(lambda: self._depth + n <= self.max_events or self._closing),
+                            self.block_timeout_s
+                        )
+                    except asyncio.TimeoutError:
+                        return self._overflow(events, live, 'rejected')
+                    if self._closing:
+                        return self._overflow(events, live, 'rejected')
+            self._items.append((time.monotonic(), events, single, nbytes))
+            self._depth += n
+            self._record('enqueued', n)
+            self._changed.notify_all()
+        return True
+
+    def _size(self, events: List[Dict[str, Any]]) -> int:
+        if not (self.integration.batching and self.integration.batch_max_bytes > 0):
+            return 0
+        return sum(len(json.dumps(e, default=str)) for e in events)
+
+    async def _take(self) -> Tuple[float, List[Dict[str, Any]], bool]:
+        """
+        Next delivery: one queued item, or several coalesced. Called holding
+        the lock; taken events count as in flight from here on.
+        """
+        await self._changed.wait_for(lambda: bool(self._items))
+        enqueued_at, events, single, nbytes = self._items.popleft()
+        self._depth -= len(events)
+        self._in_flight += len(events)
+        if not self.integration.batching:
+            return enqueued_at, events, single
+        limit = self.integration.batch_size.current
+        max_bytes = self.integration.batch_max_bytes
+        batch = list(events)
+        deadline = time.monotonic() + self.integration.batch_linger_s
+        while len(batch) < limit:
+            if not self._items:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0 or self._closing:
+                    break
+                try:
+                    await asyncio.wait_for(
+                        self._changed.wait_for(lambda: bool(self._items) or self._closing), remaining
+                    )
+                except asyncio.TimeoutError:
+                    break
+                continue
+            _, more, _, more_bytes = self._items[0]
+            if len(batch) + len(more) > limit or (max_bytes > 0 and nbytes + more_bytes > max_bytes):
+                break
+            self._items.popleft()
+            self._depth -= len(more)
+            self._in_flight += len(more)
+            batch.extend(more)
+            nbytes += more_bytes
+        return enqueued_at, batch, False
+
+    async def _worker(self) -> None:
+        while True:
+            async with self._changed:
+                enqueued_at, events, single = await self._take()
+                self._changed.notify_all()
+            failed = events
+            try:
+                if self.integration.breaker.allow():
+                    async with self.gate.slot(live=True):
+                        failed = await self.integration.deliver(events, single)
+                    self._record('delivered', len(events) - len(failed))
+                    if failed:
+                        self._record('failed', len(failed))
+                else:
+                    self._record('spooled', len(events))
+            except asyncio.CancelledError:
+                self._in_flight -= len(events)
+                self._hand_over(events)
+                raise
+            async with self._changed:
+                self._in_flight -= len(events)
+                self._changed.notify_all()
+            self.last_delivery_lag_s = time.monotonic() - enqueued_at
+            if failed:
+                self._hand_over(failed)
+
+    async def close(self, timeout_s: float = 5.0) -> None:
+        """
+        Stop accepting events, let the workers drain for up to `timeout_s`
+        and hand whatever is left to `on_failure`.
+        """
+        self._closing = True
+        async with self._changed:
+            self._changed.notify_all()
+            try:
+                await asyncio.wait_for(
+                    self._changed.wait_for(lambda: not self._items and self._in_flight == 0), timeout_s
+                )
+            except asyncio.TimeoutError:
+                logger.warning("integration_queue_close_timeout", integration=self.name, depth=self._depth)
+        for task in self._workers:
+            task.cancel()
+        await asyncio.gather(*self._workers, return_exceptions=True)
+        self._workers = []
+        while self._items:
+            events = self._items.popleft()[1]
+            self._depth -= len(events)
+            self._hand_over(events)
+
+    def stats(self) -> Dict[str, Any]:
+        return {
+            'depth': self._depth,
+            'max_events': self.max_events,
+            'in_flight': self._in_flight,
+            'lag_s': round(self.lag_s, 3),
+            'last_delivery_lag_s': round(self.last_delivery_lag_s, 3),
+            'concurrency': self.concurrency,
+            'overflow': self.overflow,
+            'batch_size': self.integration.batch_size.current if self.integration.batching else None,
+            'breaker': self.integration.breaker.stats(),
+            **self.counts,
+        }
@@ -1,8 +1,10 @@
 """Elasticsearch/ELK integration."""
+import asyncio
 import httpx
 import json
-from typing import Dict, Any, List
-from datetime import datetime
+import random
+from typing import Dict, Any, List, Optional, Tuple
+from datetime import datetime, timezone
 from .base import BaseIntegration, IntegrationConfig
 
 try:
@@ -13,6 +15,148 @@ except ImportError:
     logger = logging.getLogger(__name__)  # type: ignore
 
 
+def retryable_status(status: int) -> bool:
+    """Whether a bulk item or request with this HTTP status may succeed later."""
+    return status == 429 or status >= 500
+
+
+class BulkIndexer:
+    """
+    Indexes documents through the `_bulk` API.
+    
+    Documents are encoded once and split into `_bulk` requests of at most
+    `max_bytes` of NDJSON and `max_docs` documents; up to `concurrency`
+    requests are in flight at once. The per-item results are parsed, and
+    only items rejected with 429 or 5xx (or whose request failed as a
+    whole with a network error, 429 or 5xx) are retried, up to
+    `max_retries` times with jittered exponential backoff. Items rejected
+    with another status (mapping errors, for instance) will never succeed
+    and are reported as rejected rather than failed.
+    """
+    
+    def __init__(
+        self,
+        client: Any,
+        url: str,
+        max_bytes: int = 5 * 1024 * 1024,
+        max_docs: int = 1000,
+        concurrency: int = 2,
+        max_retries: int = 3,
+        backoff_s: float = 0.5,
+        max_backoff_s: float = 10.0
+    ):
+        """
+        Args:
+            client: httpx.AsyncClient (or compatible)
+            url: Elasticsearch base URL
+            max_bytes: Largest `_bulk` request body
+            max_docs: Most documents per `_bulk` request
+            concurrency: `_bulk` requests in flight at once
+            max_retries: Retries of retryable items
+            backoff_s: First retry delay (doubled per retry)
+            max_backoff_s: Upper bound for the retry delay
+        """
+        self.client = client
+        self.url = url
+        self.max_bytes = max_bytes
+        self.max_docs = max(1, max_docs)
+        self.max_retries = max_retries
+        self.backoff_s = backoff_s
+        self.max_backoff_s = max_backoff_s
+        self._slots = asyncio.Semaphore(max(1, concurrency))
+        self.counts = {'requests': 0, 'indexed': 0, 'retried': 0, 'failed': 0, 'rejected': 0}
+    
+    @staticmethod
+    def encode(index: str, doc: Dict[str, Any], doc_id: Optional[str] = None) -> bytes:
+        """NDJSON action and source lines of one document."""
+        action = {'_index': index}
+        if doc_id:
+            action['_id'] = doc_id
+        return (json.dumps({'index': action}) + '\n' + json.dumps(doc, default=str) + '\n').encode('utf-8')
+    
+    def _chunks(self, items: List[bytes], pending: List[int]) -> List[List[int]]:
+        chunks: List[List[int]] = []
+        size = 0
+        for i in pending:
+            n = len(items[i])
+            if chunks and len(chunks[-1]) < self.max_docs and size + n <= self.max_bytes:
+                chunks[-1].append(i)
+                size += n
+            else:
+                chunks.append([i])
+                size = n
+        return chunks
+    
+    async def _send(self, items: List[bytes], chunk: List[int]) -> List[Tuple[int, str]]:
+        """Send one `_bulk` request; (item, 'ok' | 'retry' | 'rejected') per document."""
+        async with self._slots:
+            self.counts['requests'] += 1
+            try:
+                r = await self.client.post(
+                    f'{self.url}/_bulk',
+                    content=b''.join(items[i] for i in chunk),
+                    headers={'Content-Type': 'application/x-ndjson'}
+                )
+            except Exception as e:
+                logger.warning("elasticsearch_bulk_request_failed", error=str(e), docs=len(chunk))
+                return [(i, 'retry') for i in chunk]
+        if r.status_code != 200:
+            logger.warning("elasticsearch_bulk_failed", status=r.status_code, docs=len(chunk))
+            outcome = 'retry' if retryable_status(r.status_code) else 'rejected'
+            return [(i, outcome) for i in chunk]
+        result = r.json()
+        if not result.get('errors'):
+            return [(i, 'ok') for i in chunk]
+        outcomes = []
+        first_error = None
+        bulk_items = result.get('items', [])
+        for n, i in enumerate(chunk):
+            # An item missing from the response is retried
+            info = next(iter(bulk_items[n].values()), {}) if n < len(bulk_items) else {}
+            status = info.get('status', 500)
+            if status < 300:
+                outcomes.append((i, 'ok'))
+                continue
+            outcomes.append((i, 'retry' if retryable_status(status) else 'rejected'))
+            if first_error is None and not retryable_status(status):
+                first_error = info.get('error')
+        if first_error is not None:
+            logger.warning("elasticsearch_documents_rejected", error=first_error)
+        return outcomes
+    
+    async def index(self, items: List[bytes]) -> Dict[str, Any]:
+        """
+        Index encoded documents (see `encode`).
+        
+        Returns:
+            Counts of 'success', 'failed' (still retryable after the last
+            attempt) and 'rejected' documents, and the positions of the
+            failed ones in `items` ('failed_indices')
+        """
+        pending = list(range(len(items)))
+        success = rejected = 0
+        for attempt in range(self.max_retries + 1):
+            if attempt:
+                delay = min(self.max_backoff_s, self.backoff_s * 2 ** (attempt - 1))
+                await asyncio.sleep(delay * random.uniform(0.5, 1.0))
+                self.counts['retried'] += len(pending)
+            results = await asyncio.gather(*(self._send(items, c) for c in self._chunks(items, pending)))
+            pending = []
+            for i, outcome in (o for chunk in results for o in chunk):
+                if outcome == 'ok':
+                    success += 1
+                elif outcome == 'rejected':
+                    rejected += 1
+                else:
+                    pending.append(i)
+            if not pending:
+                break
+        self.counts['indexed'] += success
+        self.counts['rejected'] += rejected
+        self.counts['failed'] += len(pending)
+        return {'success': success, 'failed': len(pending), 'rejected': rejected, 'failed_indices': pending}
+
+
 class ELKIntegration(BaseIntegration):
     """
     Integration with Elasticsearch/ELK stack.
@@ -25,8 +169,22 @@ class ELKIntegration(BaseIntegration):
         - username: Optional basic auth username
         - password: Optional basic auth password
         - api_key: Optional API key
+        - bulk_max_mb: Largest `_bulk` request body (default: 5)
+        - bulk_max_docs: Most documents per `_bulk` request (default: 1000)
+        - bulk_concurrency: `_bulk` requests in flight per batch (default: 2)
+        - max_retries: Retries of 429/5xx items (default: 3)
+        - retry_backoff_s: First retry delay, doubled per retry (default: 0.5)
+    
+    Documents are buffered by the integration's dispatch queue, which
+    coalesces them by count, bytes and linger time (`batch_max_events`,
+    `batch_max_bytes`, `batch_linger_ms`), and indexed by `BulkIndexer`.
+    Each document goes to the daily index of its own event time and uses
+    the event's idempotency key as `_id`, so retries do not duplicate it.
     """
     
+    # Queued events are coalesced into send_batch calls
+    DEFAULT_BATCHING = True
+    
     def __init__(self, config: IntegrationConfig):
         """Initialize ELK integration."""
         super().__init__(config)
@@ -36,6 +194,7 @@ class ELKIntegration(BaseIntegration):
         self.password = self.get_config('password')
         self.api_key = self.get_config('api_key')
         self.client: httpx.AsyncClient = None
+        self.indexer: Optional[BulkIndexer] = None
     
     async def initialize(self) -> None:
         """Initialize Elasticsearch client."""
@@ -47,10 +206,21 @@ class ELKIntegration(BaseIntegration):
         elif self.username and self.password:
             auth = (self.username, self.password)
         
+        concurrency = int(self.get_config('bulk_concurrency', 2))
         self.client = httpx.AsyncClient(
             timeout=10.0,
             headers=headers,
-            auth=auth
+            auth=auth,
+            limits=httpx.Limits(max_connections=max(10, concurrency * 2))
+        )
+        self.indexer = BulkIndexer(
+            self.client,
+            self.es_url,
+            max_bytes=int(float(self.get_config('bulk_max_mb', 5)) * 1024 * 1024),
+            max_docs=int(self.get_config('bulk_max_docs', 1000)),
+            concurrency=concurrency,
+            max_retries=int(self.get_config('max_retries', 3)),
+            backoff_s=float(self.get_config('retry_backoff_s', 0.5))
         )
         
         # Create index template if it doesn't exist
@@ -140,70 +310,54 @@ class ELKIntegration(BaseIntegration):
             'metadata': event_data.get('metadata', {})
         }
     
-    def _get_index_name(self) -> str:
-        """Get current index name with date suffix."""
-        today = datetime.utcnow().strftime('%Y.%m.%d')
-        return f'{self.index_prefix}-{today}'
+    def _get_index_name(self, at: Optional[str] = None) -> str:
+        """
+        Index name with the date suffix of the event time (UTC).
+        
+        Args:
+            at: ISO 8601 event timestamp; the current time if missing or invalid
+        """
+        when = None
+        if at:
+            try:
+                when = datetime.fromisoformat(str(at).replace('Z', '+00:00'))
+            except ValueError:
+                pass
+        if when is None:
+            when = datetime.utcnow()
+        elif when.tzinfo is not None:
+            when = when.astimezone(timezone.utc)
+        return f'{self.index_prefix}-{when.strftime("%Y.%m.%d")}'
     
     async def send_event(self, event: Dict[str, Any]) -> bool:
         """Send event to Elasticsearch."""
-        try:
-            doc = self._event_to_es_document(event)
-            index_name = self._get_index_name()
-            
-            r = await self.client.post(
-                f'{self.es_url}/{index_name}/_doc',
-                json=doc
-            )
-            
-            if r.status_code in (200, 201):
-                logger.debug("event_sent_to_elasticsearch", index=index_name)
-                return True
-            else:
-                logger.warning("elasticsearch_index_failed", status=r.status_code)
-                return False
-        except Exception as e:
-            logger.error("elasticsearch_send_failed", error=str(e))
-            return False
+        return (await self.send_batch([event]))['failed'] == 0
     
     async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, int]:
-        """Send batch of events to Elasticsearch using bulk API."""
+        """
+        Send batch of events to Elasticsearch using bulk API.
+        
+        Returns:
+            Counts of 'success' and 'failed' events; documents Elasticsearch
+            rejected permanently are logged and counted as 'rejected', not
+            failed, since redelivering them cannot succeed
+        """
         try:
-            index_name = self._get_index_name()
-            
-            # Build bulk request
-            bulk_data = []
-            for event in events:
-                # Action line
-                bulk_data.append(json.dumps({'index': {'_index': index_name}}))
-                # Document line
-                bulk_data.append(json.dumps(self._event_to_es_document(event)))
-            
-            bulk_body = '\n'.join(bulk_data) + '\n'
-            
-            r = await self.client.post(
-                f'{self.es_url}/_bulk',
-                content=bulk_body,
-                headers={'Content-Type': 'application/x-ndjson'}
-            )
-            
-            if r.status_code == 200:
-                result = r.json()
-                items = result.get('items', [])
-                
-                success = sum(1 for item in items if item.get('index', {}).get('status') in (200, 201))
-                failed = len(items) - success
-                
-                logger.info(
-                    "batch_sent_to_elasticsearch",
-                    total=len(events),
-                    success=success,
-                    failed=failed
+            items = [
+                BulkIndexer.encode(
+                    self._get_index_name(event.get('event', {}).get('at')),
+                    self._event_to_es_document(event),
+                    event.get('idempotency_key')
                 )
-                return {'success': success, 'failed': failed}
-            else:
-                logger.error("elasticsearch_bulk_failed", status=r.status_code)
-                return {'success': 0, 'failed': len(events)}
+                for event in events
+            ]
+            result = await self.indexer.index(items)
+            logger.info(
+                "batch_sent_to_elasticsearch",
+                total=len(events),
+                **result
+            )
+            return result
         except Exception as e:
             logger.error("elasticsearch_batch_error", error=str(e))
             return {'success': 0, 'failed': len(events)}
@@ -222,7 +376,8 @@ class ELKIntegration(BaseIntegration):
                     'integration': self.name,
                     'backend': 'elasticsearch',
                     'cluster_status': status,
-                    'details': health
+                    'details': health,
+                    'bulk': self.indexer.counts if self.indexer else None
                 }
             else:
                 return {
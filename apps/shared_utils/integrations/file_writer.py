@@ -0,0 +1,393 @@
+"""Long-lived, buffered, rotating file writers for the export integrations."""
+import asyncio
+import os
+import time
+from concurrent.futures import ThreadPoolExecutor
+from datetime import datetime
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Union
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
+
+ROTATION_FORMATS = {'hourly': '%Y%m%d_%H', 'daily': '%Y%m%d', 'none': None}
+COMPRESSION_EXTENSIONS = {None: '', 'gzip': '.gz', 'zstd': '.zst'}
+PART_MARKER = '.part'
+
+
+def compression_codec(value: Union[bool, str, None]) -> Optional[str]:
+    """
+    Normalize a `compression` config value.
+
+    Args:
+        value: False/None, True (gzip), 'gzip' or 'zstd'
+
+    Returns:
+        None, 'gzip' or 'zstd'
+
+    Raises:
+        ValueError: For an unknown codec, or zstd without the zstandard package
+    """
+    if value is True:
+        return 'gzip'
+    if not value or value == 'none':
+        return None
+    if value not in COMPRESSION_EXTENSIONS:
+        raise ValueError(f"compression must be gzip, zstd or false, got {value!r}")
+    if value == 'zstd':
+        try:
+            import zstandard  # noqa: F401
+        except ImportError:
+            raise ValueError("compression 'zstd' needs the zstandard package (pip install .[export])")
+    return value
+
+
+class RotatingFileWriter:
+    """
+    One open output file per active period, written through a memory buffer.
+
+    Records are appended to an in-memory buffer that is written out when it
+    reaches `buffer_bytes` or is older than `flush_interval_s`, optionally
+    followed by an fsync. gzip and zstd streams stay open for the whole
+    file, so the file is one continuous compressed stream rather than one
+    member per append.
+
+    The active file is named `<prefix>_<period>.part<ext>`. A file is
+    finalized when its period ends (`rotation`), it reaches `max_bytes` on
+    disk or it has been open for `max_age_s`: the stream is closed, fsynced and atomically renamed to
+    `<prefix>_<period><ext>` (or `<prefix>_<period>.<n><ext>` if that name
+    is taken), so readers never see a half-written final file.
+    `recover()` finalizes files left active by a crash.
+
+    The sync methods block; the `*_async` methods run them on the writer's
+    own single thread, which keeps writes ordered without a lock.
+    """
+
+    def __init__(
+        self,
+        directory: Union[str, Path],
+        prefix: str,
+        extension: str,
+        rotation: str = 'daily',
+        max_bytes: int = 0,
+        compression: Optional[str] = None,
+        buffer_bytes: int = 256 * 1024,
+        flush_interval_s: float = 1.0,
+        fsync: bool = False,
+        header: bytes = b'',
+        max_age_s: Optional[float] = None
+    ):
+        """
+        Args:
+            directory: Output directory
+            prefix: File name prefix
+            extension: File extension without compression suffix (e.g. '.csv')
+            rotation: 'hourly', 'daily' or 'none'
+            max_bytes: Rotate once a file reaches this size on disk (0: never)
+            compression: None, 'gzip' or 'zstd'
+            buffer_bytes: Buffered bytes that trigger a write
+            flush_interval_s: Longest time data stays in the buffer
+            fsync: fsync after every flush (finalized files are always fsynced)
+            header: Written at the start of every file
+            max_age_s: Finalize a file this long after it was opened (0: never;
+                defaults to an hour with rotation 'none', else 0), so files
+                without a period still become final
+        """
+        if rotation not in ROTATION_FORMATS:
+            raise ValueError(f"rotation must be one of {', '.join(ROTATION_FORMATS)}, got {rotation!r}")
+        self.directory = Path(directory)
+        self.prefix = prefix
+        self.extension = extension + COMPRESSION_EXTENSIONS[compression]
+        self.rotation = rotation
+        self.max_bytes = max_bytes
+        self.compression = compression
+        self.buffer_bytes = max(1, buffer_bytes)
+        self.flush_interval_s = flush_interval_s
+        self.fsync = fsync
+        self.header = header
+        if max_age_s is None:
+            max_age_s = 3600.0 if rotation == 'none' else 0.0
+        self.max_age_s = max_age_s
+
+        self._raw = None
+        self._stream = None
+        self._period: Optional[str] = None
+        self._path: Optional[Path] = None
+        self._opened_at = 0.0
+        self._buffer: List[Any] = []
+        self._buffered = 0
+        self._last_flush = time.monotonic()
+        self._executor: Optional[ThreadPoolExecutor] = None
+        self._flusher: Optional[asyncio.Task] = None
+        self.records = 0
+        self.files_finalized = 0
+        self.last_file: Optional[str] = None
+
+    def _period_key(self) -> str:
+        fmt = ROTATION_FORMATS[self.rotation]
+        return datetime.utcnow().strftime(fmt) if fmt else 'events'
+
+    def _part_path(self, period: str) -> Path:
+        return self.directory / f'{self.prefix}_{period}{PART_MARKER}{self.extension}'
+
+    def _final_path(self, period: str) -> Path:
+        path = self.directory / f'{self.prefix}_{period}{self.extension}'
+        n = 0
+        while path.exists():
+            n += 1
+            path = self.directory / f'{self.prefix}_{period}.{n}{self.extension}'
+        return path
+
+    # Stream handling; overridden by columnar writers
+
+    def _open_stream(self, path: Path) -> None:
+        self._raw = open(path, 'ab')
+        if self.compression == 'gzip':
+            import gzip
+            self._stream = gzip.GzipFile(fileobj=self._raw, mode='wb')
+        elif self.compression == 'zstd':
+            import zstandard
+            self._stream = zstandard.ZstdCompressor().stream_writer(self._raw, closefd=False)
+        else:
+            self._stream = self._raw
+        if self.header and self._raw.tell() == 0:
+            self._stream.write(self.header)
+
+    def _write_buffer(self, records: List[Any]) -> None:
+        self._stream.write(b''.join(records))
+        if self._stream is not self._raw:
+            # Sync flush, so everything written so far can be decompressed
+            self._stream.flush()
+        self._raw.flush()
+
+    def _close_stream(self) -> None:
+        if self._stream is not self._raw:
+            self._stream.close()
+        self._raw.flush()
+
+    def _size(self) -> int:
+        return self._raw.tell()
+
+    def _record_size(self, record: Any) -> int:
+        return len(record)
+
+    # Sync API (runs on the writer thread)
+
+    def write(self, records: List[Any]) -> None:
+        """Buffer records for the current file, flushing or rotating as needed."""
+        period = self._period_key()
+        if self._path is not None and period != self._period:
+            self._finalize()
+        if self._path is None:
+            self._period = period
+            self._path = self._part_path(period)
+            self._open_stream(self._path)
+            self._opened_at = time.monotonic()
+        self._buffer.extend(records)
+        self._buffered += sum(self._record_size(r) for r in records)
+        self.records += len(records)
+        if self._buffered >= self.buffer_bytes:
+            self.flush()
+
+    def flush(self) -> None:
+        """Write the buffer to the active file and rotate it if it is full."""
+        self._last_flush = time.monotonic()
+        if self._path is None or not self._buffer:
+            return
+        self._write_buffer(self._buffer)
+        self._buffer = []
+        self._buffered = 0
+        if self.fsync:
+            os.fsync(self._raw.fileno())
+        if self.max_bytes and self._size() >= self.max_bytes:
+            self._finalize()
+
+    def _expired(self) -> bool:
+        return bool(self.max_age_s) and time.monotonic() - self._opened_at >= self.max_age_s
+
+    def tick(self) -> None:
+        """Interval flush; also finalizes a file whose period has ended or that is too old."""
+        if self._path is not None and (self._period_key() != self._period or self._expired()):
+            self._finalize()
+        elif time.monotonic() - self._last_flush >= self.flush_interval_s:
+            self.flush()
+
+    def _finalize(self) -> None:
+        if self._buffer:
+            self._write_buffer(self._buffer)
+            self._buffer = []
+            self._buffered = 0
+        self._close_stream()
+        os.fsync(self._raw.fileno())
+        self._raw.close()
+        final = self._final_path(self._period)
+        os.replace(self._path, final)
+        if self.fsync:
+            fd = os.open(self.directory, os.O_RDONLY)
+            try:
+                os.fsync(fd)
+            finally:
+                os.close(fd)
+        logger.info("export_file_finalized", file=final.name, size_bytes=final.stat().st_size)
+        self.files_finalized += 1
+        self.last_file = final.name
+        self._raw = self._stream = None
+        self._path = self._period = None
+
+    def close(self) -> None:
+        """Flush and finalize the active file."""
+        if self._path is not None:
+            self._finalize()
+
+    def recover(self) -> List[Path]:
+        """
+        Finalize files a previous process left active.
+
+        Returns:
+            The finalized paths
+        """
+        recovered = []
+        for path in sorted(self.directory.glob(f'{self.prefix}_*{PART_MARKER}{self.extension}')):
+            if path == self._path:
+                continue
+            name = path.name[len(self.prefix) + 1:-len(PART_MARKER + self.extension)]
+            final = self._final_path(name)
+            if not self._recoverable(path):
+                # Kept for inspection, out of the way of the next active file
+                os.replace(path, path.with_name(path.name + '.unrecoverable'))
+                logger.warning("export_file_not_recoverable", file=path.name)
+                continue
+            os.replace(path, final)
+            recovered.append(final)
+            logger.warning("export_file_recovered", file=final.name)
+        return recovered
+
+    def _recoverable(self, path: Path) -> bool:
+        # Row formats are readable up to the last flush
+        return True
+
+    # Async API
+
+    def _run(self, fn, *args) -> 'asyncio.Future':
+        if self._executor is None:
+            self._executor = ThreadPoolExecutor(max_workers=1, thread_name_prefix=f'writer-{self.prefix}')
+        return asyncio.get_running_loop().run_in_executor(self._executor, fn, *args)
+
+    async def start(self) -> None:
+        """Recover leftover files and start the interval flusher."""
+        self.directory.mkdir(parents=True, exist_ok=True)
+        await self._run(self.recover)
+        if self._flusher is None:
+            self._flusher = asyncio.create_task(self._flush_loop())
+
+    async def _flush_loop(self) -> None:
+        interval = max(0.05, min(self.flush_interval_s, 1.0))
+        while True:
+            await asyncio.sleep(interval)
+            try:
+                await self._run(self.tick)
+            except Exception as e:
+                logger.error("export_flush_failed", prefix=self.prefix, error=str(e))
+
+    async def write_async(self, records: List[Any]) -> None:
+        await self._run(self.write, records)
+
+    async def close_async(self) -> None:
+        """Stop the flusher, finalize the active file and stop the writer thread."""
+        if self._flusher is not None:
+            self._flusher.cancel()
+            await asyncio.gather(self._flusher, return_exceptions=True)
+            self._flusher = None
+        if self._executor is not None:
+            await self._run(self.close)
+            self._executor.shutdown(wait=True)
+            self._executor = None
+
+    def stats(self) -> Dict[str, Any]:
+        return {
+            'active_file': self._path.name if self._path else None,
+            'buffered_bytes': self._buffered,
+            'records': self.records,
+            'files_finalized': self.files_finalized,
+            'last_file': self.last_file,
+        }
+
+
+class ParquetRotatingWriter(RotatingFileWriter):
+    """
+    Rotating writer producing one Parquet file per rotated file.
+
+    Records are row dicts matching `schema`; the buffer is written as one
+    row group when it reaches `row_group_rows` or is `flush_interval_s`
+    old, whichever comes first (keep the interval long: each interval
+    flush writes a smaller row group). A Parquet file is only readable once
+    its footer is written, so an active file left by a crash cannot be
+    recovered; it is renamed with an `.unrecoverable` suffix. `max_age_s`
+    bounds how long rows stay unreadable in the active file.
+    """
+
+    def __init__(
+        self,
+        directory: Union[str, Path],
+        prefix: str,
+        schema: Any,
+        rotation: str = 'daily',
+        max_bytes: int = 0,
+        compression: Optional[str] = 'zstd',
+        row_group_rows: int = 10000,
+        fsync: bool = False,
+        flush_interval_s: float = 60.0,
+        max_age_s: Optional[float] = None
+    ):
+        """
+        Args:
+            directory: Output directory
+            prefix: File name prefix
+            schema: pyarrow schema of the rows
+            rotation: 'hourly', 'daily' or 'none'
+            max_bytes: Rotate once a file reaches this size on disk (0: never)
+            compression: Parquet column codec (e.g. 'zstd', 'snappy', None)
+            row_group_rows: Rows per row group
+            fsync: fsync after every row group
+            flush_interval_s: Longest time rows wait for a full row group
+            max_age_s: Finalize a file this long after it was opened (see
+                RotatingFileWriter)
+        """
+        super().__init__(
+            directory, prefix, '.parquet', rotation=rotation, max_bytes=max_bytes,
+            buffer_bytes=max(1, row_group_rows), flush_interval_s=flush_interval_s, fsync=fsync,
+            max_age_s=max_age_s
+        )
+        self.schema = schema
+        self.parquet_compression = compression or 'none'
+        self._writer = None
+
+    def _record_size(self, record: Any) -> int:
+        return 1
+
+    def _open_stream(self, path: Path) -> None:
+        import pyarrow.parquet as pq
+        self._raw = open(path, 'wb')
+        self._writer = pq.ParquetWriter(self._raw, self.schema, compression=self.parquet_compression)
+
+    def _write_buffer(self, records: List[Any]) -> None:
+        import pyarrow as pa
+        self._writer.write_table(pa.Table.from_pylist(records, schema=self.schema))
+        self._raw.flush()
+
+    def _close_stream(self) -> None:
+        self._writer.close()
+        self._writer = None
+        self._raw.flush()
+
+    def _recoverable(self, path: Path) -> bool:
+        with open(path, 'rb') as f:
+            f.seek(0, os.SEEK_END)
+            if f.tell() < 8:
+                return False
+            f.seek(-4, os.SEEK_END)
+            return f.read(4) == b'PAR1'
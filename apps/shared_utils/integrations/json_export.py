@@ -1,10 +1,9 @@
 """JSON export integration for local file storage."""
 import json
-import asyncio
 from pathlib import Path
 from typing import Dict, Any, List
-from datetime import datetime
 from .base import BaseIntegration, IntegrationConfig
+from .file_writer import RotatingFileWriter, compression_codec
 
 try:
     import structlog
@@ -18,119 +17,75 @@ class JSONExportIntegration(BaseIntegration):
     """
     JSON export integration for local file storage.
     
-    Writes events to JSON files (one event per line - JSONL format).
+    Writes events to JSON files (one event per line - JSONL format) through
+    one long-lived, buffered writer (see RotatingFileWriter).
     
     Configuration:
         - output_dir: Directory for JSON files (default: /var/log/wafer-monitor)
         - rotation: Rotation strategy (daily, hourly, none)
         - pretty_print: Pretty print JSON (default: False)
-        - compression: Enable gzip compression (default: False)
+        - compression: false, true/gzip or zstd (default: False)
+        - max_file_mb: Also rotate at this file size (default: 0, off)
+        - buffer_kb: Buffered data that triggers a write (default: 256)
+        - flush_interval_s: Longest time events stay buffered (default: 1.0)
+        - max_file_age_s: Also finalize a file this long after it was
+          opened (default: 3600 with rotation none, else 0, off)
+        - fsync: fsync after every write (default: False)
     """
     
+    # Queued events are coalesced into send_batch calls
+    DEFAULT_BATCHING = True
+    
     def __init__(self, config: IntegrationConfig):
         """Initialize JSON export integration."""
         super().__init__(config)
         self.output_dir = Path(self.get_config('output_dir', '/var/log/wafer-monitor'))
         self.rotation = self.get_config('rotation', 'daily')
         self.pretty_print = self.get_config('pretty_print', False)
-        self.compression = self.get_config('compression', False)
-        self._lock = asyncio.Lock()
+        self.compression = compression_codec(self.get_config('compression', False))
+        max_age = self.get_config('max_file_age_s')
+        self.writer = RotatingFileWriter(
+            self.output_dir,
+            'wafer_events',
+            '.jsonl',
+            rotation=self.rotation,
+            max_bytes=int(float(self.get_config('max_file_mb', 0)) * 1024 * 1024),
+            compression=self.compression,
+            buffer_bytes=int(self.get_config('buffer_kb', 256)) * 1024,
+            flush_interval_s=float(self.get_config('flush_interval_s', 1.0)),
+            fsync=bool(self.get_config('fsync', False)),
+            max_age_s=float(max_age) if max_age is not None else None
+        )
     
     async def initialize(self) -> None:
-        """Create output directory if it doesn't exist."""
-        self.output_dir.mkdir(parents=True, exist_ok=True)
+        """Create output directory, finalize leftover files and start flushing."""
+        await self.writer.start()
         self._initialized = True
         logger.info(
             "json_export_initialized",
             name=self.name,
             output_dir=str(self.output_dir),
-            rotation=self.rotation
+            rotation=self.rotation,
+            compression=self.compression
         )
     
-    def _get_json_filename(self) -> Path:
-        """Get current JSON filename based on rotation strategy."""
-        now = datetime.utcnow()
-        
-        if self.rotation == 'hourly':
-            suffix = now.strftime('%Y%m%d_%H')
-        elif self.rotation == 'daily':
-            suffix = now.strftime('%Y%m%d')
-        else:
-            suffix = 'events'
-        
-        ext = '.jsonl.gz' if self.compression else '.jsonl'
-        return self.output_dir / f'wafer_events_{suffix}{ext}'
+    def _encode(self, event: Dict[str, Any]) -> bytes:
+        return (json.dumps(event, indent=2 if self.pretty_print else None, default=str) + '\n').encode('utf-8')
     
     async def send_event(self, event: Dict[str, Any]) -> bool:
         """Append event to JSON file."""
-        try:
-            async with self._lock:
-                filename = self._get_json_filename()
-                
-                # Use thread executor for file I/O
-                await asyncio.get_event_loop().run_in_executor(
-                    None,
-                    self._write_json_sync,
-                    filename,
-                    event
-                )
-                
-                logger.debug("event_written_to_json", filename=filename.name)
-                return True
-        except Exception as e:
-            logger.error("json_write_failed", error=str(e))
-            return False
-    
-    def _write_json_sync(self, filename: Path, event: Dict[str, Any]) -> None:
-        """Synchronous JSON write."""
-        if self.compression:
-            import gzip
-            with gzip.open(filename, 'at', encoding='utf-8') as f:
-                json.dump(event, f, indent=2 if self.pretty_print else None)
-                f.write('\n')
-        else:
-            with open(filename, 'a', encoding='utf-8') as f:
-                json.dump(event, f, indent=2 if self.pretty_print else None)
-                f.write('\n')
+        return (await self.send_batch([event]))['failed'] == 0
     
     async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, int]:
         """Append batch of events to JSON file."""
         try:
-            async with self._lock:
-                filename = self._get_json_filename()
-                
-                # Use thread executor for file I/O
-                await asyncio.get_event_loop().run_in_executor(
-                    None,
-                    self._write_json_batch_sync,
-                    filename,
-                    events
-                )
-                
-                logger.info(
-                    "batch_written_to_json",
-                    filename=filename.name,
-                    count=len(events)
-                )
-                return {'success': len(events), 'failed': 0}
+            await self.writer.write_async([self._encode(e) for e in events])
+            logger.debug("batch_written_to_json", count=len(events))
+            return {'success': len(events), 'failed': 0}
         except Exception as e:
             logger.error("json_batch_write_failed", error=str(e))
             return {'success': 0, 'failed': len(events)}
     
-    def _write_json_batch_sync(self, filename: Path, events: List[Dict[str, Any]]) -> None:
-        """Synchronous JSON batch write."""
-        if self.compression:
-            import gzip
-            with gzip.open(filename, 'at', encoding='utf-8') as f:
-                for event in events:
-                    json.dump(event, f, indent=2 if self.pretty_print else None)
-                    f.write('\n')
-        else:
-            with open(filename, 'a', encoding='utf-8') as f:
-                for event in events:
-                    json.dump(event, f, indent=2 if self.pretty_print else None)
-                    f.write('\n')
-    
     async def health_check(self) -> Dict[str, Any]:
         """Check JSON export health."""
         try:
@@ -145,7 +100,8 @@ class JSONExportIntegration(BaseIntegration):
                 'backend': 'json_export',
                 'output_dir': str(self.output_dir),
                 'compression': self.compression,
-                'writable': True
+                'writable': True,
+                'writer': self.writer.stats()
             }
         except Exception as e:
             return {
@@ -157,6 +113,6 @@ class JSONExportIntegration(BaseIntegration):
             }
     
     async def close(self) -> None:
-        """Cleanup (nothing to close for JSON)."""
+        """Flush and finalize the active file."""
+        await self.writer.close_async()
         logger.info("json_export_closed", name=self.name)
-
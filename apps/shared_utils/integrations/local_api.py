@@ -2,6 +2,7 @@
 import httpx
 from typing import Dict, Any, List
 from .base import BaseIntegration, IntegrationConfig
+from ..wire import encode_batch, parse_format
 
 try:
     import structlog
@@ -18,11 +19,20 @@ class LocalAPIIntegration(BaseIntegration):
     This is the primary integration for the wafer monitoring system.
     """
     
+    # Primary store: make callers wait for room (then spool) rather than drop
+    DEFAULT_OVERFLOW = 'block'
+    
+    # Queued events are coalesced into /v1/ingest/events:batch requests
+    DEFAULT_BATCHING = True
+    
     def __init__(self, config: IntegrationConfig):
         """Initialize Local API integration."""
         super().__init__(config)
         self.base_url = self.get_config('base_url', 'http://localhost:18000')
         self.timeout = self.get_config('timeout', 5.0)
+        # Body format of batch requests: json, json+zstd, msgpack or msgpack+zstd
+        self.wire_format = self.get_config('wire_format', 'json')
+        parse_format(self.wire_format)
         self.client: httpx.AsyncClient = None
     
     async def initialize(self) -> None:
@@ -36,7 +46,8 @@ class LocalAPIIntegration(BaseIntegration):
         logger.info(
             "local_api_integration_initialized",
             name=self.name,
-            base_url=self.base_url
+            base_url=self.base_url,
+            wire_format=self.wire_format
         )
     
     async def send_event(self, event: Dict[str, Any]) -> bool:
@@ -54,26 +65,49 @@ class LocalAPIIntegration(BaseIntegration):
             )
             return False
     
-    async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, int]:
-        """Send batch of events to Local API."""
+    async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, Any]:
+        """
+        Send batch of events to Local API.
+        
+        Returns:
+            Counts of 'success', 'failed' and 'rejected' events. Only
+            transport errors, 5xx, 408 and 429 fail the batch; events the
+            Local API refuses (per-item 'rejected' results, or a 4xx for
+            the whole request) are counted as rejected, since redelivering
+            them cannot succeed.
+        """
         try:
-            r = await self.client.post('/v1/ingest/events:batch', json=events)
-            r.raise_for_status()
-            result = r.json()
-            
-            success = result.get('forwarded', len(events))
-            failed = len(events) - success
-            
-            logger.info(
-                "batch_sent_to_local_api",
-                total=len(events),
-                success=success,
-                failed=failed
-            )
-            return {'success': success, 'failed': failed}
+            content, headers = encode_batch(events, self.wire_format)
+            r = await self.client.post('/v1/ingest/events:batch', content=content, headers=headers)
         except Exception as e:
             logger.error("local_api_batch_failed", error=str(e), count=len(events))
-            return {'success': 0, 'failed': len(events)}
+            return {'success': 0, 'failed': len(events), 'rejected': 0}
+        
+        code = r.status_code
+        if code >= 500 or code in (408, 429):
+            logger.error("local_api_batch_failed", status_code=code, count=len(events))
+            return {'success': 0, 'failed': len(events), 'rejected': 0}
+        if code >= 400:
+            logger.warning("local_api_batch_rejected", status_code=code, count=len(events), error=r.text[:500])
+            return {'success': 0, 'failed': 0, 'rejected': len(events)}
+        
+        # Local API lists per-item results; the sidecar only reports counts
+        results = r.json().get('results', [])
+        rejected = sum(1 for item in results if item.get('status') == 'rejected')
+        success = len(events) - rejected
+        logger.info(
+            "batch_sent_to_local_api",
+            total=len(events),
+            success=success,
+            rejected=rejected
+        )
+        if rejected:
+            logger.warning(
+                "local_api_events_rejected",
+                count=rejected,
+                error=next(item.get('error') for item in results if item.get('status') == 'rejected')
+            )
+        return {'success': success, 'failed': 0, 'rejected': rejected}
     
     async def health_check(self) -> Dict[str, Any]:
         """Check Local API health."""
@@ -0,0 +1,125 @@
+"""Circuit breaker and latency-adaptive batch sizing for integration backends."""
+import time
+from typing import Any, Dict
+
+
+class CircuitOpenError(RuntimeError):
+    """Raised when a delivery is refused because the backend's breaker is open."""
+
+
+class CircuitBreaker:
+    """
+    Closed / open / half-open circuit breaker.
+
+    After `failure_threshold` consecutive failures the breaker opens and
+    refuses deliveries for `reset_timeout_s`. It then lets up to
+    `half_open_max` probe deliveries through: a successful probe closes it,
+    a failed one re-opens it with the timeout doubled (up to
+    `max_reset_timeout_s`).
+    """
+
+    def __init__(
+        self,
+        failure_threshold: int = 5,
+        reset_timeout_s: float = 30.0,
+        half_open_max: int = 1,
+        max_reset_timeout_s: float = 300.0
+    ):
+        """
+        Args:
+            failure_threshold: Consecutive failures that open the breaker
+            reset_timeout_s: Time the breaker stays open before probing
+            half_open_max: Concurrent probes while half-open
+            max_reset_timeout_s: Upper bound for the backed-off timeout
+        """
+        self.failure_threshold = max(1, failure_threshold)
+        self.reset_timeout_s = reset_timeout_s
+        self.half_open_max = max(1, half_open_max)
+        self.max_reset_timeout_s = max(reset_timeout_s, max_reset_timeout_s)
+        self.state = 'closed'
+        self._failures = 0
+        self._timeout_s = reset_timeout_s
+        self._opened_at = 0.0
+        self._probes = 0
+        self.opened = 0
+
+    @property
+    def accepting(self) -> bool:
+        """False while open and not yet due for a probe."""
+        return self.state != 'open' or time.monotonic() - self._opened_at >= self._timeout_s
+
+    def allow(self) -> bool:
+        """Ask to make one delivery; every True must be followed by record()."""
+        if self.state == 'closed':
+            return True
+        if self.state == 'open':
+            if time.monotonic() - self._opened_at < self._timeout_s:
+                return False
+            self.state = 'half_open'
+            self._probes = 0
+        if self._probes >= self.half_open_max:
+            return False
+        self._probes += 1
+        return True
+
+    def record(self, ok: bool) -> None:
+        """Report the outcome of an allowed delivery."""
+        if self.state == 'half_open':
+            self._probes = max(0, self._probes - 1)
+            if ok:
+                self._close()
+            else:
+                self._open(min(self.max_reset_timeout_s, self._timeout_s * 2))
+            return
+        if ok:
+            self._failures = 0
+            return
+        self._failures += 1
+        if self.state == 'closed' and self._failures >= self.failure_threshold:
+            self._open(self.reset_timeout_s)
+
+    def _open(self, timeout_s: float) -> None:
+        self.state = 'open'
+        self._timeout_s = timeout_s
+        self._opened_at = time.monotonic()
+        self.opened += 1
+
+    def _close(self) -> None:
+        self.state = 'closed'
+        self._failures = 0
+        self._timeout_s = self.reset_timeout_s
+
+    def stats(self) -> Dict[str, Any]:
+        return {
+            'state': self.state,
+            'consecutive_failures': self._failures,
+            'reset_timeout_s': self._timeout_s,
+            'opened': self.opened,
+        }
+
+
+class AdaptiveBatchSize:
+    """
+    Batch size tuned to backend latency (AIMD).
+
+    A full batch that completes within `target_latency_s` grows the size by
+    a quarter; a slow batch shrinks it to 70% and a failed one halves it,
+    always within [min_size, max_size].
+    """
+
+    def __init__(self, min_size: int = 1, max_size: int = 500, target_latency_s: float = 0.5):
+        self.min_size = max(1, min_size)
+        self.max_size = max(self.min_size, max_size)
+        self.target_latency_s = target_latency_s
+        self.current = self.min_size
+        self.last_latency_s = 0.0
+
+    def observe(self, size: int, latency_s: float, ok: bool) -> None:
+        """Adjust after a delivery of `size` events."""
+        self.last_latency_s = latency_s
+        if not ok:
+            self.current = max(self.min_size, self.current // 2)
+        elif latency_s > self.target_latency_s:
+            self.current = max(self.min_size, int(self.current * 0.7))
+        elif size >= self.current:
+            self.current = min(self.max_size, self.current + max(1, self.current // 4))
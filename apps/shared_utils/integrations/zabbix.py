@@ -1,7 +1,12 @@
 """Zabbix integration for monitoring."""
-import httpx
+import asyncio
 import json
-from typing import Dict, Any, List
+import re
+import struct
+import time
+import zlib
+from typing import Dict, Any, Iterable, List, Optional, Tuple
+from urllib.parse import urlsplit
 from datetime import datetime
 from .base import BaseIntegration, IntegrationConfig
 
@@ -12,39 +17,238 @@ except ImportError:
     import logging
     logger = logging.getLogger(__name__)  # type: ignore
 
+# Zabbix protocol header: "ZBXD", flags, data length, reserved (uncompressed length)
+ZBX_HEADER = struct.Struct('<4sBII')
+ZBX_FLAG_STANDARD = 0x01
+ZBX_FLAG_COMPRESSED = 0x02
+# Largest response accepted from the server
+ZBX_MAX_RESPONSE_BYTES = 16 * 1024 * 1024
+# zabbix_sender sends at most 250 values per request
+ZBX_MAX_ITEMS = 250
+INFO_RE = re.compile(r'processed:\s*(\d+);\s*failed:\s*(\d+);\s*total:\s*(\d+)')
+
+
+def pack(payload: Dict[str, Any], compress: bool = False) -> bytes:
+    """Frame a JSON payload with the Zabbix protocol header."""
+    data = json.dumps(payload, default=str).encode('utf-8')
+    if compress:
+        body = zlib.compress(data)
+        return ZBX_HEADER.pack(b'ZBXD', ZBX_FLAG_STANDARD | ZBX_FLAG_COMPRESSED, len(body), len(data)) + body
+    return ZBX_HEADER.pack(b'ZBXD', ZBX_FLAG_STANDARD, len(data), 0) + data
+
+
+async def read_packet(reader: asyncio.StreamReader) -> Dict[str, Any]:
+    """
+    Read one framed JSON packet.
+    
+    Raises:
+        ConnectionError: If the peer closed the connection without answering
+        ValueError: On a truncated, malformed or oversized packet
+    """
+    try:
+        header = await reader.readexactly(ZBX_HEADER.size)
+    except asyncio.IncompleteReadError as e:
+        if e.partial:
+            raise ValueError(f"truncated Zabbix header: {e.partial!r}") from e
+        raise ConnectionError("connection closed without a response") from e
+    magic, flags, length, reserved = ZBX_HEADER.unpack(header)
+    if magic != b'ZBXD' or not flags & ZBX_FLAG_STANDARD:
+        raise ValueError(f"not a Zabbix packet: {header!r}")
+    if length > ZBX_MAX_RESPONSE_BYTES:
+        raise ValueError(f"Zabbix packet too large: {length} bytes")
+    data = await reader.readexactly(length)
+    if flags & ZBX_FLAG_COMPRESSED:
+        data = zlib.decompress(data)
+    return json.loads(data)
+
+
+def parse_info(response: Dict[str, Any]) -> Tuple[int, int, int]:
+    """(processed, failed, total) of a sender data response."""
+    if response.get('response') != 'success':
+        raise ValueError(f"Zabbix server refused data: {response.get('info') or response}")
+    m = INFO_RE.search(response.get('info', ''))
+    if not m:
+        raise ValueError(f"unexpected Zabbix response: {response}")
+    return int(m.group(1)), int(m.group(2)), int(m.group(3))
+
+
+class ZabbixSender:
+    """
+    Zabbix sender protocol client (`sender data` requests to a trapper).
+    
+    Up to `max_connections` requests run at once, each on its own TCP
+    connection. Idle connections are kept and reused while the peer keeps
+    them open; Zabbix server itself closes a trapper connection after each
+    response, in which case the next request connects again. A request on
+    a reused connection that the peer closed before answering is resent
+    once on a fresh connection (the server had not read it).
+    """
+    
+    def __init__(
+        self,
+        host: str,
+        port: int = 10051,
+        timeout_s: float = 10.0,
+        max_connections: int = 2,
+        compress: bool = False
+    ):
+        """
+        Args:
+            host: Zabbix server or proxy host
+            port: Trapper port
+            timeout_s: Connect and response timeout
+            max_connections: Requests in flight at once
+            compress: Send zlib-compressed packets (Zabbix 4.0+)
+        """
+        self.host = host
+        self.port = port
+        self.timeout_s = timeout_s
+        self.compress = compress
+        self._slots = asyncio.Semaphore(max(1, max_connections))
+        self._idle: List[Tuple[asyncio.StreamReader, asyncio.StreamWriter]] = []
+        self.connects = 0
+        self.requests = 0
+    
+    async def _connect(self) -> Tuple[asyncio.StreamReader, asyncio.StreamWriter]:
+        self.connects += 1
+        return await asyncio.wait_for(asyncio.open_connection(self.host, self.port), self.timeout_s)
+    
+    def _release(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        if reader.at_eof() or writer.is_closing():
+            writer.close()
+        else:
+            self._idle.append((reader, writer))
+    
+    async def _exchange(self, reader, writer, packet: bytes) -> Dict[str, Any]:
+        writer.write(packet)
+        await writer.drain()
+        return await asyncio.wait_for(read_packet(reader), self.timeout_s)
+    
+    async def request(self, payload: Dict[str, Any]) -> Dict[str, Any]:
+        """Send one request and return the server's response."""
+        packet = pack(payload, self.compress)
+        async with self._slots:
+            self.requests += 1
+            reused = bool(self._idle)
+            reader, writer = self._idle.pop() if reused else await self._connect()
+            try:
+                try:
+                    response = await self._exchange(reader, writer, packet)
+                except (ConnectionError, OSError):
+                    if not reused:
+                        raise
+                    writer.close()
+                    reader, writer = await self._connect()
+                    response = await self._exchange(reader, writer, packet)
+            except BaseException:
+                writer.close()
+                raise
+            self._release(reader, writer)
+            return response
+    
+    async def send(self, items: List[Dict[str, Any]]) -> Tuple[int, int]:
+        """
+        Send trapper values in one request.
+        
+        Returns:
+            (processed, failed) as reported by the server
+        """
+        now = time.time()
+        processed, failed, _ = parse_info(await self.request({
+            'request': 'sender data',
+            'data': items,
+            'clock': int(now),
+            'ns': int((now % 1) * 1e9)
+        }))
+        return processed, failed
+    
+    async def probe(self) -> None:
+        """Open and close a connection."""
+        _, writer = await self._connect()
+        writer.close()
+    
+    async def close(self) -> None:
+        while self._idle:
+            _, writer = self._idle.pop()
+            writer.close()
+
 
 class ZabbixIntegration(BaseIntegration):
     """
     Integration with Zabbix monitoring system.
     
-    Sends events as Zabbix trapper items.
+    Sends events as Zabbix trapper items with the native sender protocol
+    (see ZabbixSender), at most `max_items_per_request` values per request.
+    
+    With `lld` enabled, item keys take the form
+    `wafer.event[<entity type>,<event kind>]` and every new combination is
+    registered through the `lld_key` discovery rule (macros `{#ENTITY_TYPE}`
+    and `{#EVENT_KIND}`), so the host's item prototype
+    `wafer.event[{#ENTITY_TYPE},{#EVENT_KIND}]` creates the items. The full
+    set is re-sent every `lld_interval_s` to keep discovered items alive.
+    
+    The server creates discovered items a while after the discovery value
+    arrives, and refuses their values until then. For `lld_delay_s` after
+    a key first appears its values are sent in requests of their own, and a refused request is reported as
+    'deferred' so the events are redelivered later instead of being
+    rejected.
     
     Configuration:
-        - zabbix_server: Zabbix server URL (e.g., http://zabbix:10051)
+        - zabbix_server: Zabbix server or proxy, as host, host:port or URL
+          (e.g., zabbix:10051; the port defaults to 10051)
         - host: Zabbix host name
-        - auth_token: Optional authentication token
+        - auth_token: Unused by the trapper protocol (kept for compatibility)
+        - max_items_per_request: Values per request (default: 250)
+        - max_connections: Requests in flight at once (default: 2)
+        - compression: zlib-compress requests, Zabbix 4.0+ (default: False)
+        - timeout_s: Connect and response timeout (default: 10)
+        - lld: Register item keys through low-level discovery (default: False)
+        - lld_key: Discovery rule key (default: wafer.discovery)
+        - lld_interval_s: Re-send interval of the discovery data (default: 3600)
+        - lld_delay_s: How long refused values of a newly discovered key are
+          redelivered rather than rejected (default: 120)
     """
     
+    # Queued events are coalesced into send_batch calls
+    DEFAULT_BATCHING = True
+    
     def __init__(self, config: IntegrationConfig):
         """Initialize Zabbix integration."""
         super().__init__(config)
-        self.zabbix_server = self.get_config('zabbix_server', 'http://localhost:10051')
+        self.zabbix_server = self.get_config('zabbix_server', 'localhost:10051')
         self.host = self.get_config('host', 'wafer-monitor')
         self.auth_token = self.get_config('auth_token')
-        self.client: httpx.AsyncClient = None
+        self.max_items = max(1, int(self.get_config('max_items_per_request', ZBX_MAX_ITEMS)))
+        self.lld = bool(self.get_config('lld', False))
+        self.lld_key = self.get_config('lld_key', 'wafer.discovery')
+        self.lld_interval_s = float(self.get_config('lld_interval_s', 3600))
+        self.lld_delay_s = float(self.get_config('lld_delay_s', 120))
+        # (entity type, event kind) combinations the server accepted discovery for
+        self._discovered: set = set()
+        # Monotonic time each combination was first seen, for lld_delay_s
+        self._first_seen: Dict[Tuple[str, str], float] = {}
+        self._lld_sent_at = 0.0
+        self._lld_lock = asyncio.Lock()
+        
+        server = self.zabbix_server if '://' in self.zabbix_server else f'tcp://{self.zabbix_server}'
+        address = urlsplit(server)
+        self.sender = ZabbixSender(
+            address.hostname or 'localhost',
+            address.port or 10051,
+            timeout_s=float(self.get_config('timeout_s', 10.0)),
+            max_connections=int(self.get_config('max_connections', 2)),
+            compress=bool(self.get_config('compression', False))
+        )
     
     async def initialize(self) -> None:
-        """Initialize Zabbix client."""
-        self.client = httpx.AsyncClient(
-            timeout=10.0,
-            headers={'Content-Type': 'application/json'}
-        )
+        """Initialize Zabbix client (connections are opened on demand)."""
         self._initialized = True
         logger.info(
             "zabbix_integration_initialized",
             name=self.name,
-            server=self.zabbix_server,
-            host=self.host
+            server=f'{self.sender.host}:{self.sender.port}',
+            host=self.host,
+            lld=self.lld
         )
     
     def _event_to_zabbix_item(self, event: Dict[str, Any]) -> Dict[str, Any]:
@@ -64,10 +268,14 @@ class ZabbixIntegration(BaseIntegration):
         # Create Zabbix item key
         entity_type = entity.get('type', 'unknown')
         event_kind = event_data.get('kind', 'unknown')
-        key = f"wafer.{entity_type}.{event_kind}"
+        if self.lld:
+            key = f"wafer.event[{entity_type},{event_kind}]"
+        else:
+            key = f"wafer.{entity_type}.{event_kind}"
         
-        # Prepare value (use duration_s if available, otherwise 1)
-        value = metrics.get('duration_s', 1)
+        # Prepare value (use duration_s if available, otherwise 1); the
+        # protocol carries values as strings
+        value = str(metrics.get('duration_s', 1))
         
         # Timestamp
         timestamp = int(datetime.fromisoformat(
@@ -82,83 +290,124 @@ class ZabbixIntegration(BaseIntegration):
             'ns': 0
         }
     
+    @staticmethod
+    def _combo(event: Dict[str, Any]) -> Tuple[str, str]:
+        return (event.get('entity', {}).get('type', 'unknown'), event.get('event', {}).get('kind', 'unknown'))
+    
+    def _discovery_item(self, combos: Iterable[Tuple[str, str]]) -> Dict[str, Any]:
+        rows = [{'{#ENTITY_TYPE}': t, '{#EVENT_KIND}': k} for t, k in sorted(combos)]
+        return {
+            'host': self.host,
+            'key': self.lld_key,
+            'value': json.dumps({'data': rows}),
+            'clock': int(time.time()),
+            'ns': 0
+        }
+    
+    async def _register(self, events: List[Dict[str, Any]]) -> None:
+        """Send discovery data when new item keys appear or it is due again."""
+        combos = {self._combo(e) for e in events}
+        async with self._lld_lock:
+            now = time.monotonic()
+            for combo in combos:
+                self._first_seen.setdefault(combo, now)
+            due = now - self._lld_sent_at >= self.lld_interval_s
+            if combos <= self._discovered and not due:
+                return
+            processed, failed = await self.sender.send([self._discovery_item(self._discovered | combos)])
+            if failed:
+                # Not recorded: the next batch with these keys tries again
+                logger.warning("zabbix_discovery_rejected", key=self.lld_key, host=self.host)
+                return
+            self._discovered |= combos
+            self._lld_sent_at = time.monotonic()
+            logger.info("zabbix_discovery_sent", key=self.lld_key, items=len(self._discovered))
+    
+    def _is_new(self, combo: Tuple[str, str], now: float) -> bool:
+        """True while the server may not have created the item for `combo` yet."""
+        first_seen = self._first_seen.get(combo)
+        return first_seen is not None and now - first_seen < self.lld_delay_s
+    
     async def send_event(self, event: Dict[str, Any]) -> bool:
         """Send event to Zabbix as trapper item."""
-        try:
-            item = self._event_to_zabbix_item(event)
-            
-            # Zabbix sender protocol
-            payload = {
-                'request': 'sender data',
-                'data': [item]
-            }
-            
-            # Send to Zabbix trapper
-            r = await self.client.post(
-                f"{self.zabbix_server}/zabbix_sender",
-                json=payload
-            )
-            
-            if r.status_code == 200:
-                logger.debug("event_sent_to_zabbix", key=item['key'])
-                return True
-            else:
-                logger.warning(
-                    "zabbix_send_non_200",
-                    status_code=r.status_code,
-                    response=r.text
-                )
-                return False
-        except Exception as e:
-            logger.error("zabbix_send_failed", error=str(e))
-            return False
+        return (await self.send_batch([event]))['failed'] == 0
     
-    async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, int]:
-        """Send batch of events to Zabbix."""
+    async def send_batch(self, events: List[Dict[str, Any]]) -> Dict[str, Any]:
+        """
+        Send batch of events to Zabbix.
+        
+        Values the server does not accept (unknown host or key, wrong item
+        type) are counted as 'rejected': redelivering them cannot succeed.
+        Only requests that fail in transport count as failed, except for
+        refused values of newly discovered keys, which are deferred: they
+        are sent per key, and a refused key's events are returned in
+        'failed_indices' for redelivery.
+        """
         items = [self._event_to_zabbix_item(e) for e in events]
         
         try:
-            payload = {
-                'request': 'sender data',
-                'data': items
-            }
+            # (positions in `items`, values of one newly discovered key)
+            groups: List[Tuple[List[int], bool]] = []
+            settled = list(range(len(items)))
+            if self.lld:
+                await self._register(events)
+                now = time.monotonic()
+                new: Dict[Tuple[str, str], List[int]] = {}
+                settled = []
+                for i, event in enumerate(events):
+                    combo = self._combo(event)
+                    if self._is_new(combo, now):
+                        new.setdefault(combo, []).append(i)
+                    else:
+                        settled.append(i)
+                for positions in new.values():
+                    groups.extend((positions[i:i + self.max_items], True) for i in range(0, len(positions), self.max_items))
+            groups.extend((settled[i:i + self.max_items], False) for i in range(0, len(settled), self.max_items))
             
-            r = await self.client.post(
-                f"{self.zabbix_server}/zabbix_sender",
-                json=payload
-            )
+            results = await asyncio.gather(*(self.sender.send([items[i] for i in g]) for g, _ in groups))
+            processed = rejected = 0
+            deferred: List[int] = []
+            for (positions, is_new), (p, f) in zip(groups, results):
+                if is_new and f == len(positions):
+                    deferred.extend(positions)
+                    continue
+                processed += p
+                rejected += f
             
-            if r.status_code == 200:
-                result = r.json()
-                processed = result.get('processed', len(items))
-                failed = result.get('failed', 0)
-                
-                logger.info(
-                    "batch_sent_to_zabbix",
-                    total=len(items),
-                    processed=processed,
-                    failed=failed
-                )
-                return {'success': processed, 'failed': failed}
-            else:
-                logger.error("zabbix_batch_failed", status_code=r.status_code)
-                return {'success': 0, 'failed': len(items)}
+            logger.info(
+                "batch_sent_to_zabbix",
+                total=len(items),
+                processed=processed,
+                failed=rejected,
+                deferred=len(deferred)
+            )
+            if rejected:
+                logger.warning("zabbix_values_rejected", count=rejected, host=self.host)
+            if deferred:
+                logger.info("zabbix_values_deferred", count=len(deferred), host=self.host)
+                return {
+                    'success': processed, 'failed': len(deferred), 'rejected': rejected,
+                    'failed_indices': sorted(deferred), 'deferred': len(deferred)
+                }
+            return {'success': processed, 'failed': 0, 'rejected': rejected}
         except Exception as e:
-            logger.error("zabbix_batch_error", error=str(e))
+            logger.error("zabbix_batch_error", error=str(e), error_type=type(e).__name__)
             return {'success': 0, 'failed': len(items)}
     
     async def health_check(self) -> Dict[str, Any]:
         """Check Zabbix connectivity."""
         try:
-            # Try to ping Zabbix API
-            r = await self.client.get(f"{self.zabbix_server}/api_jsonrpc.php", timeout=3.0)
+            # Trapper port accepts connections
+            await self.sender.probe()
             
             return {
-                'status': 'healthy' if r.status_code < 500 else 'degraded',
+                'status': 'healthy',
                 'integration': self.name,
                 'backend': 'zabbix',
-                'server': self.zabbix_server,
-                'host': self.host
+                'server': f'{self.sender.host}:{self.sender.port}',
+                'host': self.host,
+                'connects': self.sender.connects,
+                'requests': self.sender.requests
             }
         except Exception as e:
             return {
@@ -169,8 +418,6 @@ class ZabbixIntegration(BaseIntegration):
             }
     
     async def close(self) -> None:
-        """Close Zabbix client."""
-        if self.client:
-            await self.client.aclose()
+        """Close Zabbix connections."""
+        await self.sender.close()
         logger.info("zabbix_integration_closed", name=self.name)
-
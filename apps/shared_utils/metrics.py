@@ -1,22 +1,110 @@
 """Prometheus metrics collection."""
+import glob
+import os
 import time
-from typing import Dict, Optional
+from typing import Any, Dict, Optional, Tuple
 from prometheus_client import Counter, Histogram, Gauge, CollectorRegistry, generate_latest, CONTENT_TYPE_LATEST
+from prometheus_client import multiprocess, values
+from prometheus_client.openmetrics import exposition as openmetrics
+
+# Directory of the per-process metric files in multiprocess mode (read by prometheus_client)
+MULTIPROC_DIR_ENV = 'PROMETHEUS_MULTIPROC_DIR'
+
+# Buckets for sub-request stages: 50us .. 2.5s
+STAGE_BUCKETS = (
+    0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01,
+    0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5
+)
+
+
+def route_template(request: Any) -> str:
+    """
+    Endpoint label for a request: the matched route's path template
+    (e.g. '/v1/jobs/{job_id}'), so path parameters do not create new
+    label values. Requests that matched no route share one label.
+    """
+    route = request.scope.get('route')
+    return getattr(route, 'path', None) or 'unmatched'
+
+
+def current_trace_id() -> Optional[str]:
+    """Hex trace id of the current, sampled OpenTelemetry span (None without one)."""
+    try:
+        from opentelemetry import trace
+    except ImportError:
+        return None
+    ctx = trace.get_current_span().get_span_context()
+    if not ctx.is_valid or not ctx.trace_flags.sampled:
+        return None
+    return format(ctx.trace_id, '032x')
+
+
+class StageTimer:
+    """
+    Times consecutive stages of one request into a stage histogram.
+    
+    Each `mark(stage)` observes the time since the previous mark (or since
+    creation) under that stage, so the stages add up to the request
+    without overlapping. Children are pre-bound by the collector, so a
+    mark costs one perf_counter() call and one observation; the trace id
+    of the request, if sampled, is attached as exemplar.
+    """
+    
+    __slots__ = ('_collector', '_path', '_last', '_exemplar')
+    
+    def __init__(self, collector: 'MetricsCollector', path: str):
+        self._collector = collector
+        self._path = path
+        trace_id = current_trace_id()
+        self._exemplar = {'trace_id': trace_id} if trace_id else None
+        self._last = time.perf_counter()
+    
+    def mark(self, stage: str) -> None:
+        now = time.perf_counter()
+        child = self._collector.bound(self._collector.ingest_stage_duration_seconds, self._path, stage)
+        if self._exemplar is None:
+            child.observe(now - self._last)
+        else:
+            child.observe(now - self._last, exemplar=self._exemplar)
+        self._last = now
+
+
+class NullStageTimer:
+    """StageTimer stand-in for code paths that are not timed."""
+    
+    __slots__ = ()
+    
+    def mark(self, stage: str) -> None:
+        pass
+
+
+NULL_STAGE_TIMER = NullStageTimer()
 
 
 class MetricsCollector:
     """Centralized metrics collector using Prometheus client."""
     
-    def __init__(self, service_name: str, registry: Optional[CollectorRegistry] = None):
+    def __init__(
+        self,
+        service_name: str,
+        registry: Optional[CollectorRegistry] = None,
+        multiprocess_dir: Optional[str] = None
+    ):
         """
         Initialize metrics collector.
         
         Args:
             service_name: Name of the service for metrics labeling
             registry: Optional custom registry (defaults to default registry)
+            multiprocess_dir: Metric files shared by several worker processes;
+                when set, `get_metrics` reports the sum over all of them
+                (see enable_multiprocess)
         """
         self.service_name = service_name
         self.registry = registry or CollectorRegistry()
+        self.multiprocess_dir = multiprocess_dir
+        # Label children by (metric, label values); see bound()
+        self._children: Dict[Tuple[int, Tuple[str, ...]], Any] = {}
         
         # HTTP request metrics
         self.http_requests_total = Counter(
@@ -33,6 +121,15 @@ class MetricsCollector:
             registry=self.registry
         )
         
+        # Stages of the ingest hot path (see StageTimer)
+        self.ingest_stage_duration_seconds = Histogram(
+            'ingest_stage_duration_seconds',
+            'Time spent in each stage of event ingestion',
+            ['path', 'stage'],
+            buckets=STAGE_BUCKETS,
+            registry=self.registry
+        )
+        
         # Database metrics
         self.db_operations_total = Counter(
             'db_operations_total',
@@ -51,12 +148,14 @@ class MetricsCollector:
         self.db_pool_size = Gauge(
             'db_pool_size',
             'Current database connection pool size',
+            multiprocess_mode='livesum',
             registry=self.registry
         )
         
         self.db_pool_available = Gauge(
             'db_pool_available',
             'Available database connections',
+            multiprocess_mode='livesum',
             registry=self.registry
         )
         
@@ -68,9 +167,57 @@ class MetricsCollector:
             registry=self.registry
         )
         
+        self.ingest_duplicates_total = Counter(
+            'ingest_duplicates_total',
+            'Events dropped as duplicates of an already accepted idempotency key',
+            ['stage'],
+            registry=self.registry
+        )
+        
         self.events_in_spool = Gauge(
             'events_in_spool',
             'Number of events in spool directory',
+            multiprocess_mode='liveall',
+            registry=self.registry
+        )
+        
+        # In-process cache metrics
+        self.cache_lookups_total = Counter(
+            'cache_lookups_total',
+            'In-process cache lookups',
+            ['cache', 'result'],
+            registry=self.registry
+        )
+        
+        self.cache_entries = Gauge(
+            'cache_entries',
+            'Number of entries held by an in-process cache',
+            ['cache'],
+            multiprocess_mode='liveall',
+            registry=self.registry
+        )
+        
+        # Integration dispatch queue metrics
+        self.integration_queue_depth = Gauge(
+            'integration_queue_depth',
+            'Events waiting in an integration dispatch queue',
+            ['integration'],
+            multiprocess_mode='liveall',
+            registry=self.registry
+        )
+        
+        self.integration_queue_lag_seconds = Gauge(
+            'integration_queue_lag_seconds',
+            'Age of the oldest event waiting in an integration dispatch queue',
+            ['integration'],
+            multiprocess_mode='liveall',
+            registry=self.registry
+        )
+        
+        self.integration_events_total = Counter(
+            'integration_events_total',
+            'Events handled by integration dispatch queues',
+            ['integration', 'outcome'],
             registry=self.registry
         )
         
@@ -94,28 +241,58 @@ class MetricsCollector:
         self.system_cpu_usage = Gauge(
             'system_cpu_usage',
             'System CPU usage percentage',
+            multiprocess_mode='liveall',
             registry=self.registry
         )
         
         self.system_memory_usage_bytes = Gauge(
             'system_memory_usage_bytes',
             'System memory usage in bytes',
+            multiprocess_mode='liveall',
             registry=self.registry
         )
     
+    def bound(self, metric: Any, *label_values: str) -> Any:
+        """
+        Label child of `metric` for positional label values, created once.
+        
+        `labels()` validates and locks on every call; hot paths look the
+        child up here instead. Callers must keep label values bounded
+        (route templates, not raw paths).
+        """
+        key = (id(metric), label_values)
+        child = self._children.get(key)
+        if child is None:
+            child = self._children[key] = metric.labels(*label_values)
+        return child
+    
+    def stage_timer(self, path: str) -> StageTimer:
+        """Start timing the stages of one request on `path` (e.g. 'single', 'batch')."""
+        return StageTimer(self, path)
+    
     def record_http_request(self, method: str, endpoint: str, status: int, duration: float) -> None:
-        """Record HTTP request metrics."""
-        self.http_requests_total.labels(method=method, endpoint=endpoint, status=str(status)).inc()
-        self.http_request_duration_seconds.labels(method=method, endpoint=endpoint).observe(duration)
+        """Record HTTP request metrics; `endpoint` should be a route template."""
+        self.bound(self.http_requests_total, method, endpoint, str(status)).inc()
+        trace_id = current_trace_id()
+        child = self.bound(self.http_request_duration_seconds, method, endpoint)
+        if trace_id is None:
+            child.observe(duration)
+        else:
+            child.observe(duration, exemplar={'trace_id': trace_id})
     
     def record_db_operation(self, operation: str, table: str, status: str, duration: float) -> None:
         """Record database operation metrics."""
-        self.db_operations_total.labels(operation=operation, table=table, status=status).inc()
-        self.db_operation_duration_seconds.labels(operation=operation, table=table).observe(duration)
+        self.bound(self.db_operations_total, operation, table, status).inc()
+        self.bound(self.db_operation_duration_seconds, operation, table).observe(duration)
     
-    def record_event_processed(self, event_type: str, status: str) -> None:
+    def record_event_processed(self, event_type: str, status: str, count: int = 1) -> None:
         """Record event processing metrics."""
-        self.events_processed_total.labels(event_type=event_type, status=status).inc()
+        self.events_processed_total.labels(event_type=event_type, status=status).inc(count)
+    
+    def record_duplicates(self, stage: str, count: int = 1) -> None:
+        """Record duplicates dropped by the in-process 'filter' or found by the 'database'."""
+        if count:
+            self.bound(self.ingest_duplicates_total, stage).inc(count)
     
     def record_job(self, app_name: str, status: str, duration: Optional[float] = None) -> None:
         """Record job metrics."""
@@ -123,6 +300,23 @@ class MetricsCollector:
         if duration is not None:
             self.job_duration_seconds.labels(app_name=app_name).observe(duration)
     
+    def record_cache_lookup(self, cache: str, hit: bool) -> None:
+        """Record an in-process cache hit or miss."""
+        self.cache_lookups_total.labels(cache=cache, result='hit' if hit else 'miss').inc()
+    
+    def update_cache_size(self, cache: str, size: int) -> None:
+        """Update the entry count of an in-process cache."""
+        self.cache_entries.labels(cache=cache).set(size)
+    
+    def record_integration_events(self, integration: str, outcome: str, count: int = 1) -> None:
+        """Record delivered/failed/dropped/rejected events of an integration queue."""
+        self.integration_events_total.labels(integration=integration, outcome=outcome).inc(count)
+    
+    def update_integration_queue(self, integration: str, depth: int, lag_s: float) -> None:
+        """Update the depth and lag of an integration queue."""
+        self.integration_queue_depth.labels(integration=integration).set(depth)
+        self.integration_queue_lag_seconds.labels(integration=integration).set(lag_s)
+    
     def update_pool_metrics(self, size: int, available: int) -> None:
         """Update database pool metrics."""
         self.db_pool_size.set(size)
@@ -132,12 +326,30 @@ class MetricsCollector:
         """Update spool directory count."""
         self.events_in_spool.set(count)
     
-    def get_metrics(self) -> bytes:
-        """Get metrics in Prometheus format."""
-        return generate_latest(self.registry)
+    @staticmethod
+    def _openmetrics(accept: Optional[str]) -> bool:
+        return bool(accept) and 'application/openmetrics-text' in accept
     
-    def get_content_type(self) -> str:
+    def get_metrics(self, accept: Optional[str] = None) -> bytes:
+        """
+        Get metrics in Prometheus format, or in OpenMetrics format (which
+        carries exemplars) when the scraper's Accept header asks for it.
+        
+        In multiprocess mode the values are aggregated over every worker's
+        files; prometheus_client keeps no exemplars there.
+        """
+        registry = self.registry
+        if self.multiprocess_dir:
+            registry = CollectorRegistry()
+            multiprocess.MultiProcessCollector(registry, path=self.multiprocess_dir)
+        if self._openmetrics(accept):
+            return openmetrics.generate_latest(registry)
+        return generate_latest(registry)
+    
+    def get_content_type(self, accept: Optional[str] = None) -> str:
         """Get content type for metrics endpoint."""
+        if self._openmetrics(accept):
+            return openmetrics.CONTENT_TYPE_LATEST
         return CONTENT_TYPE_LATEST
 
 
@@ -154,3 +366,52 @@ def get_metrics_collector(service_name: str | None = None) -> MetricsCollector:
         _metrics_collector = MetricsCollector(service_name)
     return _metrics_collector
 
+
+
+def prepare_multiprocess_dir(path: Optional[str] = None) -> str:
+    """
+    Create (or empty) the metric file directory before worker processes fork.
+    
+    Files left by an earlier run would otherwise be summed into this one.
+    The directory is exported as PROMETHEUS_MULTIPROC_DIR so the workers
+    inherit it.
+    
+    Args:
+        path: Directory to use (default: PROMETHEUS_MULTIPROC_DIR, or a new
+            temporary directory)
+    
+    Returns:
+        The directory
+    """
+    path = path or os.environ.get(MULTIPROC_DIR_ENV)
+    if path:
+        os.makedirs(path, exist_ok=True)
+        for name in glob.glob(os.path.join(path, '*.db')):
+            os.remove(name)
+    else:
+        import tempfile
+        path = tempfile.mkdtemp(prefix='metrics-')
+    os.environ[MULTIPROC_DIR_ENV] = path
+    return path
+
+
+def enable_multiprocess() -> MetricsCollector:
+    """
+    Switch this (forked) worker process to multiprocess metrics.
+    
+    Values are written to per-process files in PROMETHEUS_MULTIPROC_DIR, so
+    any worker's `/metrics` reports the whole service. The global collector
+    is recreated on that storage; callers holding the old one must replace
+    it with the return value.
+    """
+    global _metrics_collector
+    values.ValueClass = values.MultiProcessValue()
+    service_name = _metrics_collector.service_name if _metrics_collector else 'service'
+    _metrics_collector = MetricsCollector(service_name, multiprocess_dir=os.environ[MULTIPROC_DIR_ENV])
+    return _metrics_collector
+
+
+def mark_process_dead(pid: int) -> None:
+    """Drop the live gauges of an exited worker process (multiprocess mode only)."""
+    if os.environ.get(MULTIPROC_DIR_ENV):
+        multiprocess.mark_process_dead(pid)
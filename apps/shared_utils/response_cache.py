@@ -0,0 +1,134 @@
+"""Async response cache with TTL, stale-while-revalidate, single-flight and ETag revalidation."""
+import asyncio
+import time
+from collections import OrderedDict
+from dataclasses import dataclass
+from typing import Any, Awaitable, Callable, Dict, Hashable, Optional, Tuple
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
+
+
+class NotModified:
+    """Returned by a fetcher when the origin answered 304 for the cached ETag."""
+
+
+NOT_MODIFIED = NotModified()
+
+# fetch(etag) -> (value, etag) or NOT_MODIFIED
+FetchFn = Callable[[Optional[str]], Awaitable[Any]]
+
+
+@dataclass
+class CacheEntry:
+    value: Any
+    etag: Optional[str]
+    fetched_at: float
+
+
+def cache_key(*parts: Any, params: Optional[Dict[str, Any]] = None) -> Tuple[Hashable, ...]:
+    """Build a cache key from fixed parts and order-insensitive query parameters."""
+    normalized = tuple(sorted((str(k), str(v)) for k, v in (params or {}).items() if v not in (None, '')))
+    return tuple(parts) + (normalized,)
+
+
+class ResponseCache:
+    """
+    Bounded LRU cache for upstream responses.
+
+    - Within `ttl_s` an entry is served as is ('hit').
+    - Up to `stale_s` beyond the TTL it is still served ('stale'), while one
+      background task revalidates it.
+    - Otherwise the caller waits for a fetch ('miss'). Concurrent callers
+      for the same key share one in-flight fetch (single-flight).
+    - Revalidation passes the cached ETag to the fetcher. A NOT_MODIFIED
+      answer just refreshes the entry's age.
+    """
+
+    def __init__(self, ttl_s: float = 5.0, stale_s: float = 30.0, max_entries: int = 1000):
+        """
+        Args:
+            ttl_s: Age up to which entries are fresh
+            stale_s: Extra age during which stale entries are served while revalidating
+            max_entries: Maximum number of cached keys (least recently used evicted)
+        """
+        self.ttl_s = ttl_s
+        self.stale_s = stale_s
+        self.max_entries = max(1, max_entries)
+        self._entries: 'OrderedDict[Hashable, CacheEntry]' = OrderedDict()
+        self._inflight: Dict[Hashable, asyncio.Future] = {}
+        self.stats = {'hit': 0, 'stale': 0, 'miss': 0, 'revalidated': 0, 'coalesced': 0}
+
+    def __len__(self) -> int:
+        return len(self._entries)
+
+    async def get(self, key: Hashable, fetch: FetchFn) -> Tuple[Any, str]:
+        """
+        Return the value for `key`, fetching or revalidating as needed.
+
+        Returns:
+            (value, status) where status is 'hit', 'stale' or 'miss'
+
+        Raises:
+            Whatever `fetch` raises when there is no usable cached value
+        """
+        entry = self._entries.get(key)
+        if entry is not None:
+            age = time.monotonic() - entry.fetched_at
+            if age < self.ttl_s:
+                self._entries.move_to_end(key)
+                self.stats['hit'] += 1
+                return entry.value, 'hit'
+            if age < self.ttl_s + self.stale_s:
+                self._entries.move_to_end(key)
+                self.stats['stale'] += 1
+                if key not in self._inflight:
+                    task = self._start_fetch(key, fetch)
+                    # Failures are logged; the stale value keeps being served
+                    task.add_done_callback(lambda f: f.cancelled() or f.exception())
+                return entry.value, 'stale'
+
+        self.stats['miss'] += 1
+        inflight = self._inflight.get(key)
+        if inflight is not None:
+            self.stats['coalesced'] += 1
+            return await asyncio.shield(inflight), 'miss'
+        return await asyncio.shield(self._start_fetch(key, fetch)), 'miss'
+
+    def _start_fetch(self, key: Hashable, fetch: FetchFn) -> asyncio.Future:
+        fut = asyncio.ensure_future(self._fetch(key, fetch))
+        self._inflight[key] = fut
+        fut.add_done_callback(lambda f: self._inflight.pop(key, None))
+        return fut
+
+    async def _fetch(self, key: Hashable, fetch: FetchFn) -> Any:
+        entry = self._entries.get(key)
+        try:
+            result = await fetch(entry.etag if entry else None)
+        except Exception as e:
+            logger.warning("cache_fetch_failed", key=str(key)[:200], error=str(e))
+            raise
+        if result is NOT_MODIFIED and entry is not None:
+            entry.fetched_at = time.monotonic()
+            self.stats['revalidated'] += 1
+            return entry.value
+        value, etag = result
+        self._store(key, CacheEntry(value, etag, time.monotonic()))
+        return value
+
+    def _store(self, key: Hashable, entry: CacheEntry) -> None:
+        self._entries[key] = entry
+        self._entries.move_to_end(key)
+        while len(self._entries) > self.max_entries:
+            self._entries.popitem(last=False)
+
+    def invalidate(self, key: Optional[Hashable] = None) -> None:
+        """Drop one key, or everything when `key` is None."""
+        if key is None:
+            self._entries.clear()
+        else:
+            self._entries.pop(key, None)
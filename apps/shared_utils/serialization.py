@@ -0,0 +1,78 @@
+"""Fast JSON encoding and opaque keyset-pagination cursors for the query APIs."""
+import base64
+import json
+from datetime import datetime
+from decimal import Decimal
+from typing import Any, List, Tuple
+from uuid import UUID
+
+try:
+    import orjson
+except ImportError:  # pragma: no cover - stdlib fallback
+    orjson = None  # type: ignore
+
+
+class CursorError(ValueError):
+    """Raised when a pagination cursor cannot be decoded."""
+
+
+def json_default(o: Any) -> Any:
+    """Encode types returned by asyncpg that the json module does not know."""
+    if isinstance(o, datetime):
+        return o.isoformat()
+    if isinstance(o, UUID):
+        return str(o)
+    if isinstance(o, Decimal):
+        return float(o)
+    raise TypeError(f'Object of type {type(o).__name__} is not JSON serializable')
+
+
+def dumps(obj: Any) -> bytes:
+    """
+    Serialize to compact JSON bytes.
+
+    Uses orjson when installed (native datetime/UUID support), falling back
+    to the standard library.
+    """
+    if orjson is not None:
+        return orjson.dumps(obj, default=json_default)
+    return json.dumps(obj, default=json_default, separators=(',', ':')).encode('utf-8')
+
+
+def loads(data: Any) -> Any:
+    """Parse JSON from bytes or str."""
+    if orjson is not None:
+        return orjson.loads(data)
+    return json.loads(data)
+
+
+def encode_cursor(inserted_at: datetime, entity_id: Any) -> str:
+    """
+    Build an opaque cursor pointing just after a row in (inserted_at, id) DESC order.
+
+    Args:
+        inserted_at: Sort timestamp of the last row returned
+        entity_id: Id of the last row returned (tie-breaker)
+    """
+    raw = dumps([inserted_at.isoformat(), str(entity_id)])
+    return base64.urlsafe_b64encode(raw).rstrip(b'=').decode('ascii')
+
+
+def decode_cursor(token: str) -> Tuple[datetime, UUID]:
+    """
+    Decode a cursor produced by `encode_cursor`.
+
+    Raises:
+        CursorError: If the token is malformed
+    """
+    try:
+        raw = base64.urlsafe_b64decode(token + '=' * (-len(token) % 4))
+        ts, entity_id = loads(raw)
+        return datetime.fromisoformat(ts), UUID(entity_id)
+    except Exception as e:
+        raise CursorError(f'Invalid cursor: {token!r}') from e
+
+
+def ndjson_lines(rows: List[Any]) -> bytes:
+    """Encode rows as newline-delimited JSON."""
+    return b''.join(dumps(r) + b'\n' for r in rows)
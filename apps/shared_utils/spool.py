@@ -0,0 +1,322 @@
+"""Segmented append-only write-ahead log used by the sidecar to spool events."""
+import json
+import os
+import struct
+import time
+import zlib
+from pathlib import Path
+from typing import Any, Dict, List, NamedTuple, Optional, Tuple
+
+try:
+    import structlog
+    logger = structlog.get_logger(__name__)
+except ImportError:
+    import logging
+    logger = logging.getLogger(__name__)  # type: ignore
+
+# Record layout: 4-byte big-endian payload length, 4-byte CRC32 of payload, payload (JSON)
+HEADER = struct.Struct('>II')
+SEGMENT_SUFFIX = '.seg'
+CHECKPOINT_FILE = 'checkpoint.json'
+DEAD_LETTER_FILE = 'dead-letter.jsonl'
+
+
+class SpoolPosition(NamedTuple):
+    """Read position in the log: segment sequence number and byte offset."""
+    segment: int
+    offset: int
+
+
+class SpoolEntry(NamedTuple):
+    """A record read from the log and the position just after it."""
+    record: Dict[str, Any]
+    position: SpoolPosition
+
+
+class SegmentedSpool:
+    """
+    Durable FIFO of JSON records stored as length-prefixed segments.
+
+    - Appends go to the active segment and are fsync'd in batches
+      (every `fsync_batch` records or `fsync_interval_s` seconds).
+    - The active segment is rotated once it exceeds `segment_max_bytes`.
+    - Readers `read()` a batch, process it, then `commit()` the position of
+      the last processed entry; the checkpoint is persisted atomically and fully drained
+      segments are deleted.
+    - `pending` is maintained incrementally, so it is O(1) to query.
+
+    Not thread-safe; intended to be used from a single event loop.
+    """
+
+    def __init__(
+        self,
+        directory: Path,
+        segment_max_bytes: int = 64 * 1024 * 1024,
+        fsync_batch: int = 64,
+        fsync_interval_s: float = 1.0
+    ):
+        """
+        Open (or create) a spool in `directory`.
+
+        Recovers the checkpoint, truncates a torn tail record left by a crash,
+        counts pending records and migrates any legacy one-file-per-event
+        `*.json` spool files found in the directory.
+
+        Args:
+            directory: Spool directory
+            segment_max_bytes: Rotate the active segment beyond this size
+            fsync_batch: fsync after this many unsynced appends
+            fsync_interval_s: fsync if the oldest unsynced append is older than this
+        """
+        self.directory = Path(directory)
+        self.directory.mkdir(parents=True, exist_ok=True)
+        self.segment_max_bytes = segment_max_bytes
+        self.fsync_batch = max(1, fsync_batch)
+        self.fsync_interval_s = fsync_interval_s
+
+        self._unsynced = 0
+        self._last_sync = time.monotonic()
+
+        segments = self._segments()
+        self._read_pos = self._load_checkpoint(segments)
+        self._write_seq = segments[-1] if segments else max(self._read_pos.segment, 1)
+        self._writer = open(self._segment_path(self._write_seq), 'ab')
+        self._truncate_torn_tail()
+
+        self._pending = self._count_from(self._read_pos)
+        migrated = self._migrate_legacy_files()
+
+        logger.info(
+            "spool_opened",
+            directory=str(self.directory),
+            segments=len(self._segments()),
+            pending=self._pending,
+            migrated=migrated
+        )
+
+    # ------------------------------------------------------------------ paths
+
+    def _segment_path(self, seq: int) -> Path:
+        return self.directory / f"{seq:020d}{SEGMENT_SUFFIX}"
+
+    def _segments(self) -> List[int]:
+        seqs = []
+        for p in self.directory.glob(f'*{SEGMENT_SUFFIX}'):
+            try:
+                seqs.append(int(p.stem))
+            except ValueError:
+                continue
+        return sorted(seqs)
+
+    # ------------------------------------------------------------- recovery
+
+    def _load_checkpoint(self, segments: List[int]) -> SpoolPosition:
+        path = self.directory / CHECKPOINT_FILE
+        first = SpoolPosition(segments[0], 0) if segments else SpoolPosition(1, 0)
+        try:
+            data = json.loads(path.read_text(encoding='utf-8'))
+            pos = SpoolPosition(int(data['segment']), int(data['offset']))
+        except FileNotFoundError:
+            return first
+        except Exception as e:
+            logger.warning("spool_checkpoint_unreadable", error=str(e))
+            return first
+        # Checkpoint may point at a segment that was already deleted
+        if segments and pos.segment < segments[0]:
+            return first
+        return pos
+
+    def _truncate_torn_tail(self) -> None:
+        """Drop an incomplete or corrupt record at the end of the active segment."""
+        path = self._segment_path(self._write_seq)
+        good = 0
+        with open(path, 'rb') as f:
+            while True:
+                rec = self._read_record(f)
+                if rec is None:
+                    break
+                good += rec[1]
+        if good < path.stat().st_size:
+            logger.warning(
+                "spool_torn_tail_truncated",
+                segment=path.name,
+                dropped_bytes=path.stat().st_size - good
+            )
+            self._writer.truncate(good)
+            self._writer.flush()
+            os.fsync(self._writer.fileno())
+
+    def _count_from(self, pos: SpoolPosition) -> int:
+        count = 0
+        for seq in self._segments():
+            if seq < pos.segment:
+                continue
+            with open(self._segment_path(seq), 'rb') as f:
+                if seq == pos.segment:
+                    f.seek(pos.offset)
+                while self._read_record(f) is not None:
+                    count += 1
+        return count
+
+    def _migrate_legacy_files(self) -> int:
+        """Append legacy `<key>_<micros>.json` spool files in their original order."""
+        legacy = list(self.directory.glob('*.json'))
+        legacy = [p for p in legacy if p.name != CHECKPOINT_FILE]
+        if not legacy:
+            return 0
+
+        def spooled_at(p: Path) -> Tuple[int, str]:
+            try:
+                return int(p.stem.rsplit('_', 1)[1]), p.name
+            except (IndexError, ValueError):
+                return 0, p.name
+
+        migrated: List[Path] = []
+        for p in sorted(legacy, key=spooled_at):
+            try:
+                self.append(json.loads(p.read_text(encoding='utf-8')), sync=False)
+                migrated.append(p)
+            except Exception as e:
+                # Left in place for manual inspection
+                logger.warning("spool_legacy_file_unreadable", filename=p.name, error=str(e))
+        # Make the migrated records durable before deleting their source files
+        self.sync()
+        for p in migrated:
+            p.unlink(missing_ok=True)
+        logger.info("spool_legacy_files_migrated", count=len(migrated), skipped=len(legacy) - len(migrated))
+        return len(migrated)
+
+    # ---------------------------------------------------------------- records
+
+    @staticmethod
+    def _read_record(f: Any) -> Optional[Tuple[Dict[str, Any], int]]:
+        """Read one record; None at end of data or on a torn/corrupt record."""
+        header = f.read(HEADER.size)
+        if len(header) < HEADER.size:
+            return None
+        length, crc = HEADER.unpack(header)
+        payload = f.read(length)
+        if len(payload) < length or zlib.crc32(payload) != crc:
+            return None
+        return json.loads(payload), HEADER.size + length
+
+    # ------------------------------------------------------------------ write
+
+    def append(self, record: Dict[str, Any], sync: bool = True) -> None:
+        """
+        Append a record to the log.
+
+        Args:
+            record: JSON-serializable record
+            sync: Apply the fsync batching policy after this append
+        """
+        payload = json.dumps(record, separators=(',', ':')).encode('utf-8')
+        self._writer.write(HEADER.pack(len(payload), zlib.crc32(payload)) + payload)
+        self._pending += 1
+        self._unsynced += 1
+
+        if sync and (
+            self._unsynced >= self.fsync_batch
+            or time.monotonic() - self._last_sync >= self.fsync_interval_s
+        ):
+            self.sync()
+
+        if self._writer.tell() >= self.segment_max_bytes:
+            self._rotate()
+
+    def sync(self) -> None:
+        """Flush and fsync any unsynced appends."""
+        if self._unsynced:
+            self._writer.flush()
+            os.fsync(self._writer.fileno())
+            self._unsynced = 0
+        self._last_sync = time.monotonic()
+
+    def _rotate(self) -> None:
+        self.sync()
+        self._writer.close()
+        self._write_seq += 1
+        self._writer = open(self._segment_path(self._write_seq), 'ab')
+        logger.debug("spool_segment_rotated", segment=self._write_seq)
+
+    # ------------------------------------------------------------------- read
+
+    @property
+    def pending(self) -> int:
+        """Number of records appended but not yet committed."""
+        return self._pending
+
+    def read(self, max_records: int) -> List[SpoolEntry]:
+        """
+        Read up to `max_records` records from the committed position.
+
+        Does not advance the checkpoint; call `commit()` with the position
+        of the last processed entry once processing succeeded.
+
+        Returns:
+            Entries in append order, each with the position just after it
+        """
+        # Make buffered appends visible to the reader
+        self._writer.flush()
+        seg, off = self._read_pos
+        entries: List[SpoolEntry] = []
+
+        while len(entries) < max_records:
+            path = self._segment_path(seg)
+            exhausted = True
+            if path.exists():
+                with open(path, 'rb') as f:
+                    f.seek(off)
+                    while len(entries) < max_records:
+                        rec = self._read_record(f)
+                        if rec is None:
+                            break
+                        off += rec[1]
+                        entries.append(SpoolEntry(rec[0], SpoolPosition(seg, off)))
+                    exhausted = off >= os.fstat(f.fileno()).st_size
+            if seg >= self._write_seq or (not exhausted and len(entries) >= max_records):
+                break
+            if not exhausted:
+                logger.error("spool_segment_corrupt_skipped", segment=path.name, offset=off)
+            # Sealed segment done: point its last entry at the next segment so
+            # committing it lets the drained segment be deleted
+            if entries and entries[-1].position.segment == seg:
+                entries[-1] = entries[-1]._replace(position=SpoolPosition(seg + 1, 0))
+            seg, off = seg + 1, 0
+
+        return entries
+
+    def commit(self, pos: SpoolPosition, count: int) -> None:
+        """
+        Persist `pos` as the new read checkpoint and delete drained segments.
+
+        Args:
+            pos: Position of the last processed entry returned by `read()`
+            count: Number of records consumed up to `pos`
+        """
+        path = self.directory / CHECKPOINT_FILE
+        tmp = path.with_suffix('.tmp')
+        with open(tmp, 'w', encoding='utf-8') as f:
+            json.dump({'segment': pos.segment, 'offset': pos.offset}, f)
+            f.flush()
+            os.fsync(f.fileno())
+        os.replace(tmp, path)
+
+        self._read_pos = pos
+        self._pending = max(0, self._pending - count)
+
+        for seq in self._segments():
+            if seq >= pos.segment:
+                break
+            self._segment_path(seq).unlink(missing_ok=True)
+            logger.debug("spool_segment_deleted", segment=seq)
+
+    def dead_letter(self, record: Dict[str, Any], reason: str) -> None:
+        """Set aside a record that can never be delivered."""
+        with open(self.directory / DEAD_LETTER_FILE, 'a', encoding='utf-8') as f:
+            f.write(json.dumps({'reason': reason, 'record': record}) + '\n')
+
+    def close(self) -> None:
+        """Sync and close the active segment."""
+        self.sync()
+        self._writer.close()
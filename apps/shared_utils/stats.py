@@ -0,0 +1,227 @@
+"""Mergeable job/event statistics built from the TimescaleDB continuous aggregates."""
+import math
+from datetime import datetime, timedelta
+from typing import Any, Dict, Iterable, List, Optional, Sequence, Tuple
+
+# Layout of the `duration_hist` columns in job_stats_hourly/job_stats_daily:
+# histogram(log10(duration_s), HIST_MIN_LOG10, HIST_MAX_LOG10, HIST_BUCKETS),
+# i.e. HIST_BUCKETS equal-width buckets in log space plus an underflow (first)
+# and overflow (last) slot. Must match ops/sql/timescaledb_enhancements.sql.
+HIST_MIN_LOG10 = -1.0
+HIST_MAX_LOG10 = 5.0
+HIST_BUCKETS = 48
+
+GRANULARITIES = ('hour', 'day')
+
+PERCENTILES = (('p50_duration_s', 0.5), ('p95_duration_s', 0.95), ('p99_duration_s', 0.99))
+
+# Fields summed when buckets are combined
+_SUM_FIELDS = ('job_count', 'succeeded', 'failed', 'duration_sum_s', 'cpu_sum_s', 'mem_sum_mb')
+_MIN_FIELDS = ('min_duration_s',)
+_MAX_FIELDS = ('max_duration_s', 'max_mem_mb')
+
+
+def choose_granularity(
+    frm: datetime,
+    to: datetime,
+    requested: str = 'auto',
+    hourly_max_hours: int = 72
+) -> str:
+    """
+    Pick the aggregate to read for a time range.
+
+    Args:
+        frm: Range start
+        to: Range end
+        requested: 'hour', 'day' or 'auto'
+        hourly_max_hours: Longest range served from hourly buckets in 'auto' mode
+
+    Raises:
+        ValueError: If `requested` is not a known granularity
+    """
+    if requested in GRANULARITIES:
+        return requested
+    if requested != 'auto':
+        raise ValueError(f"granularity must be one of 'auto', 'hour', 'day': {requested!r}")
+    return 'hour' if to - frm <= timedelta(hours=hourly_max_hours) else 'day'
+
+
+def parse_group_by(value: Optional[str], allowed: Sequence[str]) -> List[str]:
+    """
+    Parse a comma-separated `group_by` parameter.
+
+    Raises:
+        ValueError: If a field is not in `allowed`
+    """
+    fields = [f.strip() for f in (value or '').split(',') if f.strip()]
+    unknown = [f for f in fields if f not in allowed]
+    if unknown:
+        raise ValueError(f"Cannot group by {', '.join(unknown)}; allowed: {', '.join(allowed)}")
+    return list(dict.fromkeys(fields))
+
+
+def _bucket_key(bucket: Any) -> str:
+    return bucket.isoformat() if isinstance(bucket, datetime) else str(bucket)
+
+
+def job_partial_from_row(row: Dict[str, Any]) -> Dict[str, Any]:
+    """
+    Turn one continuous-aggregate row (one status of one app in one bucket)
+    into a mergeable partial: averages become sums weighted by job_count.
+    """
+    count = int(row['job_count'] or 0)
+    status = row.get('status')
+    hist = row.get('duration_hist')
+    return {
+        'job_count': count,
+        'succeeded': count if status == 'succeeded' else 0,
+        'failed': count if status == 'failed' else 0,
+        'duration_sum_s': (row.get('avg_duration_s') or 0.0) * count,
+        'cpu_sum_s': (row.get('avg_cpu_s') or 0.0) * count,
+        'mem_sum_mb': (row.get('avg_mem_mb') or 0.0) * count,
+        'min_duration_s': row.get('min_duration_s'),
+        'max_duration_s': row.get('max_duration_s'),
+        'max_mem_mb': row.get('max_mem_mb'),
+        'duration_hist': list(hist) if hist else None,
+    }
+
+
+def _combine(acc: Dict[str, Any], part: Dict[str, Any]) -> None:
+    for f in _SUM_FIELDS:
+        acc[f] = acc.get(f, 0) + (part.get(f) or 0)
+    for f in _MIN_FIELDS:
+        if part.get(f) is not None:
+            acc[f] = part[f] if acc.get(f) is None else min(acc[f], part[f])
+    for f in _MAX_FIELDS:
+        if part.get(f) is not None:
+            acc[f] = part[f] if acc.get(f) is None else max(acc[f], part[f])
+    hist = part.get('duration_hist')
+    if hist:
+        if acc.get('duration_hist'):
+            acc['duration_hist'] = [a + b for a, b in zip(acc['duration_hist'], hist)]
+        else:
+            acc['duration_hist'] = list(hist)
+
+
+def histogram_quantile(
+    hist: Sequence[int],
+    q: float,
+    lo: Optional[float] = None,
+    hi: Optional[float] = None
+) -> Optional[float]:
+    """
+    Estimate the q-quantile of durations from a `duration_hist`.
+
+    Interpolates geometrically inside the bucket holding the quantile, so
+    the relative error is bounded by the bucket width (about 33%). Values
+    in the under/overflow slots are reported as `lo`/`hi` (the observed
+    min/max) when given.
+    """
+    total = sum(hist)
+    if not total or len(hist) != HIST_BUCKETS + 2:
+        return None
+    rank = q * total
+    width = (HIST_MAX_LOG10 - HIST_MIN_LOG10) / HIST_BUCKETS
+    seen = 0
+    for i, n in enumerate(hist):
+        if n and seen + n >= rank:
+            if i == 0:
+                value = lo if lo is not None else 10 ** HIST_MIN_LOG10
+            elif i == HIST_BUCKETS + 1:
+                value = hi if hi is not None else 10 ** HIST_MAX_LOG10
+            else:
+                frac = (rank - seen) / n
+                value = 10 ** (HIST_MIN_LOG10 + width * (i - 1 + frac))
+            if lo is not None:
+                value = max(value, lo)
+            if hi is not None:
+                value = min(value, hi)
+            return value
+        seen += n
+    return hi
+
+
+def finalize_job_bucket(acc: Dict[str, Any]) -> Dict[str, Any]:
+    """Add derived rates, averages and percentiles to a merged bucket (in place)."""
+    count = acc.get('job_count') or 0
+
+    def ratio(value: float) -> Optional[float]:
+        return round(value / count, 4) if count else None
+
+    acc['success_rate'] = ratio(acc.get('succeeded', 0))
+    acc['avg_duration_s'] = ratio(acc.get('duration_sum_s', 0.0))
+    acc['avg_cpu_s'] = ratio(acc.get('cpu_sum_s', 0.0))
+    acc['avg_mem_mb'] = ratio(acc.get('mem_sum_mb', 0.0))
+    hist = acc.get('duration_hist')
+    for name, q in PERCENTILES:
+        value = histogram_quantile(hist, q, acc.get('min_duration_s'), acc.get('max_duration_s')) if hist else None
+        acc[name] = round(value, 4) if value is not None and math.isfinite(value) else None
+    return acc
+
+
+def merge_job_buckets(
+    parts: Iterable[Dict[str, Any]],
+    group_by: Sequence[str] = ()
+) -> List[Dict[str, Any]]:
+    """
+    Combine job partials sharing a bucket (and `group_by` fields) and finalize them.
+
+    Works both on partials built from aggregate rows and on buckets returned
+    by other sites, since finalized buckets keep their mergeable fields.
+
+    Returns:
+        Buckets ordered by time, then group fields
+    """
+    merged: Dict[Tuple, Dict[str, Any]] = {}
+    for part in parts:
+        key = (_bucket_key(part['bucket']),) + tuple(part.get(g) for g in group_by)
+        acc = merged.get(key)
+        if acc is None:
+            acc = merged[key] = {'bucket': key[0], **{g: part.get(g) for g in group_by}}
+        _combine(acc, part)
+    return [finalize_job_bucket(merged[k]) for k in sorted(merged, key=lambda k: tuple(str(x) for x in k))]
+
+
+def merge_event_buckets(
+    rows: Iterable[Dict[str, Any]],
+    group_by: Sequence[str] = ()
+) -> List[Dict[str, Any]]:
+    """Sum event counts sharing a bucket (and `group_by` fields)."""
+    merged: Dict[Tuple, Dict[str, Any]] = {}
+    for row in rows:
+        key = (_bucket_key(row['bucket']),) + tuple(row.get(g) for g in group_by)
+        acc = merged.get(key)
+        if acc is None:
+            acc = merged[key] = {'bucket': key[0], **{g: row.get(g) for g in group_by}, 'event_count': 0}
+        acc['event_count'] += int(row.get('event_count') or 0)
+    return [merged[k] for k in sorted(merged, key=lambda k: tuple(str(x) for x in k))]
+
+
+def merge_failures(rows: Iterable[Dict[str, Any]]) -> List[Dict[str, Any]]:
+    """
+    Combine failure-analysis rows per (app_name, error_type).
+
+    The average duration before failure is re-weighted by failure_count.
+
+    Returns:
+        Rows ordered by failure_count descending
+    """
+    merged: Dict[Tuple[str, str], Dict[str, Any]] = {}
+    for row in rows:
+        key = (row.get('app_name'), row.get('error_type'))
+        count = int(row.get('failure_count') or 0)
+        acc = merged.setdefault(key, {'app_name': key[0], 'error_type': key[1], 'failure_count': 0, '_duration_sum': 0.0})
+        acc['failure_count'] += count
+        acc['_duration_sum'] += float(row.get('avg_duration_before_failure') or 0.0) * count
+    out = []
+    for acc in merged.values():
+        total = acc.pop('_duration_sum')
+        acc['avg_duration_before_failure'] = round(total / acc['failure_count'], 2) if acc['failure_count'] else None
+        out.append(acc)
+    out.sort(key=lambda r: (-r['failure_count'], str(r['app_name']), str(r['error_type'])))
+    return out
+
+
+def histogram_layout() -> Dict[str, Any]:
+    """Describe the duration histogram so clients can interpret `duration_hist`."""
+    return {'scale': 'log10', 'min': HIST_MIN_LOG10, 'max': HIST_MAX_LOG10, 'buckets': HIST_BUCKETS}
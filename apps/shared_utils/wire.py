@@ -0,0 +1,223 @@
+"""Content-negotiated wire formats for event batches (JSON or msgpack, optionally zstd)."""
+from dataclasses import dataclass
+from functools import lru_cache
+from typing import Any, Dict, List, Optional, Tuple, Type
+
+from .serialization import dumps, loads
+
+JSON_TYPE = 'application/json'
+MSGPACK_TYPE = 'application/msgpack'
+MSGPACK_TYPES = (MSGPACK_TYPE, 'application/x-msgpack', 'application/vnd.msgpack')
+ZSTD_ENCODING = 'zstd'
+
+# Accepted `wire_format` settings: encoding, optionally '+zstd' for a compressed body
+WIRE_FORMATS = ('json', 'json+zstd', 'msgpack', 'msgpack+zstd')
+
+# Refuse to inflate compressed bodies beyond this (decompression bomb guard)
+MAX_DECOMPRESSED_BYTES = 64 * 1024 * 1024
+
+
+class WireFormatError(ValueError):
+    """Raised when a body cannot be decoded; `status_code` is the HTTP status to answer with."""
+
+    def __init__(self, message: str, status_code: int = 400):
+        super().__init__(message)
+        self.status_code = status_code
+
+
+def parse_format(fmt: str) -> Tuple[str, bool]:
+    """
+    Split a `wire_format` setting into its media type and compression flag.
+
+    Raises:
+        ValueError: If `fmt` is not one of WIRE_FORMATS
+    """
+    fmt = (fmt or 'json').strip().lower()
+    if fmt not in WIRE_FORMATS:
+        raise ValueError(f"wire format must be one of {WIRE_FORMATS}, got {fmt!r}")
+    encoding, _, compression = fmt.partition('+')
+    return (MSGPACK_TYPE if encoding == 'msgpack' else JSON_TYPE), bool(compression)
+
+
+def _msgpack() -> Any:
+    try:
+        import msgpack
+    except ImportError:
+        raise WireFormatError('msgpack bodies need the msgpack package', status_code=415)
+    return msgpack
+
+
+def _zstd() -> Any:
+    try:
+        import zstandard
+    except ImportError:
+        raise WireFormatError('zstd bodies need the zstandard package', status_code=415)
+    return zstandard
+
+
+def encode_batch(items: Any, fmt: str = 'json') -> Tuple[bytes, Dict[str, str]]:
+    """
+    Encode a batch request body.
+
+    The document shape is the same in every format (ids and timestamps stay
+    strings), so a body can be forwarded, spooled or re-encoded without
+    knowing which format it arrived in.
+
+    Returns:
+        (body, headers) where headers carry Content-Type and, if compressed,
+        Content-Encoding
+    """
+    media_type, compressed = parse_format(fmt)
+    if media_type == MSGPACK_TYPE:
+        body = _msgpack().packb(items, use_bin_type=True)
+    else:
+        body = dumps(items)
+    headers = {'Content-Type': media_type}
+    if compressed:
+        body = _zstd().ZstdCompressor().compress(body)
+        headers['Content-Encoding'] = ZSTD_ENCODING
+    return body, headers
+
+
+def _media_type(content_type: Optional[str]) -> str:
+    return (content_type or JSON_TYPE).split(';', 1)[0].strip().lower()
+
+
+def decode_batch(body: bytes, content_type: Optional[str], content_encoding: Optional[str] = None) -> Any:
+    """
+    Decode a request body sent with `encode_batch` (or plain JSON).
+
+    Raises:
+        WireFormatError: 415 for an unsupported media type or encoding,
+            400 for a body that does not decode
+    """
+    media_type = _media_type(content_type)
+    if media_type != JSON_TYPE and media_type not in MSGPACK_TYPES:
+        raise WireFormatError(f'Unsupported media type: {media_type}', status_code=415)
+
+    encoding = (content_encoding or 'identity').strip().lower()
+    if encoding == ZSTD_ENCODING:
+        zstandard = _zstd()
+        try:
+            with zstandard.ZstdDecompressor().stream_reader(body) as reader:
+                raw = reader.read(MAX_DECOMPRESSED_BYTES + 1)
+        except Exception as e:
+            raise WireFormatError(f'Invalid zstd body: {e}')
+        if len(raw) > MAX_DECOMPRESSED_BYTES:
+            raise WireFormatError('Decompressed body too large', status_code=413)
+        body = raw
+    elif encoding != 'identity':
+        raise WireFormatError(f'Unsupported content encoding: {encoding}', status_code=415)
+
+    try:
+        if media_type == JSON_TYPE:
+            return loads(body)
+        return _msgpack().unpackb(body, raw=False)
+    except WireFormatError:
+        raise
+    except Exception as e:
+        raise WireFormatError(f'Invalid {media_type} body: {e}')
+
+
+@dataclass
+class WireBatch:
+    """A decoded batch request, with the original body kept for pass-through forwarding."""
+    body: bytes
+    content_type: str
+    content_encoding: Optional[str]
+    items: List[Any]
+
+    def headers(self) -> Dict[str, str]:
+        """Headers to forward `body` unchanged."""
+        headers = {'Content-Type': self.content_type}
+        if self.content_encoding:
+            headers['Content-Encoding'] = self.content_encoding
+        return headers
+
+
+async def read_batch(request: Any) -> WireBatch:
+    """
+    Read and decode the JSON array body of a batch endpoint.
+
+    Raises:
+        HTTPException: 415/413/400 if the body cannot be decoded
+        RequestValidationError: If the body is not an array
+    """
+    from fastapi import HTTPException
+    from fastapi.exceptions import RequestValidationError
+
+    body = await request.body()
+    content_type = request.headers.get('content-type') or JSON_TYPE
+    content_encoding = request.headers.get('content-encoding')
+    try:
+        items = decode_batch(body, content_type, content_encoding)
+    except WireFormatError as e:
+        raise HTTPException(status_code=e.status_code, detail=str(e))
+    if not isinstance(items, list):
+        raise RequestValidationError([{
+            'type': 'list_type', 'loc': ('body',), 'msg': 'Input should be a valid list', 'input': None
+        }])
+    return WireBatch(body, content_type, content_encoding, items)
+
+
+@lru_cache(maxsize=None)
+def _list_adapter(model: Type[Any]) -> Any:
+    from pydantic import TypeAdapter
+    return TypeAdapter(List[model])  # type: ignore[valid-type]
+
+
+_JSON_SCALARS = (str, int, float, bool, type(None))
+
+
+def json_errors(items: List[Any]) -> List[Dict[str, Any]]:
+    """
+    Locate values that have no JSON form (msgpack bin and ext values,
+    non-string map keys), one error per offending item.
+
+    Events are stored, spooled and forwarded as JSON documents, so such a
+    value would only fail later, after the event was acknowledged.
+    """
+    errors = []
+    for i, item in enumerate(items):
+        stack: List[Tuple[Tuple[Any, ...], Any]] = [((i,), item)]
+        while stack:
+            loc, value = stack.pop()
+            if isinstance(value, dict):
+                bad_key = next((k for k in value if not isinstance(k, str)), None)
+                if bad_key is not None:
+                    errors.append({'type': 'json_type', 'loc': ('body', *loc), 'input': None,
+                                   'msg': f'Map keys must be strings, got {type(bad_key).__name__}'})
+                    break
+                stack.extend(((*loc, k), v) for k, v in value.items())
+            elif isinstance(value, list):
+                stack.extend(((*loc, j), v) for j, v in enumerate(value))
+            elif not isinstance(value, _JSON_SCALARS):
+                errors.append({'type': 'json_type', 'loc': ('body', *loc), 'input': None,
+                               'msg': f'Value is not representable in JSON ({type(value).__name__})'})
+                break
+    return errors
+
+
+def validate_items(items: List[Any], model: Type[Any]) -> List[Any]:
+    """
+    Validate decoded batch items against a pydantic model.
+
+    Items must also be plain JSON documents (see json_errors); a msgpack
+    body can carry binary or extension values that JSON cannot.
+
+    Raises:
+        RequestValidationError: With the same errors FastAPI reports for a
+            `List[model]` body parameter (422)
+    """
+    from fastapi.exceptions import RequestValidationError
+    from pydantic import ValidationError
+
+    errors = json_errors(items)
+    if errors:
+        raise RequestValidationError(errors)
+    try:
+        return _list_adapter(model).validate_python(items)
+    except ValidationError as e:
+        raise RequestValidationError([
+            {**err, 'loc': ('body', *err['loc'])} for err in e.errors()
+        ])
@@ -0,0 +1,196 @@
+"""Pre-fork worker supervisor: several shared-nothing uvicorn processes on one port."""
+import os
+import signal
+import socket
+import time
+from typing import Any, Callable, Dict, Optional, Tuple
+
+from .logging import get_logger
+
+logger = get_logger(__name__)
+
+# uvicorn's exit code for a failed lifespan startup
+STARTUP_FAILURE = 3
+
+# Index of this worker process; None outside serve_workers
+_worker_index: Optional[int] = None
+
+
+def worker_index() -> int:
+    """Index of the current worker (0 when running as a single process)."""
+    return _worker_index or 0
+
+
+def pool_sizes(min_size: int, max_size: int, workers: int) -> Tuple[int, int]:
+    """
+    Split a connection budget across workers.
+
+    `max_size` is the total for the whole service, so N workers never open
+    more connections than one process did; each gets at least one.
+
+    Returns:
+        (min_size, max_size) for one worker's pool
+    """
+    per_worker = max(1, max_size // max(1, workers))
+    return min(min_size, per_worker), per_worker
+
+
+def reuseport_socket(host: str, port: int) -> socket.socket:
+    """
+    Bind (but do not listen on) a TCP socket with SO_REUSEPORT.
+
+    Every worker binds its own socket and the kernel spreads new connections
+    across the listening ones. uvicorn only calls listen() after the lifespan
+    startup has run, so a worker gets no connections before its pool is warm.
+    """
+    if not hasattr(socket, 'SO_REUSEPORT'):
+        raise RuntimeError("SO_REUSEPORT is not supported on this platform")
+    family = socket.AF_INET6 if ':' in host else socket.AF_INET
+    sock = socket.socket(family, socket.SOCK_STREAM)
+    try:
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+        sock.bind((host, port))
+    except OSError:
+        sock.close()
+        raise
+    return sock
+
+
+def _run_worker(
+    app: Any,
+    host: str,
+    port: int,
+    index: int,
+    post_fork: Optional[Callable[[int], None]],
+    uvicorn_kwargs: Dict[str, Any]
+) -> int:
+    import uvicorn
+    from .metrics import enable_multiprocess
+
+    global _worker_index
+    _worker_index = index
+    # The supervisor's handlers were inherited; uvicorn installs its own
+    signal.signal(signal.SIGTERM, signal.SIG_DFL)
+    signal.signal(signal.SIGINT, signal.default_int_handler)
+
+    enable_multiprocess()
+    if post_fork is not None:
+        post_fork(index)
+    sock = reuseport_socket(host, port)
+    server = uvicorn.Server(uvicorn.Config(app, **uvicorn_kwargs))
+    server.run(sockets=[sock])
+    return 0 if server.started else STARTUP_FAILURE
+
+
+def serve_workers(
+    app: Any,
+    host: str,
+    port: int,
+    workers: int = 1,
+    restart_delay_s: float = 1.0,
+    post_fork: Optional[Callable[[int], None]] = None,
+    **uvicorn_kwargs: Any
+) -> int:
+    """
+    Run `app` on `workers` forked processes sharing `host:port`.
+
+    With one worker this is plain `uvicorn.run`. Otherwise the calling
+    process becomes a supervisor: it forks the workers (the app module is
+    already imported, so they start without re-importing anything), forwards
+    SIGTERM/SIGINT to them as SIGTERM, and restarts workers that die. A
+    worker whose startup fails stops the whole service, as a single process
+    would.
+
+    Workers share nothing after the fork (each has its own database pool
+    and caches) except metrics: they are kept in prometheus_client's
+    multiprocess files under PROMETHEUS_MULTIPROC_DIR, emptied at startup,
+    so every worker's `/metrics` reports the whole service.
+
+    Anything that starts threads or opens connections (tracing exporters,
+    instrumentation) belongs in `post_fork`, which runs in each worker
+    before its server starts - and once in-process with a single worker.
+
+    Args:
+        app: ASGI application
+        host: Bind address
+        port: Bind port
+        workers: Number of worker processes
+        restart_delay_s: Pause before a crashed worker is replaced
+        post_fork: Called with the worker index in each worker process
+        **uvicorn_kwargs: Passed to `uvicorn.Config` (e.g. log_config)
+
+    Returns:
+        Process exit code
+    """
+    import uvicorn
+    from .metrics import prepare_multiprocess_dir, mark_process_dead
+
+    if workers <= 1:
+        if post_fork is not None:
+            post_fork(0)
+        uvicorn.run(app, host=host, port=port, **uvicorn_kwargs)
+        return 0
+
+    # Fail in the supervisor, before forking, if the port is unusable
+    reuseport_socket(host, port).close()
+    metrics_dir = prepare_multiprocess_dir()
+
+    children: Dict[int, int] = {}
+    stopping = False
+    exit_code = 0
+
+    def spawn(index: int) -> None:
+        pid = os.fork()
+        if pid == 0:
+            code = 1
+            try:
+                code = _run_worker(app, host, port, index, post_fork, uvicorn_kwargs)
+            except BaseException:
+                logger.exception("worker_failed", worker=index)
+            finally:
+                os._exit(code)
+        children[pid] = index
+        logger.info("worker_started", worker=index, pid=pid)
+
+    def stop(signum: int = signal.SIGTERM, frame: Any = None) -> None:
+        nonlocal stopping
+        stopping = True
+        for pid in list(children):
+            try:
+                os.kill(pid, signal.SIGTERM)
+            except ProcessLookupError:
+                pass
+
+    signal.signal(signal.SIGTERM, stop)
+    signal.signal(signal.SIGINT, stop)
+
+    logger.info("supervisor_starting", workers=workers, host=host, port=port, metrics_dir=metrics_dir)
+    for i in range(workers):
+        spawn(i)
+
+    while children:
+        try:
+            pid, status = os.wait()
+        except ChildProcessError:
+            break
+        index = children.pop(pid, None)
+        if index is None:
+            continue
+        code = os.waitstatus_to_exitcode(status)
+        mark_process_dead(pid)
+        if stopping:
+            logger.info("worker_stopped", worker=index, pid=pid, code=code)
+            continue
+        if code == STARTUP_FAILURE:
+            logger.error("worker_startup_failed", worker=index, pid=pid)
+            exit_code = STARTUP_FAILURE
+            stop()
+            continue
+        logger.warning("worker_exited", worker=index, pid=pid, code=code)
+        time.sleep(restart_delay_s)
+        if not stopping:
+            spawn(index)
+
+    logger.info("supervisor_stopped")
+    return exit_code
@@ -8,12 +8,11 @@ import os
 import asyncio
 import json
 import httpx
-import uuid
 from pathlib import Path
 from fastapi import FastAPI, Request, Response
 from fastapi.responses import JSONResponse
 from pydantic import BaseModel
-from typing import List
+from typing import List, Optional
 import time
 
 # Import shared utilities
@@ -21,7 +20,10 @@ import sys
 sys.path.insert(0, str(Path(__file__).parent.parent))
 from shared_utils import setup_logging, get_logger, setup_tracing, instrument_fastapi
 from shared_utils import MetricsCollector, get_metrics_collector
-from shared_utils import SidecarAgentConfig
+from shared_utils import SidecarAgentConfig, SegmentedSpool, BatchCoalescer, DedupFilter, first_occurrences
+from shared_utils import SpoolDrainer, PriorityGate
+from shared_utils.metrics import route_template
+from shared_utils.wire import WireBatch, encode_batch, parse_format, read_batch, validate_items
 
 # Configuration
 config = SidecarAgentConfig()
@@ -38,9 +40,15 @@ else:
 # Initialize metrics collector
 metrics = get_metrics_collector(config.service_name)
 
-# Setup directories
+# Open the spool log (migrates a legacy one-file-per-event spool on first start)
 SPOOL_DIR = Path(config.spool_dir)
-SPOOL_DIR.mkdir(parents=True, exist_ok=True)
+spooler = SegmentedSpool(
+    SPOOL_DIR,
+    segment_max_bytes=config.spool_segment_max_bytes,
+    fsync_batch=config.spool_fsync_batch,
+    fsync_interval_s=config.spool_fsync_interval_s
+)
+metrics.update_spool_count(spooler.pending)
 
 # FastAPI app
 app = FastAPI(
@@ -72,7 +80,7 @@ async def metrics_middleware(request: Request, call_next):
     
     metrics.record_http_request(
         method=request.method,
-        endpoint=request.url.path,
+        endpoint=route_template(request),
         status=response.status_code,
         duration=duration
     )
@@ -80,52 +88,178 @@ async def metrics_middleware(request: Request, call_next):
     return response
 
 
-async def forward(ev: dict) -> None:
+class ForwardRejected(Exception):
+    """Raised when the Local API rejects an individual event in a batch."""
+
+
+# Long-lived HTTP client shared by all forwards (created at startup)
+_client: Optional[httpx.AsyncClient] = None
+
+# Optional micro-batching stage for single-event ingests
+_coalescer: Optional[BatchCoalescer] = None
+
+# Shares Local API connections between live traffic and spool replay, live first
+gate = PriorityGate(config.max_connections)
+
+# Idempotency keys forwarded or spooled recently; client retries of those are dropped
+dedup = DedupFilter(config.dedup_max_keys, config.dedup_window_s) if config.dedup_enabled else None
+
+
+def is_duplicate(key: str) -> bool:
+    """Check the dedup filter; True if an event with `key` was accepted recently."""
+    if dedup is None or not dedup.seen(key):
+        return False
+    metrics.record_duplicates('filter')
+    return True
+
+
+def remember_keys(keys: List[str]) -> None:
+    """Record idempotency keys of forwarded or spooled events in the dedup filter."""
+    if dedup is not None:
+        dedup.add_many(keys)
+        metrics.update_cache_size('dedup', len(dedup))
+
+
+def get_client() -> httpx.AsyncClient:
+    """
+    Get or create the pooled HTTP client for the Local API.
+    
+    Returns:
+        Shared AsyncClient instance
+    """
+    global _client
+    if _client is None or _client.is_closed:
+        _client = httpx.AsyncClient(
+            base_url=config.local_api_base,
+            timeout=config.request_timeout_s,
+            limits=httpx.Limits(
+                max_keepalive_connections=config.max_connections,
+                max_connections=config.max_connections
+            )
+        )
+    return _client
+
+
+async def forward(ev: dict, live: bool = True) -> None:
     """
     Forward an event to the Local API.
     
     Args:
         ev: Event dict to forward
+        live: False for spool replay, which yields to live traffic
         
     Raises:
         httpx.HTTPError: If the request fails
     """
-    async with httpx.AsyncClient(timeout=config.request_timeout_s) as client:
-        try:
-            logger.debug("forwarding_event", event_kind=ev.get('event', {}).get('kind'))
-            r = await client.post(f'{config.local_api_base}/v1/ingest/events', json=ev)
-            r.raise_for_status()
-            metrics.record_event_processed('forward', 'success')
-            logger.info(
-                "event_forwarded",
-                event_kind=ev.get('event', {}).get('kind'),
-                status_code=r.status_code
-            )
-        except Exception as e:
-            metrics.record_event_processed('forward', 'failed')
-            logger.error(
-                "forward_failed",
-                event_kind=ev.get('event', {}).get('kind'),
-                error=str(e),
-                error_type=type(e).__name__
-            )
-            raise
+    try:
+        logger.debug("forwarding_event", event_kind=ev.get('event', {}).get('kind'))
+        async with gate.slot(live):
+            r = await get_client().post('/v1/ingest/events', json=ev)
+        r.raise_for_status()
+        metrics.record_event_processed('forward', 'success')
+        logger.info(
+            "event_forwarded",
+            event_kind=ev.get('event', {}).get('kind'),
+            status_code=r.status_code
+        )
+    except Exception as e:
+        metrics.record_event_processed('forward', 'failed')
+        logger.error(
+            "forward_failed",
+            event_kind=ev.get('event', {}).get('kind'),
+            error=str(e),
+            error_type=type(e).__name__
+        )
+        raise
+
+
+async def forward_batch(
+    evs: List[dict],
+    live: bool = True,
+    body: Optional[WireBatch] = None
+) -> List[Optional[Exception]]:
+    """
+    Forward events to the Local API in one batch request.
+    
+    The request body is `evs` encoded in `config.forward_wire_format`, or
+    `body` forwarded as it arrived when it holds exactly `evs`.
+    
+    Args:
+        evs: Event dicts to forward
+        live: False for spool replay, which yields to live traffic
+        body: Received request body to pass through unchanged
+        
+    Returns:
+        One entry per event: None if accepted, otherwise the exception
+        describing why it was not
+        
+    Raises:
+        httpx.HTTPError: If the request as a whole fails
+    """
+    if body is not None:
+        content, headers = body.body, body.headers()
+    else:
+        content, headers = encode_batch(evs, config.forward_wire_format)
+    try:
+        async with gate.slot(live):
+            r = await get_client().post('/v1/ingest/events:batch', content=content, headers=headers)
+        r.raise_for_status()
+    except Exception as e:
+        metrics.record_event_processed('forward', 'failed')
+        logger.error(
+            "forward_batch_failed",
+            count=len(evs),
+            error=str(e),
+            error_type=type(e).__name__
+        )
+        raise
+    
+    outcomes: List[Optional[Exception]] = [None] * len(evs)
+    for item in r.json().get('results', []):
+        idx = item.get('index')
+        if item.get('status') == 'rejected' and isinstance(idx, int) and 0 <= idx < len(evs):
+            outcomes[idx] = ForwardRejected(item.get('error', 'rejected'))
+    
+    for outcome in outcomes:
+        metrics.record_event_processed('forward', 'failed' if outcome else 'success')
+    logger.info(
+        "batch_forwarded",
+        count=len(evs),
+        passthrough=body is not None,
+        rejected=sum(1 for o in outcomes if o),
+        status_code=r.status_code
+    )
+    return outcomes
+
+
+async def forward_one(ev: dict) -> None:
+    """
+    Forward a single event, coalescing it into a batch when enabled.
+    
+    Raises:
+        Exception: If the event was not accepted by the Local API
+    """
+    if _coalescer is None:
+        await forward(ev)
+        return
+    
+    err = await _coalescer.submit(ev)
+    if err is not None:
+        raise err
 
 
 def spool(ev: dict) -> None:
     """
-    Spool an event to disk for later retry.
+    Append an event to the spool log for later retry.
     
     Args:
         ev: Event dict to spool
     """
     try:
-        idem_key = ev.get('idempotency_key', '') or str(uuid.uuid4())
-        timestamp = int(time.time() * 1e6)
-        fname = SPOOL_DIR / f"{idem_key}_{timestamp}.json"
-        fname.write_text(json.dumps(ev), encoding='utf-8')
+        spooler.append(ev)
         metrics.record_event_processed('spool', 'success')
-        logger.info("event_spooled", filename=fname.name)
+        metrics.update_spool_count(spooler.pending)
+        logger.info("event_spooled", idempotency_key=ev.get('idempotency_key'), pending=spooler.pending)
     except Exception as e:
         metrics.record_event_processed('spool', 'failed')
         logger.error(
@@ -135,42 +269,73 @@ def spool(ev: dict) -> None:
         )
 
 
-async def drain_spool() -> None:
+def is_permanent_failure(e: Exception) -> bool:
+    """True if the Local API rejected the event in a way retrying cannot fix."""
+    if isinstance(e, ForwardRejected):
+        return True
+    if isinstance(e, httpx.HTTPStatusError):
+        code = e.response.status_code
+        return 400 <= code < 500 and code not in (408, 429)
+    return False
+
+
+async def replay_batch(evs: List[dict]) -> List[Optional[Exception]]:
     """
-    Background task to drain the spool directory.
+    Deliver spooled events at replay priority.
     
-    Continuously attempts to forward spooled events to the Local API.
-    Runs every `config.drain_interval_s` seconds.
+    If the Local API rejects the batch as a whole with a non-retryable 4xx,
+    fall back to single forwards so that only the offending events are
+    dead-lettered.
     """
-    logger.info("spool_drainer_started", interval_s=config.drain_interval_s)
+    try:
+        return await forward_batch(evs, live=False)
+    except Exception as e:
+        if not is_permanent_failure(e):
+            raise
     
-    while True:
+    outcomes: List[Optional[Exception]] = []
+    for ev in evs:
         try:
-            files = sorted(SPOOL_DIR.glob('*.json'))
-            spool_count = len(files)
-            metrics.update_spool_count(spool_count)
-            
-            if spool_count > 0:
-                logger.debug("draining_spool", count=spool_count)
-            
-            for p in files:
-                try:
-                    data = json.loads(p.read_text(encoding='utf-8'))
-                    await forward(data)
-                    p.unlink(missing_ok=True)
-                    logger.debug("spool_file_processed", filename=p.name)
-                except Exception as e:
-                    logger.warning(
-                        "spool_drain_item_failed",
-                        filename=p.name,
-                        error=str(e)
-                    )
-                    # Keep file for next attempt
-            
+            await forward(ev, live=False)
+            outcomes.append(None)
         except Exception as e:
-            logger.error("spool_drain_error", error=str(e))
-        
-        await asyncio.sleep(config.drain_interval_s)
+            outcomes.append(e)
+    return outcomes
+
+
+drainer = SpoolDrainer(
+    spooler,
+    replay_batch,
+    batch_size=config.max_batch_size,
+    max_concurrency=config.drain_max_concurrency,
+    target_latency_s=config.drain_target_latency_s,
+    high_water=config.spool_high_water,
+    low_water=config.spool_low_water,
+    is_permanent=is_permanent_failure,
+    on_outcome=lambda status, count: metrics.record_event_processed('drain', status, count)
+)
+
+
+async def drain_spool() -> None:
+    """
+    Background task to drain the spool log.
+    
+    Replays spooled events to the Local API in concurrent batches.
+    Runs every `config.drain_interval_s` seconds, longer while backing off.
+    """
+    await drainer.run(
+        config.drain_interval_s,
+        on_cycle=lambda: metrics.update_spool_count(spooler.pending)
+    )
+
+
+def backpressure_response(body: dict) -> JSONResponse:
+    """429 response telling clients to retry later instead of growing the spool."""
+    return JSONResponse(
+        {**body, 'ok': False, 'error': 'spool above high-water mark'},
+        status_code=429,
+        headers={'Retry-After': str(drainer.retry_after_s())}
+    )
 
 
 @app.on_event('startup')
@@ -182,14 +347,37 @@ async def start() -> None:
         spool_dir=str(SPOOL_DIR),
         drain_interval_s=config.drain_interval_s
     )
+    global _coalescer
+    parse_format(config.forward_wire_format)
+    get_client()
+    if config.coalesce_enabled:
+        _coalescer = BatchCoalescer(
+            forward_batch,
+            max_items=config.max_batch_size,
+            linger_s=config.coalesce_linger_ms / 1000.0,
+            name='sidecar-forward'
+        )
+        logger.info(
+            "forward_coalescing_enabled",
+            linger_ms=config.coalesce_linger_ms,
+            max_batch_size=config.max_batch_size
+        )
     asyncio.create_task(drain_spool())
     logger.info("service_started")
 
 
 @app.on_event('shutdown')
 async def shutdown() -> None:
-    """Shutdown handler."""
+    """Shutdown handler - flush coalesced events and close the HTTP client."""
+    global _client, _coalescer
     logger.info("service_shutting_down")
+    if _coalescer is not None:
+        await _coalescer.close()
+        _coalescer = None
+    if _client is not None:
+        await _client.aclose()
+        _client = None
+    spooler.close()
 
 
 @app.post('/v1/ingest/events')
@@ -198,7 +386,8 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
     Ingest a single event.
     
     Attempts to forward immediately. If forwarding fails, spools the event
-    for later retry by the background drainer.
+    for later retry by the background drainer. Events whose idempotency key
+    was accepted recently are acknowledged without forwarding.
     
     Args:
         ev: Event to ingest
@@ -206,9 +395,18 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
     Returns:
         Success response
     """
+    if is_duplicate(ev.idempotency_key):
+        return JSONResponse({'ok': True, 'duplicate': True})
     try:
-        await forward(ev.model_dump())
+        await forward_one(ev.model_dump())
     except Exception as e:
+        if drainer.check_backpressure():
+            logger.warning(
+                "forward_failed_backpressure",
+                idempotency_key=ev.idempotency_key,
+                error=str(e)
+            )
+            return backpressure_response({})
         logger.warning(
             "forward_failed_spooling",
             idempotency_key=ev.idempotency_key,
@@ -216,63 +414,101 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
         )
         spool(ev.model_dump())
     
+    remember_keys([ev.idempotency_key])
     return JSONResponse({'ok': True})
 
 
 @app.post('/v1/ingest/events:batch')
-async def ingest_batch(events: List[IngestEvent]) -> JSONResponse:
+async def ingest_batch(request: Request) -> JSONResponse:
     """
     Ingest a batch of events.
     
-    Attempts to forward each event. Failed events are spooled.
+    Accepts the same body formats as the Local API batch endpoint (JSON or
+    msgpack, optionally zstd-compressed). Forwards the events in chunks of
+    `config.max_batch_size` through the Local API batch endpoint. Events
+    that are not accepted are spooled. Repeated idempotency keys (within
+    the batch or accepted recently) are dropped before forwarding.
+    
+    A batch that fits in one chunk and loses no duplicates is forwarded as
+    the received body, without re-encoding it.
     
     Args:
-        events: List of events to ingest
+        request: Request whose body holds the events to ingest
         
     Returns:
         Response with forwarding statistics
     """
+    batch = await read_batch(request)
+    events: List[IngestEvent] = validate_items(batch.items, IngestEvent)
     ok = 0
-    for ev in events:
+    failed: List[int] = []
+    # Positions in `events` of the events that are forwarded
+    positions = first_occurrences([ev.idempotency_key for ev in events], is_duplicate)
+    duplicates = len(events) - len(positions)
+    # The validated documents themselves; the models are only needed for the keys
+    evs = [batch.items[i] for i in positions]
+    passthrough = batch if not duplicates and len(evs) <= config.max_batch_size else None
+    
+    for i in range(0, len(evs), config.max_batch_size):
+        chunk = evs[i:i + config.max_batch_size]
         try:
-            await forward(ev.model_dump())
-            ok += 1
+            outcomes = await forward_batch(chunk, body=passthrough)
         except Exception:
-            spool(ev.model_dump())
+            outcomes = [Exception('batch forward failed')] * len(chunk)
+        for j, outcome in enumerate(outcomes):
+            if outcome is None:
+                ok += 1
+            else:
+                failed.append(i + j)
+    
+    if failed and drainer.check_backpressure():
+        failed_set = set(failed)
+        remember_keys([ev['idempotency_key'] for j, ev in enumerate(evs) if j not in failed_set])
+        logger.warning("batch_backpressure", total=len(events), forwarded=ok, rejected=len(failed))
+        return backpressure_response({'forwarded': ok, 'rejected_indices': [positions[j] for j in failed]})
+    
+    for idx in failed:
+        spool(evs[idx])
+    remember_keys([ev['idempotency_key'] for ev in evs])
     
     logger.info(
         "batch_processed",
         total=len(events),
         forwarded=ok,
-        spooled=len(events) - ok
+        spooled=len(evs) - ok,
+        duplicates=duplicates
     )
     
     return JSONResponse({
         'ok': True,
         'forwarded': ok,
-        'spooled': len(events) - ok
+        'spooled': len(evs) - ok,
+        'duplicates': duplicates
     })
 
 
 @app.get('/v1/healthz')
 async def healthz() -> JSONResponse:
     """Health check endpoint."""
-    spool_count = len(list(SPOOL_DIR.glob('*.json')))
+    spool_count = spooler.pending
     return JSONResponse({
         'status': 'ok',
         'service': config.service_name,
         'version': '2.0.0',
         'spool_count': spool_count,
-        'spool_dir': str(SPOOL_DIR)
+        'spool_dir': str(SPOOL_DIR),
+        'drain': drainer.stats(),
+        'dedup': dedup.stats() if dedup else 'disabled'
     })
 
 
 @app.get('/metrics')
-async def metrics_endpoint() -> Response:
-    """Prometheus metrics endpoint."""
+async def metrics_endpoint(request: Request) -> Response:
+    """Prometheus metrics endpoint (OpenMetrics with exemplars if requested)."""
+    accept = request.headers.get('accept')
     return Response(
-        content=metrics.get_metrics(),
-        media_type=metrics.get_content_type()
+        content=metrics.get_metrics(accept),
+        media_type=metrics.get_content_type(accept)
     )
 
 
@@ -12,12 +12,11 @@ Enhanced version that supports multiple backends simultaneously:
 import os
 import asyncio
 import json
-import uuid
 from pathlib import Path
 from fastapi import FastAPI, Request, Response
 from fastapi.responses import JSONResponse
 from pydantic import BaseModel
-from typing import List, Dict, Any
+from typing import List, Dict, Any, Optional
 import time
 
 # Import shared utilities
@@ -25,7 +24,10 @@ import sys
 sys.path.insert(0, str(Path(__file__).parent.parent))
 from shared_utils import setup_logging, get_logger
 from shared_utils import MetricsCollector, get_metrics_collector
-from shared_utils import SidecarAgentConfig
+from shared_utils import SidecarAgentConfig, SegmentedSpool, DedupFilter, first_occurrences
+from shared_utils import SpoolDrainer, PriorityGate
+from shared_utils.metrics import route_template
+from shared_utils.wire import read_batch, validate_items
 from shared_utils.integrations import IntegrationContainer, get_container, IntegrationConfig, IntegrationType
 
 # Configuration
@@ -38,9 +40,15 @@ logger = get_logger(__name__)
 # Initialize metrics collector
 metrics = get_metrics_collector(config.service_name)
 
-# Setup directories
+# Open the spool log (migrates a legacy one-file-per-event spool on first start)
 SPOOL_DIR = Path(config.spool_dir)
-SPOOL_DIR.mkdir(parents=True, exist_ok=True)
+spooler = SegmentedSpool(
+    SPOOL_DIR,
+    segment_max_bytes=config.spool_segment_max_bytes,
+    fsync_batch=config.spool_fsync_batch,
+    fsync_interval_s=config.spool_fsync_interval_s
+)
+metrics.update_spool_count(spooler.pending)
 
 # FastAPI app
 app = FastAPI(
@@ -52,6 +60,27 @@ app = FastAPI(
 # Integration container (dependency injection)
 container: IntegrationContainer = get_container()
 
+# Shares backend capacity between live traffic and spool replay, live first
+gate = PriorityGate(config.max_connections)
+
+# Idempotency keys dispatched or spooled recently; client retries of those are dropped
+dedup = DedupFilter(config.dedup_max_keys, config.dedup_window_s) if config.dedup_enabled else None
+
+
+def is_duplicate(key: str) -> bool:
+    """Check the dedup filter; True if an event with `key` was accepted recently."""
+    if dedup is None or not dedup.seen(key):
+        return False
+    metrics.record_duplicates('filter')
+    return True
+
+
+def remember_keys(keys: List[str]) -> None:
+    """Record idempotency keys of dispatched or spooled events in the dedup filter."""
+    if dedup is not None:
+        dedup.add_many(keys)
+        metrics.update_cache_size('dedup', len(dedup))
+
 
 class IngestEvent(BaseModel):
     """Event model for ingestion."""
@@ -71,7 +100,7 @@ async def metrics_middleware(request: Request, call_next):
     
     metrics.record_http_request(
         method=request.method,
-        endpoint=request.url.path,
+        endpoint=route_template(request),
         status=response.status_code,
         duration=duration
     )
@@ -79,19 +108,21 @@ async def metrics_middleware(request: Request, call_next):
     return response
 
 
-async def forward(ev: dict) -> Dict[str, bool]:
+async def forward(ev: dict, live: bool = True) -> Dict[str, bool]:
     """
     Forward an event to all enabled integrations.
     
     Args:
         ev: Event dict to forward
+        live: False for spool replay, which yields to live traffic
         
     Returns:
         Dictionary mapping integration name to success status
     """
     logger.debug("forwarding_event_to_integrations", event_kind=ev.get('event', {}).get('kind'))
     
-    results = await container.send_event(ev)
+    async with gate.slot(live):
+        results = await container.send_event(ev)
     
     # Record metrics for each integration
     for integration_name, success in results.items():
@@ -121,18 +152,16 @@ async def forward(ev: dict) -> Dict[str, bool]:
 
 def spool(ev: dict) -> None:
     """
-    Spool an event to disk for later retry.
+    Append an event to the spool log for later retry.
     
     Args:
         ev: Event dict to spool
     """
     try:
-        idem_key = ev.get('idempotency_key', '') or str(uuid.uuid4())
-        timestamp = int(time.time() * 1e6)
-        fname = SPOOL_DIR / f"{idem_key}_{timestamp}.json"
-        fname.write_text(json.dumps(ev), encoding='utf-8')
+        spooler.append(ev)
         metrics.record_event_processed('spool', 'success')
-        logger.info("event_spooled", filename=fname.name)
+        metrics.update_spool_count(spooler.pending)
+        logger.info("event_spooled", idempotency_key=ev.get('idempotency_key'), pending=spooler.pending)
     except Exception as e:
         metrics.record_event_processed('spool', 'failed')
         logger.error(
@@ -142,48 +171,60 @@ def spool(ev: dict) -> None:
         )
 
 
+async def replay_batch(evs: List[dict]) -> List[Optional[Exception]]:
+    """
+    Deliver spooled events to all integrations at replay priority.
+    
+    A batch counts as delivered once at least one integration accepted all
+    of it, matching the single-event rule. Replay only takes free queue
+    capacity, so it never displaces live events.
+    
+    Raises:
+        RuntimeError: If no integration accepted the batch
+    """
+    async with gate.slot(live=False):
+        results = await container.send_batch(evs, live=False)
+    
+    for integration_name, result in results.items():
+        metrics.record_event_processed(f'replay_{integration_name}', 'success', result.get('success', 0))
+        metrics.record_event_processed(f'replay_{integration_name}', 'failed', result.get('failed', 0))
+    
+    if not any(result.get('failed', 0) == 0 for result in results.values()):
+        raise RuntimeError('batch failed on all integrations')
+    return [None] * len(evs)
+
+
+drainer = SpoolDrainer(
+    spooler,
+    replay_batch,
+    batch_size=config.max_batch_size,
+    max_concurrency=config.drain_max_concurrency,
+    target_latency_s=config.drain_target_latency_s,
+    high_water=config.spool_high_water,
+    low_water=config.spool_low_water,
+    on_outcome=lambda status, count: metrics.record_event_processed('drain', status, count)
+)
+
+
 async def drain_spool() -> None:
     """
-    Background task to drain the spool directory.
+    Background task to drain the spool log.
     
-    Continuously attempts to forward spooled events to all integrations.
+    Replays spooled events to all integrations in concurrent batches.
     """
-    logger.info("spool_drainer_started", interval_s=config.drain_interval_s)
-    
-    while True:
-        try:
-            files = sorted(SPOOL_DIR.glob('*.json'))
-            spool_count = len(files)
-            metrics.update_spool_count(spool_count)
-            
-            if spool_count > 0:
-                logger.debug("draining_spool", count=spool_count)
-            
-            for p in files:
-                try:
-                    data = json.loads(p.read_text(encoding='utf-8'))
-                    results = await forward(data)
-                    
-                    # Only remove file if at least one integration succeeded
-                    if any(results.values()):
-                        p.unlink(missing_ok=True)
-                        logger.debug("spool_file_processed", filename=p.name)
-                    else:
-                        logger.warning(
-                            "spool_file_forward_all_failed",
-                            filename=p.name
-                        )
-                except Exception as e:
-                    logger.warning(
-                        "spool_drain_item_failed",
-                        filename=p.name,
-                        error=str(e)
-                    )
-            
-        except Exception as e:
-            logger.error("spool_drain_error", error=str(e))
-        
-        await asyncio.sleep(config.drain_interval_s)
+    await drainer.run(
+        config.drain_interval_s,
+        on_cycle=lambda: metrics.update_spool_count(spooler.pending)
+    )
+
+
+def backpressure_response(body: dict) -> JSONResponse:
+    """429 response telling clients to retry later instead of growing the spool."""
+    return JSONResponse(
+        {**body, 'ok': False, 'error': 'spool above high-water mark'},
+        status_code=429,
+        headers={'Retry-After': str(drainer.retry_after_s())}
+    )
 
 
 @app.on_event('startup')
@@ -195,6 +236,16 @@ async def start() -> None:
         drain_interval_s=config.drain_interval_s
     )
     
+    # Undeliverable events are kept in per-integration spools
+    container.on_outcome = metrics.record_integration_events
+    container.spool_dir = config.integration_spool_dir
+    container.spool_options = {
+        'segment_max_bytes': config.spool_segment_max_bytes,
+        'fsync_batch': config.spool_fsync_batch,
+        'fsync_interval_s': config.spool_fsync_interval_s
+    }
+    container.drain_interval_s = config.drain_interval_s
+    
     # Load integrations from environment
     container.register_from_env()
     
@@ -219,7 +270,9 @@ async def start() -> None:
 async def shutdown() -> None:
     """Shutdown handler - close all integrations."""
     logger.info("service_shutting_down")
-    await container.close_all()
+    # Queued events that cannot be delivered in time are spooled
+    await container.close_all(config.integration_drain_timeout_s)
+    spooler.close()
     logger.info("service_shutdown_complete")
 
 
@@ -237,16 +290,22 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
     Returns:
         Success response with forwarding details
     """
+    if is_duplicate(ev.idempotency_key):
+        return JSONResponse({'ok': True, 'duplicate': True})
     results = await forward(ev.model_dump())
     
-    # If all integrations failed, spool the event
+    # If all integrations failed, spool the event (unless the spool is full)
     if not any(results.values()):
+        if drainer.check_backpressure():
+            logger.warning("all_integrations_failed_backpressure", idempotency_key=ev.idempotency_key)
+            return backpressure_response({'integrations': results})
         logger.warning(
             "all_integrations_failed_spooling",
             idempotency_key=ev.idempotency_key
         )
         spool(ev.model_dump())
     
+    remember_keys([ev.idempotency_key])
     return JSONResponse({
         'ok': True,
         'integrations': results
@@ -254,39 +313,53 @@ async def ingest(ev: IngestEvent) -> JSONResponse:
 
 
 @app.post('/v1/ingest/events:batch')
-async def ingest_batch(events: List[IngestEvent]) -> JSONResponse:
+async def ingest_batch(request: Request) -> JSONResponse:
     """
     Ingest a batch of events.
     
-    Forwards batch to all enabled integrations. Failed events are spooled.
+    Accepts JSON or msgpack bodies, optionally zstd-compressed. Forwards
+    batch to all enabled integrations. Failed events are spooled.
+    Repeated idempotency keys (within the batch or accepted recently) are
+    dropped first.
     
     Args:
-        events: List of events to ingest
+        request: Request whose body holds the events to ingest
         
     Returns:
         Response with batch forwarding statistics
     """
-    event_dicts = [ev.model_dump() for ev in events]
+    batch = await read_batch(request)
+    events: List[IngestEvent] = validate_items(batch.items, IngestEvent)
+    event_dicts = [batch.items[i] for i in first_occurrences([ev.idempotency_key for ev in events], is_duplicate)]
+    duplicates = len(events) - len(event_dicts)
+    if not event_dicts:
+        return JSONResponse({'ok': True, 'total': len(events), 'duplicates': duplicates, 'integration_results': {}})
     results = await container.send_batch(event_dicts)
     
     # Spool events that failed on all integrations
-    for i, ev in enumerate(events):
-        all_failed = all(
-            result.get('failed', 0) > 0 
-            for result in results.values()
-        )
-        if all_failed:
-            spool(ev.model_dump())
+    all_failed = all(
+        result.get('failed', 0) > 0
+        for result in results.values()
+    )
+    if all_failed:
+        if drainer.check_backpressure():
+            logger.warning("batch_backpressure", total=len(events))
+            return backpressure_response({'total': len(events), 'integration_results': results})
+        for ev in event_dicts:
+            spool(ev)
+    remember_keys([ev['idempotency_key'] for ev in event_dicts])
     
     logger.info(
         "batch_processed",
         total=len(events),
+        duplicates=duplicates,
         integration_results=results
     )
     
     return JSONResponse({
         'ok': True,
         'total': len(events),
+        'duplicates': duplicates,
         'integration_results': results
     })
 
@@ -294,7 +367,7 @@ async def ingest_batch(events: List[IngestEvent]) -> JSONResponse:
 @app.get('/v1/healthz')
 async def healthz() -> JSONResponse:
     """Health check endpoint with integration status."""
-    spool_count = len(list(SPOOL_DIR.glob('*.json')))
+    spool_count = spooler.pending
     
     # Check health of all integrations
     integration_health = await container.health_check_all()
@@ -311,6 +384,8 @@ async def healthz() -> JSONResponse:
         'version': '3.0.0',
         'spool_count': spool_count,
         'spool_dir': str(SPOOL_DIR),
+        'drain': drainer.stats(),
+        'dedup': dedup.stats() if dedup else 'disabled',
         'integrations': integration_health
     })
 
@@ -325,16 +400,20 @@ async def list_integrations() -> JSONResponse:
         'total': len(all_integrations),
         'enabled': len(enabled),
         'integrations': all_integrations,
-        'enabled_integrations': enabled
+        'enabled_integrations': enabled,
+        'queues': container.queue_stats()
     })
 
 
 @app.get('/metrics')
-async def metrics_endpoint() -> Response:
-    """Prometheus metrics endpoint."""
+async def metrics_endpoint(request: Request) -> Response:
+    """Prometheus metrics endpoint (OpenMetrics with exemplars if requested)."""
+    for name, stats in container.queue_stats().items():
+        metrics.update_integration_queue(name, stats['depth'], stats['lag_s'])
+    accept = request.headers.get('accept')
     return Response(
-        content=metrics.get_metrics(),
-        media_type=metrics.get_content_type()
+        content=metrics.get_metrics(accept),
+        media_type=metrics.get_content_type(accept)
     )
 
 
@@ -6,6 +6,10 @@ Provides centralized monitoring across multiple fabrication sites with:
 - Cross-site analytics
 - Site health monitoring
 - Aggregated metrics
+
+As in the local dashboard, job tables are shared frames kept current with
+`since` deltas, and charts, totals and the site comparison come from the
+federated /v1/stats/jobs aggregates rather than raw job pages.
 """
 import os
 import requests
@@ -13,12 +17,30 @@ import streamlit as st
 import pandas as pd
 import plotly.express as px
 import plotly.graph_objects as go
-from datetime import datetime, timedelta
+from datetime import datetime, timedelta, timezone
 from typing import Dict, List, Any
 
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent))
+from shared_utils.delta import DeltaFrame
+from shared_utils.stats import merge_job_buckets
+
 CENTRAL_API = os.getenv('CENTRAL_API', 'http://localhost:19000')
 DEFAULT_SITE = os.getenv('DEFAULT_SITE', 'fab1')
 
+# Shortest interval between two delta requests of a shared frame
+REFRESH_S = 15.0
+# Jobs kept by a frame
+FRAME_ROWS = 1000
+
+STATUS_COLORS = {
+    'succeeded': '#00cc00',
+    'failed': '#ff4444',
+    'running': '#4488ff',
+    'canceled': '#999999'
+}
+
 # Page configuration
 st.set_page_config(
     page_title='Central Wafer Monitor',
@@ -113,17 +135,58 @@ with st.sidebar.expander('🌍 Multi-Site Comparison'):
         )
 
 
-@st.cache_data(ttl=15 if auto_refresh else 60)
-def load_jobs(site_id: str, params: Dict[str, Any]) -> Dict[str, Any]:
-    """Load jobs from Central API for a specific site."""
+def api_get(path: str, params: Dict[str, Any], timeout: float = 5) -> Dict[str, Any]:
+    """GET a Central API endpoint and decode the JSON body."""
+    r = requests.get(f'{CENTRAL_API}{path}', params=params, timeout=timeout)
+    r.raise_for_status()
+    return r.json()
+
+
+@st.cache_resource(max_entries=64, show_spinner=False)
+def job_frame(site_id: str, hours: int, status: str, app_name: str) -> DeltaFrame:
+    """Incremental job frame for one site and filter set, shared by all sessions."""
+    params = {'site': site_id, 'status': status}
+    if app_name:
+        params['app_name'] = app_name
+    return DeltaFrame(
+        lambda p: api_get('/v1/jobs', p),
+        'job_id',
+        params,
+        window=timedelta(hours=hours),
+        max_rows=FRAME_ROWS,
+        min_interval_s=REFRESH_S
+    )
+
+
+@st.cache_data(ttl=30, show_spinner=False)
+def load_job_stats(site_ids: str, hours: int, status: str, app_name: str, group_by: str = '') -> Dict[str, Any]:
+    """Load time-bucketed job statistics for one or several sites (comma-separated)."""
+    params = {
+        'site': site_ids,
+        'from': (datetime.now(timezone.utc) - timedelta(hours=hours)).isoformat(),
+        'status': status
+    }
+    if group_by:
+        params['group_by'] = group_by
+    if app_name:
+        params['app_name'] = app_name
     try:
-        params['site'] = site_id
-        r = requests.get(f'{CENTRAL_API}/v1/jobs', params=params, timeout=5)
-        r.raise_for_status()
-        return r.json()
+        return api_get('/v1/stats/jobs', params)
     except Exception as e:
-        st.error(f"Failed to load jobs for {site_id}: {str(e)}")
-        return {'items': [], 'count': 0}
+        st.error(f"Failed to load job statistics for {site_ids}: {str(e)}")
+        return {'buckets': [], 'count': 0}
+
+
+def totals(buckets: List[Dict[str, Any]], group_by: List[str] = ()) -> List[Dict[str, Any]]:
+    """Roll time buckets up into one row per group over the whole window."""
+    return merge_job_buckets([dict(b, bucket='total') for b in buckets], group_by)
+
+
+def running_jobs(site_id: str) -> int:
+    """Running jobs of a site, from a frame that only follows running jobs."""
+    frame = job_frame(site_id, hours, 'running', app_name)
+    frame.refresh()
+    return len(frame)
 
 
 @st.cache_data(ttl=10 if auto_refresh else 30)
@@ -137,27 +200,20 @@ def load_health() -> Dict[str, Any]:
         return {'status': 'error', 'error': str(e), 'sites': {}}
 
 
-# Build query parameters
-now = datetime.utcnow()
-delta = {'1h': 1, '6h': 6, '24h': 24, '72h': 72}[window]
-frm = (now - timedelta(hours=delta)).isoformat() + 'Z'
-to = now.isoformat() + 'Z'
-
-params = {
-    'from': frm,
-    'to': to,
-    'status': ','.join(status) if status else '',
-    'limit': 1000
-}
-
-if app_name:
-    params['app_name'] = app_name
-
 # Load data
-data = load_jobs(site, params)
-items = data.get('items', [])
+hours = {'1h': 1, '6h': 6, '24h': 24, '72h': 72}[window]
+status_param = ','.join(status) if status else ''
+
+frame = job_frame(site, hours, status_param, app_name)
+frame.refresh()
+if frame.error:
+    st.error(f"Failed to load jobs for {site}: {frame.error}")
+items = frame.rows()
 health = load_health()
 
+by_status = load_job_stats(site, hours, status_param, app_name, 'status')
+status_buckets = by_status.get('buckets', [])
+
 # Display system health
 st.sidebar.divider()
 st.sidebar.subheader('🏥 System Health')
@@ -184,14 +240,15 @@ for site_id in available_sites:
 # Main dashboard
 st.subheader(f"📊 Site: {site}")
 
-# Key metrics
+# Key metrics: finished jobs from the aggregates, running ones from the frame
 col1, col2, col3, col4, col5 = st.columns(5)
 
-total_jobs = len(items)
-succeeded = sum(1 for i in items if i.get('status') == 'succeeded')
-failed = sum(1 for i in items if i.get('status') == 'failed')
+finished = {row['status']: row['job_count'] for row in totals(status_buckets, ['status'])}
+succeeded = finished.get('succeeded', 0)
+failed = finished.get('failed', 0)
+canceled = finished.get('canceled', 0)
 running = sum(1 for i in items if i.get('status') == 'running')
-canceled = sum(1 for i in items if i.get('status') == 'canceled')
+total_jobs = sum(finished.values()) + running
 
 col1.metric('📊 Total Jobs', total_jobs)
 col2.metric('✅ Succeeded', succeeded)
@@ -204,24 +261,29 @@ if total_jobs > 0:
     success_rate = (succeeded / (succeeded + failed)) * 100 if (succeeded + failed) > 0 else 0
     st.metric('🎯 Success Rate', f"{success_rate:.2f}%")
 
-# Multi-site comparison
-if compare_sites and 'comparison_sites' in locals():
+# Multi-site comparison: one federated stats query for all sites
+if compare_sites and 'comparison_sites' in locals() and comparison_sites:
     st.divider()
     st.subheader('🌍 Multi-Site Comparison')
     
+    comparison = load_job_stats(','.join(comparison_sites), hours, status_param, app_name, 'site_id,status')
+    per_site: Dict[str, Dict[str, int]] = {cs: {} for cs in comparison_sites}
+    for row in totals(comparison.get('buckets', []), ['site_id', 'status']):
+        per_site.setdefault(row['site_id'], {})[row['status']] = row['job_count']
+    
     comparison_data = []
-    for comp_site in comparison_sites:
-        site_data = load_jobs(comp_site, params)
-        site_items = site_data.get('items', [])
-        
+    for comp_site, counts in per_site.items():
+        site_running = running_jobs(comp_site) if 'running' in status else 0
+        site_succeeded = counts.get('succeeded', 0)
+        site_failed = counts.get('failed', 0)
+        site_total = sum(counts.values()) + site_running
         comparison_data.append({
             'Site': comp_site,
-            'Total Jobs': len(site_items),
-            'Succeeded': sum(1 for i in site_items if i.get('status') == 'succeeded'),
-            'Failed': sum(1 for i in site_items if i.get('status') == 'failed'),
-            'Running': sum(1 for i in site_items if i.get('status') == 'running'),
-            'Success Rate (%)': (sum(1 for i in site_items if i.get('status') == 'succeeded') / 
-                                len(site_items) * 100) if site_items else 0
+            'Total Jobs': site_total,
+            'Succeeded': site_succeeded,
+            'Failed': site_failed,
+            'Running': site_running,
+            'Success Rate (%)': (site_succeeded / site_total * 100) if site_total else 0
         })
     
     df_comparison = pd.DataFrame(comparison_data)
@@ -243,79 +305,73 @@ if compare_sites and 'comparison_sites' in locals():
     
     # Comparison table
     st.dataframe(df_comparison, use_container_width=True, hide_index=True)
+    if comparison.get('partial'):
+        st.warning('Some sites did not answer; their figures are missing')
 
 # Charts
-if items:
+if status_buckets or running:
     st.divider()
     st.subheader('📈 Analytics')
     
-    df = pd.DataFrame(items)
-    
-    # Convert timestamps
-    if 'inserted_at' in df.columns:
-        df['inserted_at'] = pd.to_datetime(df['inserted_at'])
-    
     chart_col1, chart_col2 = st.columns(2)
     
     with chart_col1:
         # Status pie chart
-        status_counts = df['status'].value_counts()
+        status_counts = pd.Series({**finished, 'running': running})
+        status_counts = status_counts[status_counts > 0]
         fig_pie = px.pie(
             values=status_counts.values,
             names=status_counts.index,
             title=f'Job Status Distribution - {site}',
             color=status_counts.index,
-            color_discrete_map={
-                'succeeded': '#00cc00',
-                'failed': '#ff4444',
-                'running': '#4488ff',
-                'canceled': '#999999'
-            }
+            color_discrete_map=STATUS_COLORS
         )
         st.plotly_chart(fig_pie, use_container_width=True)
     
     with chart_col2:
-        # Timeline
-        if 'inserted_at' in df.columns:
-            df_time = df.set_index('inserted_at').resample('1H').size().reset_index(name='count')
+        # Timeline of finished jobs
+        if status_buckets:
+            df_time = pd.DataFrame([
+                {'bucket': b['bucket'], 'job_count': b['job_count']}
+                for b in merge_job_buckets(status_buckets)
+            ])
+            df_time['bucket'] = pd.to_datetime(df_time['bucket'])
+            per = 'Day' if by_status.get('granularity') == 'day' else 'Hour'
             fig_time = px.area(
                 df_time,
-                x='inserted_at',
-                y='count',
+                x='bucket',
+                y='job_count',
                 title=f'Job Activity Timeline - {site}',
-                labels={'inserted_at': 'Time', 'count': 'Jobs per Hour'}
+                labels={'bucket': 'Time', 'job_count': f'Finished Jobs per {per}'}
             )
             st.plotly_chart(fig_time, use_container_width=True)
     
     # Performance metrics
-    if all(col in df.columns for col in ['duration_s', 'mem_max_mb']):
+    if status_buckets:
         st.divider()
         st.subheader('⚡ Performance Overview')
         
+        summary = totals(status_buckets)[0]
         perf_col1, perf_col2, perf_col3, perf_col4 = st.columns(4)
         
         with perf_col1:
-            avg_duration = df['duration_s'].mean()
-            st.metric('Avg Duration', f"{avg_duration:.2f}s")
+            st.metric('Avg Duration', f"{summary['avg_duration_s'] or 0:.2f}s")
         
         with perf_col2:
-            max_duration = df['duration_s'].max()
-            st.metric('Max Duration', f"{max_duration:.2f}s")
+            st.metric('Max Duration', f"{summary.get('max_duration_s') or 0:.2f}s")
         
         with perf_col3:
-            avg_memory = df['mem_max_mb'].mean()
-            st.metric('Avg Memory', f"{avg_memory:.1f} MB")
+            st.metric('Avg Memory', f"{summary['avg_mem_mb'] or 0:.1f} MB")
         
         with perf_col4:
-            max_memory = df['mem_max_mb'].max()
-            st.metric('Max Memory', f"{max_memory:.1f} MB")
+            st.metric('Max Memory', f"{summary.get('max_mem_mb') or 0:.1f} MB")
 
 # Jobs table
 st.divider()
 st.subheader('📋 Recent Jobs')
 
 if items:
-    st.info(f"Showing {len(items)} jobs from {site} (last {window})")
+    st.info(f"Showing the {len(items)} most recently updated jobs from {site} (last {window})")
     
     df_display = pd.DataFrame(items)
     
@@ -6,6 +6,11 @@ Provides a comprehensive view of local site monitoring with:
 - Interactive charts and visualizations
 - Detailed job and subjob inspection
 - Performance analytics
+
+The jobs table is a frame shared by all sessions and kept current with
+`since` deltas; charts and totals come from the server-side hourly/daily
+aggregates (/v1/stats/jobs), so the load on the API does not grow with the
+number of jobs or open tabs.
 """
 import os
 import requests
@@ -13,11 +18,29 @@ import streamlit as st
 import pandas as pd
 import plotly.express as px
 import plotly.graph_objects as go
-from datetime import datetime, timedelta
+from datetime import datetime, timedelta, timezone
 from typing import Dict, List, Any
 
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent))
+from shared_utils.delta import DeltaFrame
+from shared_utils.stats import merge_job_buckets, HIST_MIN_LOG10, HIST_MAX_LOG10, HIST_BUCKETS
+
 BASE_URL = os.getenv('LOCAL_API', 'http://localhost:18000')
 
+# Shortest interval between two delta requests of a shared frame
+REFRESH_S = 10.0
+# Jobs kept by a frame (the table shows up to 'Max rows to display' of them)
+FRAME_ROWS = 1000
+
+STATUS_COLORS = {
+    'succeeded': '#00cc00',
+    'failed': '#ff4444',
+    'running': '#4488ff',
+    'canceled': '#999999'
+}
+
 # Page configuration
 st.set_page_config(
     page_title='Local Wafer Monitor',
@@ -83,16 +106,45 @@ with st.sidebar.expander('🔧 Advanced Filters'):
     max_rows = st.slider('Max rows to display', 10, 1000, 100)
 
 
-@st.cache_data(ttl=10 if auto_refresh else 60)
-def load_jobs(params: Dict[str, Any]) -> Dict[str, Any]:
-    """Load jobs from the API with caching."""
+def api_get(path: str, params: Dict[str, Any], timeout: float = 5) -> Dict[str, Any]:
+    """GET a Local API endpoint and decode the JSON body."""
+    r = requests.get(f'{BASE_URL}{path}', params=params, timeout=timeout)
+    r.raise_for_status()
+    return r.json()
+
+
+@st.cache_resource(max_entries=32, show_spinner=False)
+def job_frame(hours: int, status: str, app_name: str, rows: int) -> DeltaFrame:
+    """Incremental job frame for one filter set, shared by all sessions."""
+    params = {'status': status}
+    if app_name:
+        params['app_name'] = app_name
+    return DeltaFrame(
+        lambda p: api_get('/v1/jobs', p),
+        'job_id',
+        params,
+        window=timedelta(hours=hours),
+        max_rows=rows,
+        min_interval_s=REFRESH_S
+    )
+
+
+@st.cache_data(ttl=30, show_spinner=False)
+def load_job_stats(hours: int, status: str, app_name: str, group_by: str = '') -> Dict[str, Any]:
+    """Load time-bucketed job statistics for the window."""
+    params = {
+        'from': (datetime.now(timezone.utc) - timedelta(hours=hours)).isoformat(),
+        'status': status
+    }
+    if group_by:
+        params['group_by'] = group_by
+    if app_name:
+        params['app_name'] = app_name
     try:
-        r = requests.get(f'{BASE_URL}/v1/jobs', params=params, timeout=5)
-        r.raise_for_status()
-        return r.json()
+        return api_get('/v1/stats/jobs', params)
     except Exception as e:
-        st.error(f"Failed to load jobs: {str(e)}")
-        return {'items': [], 'count': 0}
+        st.error(f"Failed to load job statistics: {str(e)}")
+        return {'buckets': [], 'count': 0}
 
 
 @st.cache_data(ttl=10 if auto_refresh else 60)
@@ -106,41 +158,53 @@ def load_health() -> Dict[str, Any]:
         return {'status': 'error', 'error': str(e)}
 
 
-# Build query parameters
-now = datetime.utcnow()
-delta = {'1h': 1, '6h': 6, '24h': 24, '72h': 72}[window]
-frm = (now - timedelta(hours=delta)).isoformat() + 'Z'
-to = now.isoformat() + 'Z'
+def totals(buckets: List[Dict[str, Any]], group_by: List[str] = ()) -> List[Dict[str, Any]]:
+    """Roll time buckets up into one row per group over the whole window."""
+    return merge_job_buckets([dict(b, bucket='total') for b in buckets], group_by)
 
-params = {
-    'from': frm,
-    'to': to,
-    'status': ','.join(status) if status else '',
-    'limit': max_rows
-}
 
-if app_name:
-    params['app_name'] = app_name
+def duration_histogram(buckets: List[Dict[str, Any]]) -> pd.DataFrame:
+    """Sum the buckets' log-scale duration histograms (under/overflow slots dropped)."""
+    counts = [0] * (HIST_BUCKETS + 2)
+    for b in buckets:
+        for i, n in enumerate(b.get('duration_hist') or []):
+            counts[i] += n
+    width = (HIST_MAX_LOG10 - HIST_MIN_LOG10) / HIST_BUCKETS
+    return pd.DataFrame({
+        'duration_s': [round(10 ** (HIST_MIN_LOG10 + width * (i + 0.5)), 2) for i in range(HIST_BUCKETS)],
+        'count': counts[1:-1]
+    })
+
 
 # Load data
-data = load_jobs(params)
-items = data.get('items', [])
+hours = {'1h': 1, '6h': 6, '24h': 24, '72h': 72}[window]
+status_param = ','.join(status) if status else ''
+
+frame = job_frame(hours, status_param, app_name, FRAME_ROWS)
+frame.refresh()
+if frame.error:
+    st.error(f"Failed to load jobs: {frame.error}")
+items = frame.rows()
 health = load_health()
 
+by_status = load_job_stats(hours, status_param, app_name, 'status')
+status_buckets = by_status.get('buckets', [])
+
 # Display health status
 if health.get('status') == 'ok':
     st.sidebar.success('✅ API Status: Healthy')
 else:
     st.sidebar.error(f"❌ API Status: {health.get('status', 'Unknown')}")
 
-# Main dashboard
+# Main dashboard: finished jobs from the aggregates, running ones from the frame
 col1, col2, col3, col4, col5 = st.columns(5)
 
-total_jobs = len(items)
-succeeded = sum(1 for i in items if i.get('status') == 'succeeded')
-failed = sum(1 for i in items if i.get('status') == 'failed')
+finished = {row['status']: row['job_count'] for row in totals(status_buckets, ['status'])}
+succeeded = finished.get('succeeded', 0)
+failed = finished.get('failed', 0)
+canceled = finished.get('canceled', 0)
 running = sum(1 for i in items if i.get('status') == 'running')
-canceled = sum(1 for i in items if i.get('status') == 'canceled')
+total_jobs = sum(finished.values()) + running
 
 col1.metric('📊 Total Jobs', total_jobs)
 col2.metric('✅ Succeeded', succeeded, delta=f"{succeeded/total_jobs*100:.1f}%" if total_jobs > 0 else "0%")
@@ -154,128 +218,131 @@ if total_jobs > 0:
     st.metric('🎯 Success Rate', f"{success_rate:.2f}%")
 
 # Charts section
-if show_charts and items:
+if show_charts and (status_buckets or running):
     st.divider()
     st.subheader('📈 Analytics')
     
-    df = pd.DataFrame(items)
-    
-    # Convert timestamps
-    if 'inserted_at' in df.columns:
-        df['inserted_at'] = pd.to_datetime(df['inserted_at'])
-    if 'started_at' in df.columns:
-        df['started_at'] = pd.to_datetime(df['started_at'])
-    if 'ended_at' in df.columns:
-        df['ended_at'] = pd.to_datetime(df['ended_at'])
-    
+    granularity = by_status.get('granularity', 'hour')
     chart_col1, chart_col2 = st.columns(2)
     
     with chart_col1:
         # Status distribution pie chart
-        status_counts = df['status'].value_counts()
+        status_counts = pd.Series({**finished, 'running': running})
+        status_counts = status_counts[status_counts > 0]
         fig_pie = px.pie(
             values=status_counts.values,
             names=status_counts.index,
             title='Job Status Distribution',
             color=status_counts.index,
-            color_discrete_map={
-                'succeeded': '#00cc00',
-                'failed': '#ff4444',
-                'running': '#4488ff',
-                'canceled': '#999999'
-            }
+            color_discrete_map=STATUS_COLORS
         )
         st.plotly_chart(fig_pie, use_container_width=True)
     
     with chart_col2:
-        # Jobs over time
-        if 'inserted_at' in df.columns:
-            df_time = df.set_index('inserted_at').resample('1H').size().reset_index(name='count')
-            fig_time = px.line(
+        # Finished jobs per bucket and status
+        if status_buckets:
+            df_time = pd.DataFrame(status_buckets)
+            df_time['bucket'] = pd.to_datetime(df_time['bucket'])
+            fig_time = px.bar(
                 df_time,
-                x='inserted_at',
-                y='count',
-                title='Jobs Over Time (Hourly)',
-                labels={'inserted_at': 'Time', 'count': 'Number of Jobs'}
+                x='bucket',
+                y='job_count',
+                color='status',
+                title=f"Finished Jobs Over Time ({'Daily' if granularity == 'day' else 'Hourly'})",
+                labels={'bucket': 'Time', 'job_count': 'Number of Jobs'},
+                color_discrete_map=STATUS_COLORS
             )
             st.plotly_chart(fig_time, use_container_width=True)
     
+    stats = load_job_stats(hours, status_param, app_name)
+    buckets = stats.get('buckets', [])
+    
     # Performance metrics
-    if show_metrics and all(col in df.columns for col in ['duration_s', 'cpu_user_s', 'mem_max_mb']):
+    if show_metrics and buckets:
         st.divider()
         st.subheader('⚡ Performance Metrics')
         
+        df_perf = pd.DataFrame(buckets)
+        df_perf['bucket'] = pd.to_datetime(df_perf['bucket'])
+        
         perf_col1, perf_col2, perf_col3 = st.columns(3)
         
         with perf_col1:
-            # Duration histogram
-            fig_duration = px.histogram(
-                df[df['duration_s'].notna()],
+            # Duration histogram (log-scale buckets)
+            fig_duration = px.bar(
+                duration_histogram(buckets),
                 x='duration_s',
+                y='count',
                 title='Job Duration Distribution',
-                labels={'duration_s': 'Duration (seconds)'},
-                nbins=30
+                labels={'duration_s': 'Duration (seconds)', 'count': 'Jobs'},
+                log_x=True
             )
             st.plotly_chart(fig_duration, use_container_width=True)
         
         with perf_col2:
             # CPU usage
-            fig_cpu = px.box(
-                df[df['cpu_user_s'].notna()],
-                y='cpu_user_s',
-                title='CPU Usage Distribution',
-                labels={'cpu_user_s': 'CPU User Time (s)'}
+            fig_cpu = px.line(
+                df_perf,
+                x='bucket',
+                y='avg_cpu_s',
+                title='Average CPU Time',
+                labels={'bucket': 'Time', 'avg_cpu_s': 'CPU Time (s)'}
             )
             st.plotly_chart(fig_cpu, use_container_width=True)
         
         with perf_col3:
             # Memory usage
-            fig_mem = px.box(
-                df[df['mem_max_mb'].notna()],
-                y='mem_max_mb',
-                title='Memory Usage Distribution',
-                labels={'mem_max_mb': 'Peak Memory (MB)'}
+            fig_mem = px.line(
+                df_perf,
+                x='bucket',
+                y=['avg_mem_mb', 'max_mem_mb'],
+                title='Memory Usage',
+                labels={'bucket': 'Time', 'value': 'Memory (MB)'}
             )
             st.plotly_chart(fig_mem, use_container_width=True)
         
         # Performance summary statistics
+        summary = totals(buckets)[0]
         st.subheader('📊 Performance Summary')
         summary_col1, summary_col2, summary_col3 = st.columns(3)
         
         with summary_col1:
-            st.metric('Avg Duration', f"{df['duration_s'].mean():.2f}s")
-            st.metric('Max Duration', f"{df['duration_s'].max():.2f}s")
+            st.metric('Avg Duration', f"{summary['avg_duration_s'] or 0:.2f}s")
+            st.metric('Max Duration', f"{summary.get('max_duration_s') or 0:.2f}s")
         
         with summary_col2:
-            st.metric('Avg CPU Time', f"{df['cpu_user_s'].mean():.2f}s")
-            st.metric('Max CPU Time', f"{df['cpu_user_s'].max():.2f}s")
+            st.metric('Avg CPU Time', f"{summary['avg_cpu_s'] or 0:.2f}s")
+            st.metric('P95 Duration', f"{summary['p95_duration_s'] or 0:.2f}s")
         
         with summary_col3:
-            st.metric('Avg Memory', f"{df['mem_max_mb'].mean():.2f} MB")
-            st.metric('Max Memory', f"{df['mem_max_mb'].max():.2f} MB")
+            st.metric('Avg Memory', f"{summary['avg_mem_mb'] or 0:.2f} MB")
+            st.metric('Max Memory', f"{summary.get('max_mem_mb') or 0:.2f} MB")
     
     # Application breakdown
-    if 'app_name' in df.columns:
+    by_app = totals(load_job_stats(hours, status_param, app_name, 'app_name').get('buckets', []), ['app_name'])
+    if by_app:
         st.divider()
         st.subheader('📦 Application Breakdown')
         
-        app_stats = df.groupby('app_name').agg({
-            'job_id': 'count',
-            'status': lambda x: (x == 'succeeded').sum() / len(x) * 100,
-            'duration_s': 'mean',
-            'mem_max_mb': 'mean'
-        }).round(2)
-        
-        app_stats.columns = ['Total Jobs', 'Success Rate (%)', 'Avg Duration (s)', 'Avg Memory (MB)']
+        app_stats = pd.DataFrame([{
+            'app_name': row['app_name'],
+            'Finished Jobs': row['job_count'],
+            'Success Rate (%)': (row['success_rate'] or 0) * 100,
+            'Avg Duration (s)': row['avg_duration_s'],
+            'Avg Memory (MB)': row['avg_mem_mb']
+        } for row in by_app]).set_index('app_name').round(2)
         st.dataframe(app_stats, use_container_width=True)
 
 # Jobs table
 st.divider()
 st.subheader('📋 Jobs Table')
 
+# The frame keeps more rows than are shown; the newest updates come first
+items = items[:max_rows]
+
 # Display info about filters
 if items:
-    st.info(f"Showing {len(items)} jobs from the last {window}")
+    st.info(f"Showing the {len(items)} most recently updated jobs from the last {window}")
 else:
     st.warning("No jobs found matching the selected filters")
 
@@ -0,0 +1,97 @@
+-- ============================================================================
+-- Migration: duration histograms in the job statistics aggregates
+-- ============================================================================
+-- For databases where timescaledb_enhancements.sql was applied before
+-- job_stats_hourly/job_stats_daily gained `duration_hist` (and, daily,
+-- min/max duration and max memory), which the /v1/stats endpoints read.
+-- Continuous aggregates cannot be altered, so both are dropped and
+-- recreated with their refresh policies, then rebuilt from the job rows.
+--
+-- Buckets older than the job table's retention (72 hours by default)
+-- cannot be rebuilt and are lost; export them first if they are needed.
+-- Also switches all three statistics aggregates to real-time aggregation.
+-- Safe to re-run: the rebuild is a no-op once duration_hist exists.
+-- ============================================================================
+
+DO $$
+BEGIN
+  IF EXISTS (
+    SELECT 1 FROM information_schema.columns
+    WHERE table_name = 'job_stats_daily' AND column_name = 'duration_hist'
+  ) THEN
+    RAISE NOTICE 'job statistics aggregates are up to date';
+    RETURN;
+  END IF;
+
+  DROP MATERIALIZED VIEW IF EXISTS job_stats_hourly;
+  DROP MATERIALIZED VIEW IF EXISTS job_stats_daily;
+
+  -- Same definitions as timescaledb_enhancements.sql; the histogram layout
+  -- must match shared_utils/stats.py
+  CREATE MATERIALIZED VIEW job_stats_hourly
+  WITH (timescaledb.continuous, timescaledb.materialized_only = false) AS
+  SELECT
+      time_bucket('1 hour', inserted_at) AS hour,
+      site_id,
+      app_id,
+      status,
+      COUNT(*) AS job_count,
+      AVG(duration_s) AS avg_duration_s,
+      MAX(duration_s) AS max_duration_s,
+      MIN(duration_s) AS min_duration_s,
+      PERCENTILE_CONT(0.5) WITHIN GROUP (ORDER BY duration_s) AS median_duration_s,
+      PERCENTILE_CONT(0.95) WITHIN GROUP (ORDER BY duration_s) AS p95_duration_s,
+      AVG(cpu_user_s + cpu_system_s) AS avg_cpu_total_s,
+      AVG(mem_max_mb) AS avg_mem_mb,
+      MAX(mem_max_mb) AS max_mem_mb,
+      histogram(log(GREATEST(duration_s, 0.001)), -1.0, 5.0, 48) AS duration_hist
+  FROM job
+  WHERE duration_s IS NOT NULL
+  GROUP BY hour, site_id, app_id, status
+  WITH NO DATA;
+
+  CREATE MATERIALIZED VIEW job_stats_daily
+  WITH (timescaledb.continuous, timescaledb.materialized_only = false) AS
+  SELECT
+      time_bucket('1 day', inserted_at) AS day,
+      site_id,
+      app_id,
+      status,
+      COUNT(*) AS job_count,
+      AVG(duration_s) AS avg_duration_s,
+      MAX(duration_s) AS max_duration_s,
+      MIN(duration_s) AS min_duration_s,
+      AVG(cpu_user_s + cpu_system_s) AS avg_cpu_s,
+      AVG(mem_max_mb) AS avg_mem_mb,
+      MAX(mem_max_mb) AS max_mem_mb,
+      SUM(CASE WHEN status = 'succeeded' THEN 1 ELSE 0 END)::FLOAT / COUNT(*) AS success_rate,
+      histogram(log(GREATEST(duration_s, 0.001)), -1.0, 5.0, 48) AS duration_hist
+  FROM job
+  WHERE duration_s IS NOT NULL
+  GROUP BY day, site_id, app_id, status
+  WITH NO DATA;
+
+  PERFORM add_continuous_aggregate_policy('job_stats_hourly',
+      start_offset => INTERVAL '3 hours',
+      end_offset => INTERVAL '1 hour',
+      schedule_interval => INTERVAL '1 hour',
+      if_not_exists => TRUE
+  );
+
+  PERFORM add_continuous_aggregate_policy('job_stats_daily',
+      start_offset => INTERVAL '7 days',
+      end_offset => INTERVAL '1 day',
+      schedule_interval => INTERVAL '1 day',
+      if_not_exists => TRUE
+  );
+END $$;
+
+-- Serve buckets newer than the last refresh from the raw rows (real-time
+-- aggregation), which newer TimescaleDB versions no longer do by default
+ALTER MATERIALIZED VIEW job_stats_hourly SET (timescaledb.materialized_only = false);
+ALTER MATERIALIZED VIEW job_stats_daily SET (timescaledb.materialized_only = false);
+ALTER MATERIALIZED VIEW event_stats_hourly SET (timescaledb.materialized_only = false);
+
+-- Rebuild from the job rows still in retention (cannot run inside a DO block)
+CALL refresh_continuous_aggregate('job_stats_hourly', NULL, NULL);
+CALL refresh_continuous_aggregate('job_stats_daily', NULL, NULL);
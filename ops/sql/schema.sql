@@ -52,9 +52,14 @@ CREATE TABLE IF NOT EXISTS event (
   kind          TEXT NOT NULL,
   payload       JSONB NOT NULL,
   idempotency_key TEXT NOT NULL,
+  ingested_at   TIMESTAMPTZ NOT NULL DEFAULT now(),
   PRIMARY KEY (entity_id, at)
 );
 
+-- Time the event was stored, as opposed to `at` (when it happened). Stream
+-- backfills read by it so late-arriving events are not skipped.
+ALTER TABLE event ADD COLUMN IF NOT EXISTS ingested_at TIMESTAMPTZ NOT NULL DEFAULT now();
+
 DO $$ BEGIN
   ALTER TABLE event ADD CONSTRAINT uq_event_idem UNIQUE (idempotency_key);
 EXCEPTION WHEN duplicate_object THEN NULL; END $$;
@@ -70,14 +75,104 @@ SELECT add_retention_policy('event', INTERVAL '72 hours', if_not_exists => TRUE)
 CREATE INDEX IF NOT EXISTS idx_job_site_time ON job(site_id, inserted_at DESC);
 CREATE INDEX IF NOT EXISTS idx_sub_site_time ON subjob(site_id, inserted_at DESC);
 CREATE INDEX IF NOT EXISTS idx_event_site_time ON event(site_id, at DESC);
+CREATE INDEX IF NOT EXISTS idx_event_ingested ON event(ingested_at);
 CREATE INDEX IF NOT EXISTS idx_job_status ON job(status);
 CREATE INDEX IF NOT EXISTS idx_subjob_status ON subjob(status);
 
-CREATE OR REPLACE FUNCTION notify_event() RETURNS trigger AS $$
+-- Current state per job/subjob, upserted at ingest time so queries do not
+-- have to pick the latest row out of the history hypertables. `event_at` is
+-- the time of the event that produced the state; older (replayed) events
+-- never overwrite newer state. `inserted_at` is the time of the last update.
+CREATE TABLE IF NOT EXISTS job_current (
+  job_id        UUID PRIMARY KEY,
+  app_id        UUID NOT NULL,
+  site_id       TEXT NOT NULL,
+  job_key       TEXT NOT NULL,
+  status        TEXT NOT NULL,
+  started_at    TIMESTAMPTZ,
+  ended_at      TIMESTAMPTZ,
+  duration_s    DOUBLE PRECISION,
+  cpu_user_s    DOUBLE PRECISION DEFAULT 0,
+  cpu_system_s  DOUBLE PRECISION DEFAULT 0,
+  mem_max_mb    DOUBLE PRECISION DEFAULT 0,
+  metadata      JSONB NOT NULL DEFAULT '{}'::jsonb,
+  event_at      TIMESTAMPTZ NOT NULL,
+  inserted_at   TIMESTAMPTZ NOT NULL DEFAULT now()
+);
+
+CREATE TABLE IF NOT EXISTS subjob_current (
+  subjob_id     UUID PRIMARY KEY,
+  job_id        UUID NOT NULL,
+  app_id        UUID NOT NULL,
+  site_id       TEXT NOT NULL,
+  sub_key       TEXT NOT NULL,
+  status        TEXT NOT NULL,
+  started_at    TIMESTAMPTZ,
+  ended_at      TIMESTAMPTZ,
+  duration_s    DOUBLE PRECISION,
+  cpu_user_s    DOUBLE PRECISION DEFAULT 0,
+  cpu_system_s  DOUBLE PRECISION DEFAULT 0,
+  mem_max_mb    DOUBLE PRECISION DEFAULT 0,
+  metadata      JSONB NOT NULL DEFAULT '{}'::jsonb,
+  event_at      TIMESTAMPTZ NOT NULL,
+  inserted_at   TIMESTAMPTZ NOT NULL DEFAULT now()
+);
+
+CREATE INDEX IF NOT EXISTS idx_job_current_time ON job_current(inserted_at DESC, job_id DESC);
+CREATE INDEX IF NOT EXISTS idx_job_current_status_time ON job_current(status, inserted_at DESC);
+CREATE INDEX IF NOT EXISTS idx_job_current_site_time ON job_current(site_id, inserted_at DESC);
+CREATE INDEX IF NOT EXISTS idx_subjob_current_time ON subjob_current(inserted_at DESC, subjob_id DESC);
+CREATE INDEX IF NOT EXISTS idx_subjob_current_status_time ON subjob_current(status, inserted_at DESC);
+CREATE INDEX IF NOT EXISTS idx_subjob_current_site_time ON subjob_current(site_id, inserted_at DESC);
+CREATE INDEX IF NOT EXISTS idx_subjob_current_job ON subjob_current(job_id);
+
+-- Backfill from history when upgrading an existing database
+INSERT INTO job_current(job_id, app_id, site_id, job_key, status, started_at, ended_at, duration_s,
+                        cpu_user_s, cpu_system_s, mem_max_mb, metadata, event_at, inserted_at)
+SELECT DISTINCT ON (job_id)
+       job_id, app_id, site_id, job_key, status, started_at, ended_at, duration_s,
+       cpu_user_s, cpu_system_s, mem_max_mb, metadata, inserted_at, inserted_at
+FROM job
+ORDER BY job_id, inserted_at DESC
+ON CONFLICT (job_id) DO NOTHING;
+
+INSERT INTO subjob_current(subjob_id, job_id, app_id, site_id, sub_key, status, started_at, ended_at,
+                           duration_s, cpu_user_s, cpu_system_s, mem_max_mb, metadata, event_at, inserted_at)
+SELECT DISTINCT ON (subjob_id)
+       subjob_id, job_id, app_id, site_id, sub_key, status, started_at, ended_at,
+       duration_s, cpu_user_s, cpu_system_s, mem_max_mb, metadata, inserted_at, inserted_at
+FROM subjob
+ORDER BY subjob_id, inserted_at DESC
+ON CONFLICT (subjob_id) DO NOTHING;
+
+-- Current-state rows follow the history retention: drop entities not updated within it
+CREATE OR REPLACE PROCEDURE prune_current_state(job_id INT, config JSONB) AS $$
+DECLARE
+  cutoff TIMESTAMPTZ := now() - COALESCE(config->>'retention', '72 hours')::interval;
 BEGIN
-  PERFORM pg_notify('evt', row_to_json(NEW)::text);
-  RETURN NEW;
+  DELETE FROM subjob_current WHERE inserted_at < cutoff;
+  DELETE FROM job_current WHERE inserted_at < cutoff;
 END; $$ LANGUAGE plpgsql;
 DO $$ BEGIN
-  CREATE TRIGGER trg_notify_event AFTER INSERT ON event FOR EACH ROW EXECUTE FUNCTION notify_event();
-EXCEPTION WHEN duplicate_object THEN NULL; END $$;
+  IF NOT EXISTS (SELECT 1 FROM timescaledb_information.jobs WHERE proc_name = 'prune_current_state') THEN
+    PERFORM add_job('prune_current_state', INTERVAL '1 hour', config => '{"retention": "72 hours"}');
+  END IF;
+END $$;
+
+-- Archiver progress: every partition of `table_name` before `archived_until`
+-- has been exported to S3 (see apps/archiver). Not subject to retention.
+CREATE TABLE IF NOT EXISTS archive_watermark (
+  table_name     TEXT PRIMARY KEY,
+  archived_until TIMESTAMPTZ NOT NULL,
+  updated_at     TIMESTAMPTZ NOT NULL DEFAULT now()
+);
+
+-- Change notification for /v1/stream is sent by the Local API from the
+-- ingest transaction (one compact NOTIFY per INSERT statement). TimescaleDB
+-- does not allow transition tables on hypertables, so a statement-level
+-- trigger is not an option and the per-row triggers are removed.
+DROP TRIGGER IF EXISTS trg_notify_event ON event;
+DROP TRIGGER IF EXISTS trg_notify_event_batch ON event;
+DROP FUNCTION IF EXISTS notify_event();
+DROP FUNCTION IF EXISTS notify_event_batch();
+DROP FUNCTION IF EXISTS notify_event_row();
@@ -42,9 +42,20 @@ SELECT add_compression_policy('event', INTERVAL '12 hours', if_not_exists => TRU
 -- 2. CONTINUOUS AGGREGATES FOR PERFORMANCE
 -- ============================================================================
 
+-- Durations are also kept as a histogram of log10(duration_s): 48 buckets
+-- from 0.1s to 100000s (8 per decade) plus under/overflow. Unlike the
+-- percentile columns, histograms can be summed across buckets and sites,
+-- which is how the /v1/stats endpoints derive percentiles for any range.
+-- The bucket layout must match shared_utils/stats.py.
+--
+-- The aggregates are real-time (materialized_only = false): buckets newer
+-- than the last refresh - at least the current hour - are computed from the
+-- raw rows at query time, as newer TimescaleDB versions no longer do by
+-- default.
+
 -- Hourly job statistics
 CREATE MATERIALIZED VIEW job_stats_hourly
-WITH (timescaledb.continuous) AS
+WITH (timescaledb.continuous, timescaledb.materialized_only = false) AS
 SELECT 
     time_bucket('1 hour', inserted_at) AS hour,
     site_id,
@@ -58,7 +69,8 @@ SELECT
     PERCENTILE_CONT(0.95) WITHIN GROUP (ORDER BY duration_s) AS p95_duration_s,
     AVG(cpu_user_s + cpu_system_s) AS avg_cpu_total_s,
     AVG(mem_max_mb) AS avg_mem_mb,
-    MAX(mem_max_mb) AS max_mem_mb
+    MAX(mem_max_mb) AS max_mem_mb,
+    histogram(log(GREATEST(duration_s, 0.001)), -1.0, 5.0, 48) AS duration_hist
 FROM job
 WHERE duration_s IS NOT NULL
 GROUP BY hour, site_id, app_id, status
@@ -74,7 +86,7 @@ SELECT add_continuous_aggregate_policy('job_stats_hourly',
 
 -- Daily job statistics  
 CREATE MATERIALIZED VIEW job_stats_daily
-WITH (timescaledb.continuous) AS
+WITH (timescaledb.continuous, timescaledb.materialized_only = false) AS
 SELECT 
     time_bucket('1 day', inserted_at) AS day,
     site_id,
@@ -82,9 +94,13 @@ SELECT
     status,
     COUNT(*) AS job_count,
     AVG(duration_s) AS avg_duration_s,
+    MAX(duration_s) AS max_duration_s,
+    MIN(duration_s) AS min_duration_s,
     AVG(cpu_user_s + cpu_system_s) AS avg_cpu_s,
     AVG(mem_max_mb) AS avg_mem_mb,
-    SUM(CASE WHEN status = 'succeeded' THEN 1 ELSE 0 END)::FLOAT / COUNT(*) AS success_rate
+    MAX(mem_max_mb) AS max_mem_mb,
+    SUM(CASE WHEN status = 'succeeded' THEN 1 ELSE 0 END)::FLOAT / COUNT(*) AS success_rate,
+    histogram(log(GREATEST(duration_s, 0.001)), -1.0, 5.0, 48) AS duration_hist
 FROM job
 WHERE duration_s IS NOT NULL
 GROUP BY day, site_id, app_id, status
@@ -99,7 +115,7 @@ SELECT add_continuous_aggregate_policy('job_stats_daily',
 
 -- Event statistics by kind
 CREATE MATERIALIZED VIEW event_stats_hourly
-WITH (timescaledb.continuous) AS
+WITH (timescaledb.continuous, timescaledb.materialized_only = false) AS
 SELECT 
     time_bucket('1 hour', at) AS hour,
     site_id,
@@ -0,0 +1,121 @@
+"""
+Run benchmark profiles against the compose stack and check them against baselines.
+
+Usage:
+    python tests/performance/bench.py [--profile NAME ...] [--set key=value ...]
+                                      [--threshold 0.1] [--update-baseline]
+                                      [--no-up] [--down]
+
+Results go to `.bench/<timestamp>/<profile>.json`. Without
+`--update-baseline` the exit status is 1 if any metric regressed by more
+than the threshold against `tests/performance/baselines/<profile>.json`.
+"""
+import argparse
+import asyncio
+import json
+import sys
+from datetime import datetime, timezone
+from pathlib import Path
+from typing import Any, Dict, List, Optional, Sequence
+
+sys.path.insert(0, str(Path(__file__).parent))
+from harness import (
+    RESULTS_DIR, BenchResult, ComposeStack, baseline_path, compare, load_baseline, save_result
+)
+from profiles import PROFILES
+
+
+def parse_overrides(pairs: Sequence[str]) -> Dict[str, Any]:
+    """`key=value` pairs; values are parsed as JSON where possible (numbers, booleans)."""
+    out: Dict[str, Any] = {}
+    for pair in pairs:
+        key, sep, value = pair.partition('=')
+        if not sep:
+            raise ValueError(f'expected key=value, got {pair!r}')
+        try:
+            out[key] = json.loads(value)
+        except json.JSONDecodeError:
+            out[key] = value
+    return out
+
+
+def profile_params(name: str, overrides: Dict[str, Any]) -> Dict[str, Any]:
+    """A profile's defaults with the overrides that apply to it."""
+    defaults = PROFILES[name][1]
+    return {**defaults, **{k: v for k, v in overrides.items() if k in defaults}}
+
+
+async def run_profiles(
+    stack: ComposeStack,
+    names: Sequence[str],
+    overrides: Dict[str, Any],
+    threshold: float,
+    update_baseline: bool,
+    out_dir: Path
+) -> List[str]:
+    """Run the profiles in order; returns one line per regression found."""
+    failures: List[str] = []
+    for name in names:
+        func, _ = PROFILES[name]
+        params = profile_params(name, overrides)
+        print(f'== {name} {json.dumps(params, sort_keys=True)}', flush=True)
+        result: BenchResult = await func(stack, params)
+        save_result(result, out_dir / f'{name}.json')
+        for metric, value in result.metrics.items():
+            print(f'   {metric:<28} {value}')
+        if update_baseline:
+            save_result(result, baseline_path(name))
+            print(f'   baseline updated: {baseline_path(name)}')
+            continue
+        baseline = load_baseline(name, params)
+        if baseline is None:
+            print('   no baseline for these parameters (run with --update-baseline to record one)')
+            continue
+        for r in compare(result.metrics, baseline['metrics'], threshold):
+            failures.append(f'{name}: {r}')
+            print(f'   REGRESSION {r}')
+    return failures
+
+
+def parse_args(argv: Optional[Sequence[str]] = None) -> argparse.Namespace:
+    parser = argparse.ArgumentParser(description='TrackMate benchmark suite')
+    parser.add_argument('--profile', action='append', choices=sorted(PROFILES),
+                        help='Profile to run (repeatable, default: all)')
+    parser.add_argument('--set', dest='overrides', action='append', default=[], metavar='KEY=VALUE',
+                        help='Override a profile parameter (repeatable)')
+    parser.add_argument('--threshold', type=float, default=0.10,
+                        help='Relative change beyond which a metric counts as regressed')
+    parser.add_argument('--update-baseline', action='store_true', help='Store the results as new baselines')
+    parser.add_argument('--no-up', action='store_true', help='Use an already running stack')
+    parser.add_argument('--down', action='store_true', help='Tear the stack (and its volumes) down afterwards')
+    return parser.parse_args(argv)
+
+
+async def main(argv: Optional[Sequence[str]] = None) -> int:
+    args = parse_args(argv)
+    names = args.profile or list(PROFILES)
+    overrides = parse_overrides(args.overrides)
+    out_dir = RESULTS_DIR / datetime.now(timezone.utc).strftime('%Y%m%dT%H%M%SZ')
+
+    stack = ComposeStack(env={'BENCH_SITES': json.dumps({'site0': 'http://local_api:18000'})})
+    if not args.no_up:
+        stack.up()
+    try:
+        for url in (stack.local_api_url, stack.sidecar_url, stack.central_api_url):
+            await stack.wait_healthy(url)
+        failures = await run_profiles(stack, names, overrides, args.threshold, args.update_baseline, out_dir)
+    finally:
+        if args.down:
+            stack.down(volumes=True)
+
+    print(f'results: {out_dir}')
+    if failures:
+        print(f'{len(failures)} regression(s) above {args.threshold:.0%}:')
+        for line in failures:
+            print(f'  {line}')
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(asyncio.run(main()))
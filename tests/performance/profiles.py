@@ -0,0 +1,410 @@
+"""
+Workload profiles of the benchmark suite.
+
+Each profile takes the running ComposeStack plus its parameters and
+returns a BenchResult. Ingest profiles are open-loop: requests are issued
+on a fixed schedule and latency is measured from the scheduled send time,
+so a stalled server shows up as latency instead of silently lowering the
+offered load.
+"""
+import asyncio
+import json
+import math
+import time
+from datetime import datetime, timedelta, timezone
+from typing import Any, Awaitable, Callable, Dict, Optional, Tuple
+from uuid import uuid4
+
+import asyncpg
+import httpx
+
+from harness import BenchResult, ComposeStack, DbSampler, LatencyRecorder
+
+SITE_ID = 'bench'
+BENCH_APP = {'app_id': str(uuid4()), 'name': 'bench-app', 'version': '1.0.0'}
+
+
+def make_event(job_id: Optional[str] = None, kind: str = 'started') -> Dict[str, Any]:
+    """An ingest event for a (new) bench job."""
+    return {
+        'idempotency_key': str(uuid4()),
+        'site_id': SITE_ID,
+        'app': BENCH_APP,
+        'entity': {
+            'type': 'job',
+            'id': job_id or str(uuid4()),
+            'parent_id': None,
+            'business_key': 'bench',
+            'sub_key': None
+        },
+        'event': {
+            'kind': kind,
+            'at': datetime.now(timezone.utc).isoformat(),
+            'status': 'running' if kind != 'finished' else 'succeeded',
+            'metrics': {'cpu_user_s': 0.1, 'mem_max_mb': 100.0},
+            'metadata': {'bench': True}
+        }
+    }
+
+
+async def open_loop(
+    schedule: Callable[[int], float],
+    total: int,
+    send: Callable[[int], Awaitable[None]],
+    max_inflight: int
+) -> float:
+    """
+    Issue `total` sends at the offsets (seconds from start) given by `schedule`.
+
+    At most `max_inflight` sends run at once; a send waiting for a slot is
+    late, not skipped. Returns the wall time until the last send finished.
+    """
+    slots = asyncio.Semaphore(max_inflight)
+    start = time.perf_counter()
+
+    async def one(i: int) -> None:
+        async with slots:
+            await send(i)
+
+    tasks = []
+    for i in range(total):
+        delay = start + schedule(i) - time.perf_counter()
+        if delay > 0:
+            await asyncio.sleep(delay)
+        tasks.append(asyncio.create_task(one(i)))
+    await asyncio.gather(*tasks)
+    return time.perf_counter() - start
+
+
+async def _ingest(
+    stack: ComposeStack,
+    name: str,
+    params: Dict[str, Any],
+    schedule: Callable[[int], float],
+    total: int
+) -> BenchResult:
+    lat = LatencyRecorder()
+    limits = httpx.Limits(max_connections=params['max_inflight'])
+    async with httpx.AsyncClient(base_url=stack.sidecar_url, timeout=30.0, limits=limits) as client:
+        t0 = time.perf_counter()
+
+        async def send(i: int) -> None:
+            try:
+                r = await client.post('/v1/ingest/events', json=make_event())
+                if r.status_code != 200:
+                    lat.error()
+                    return
+            except httpx.HTTPError:
+                lat.error()
+                return
+            lat.record(time.perf_counter() - t0 - schedule(i))
+
+        async with DbSampler(stack) as db:
+            elapsed = await open_loop(schedule, total, send, params['max_inflight'])
+    return BenchResult(
+        profile=name,
+        params=params,
+        metrics={
+            'throughput_per_s': round(lat.count / elapsed, 2),
+            'error_ratio': round(lat.errors / total, 4),
+            **lat.summary(),
+        },
+        db=db.summary(),
+        duration_s=elapsed
+    )
+
+
+async def steady_ingest(stack: ComposeStack, params: Dict[str, Any]) -> BenchResult:
+    """Single events through the sidecar at a constant rate."""
+    rate, duration = params['rate_per_s'], params['duration_s']
+    return await _ingest(stack, 'steady_ingest', params, lambda i: i / rate, int(rate * duration))
+
+
+async def bursty_ingest(stack: ComposeStack, params: Dict[str, Any]) -> BenchResult:
+    """Bursts of simultaneous single events through the sidecar."""
+    size, period = params['burst_size'], params['burst_period_s']
+    return await _ingest(
+        stack, 'bursty_ingest', params, lambda i: (i // size) * period, size * params['bursts']
+    )
+
+
+async def spool_recovery(stack: ComposeStack, params: Dict[str, Any]) -> BenchResult:
+    """
+    Spool events through a Local API outage and time the drain after it.
+
+    The Local API is stopped, `events` are sent to the sidecar (which spools
+    them), then the Local API is started again and the sidecar's spool is
+    watched until it is empty.
+    """
+    total = params['events']
+    lat = LatencyRecorder()
+    stack.stop('local_api')
+    try:
+        async with httpx.AsyncClient(base_url=stack.sidecar_url, timeout=30.0) as client:
+            t0 = time.perf_counter()
+
+            async def send(i: int) -> None:
+                start = time.perf_counter()
+                try:
+                    r = await client.post('/v1/ingest/events', json=make_event())
+                except httpx.HTTPError:
+                    lat.error()
+                    return
+                if r.status_code == 200:
+                    lat.record(time.perf_counter() - start)
+                else:
+                    lat.error()
+
+            await open_loop(lambda i: 0.0, total, send, params['max_inflight'])
+            spool_s = time.perf_counter() - t0
+    finally:
+        stack.start('local_api')
+
+    async with DbSampler(stack) as db:
+        await stack.wait_healthy(stack.local_api_url)
+        t_up = time.perf_counter()
+        deadline = t_up + params['timeout_s']
+        async with httpx.AsyncClient(base_url=stack.sidecar_url, timeout=5.0) as client:
+            while True:
+                pending = (await client.get('/v1/healthz')).json()['spool_count']
+                if pending == 0:
+                    break
+                if time.perf_counter() > deadline:
+                    raise TimeoutError(f'{pending} events still spooled after {params["timeout_s"]}s')
+                await asyncio.sleep(0.2)
+        recovery_s = time.perf_counter() - t_up
+
+    return BenchResult(
+        profile='spool_recovery',
+        params=params,
+        metrics={
+            'spool_throughput_per_s': round(lat.count / spool_s, 2),
+            'drain_throughput_per_s': round(lat.count / recovery_s, 2) if recovery_s else None,
+            'recovery_s': round(recovery_s, 3),
+            'error_ratio': round(lat.errors / total, 4),
+            **lat.summary('spool_latency'),
+        },
+        db=db.summary(),
+        duration_s=spool_s + recovery_s
+    )
+
+
+async def sse_fanout(stack: ComposeStack, params: Dict[str, Any]) -> BenchResult:
+    """
+    Delivery latency from ingest to N connected `/v1/stream` subscribers.
+
+    Events are posted straight to the Local API; latency runs from the
+    moment an event was sent until a subscriber received it.
+    """
+    n_subs, total, rate = params['subscribers'], params['events'], params['rate_per_s']
+    sent: Dict[str, float] = {}
+    lat = LatencyRecorder()
+    received = 0
+    ready = asyncio.Event()
+    connected = 0
+    done = asyncio.Event()
+
+    async def subscriber(client: httpx.AsyncClient) -> None:
+        nonlocal received, connected
+        async with client.stream('GET', '/v1/stream', params={'site': SITE_ID}) as r:
+            connected += 1
+            if connected == n_subs:
+                ready.set()
+            async for line in r.aiter_lines():
+                if not line.startswith('data: '):
+                    continue
+                key = json.loads(line[6:]).get('idempotency_key')
+                if key in sent:
+                    lat.record(time.perf_counter() - sent[key])
+                    received += 1
+                    if received == n_subs * total:
+                        done.set()
+
+    limits = httpx.Limits(max_connections=n_subs + params['max_inflight'])
+    timeout = httpx.Timeout(30.0, read=None)
+    async with httpx.AsyncClient(base_url=stack.local_api_url, timeout=timeout, limits=limits) as client:
+        subs = [asyncio.create_task(subscriber(client)) for _ in range(n_subs)]
+        try:
+            await asyncio.wait_for(ready.wait(), 60.0)
+
+            async def send(i: int) -> None:
+                ev = make_event()
+                sent[ev['idempotency_key']] = time.perf_counter()
+                try:
+                    r = await client.post('/v1/ingest/events', json=ev)
+                    if r.status_code != 200:
+                        lat.error()
+                except httpx.HTTPError:
+                    lat.error()
+
+            async with DbSampler(stack) as db:
+                elapsed = await open_loop(lambda i: i / rate, total, send, params['max_inflight'])
+                try:
+                    await asyncio.wait_for(done.wait(), params['drain_timeout_s'])
+                except asyncio.TimeoutError:
+                    pass
+        finally:
+            for t in subs:
+                t.cancel()
+            await asyncio.gather(*subs, return_exceptions=True)
+
+    return BenchResult(
+        profile='sse_fanout',
+        params=params,
+        metrics={
+            'delivered_ratio': round(received / (n_subs * total), 4),
+            'delivered_per_s': round(received / elapsed, 2),
+            'error_ratio': round(lat.errors / total, 4),
+            **lat.summary('delivery'),
+        },
+        db=db.summary(),
+        duration_s=elapsed
+    )
+
+
+def bench_sites(count: int, url: str = 'http://local_api:18000') -> str:
+    """SITES for the Central API: `count` site ids, all served by the bench Local API."""
+    return json.dumps({f'site{i}': url for i in range(count)})
+
+
+async def federated_query(stack: ComposeStack, params: Dict[str, Any]) -> BenchResult:
+    """
+    Federated `/v1/jobs?site=*` through the Central API across M sites.
+
+    All M site ids point at the one Local API of the stack, so this measures
+    the Central API's fan-out and merge plus the concurrent site load, not
+    independent site databases. The bench overlay disables the Central API
+    response cache so every request reaches the sites.
+    """
+    stack.env['BENCH_SITES'] = bench_sites(params['sites'])
+    stack.up('central_api')
+    await stack.wait_healthy(stack.central_api_url)
+
+    async with httpx.AsyncClient(base_url=stack.local_api_url, timeout=60.0) as client:
+        seed = [make_event() for _ in range(params['seed_jobs'])]
+        for i in range(0, len(seed), 500):
+            r = await client.post('/v1/ingest/events:batch', json=seed[i:i + 500])
+            r.raise_for_status()
+
+    total, concurrency = params['queries'], params['concurrency']
+    lat = LatencyRecorder()
+    query = {'site': '*', 'limit': params['limit']}
+    limits = httpx.Limits(max_connections=concurrency)
+    async with httpx.AsyncClient(base_url=stack.central_api_url, timeout=30.0, limits=limits) as client:
+
+        async def send(i: int) -> None:
+            start = time.perf_counter()
+            try:
+                r = await client.get('/v1/jobs', params=query)
+            except httpx.HTTPError:
+                lat.error()
+                return
+            if r.status_code == 200 and not r.json().get('partial'):
+                lat.record(time.perf_counter() - start)
+            else:
+                lat.error()
+
+        async with DbSampler(stack) as db:
+            elapsed = await open_loop(lambda i: 0.0, total, send, concurrency)
+
+    return BenchResult(
+        profile='federated_query',
+        params=params,
+        metrics={
+            'throughput_per_s': round(lat.count / elapsed, 2),
+            'error_ratio': round(lat.errors / total, 4),
+            **lat.summary(),
+        },
+        db=db.summary(),
+        duration_s=elapsed
+    )
+
+
+SEED_SQL = """
+INSERT INTO event (at, entity_type, entity_id, app_id, site_id, kind, payload, idempotency_key)
+SELECT $1::timestamptz + (g * $2::interval / $3::int),
+       'job', gen_random_uuid(), $4::uuid, $5, 'progress',
+       jsonb_build_object('status', 'running', 'metadata', jsonb_build_object('pad', repeat('x', $6::int))),
+       gen_random_uuid()::text
+FROM generate_series(0, $3::int - 1) AS g
+"""
+
+
+# Runs in the archiver container; also tells the harness its dependencies are installed.
+CREATE_BUCKET = """
+import os, boto3
+s3 = boto3.client('s3')
+try:
+    s3.create_bucket(Bucket=os.environ['S3_BUCKET'])
+except s3.exceptions.BucketAlreadyOwnedByYou:
+    pass
+"""
+
+
+async def _seed_archive(
+    stack: ComposeStack, start: datetime, end: datetime, target_bytes: float, payload_bytes: int
+) -> Tuple[int, int]:
+    """Fill [start, end) of the event table until it holds `target_bytes`. Returns (rows, bytes)."""
+    conn = await asyncpg.connect(stack.database_url)
+    measure = "SELECT count(*), coalesce(sum(pg_column_size(e.*)), 0) FROM event e WHERE at >= $1 AND at < $2"
+    chunk = 100_000
+    try:
+        await conn.execute("SET session_replication_role = replica")  # no NOTIFY per seeded row
+        await conn.execute("DELETE FROM event WHERE at >= $1 AND at < $2", start, end)
+        await conn.execute(SEED_SQL, start, end - start, chunk, BENCH_APP['app_id'], SITE_ID, payload_bytes)
+        _, size = await conn.fetchrow(measure, start, end)
+        remaining = max(0, math.ceil((target_bytes - size) / (size / chunk)))
+        while remaining > 0:
+            n = min(chunk, remaining)
+            await conn.execute(SEED_SQL, start, end - start, n, BENCH_APP['app_id'], SITE_ID, payload_bytes)
+            remaining -= n
+        rows, size = await conn.fetchrow(measure, start, end)
+        return rows, size
+    finally:
+        await conn.close()
+
+
+async def archive_export(stack: ComposeStack, params: Dict[str, Any]) -> BenchResult:
+    """
+    Export X GB of events to S3 (MinIO in the bench overlay) with the archiver's backfill.
+
+    Seeded rows are spread over a closed range of hours inside hot
+    retention; the backfill runs with `--force` so repeated runs export the
+    same partitions again.
+    """
+    end = (datetime.now(timezone.utc) - timedelta(hours=2)).replace(minute=0, second=0, microsecond=0)
+    start = end - timedelta(hours=params['hours'])
+    rows, size = await _seed_archive(stack, start, end, params['gb'] * 1e9, params['payload_bytes'])
+
+    await stack.wait_exec('archiver', 'python', '-c', CREATE_BUCKET)
+    t0 = time.perf_counter()
+    async with DbSampler(stack) as db:
+        await asyncio.to_thread(
+            stack.exec, 'archiver', 'python', 'apps/archiver/main.py', 'backfill',
+            '--from', start.isoformat(), '--to', end.isoformat(), '--tables', 'event', '--force'
+        )
+    elapsed = time.perf_counter() - t0
+
+    return BenchResult(
+        profile='archive_export',
+        params=params,
+        metrics={
+            'rows_per_s': round(rows / elapsed, 2),
+            'mb_per_s': round(size / 1e6 / elapsed, 2),
+            'export_s': round(elapsed, 3),
+        },
+        db={'rows': rows, 'bytes': size, **db.summary()},
+        duration_s=elapsed
+    )
+
+
+PROFILES: Dict[str, Tuple[Callable[[ComposeStack, Dict[str, Any]], Awaitable[BenchResult]], Dict[str, Any]]] = {
+    'steady_ingest': (steady_ingest, {'rate_per_s': 200, 'duration_s': 30, 'max_inflight': 64}),
+    'bursty_ingest': (bursty_ingest, {'burst_size': 500, 'burst_period_s': 2.0, 'bursts': 15, 'max_inflight': 256}),
+    'spool_recovery': (spool_recovery, {'events': 5000, 'max_inflight': 32, 'timeout_s': 300.0}),
+    'sse_fanout': (sse_fanout, {'subscribers': 50, 'events': 1000, 'rate_per_s': 100, 'max_inflight': 32,
+                                'drain_timeout_s': 30.0}),
+    'federated_query': (federated_query, {'sites': 8, 'queries': 500, 'concurrency': 16, 'limit': 100,
+                                          'seed_jobs': 5000}),
+    'archive_export': (archive_export, {'gb': 1.0, 'hours': 4, 'payload_bytes': 512}),
+}
@@ -0,0 +1,113 @@
+"""Unit tests for streaming alert evaluation."""
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.alerts import AlertManager, AlertState, WindowStats
+
+T0 = 1_760_000_000.0
+
+
+def row(kind, entity_id, status=None, site='fab1', app='a1', **metrics):
+    """Event table row as published on the event hub."""
+    return {
+        'site_id': site, 'app_id': app, 'entity_type': 'job', 'entity_id': entity_id, 'kind': kind,
+        'payload': {'kind': kind, 'status': status, 'metrics': metrics, 'metadata': {}},
+    }
+
+
+class TestWindowStats:
+    """Test suite for WindowStats."""
+
+    def test_window_slides(self):
+        """Ended jobs leave the current window and then count as the previous window."""
+        w = WindowStats(window_s=600, slots=6)
+        for i in range(4):
+            w.add(f'j{i}', 'finished', i == 0, 10.0 * (i + 1), 100.0 * i, T0 + i)
+        snap = w.snapshot(T0 + 10)
+        assert (snap['total_jobs'], snap['failed_jobs'], snap['rate']) == (4, 1, 25.0)
+        assert snap['max_duration_s'] == 40.0 and snap['avg_duration_s'] == 25.0
+        assert snap['max_memory_mb'] == 300.0
+
+        snap = w.snapshot(T0 + 700)
+        assert snap['total_jobs'] == 0 and snap['expected_jobs_per_hour'] == 24.0
+        assert w.snapshot(T0 + 1300)['expected_jobs_per_hour'] == 0.0
+
+    def test_running_jobs_bounded(self):
+        """The oldest running job sets the age; the map never exceeds max_open."""
+        w = WindowStats(window_s=600, max_open=2)
+        w.add('a', 'started', False, None, None, T0)
+        w.add('b', 'started', False, None, None, T0 + 5)
+        assert w.snapshot(T0 + 100)['oldest_running_s'] == 100.0
+        w.add('c', 'started', False, None, None, T0 + 6)
+        assert list(w.running) == ['b', 'c'] and w.dropped_open == 1
+        w.add('b', 'finished', False, 1.0, None, T0 + 7)
+        assert w.snapshot(T0 + 16)['oldest_running_s'] == 10.0
+
+
+class TestAlertManagerStreaming:
+    """Test suite for AlertManager.observe()/tick()."""
+
+    def test_failure_rate_per_key(self):
+        """Failure rate fires for the failing (site, app) only, once it has enough jobs."""
+        am = AlertManager(min_jobs=4)
+        fired = []
+        for i in range(3):
+            fired += am.observe(row('error', f'j{i}'), now=T0 + i)
+            fired += am.observe(row('finished', f'k{i}', 'succeeded', app='a2'), now=T0 + i)
+        assert fired == []
+        fired = am.observe(row('finished', 'j3', 'failed'), now=T0 + 3)
+        assert [a.name for a in fired] == ['high_failure_rate']
+        assert fired[0].labels['app_id'] == 'a1' and fired[0].labels['site_id'] == 'fab1'
+        assert 'high_failure_rate[fab1/a1]' in am.active_alerts
+        # Cooldown: no second alert for the same key
+        assert am.observe(row('error', 'j4'), now=T0 + 4) == []
+
+    def test_long_running_detected_before_end(self):
+        """A job running longer than an hour alerts on tick() and resolves when it ends."""
+        am = AlertManager()
+        am.observe(row('started', 'j1'), now=T0)
+        assert am.tick(now=T0 + 60) == []
+        fired = am.tick(now=T0 + 3700)
+        assert [a.name for a in fired] == ['long_running_job']
+        am.observe(row('finished', 'j1', 'succeeded', duration_s=3700.0), now=T0 + 3700)
+        am.tick(now=T0 + 7300)
+        assert 'long_running_job[fab1/a1]' not in am.active_alerts
+        assert am.alert_history[-1].state == AlertState.RESOLVED
+
+    def test_no_activity(self):
+        """A key that had jobs in the previous window and none now raises no_jobs_received."""
+        am = AlertManager(window_s=600)
+        am.observe(row('finished', 'j1', 'succeeded'), now=T0)
+        assert am.tick(now=T0 + 300) == []
+        fired = am.tick(now=T0 + 700)
+        assert [a.name for a in fired] == ['no_jobs_received']
+        # Without traffic for two windows the key is forgotten once the alert resolves
+        am.tick(now=T0 + 1300)
+        am.tick(now=T0 + 1400)
+        assert am.windows == {} and am.active_alerts == {}
+
+    def test_bounded_keys_and_history(self):
+        """Tracked keys and alert history stay within their bounds."""
+        am = AlertManager(history_size=2, max_keys=3)
+        for i in range(5):
+            am.observe(row('finished', 'j', 'succeeded', app=f'a{i}'), now=T0)
+        assert list(am.windows) == [('fab1', 'a2'), ('fab1', 'a3'), ('fab1', 'a4')]
+        for i in range(4):
+            am.observe(row('started', f'j{i}'), now=T0)
+            am.tick(now=T0 + 3700)
+            am.observe(row('finished', f'j{i}', 'succeeded'), now=T0 + 3700)
+            am.tick(now=T0 + 3700)
+        assert len(am.alert_history) == 2
+
+    def test_wire_format_events(self):
+        """Events in the sidecar wire format are accepted as well."""
+        am = AlertManager(min_jobs=1)
+        ev = {
+            'site_id': 'fab1', 'app': {'app_id': 'a1'}, 'entity': {'type': 'job', 'id': 'j1'},
+            'event': {'kind': 'finished', 'status': 'failed', 'metrics': {'mem_max_mb': 9000.0}},
+        }
+        names = sorted(a.name for a in am.observe(ev, now=T0))
+        assert names == ['high_failure_rate', 'high_memory_usage']
@@ -0,0 +1,73 @@
+"""Unit tests for the known-app cache used on the ingest path."""
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.app_cache import KnownAppCache
+
+
+APP_ID = '6F1C4F0E-0000-4000-8000-000000000001'
+
+
+class TestKnownAppCache:
+    """Test suite for KnownAppCache."""
+
+    def test_unknown_app_is_a_miss(self):
+        cache = KnownAppCache()
+        assert not cache.is_current(APP_ID, 'app', '1.0')
+        assert (cache.hits, cache.misses) == (0, 1)
+
+    def test_known_app_is_a_hit(self):
+        cache = KnownAppCache()
+        cache.add(APP_ID, 'app', '1.0')
+        assert cache.is_current(APP_ID, 'app', '1.0')
+        assert (cache.hits, cache.misses) == (1, 0)
+
+    def test_changed_name_or_version_is_a_miss(self):
+        """A rename or new version must reach the `app` upsert."""
+        cache = KnownAppCache()
+        cache.add(APP_ID, 'app', '1.0')
+        assert not cache.is_current(APP_ID, 'app', '1.1')
+        assert not cache.is_current(APP_ID, 'renamed', '1.0')
+        assert cache.misses == 2
+
+    def test_keys_are_case_insensitive(self):
+        cache = KnownAppCache()
+        cache.add(APP_ID, 'app', '1.0')
+        assert APP_ID.lower() in cache
+        assert cache.is_current(APP_ID.lower(), 'app', '1.0')
+
+    def test_least_recently_used_is_evicted(self):
+        cache = KnownAppCache(max_size=2)
+        cache.add('a', 'app-a', '1')
+        cache.add('b', 'app-b', '1')
+        assert cache.is_current('a', 'app-a', '1')
+        cache.add('c', 'app-c', '1')
+        assert len(cache) == 2
+        assert 'b' not in cache
+        assert 'a' in cache and 'c' in cache
+
+    def test_warm_loads_rows(self):
+        cache = KnownAppCache(max_size=2)
+        assert cache.warm([('a', 'app-a', '1'), ('b', 'app-b', '2'), ('c', 'app-c', '3')]) == 2
+        assert cache.get('c') == ('app-c', '3')
+
+    def test_get_does_not_count(self):
+        cache = KnownAppCache()
+        cache.add(APP_ID, 'app', '1.0')
+        assert cache.get(APP_ID) == ('app', '1.0')
+        assert cache.get('missing') is None
+        assert (cache.hits, cache.misses) == (0, 0)
+
+    def test_clear(self):
+        cache = KnownAppCache()
+        cache.add(APP_ID, 'app', '1.0')
+        cache.clear()
+        assert len(cache) == 0
+        assert not cache.is_current(APP_ID, 'app', '1.0')
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
@@ -0,0 +1,181 @@
+"""Unit tests for the archiver's streaming export helpers."""
+import pytest
+from datetime import datetime, timedelta, timezone
+from uuid import uuid4
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.archive import (
+    MIN_PART_SIZE, S3MultipartWriter, partition_key, manifest_key, build_manifest,
+    plan_units, next_watermark, stale_hours, hours
+)
+
+T0 = datetime(2025, 10, 19, tzinfo=timezone.utc)
+H = timedelta(hours=1)
+
+
+class FakeS3:
+    """Records S3 calls and assembles completed objects in memory."""
+
+    def __init__(self):
+        self.objects = {}
+        self.uploads = {}
+        self.aborted = []
+        self.calls = []
+
+    def put_object(self, Bucket, Key, Body):
+        self.calls.append('put_object')
+        self.objects[Key] = bytes(Body)
+
+    def create_multipart_upload(self, Bucket, Key):
+        self.calls.append('create_multipart_upload')
+        upload_id = f'upload-{len(self.uploads) + 1}'
+        self.uploads[upload_id] = {}
+        return {'UploadId': upload_id}
+
+    def upload_part(self, Bucket, Key, UploadId, PartNumber, Body):
+        self.calls.append('upload_part')
+        self.uploads[UploadId][PartNumber] = bytes(Body)
+        return {'ETag': f'"etag-{PartNumber}"'}
+
+    def complete_multipart_upload(self, Bucket, Key, UploadId, MultipartUpload):
+        self.calls.append('complete_multipart_upload')
+        parts = self.uploads.pop(UploadId)
+        numbers = [p['PartNumber'] for p in MultipartUpload['Parts']]
+        assert numbers == sorted(parts)
+        self.objects[Key] = b''.join(parts[n] for n in numbers)
+
+    def abort_multipart_upload(self, Bucket, Key, UploadId):
+        self.aborted.append(UploadId)
+        self.uploads.pop(UploadId, None)
+
+
+class TestS3MultipartWriter:
+    """Test suite for S3MultipartWriter."""
+
+    def test_small_output_uses_single_put(self):
+        """Output below one part is uploaded with put_object."""
+        s3 = FakeS3()
+        with S3MultipartWriter(s3, 'bucket', 'k') as w:
+            w.write(b'abc')
+            w.write(bytearray(b'def'))
+            assert w.tell() == 6
+        assert s3.calls == ['put_object']
+        assert s3.objects['k'] == b'abcdef'
+
+    def test_large_output_streams_parts(self):
+        """Full parts are uploaded as they fill; the buffer never exceeds one part."""
+        s3 = FakeS3()
+        chunk = bytes(range(256)) * 4096  # 1 MiB
+        w = S3MultipartWriter(s3, 'bucket', 'k', part_size=1)  # raised to the S3 minimum
+        assert w.part_size == MIN_PART_SIZE
+        for _ in range(12):
+            w.write(chunk)
+            assert len(w._buffer) < MIN_PART_SIZE
+        assert w.parts == 2
+        w.close()
+        w.close()  # idempotent
+        assert w.parts == 3
+        assert s3.objects['k'] == chunk * 12
+        assert s3.calls.count('complete_multipart_upload') == 1
+
+    def test_abort_discards_upload(self):
+        """An exception inside the context aborts the multipart upload."""
+        s3 = FakeS3()
+        with pytest.raises(RuntimeError):
+            with S3MultipartWriter(s3, 'bucket', 'k', part_size=MIN_PART_SIZE) as w:
+                w.write(b'x' * (MIN_PART_SIZE + 1))
+                raise RuntimeError('export failed')
+        assert w.aborted and s3.aborted == ['upload-1']
+        assert 'k' not in s3.objects
+        with pytest.raises(ValueError):
+            w.write(b'more')
+
+    def test_partition_key_layout(self):
+        """Keys follow <prefix><site>/<table>/dt=YYYY/MM/DD/HH/part.parquet."""
+        start = datetime(2025, 10, 19, 7, tzinfo=timezone.utc)
+        assert partition_key('monitoring/', 'fab1', 'event', start) == \
+            'monitoring/fab1/event/dt=2025/10/19/07/part.parquet'
+
+    def test_parquet_round_trip(self):
+        """Record batches written through the writer read back as Parquet."""
+        pa = pytest.importorskip('pyarrow')
+        pq = pytest.importorskip('pyarrow.parquet')
+        from shared_utils.archive import arrow_schema, rows_to_batch
+
+        schema = arrow_schema([('job_id', 'uuid'), ('duration_s', 'float8'),
+                               ('metadata', 'jsonb'), ('inserted_at', 'timestamptz')])
+        at = datetime(2025, 10, 19, 7, tzinfo=timezone.utc)
+        rows = [(uuid4(), 1.5, '{"a": 1}', at), (uuid4(), None, None, at)]
+
+        s3 = FakeS3()
+        sink = S3MultipartWriter(s3, 'bucket', 'k')
+        writer = pq.ParquetWriter(sink, schema)
+        writer.write_batch(rows_to_batch(rows, schema))
+        writer.write_batch(rows_to_batch(rows[:1], schema))
+        writer.close()
+        sink.close()
+
+        table = pq.read_table(pa.BufferReader(s3.objects['k']))
+        assert table.num_rows == 3
+        assert table.schema.equals(schema)
+        assert table.column('job_id').to_pylist()[0] == str(rows[0][0])
+
+    def test_writer_checksum(self):
+        """The writer hashes everything written, across parts."""
+        import hashlib
+        s3 = FakeS3()
+        data = b'y' * (MIN_PART_SIZE + 10)
+        with S3MultipartWriter(s3, 'bucket', 'k', part_size=MIN_PART_SIZE) as w:
+            w.write(data[:7])
+            w.write(data[7:])
+        assert w.sha256.hexdigest() == hashlib.sha256(data).hexdigest()
+
+
+class TestArchivePlanning:
+    """Test suite for watermark and work-unit planning."""
+
+    def test_units_are_hours_of_chunks(self):
+        """Chunks are clipped to the pending range and split by hour; hours without chunks are skipped."""
+        chunks = [(T0 - 6 * H, T0), (T0, T0 + 6 * H), (T0 + 12 * H, T0 + 18 * H)]
+        units = plan_units(chunks, T0 - 2 * H, T0 + 14 * H + timedelta(minutes=30))
+        assert units == (
+            hours(T0 - 2 * H, T0) + hours(T0, T0 + 6 * H) + hours(T0 + 12 * H, T0 + 15 * H)
+        )
+        assert all(end - start == H for start, end in units)
+        assert plan_units([], T0, T0 + H) == []
+
+    def test_overlapping_chunks_do_not_duplicate_hours(self):
+        """Unaligned or overlapping chunk ranges never export an hour twice."""
+        units = plan_units([(T0, T0 + 90 * timedelta(minutes=1)), (T0 + H, T0 + 3 * H)], T0, T0 + 3 * H)
+        covered = [h for u in units for h in hours(*u)]
+        assert covered == [(T0, T0 + H), (T0 + H, T0 + 2 * H), (T0 + 2 * H, T0 + 3 * H)]
+
+    def test_stale_hours(self):
+        """Hours whose live count differs from the manifest are exported again."""
+        live = {T0: 10, T0 + H: 5, T0 + 2 * H: 3}
+        archived = {T0: 10, T0 + H: 4}
+        assert stale_hours(live, archived) == [T0 + H, T0 + 2 * H]
+        assert stale_hours({}, archived) == []
+
+    def test_watermark_stops_at_first_failure(self):
+        """The watermark covers the completed prefix only and never goes backwards."""
+        units = [(T0, T0 + 6 * H), (T0 + 6 * H, T0 + 12 * H), (T0 + 18 * H, T0 + 24 * H)]
+        end = T0 + 30 * H
+        assert next_watermark(T0, units, [True, True, True], end) == end
+        assert next_watermark(T0, units, [True, False, True], end) == T0 + 6 * H
+        assert next_watermark(T0, units, [False, True, True], end) == T0
+        assert next_watermark(T0, [], [], end) == end
+        assert next_watermark(end, units, [True, True, True], T0) == end
+
+    def test_manifest(self):
+        """Manifests sit next to the data file and describe empty hours too."""
+        start = T0 + 7 * H
+        assert manifest_key('m/', 'fab1', 'job', start) == 'm/fab1/job/dt=2025/10/19/07/_manifest.json'
+        m = build_manifest('job', 'fab1', start, start + H, 0)
+        assert m['rows'] == 0 and m['key'] is None and m['start'] == start.isoformat()
+        m = build_manifest('job', 'fab1', start, start + H, 5, key='k', size_bytes=10, sha256='ab',
+                           min_time=start, max_time=start + timedelta(minutes=59))
+        assert (m['rows'], m['sha256'], m['max_time']) == (5, 'ab', (start + timedelta(minutes=59)).isoformat())
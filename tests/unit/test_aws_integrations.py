@@ -176,6 +176,114 @@ class TestAWSCloudWatchIntegration:
         assert health['status'] == 'healthy'
         assert health['backend'] == 'aws_cloudwatch'
         assert health['region'] == 'us-east-1'
+    
+    def test_event_to_emf_log(self, cloudwatch_config, sample_event):
+        """Test Embedded Metric Format log message."""
+        import json
+        integration = AWSCloudWatchIntegration(cloudwatch_config)
+        
+        log_event = integration._event_to_emf_log(sample_event)
+        message = json.loads(log_event['message'])
+        
+        aws = message['_aws']
+        assert aws['Timestamp'] == log_event['timestamp']
+        directives = {tuple(d['Dimensions'][0]): d for d in aws['CloudWatchMetrics']}
+        assert all(d['Namespace'] == 'TestNamespace' for d in directives.values())
+        # JobCompleted carries the extra Status dimension, so it gets its own directive
+        assert [m['Name'] for m in directives[('SiteId', 'AppName', 'EntityType', 'ComputePlatform', 'Status')]['Metrics']] == ['JobCompleted']
+        names = {m['Name'] for d in directives.values() for m in d['Metrics']}
+        assert {'JobDuration', 'MemoryMaxMB'} <= names
+        # Every referenced dimension and metric is a root property
+        assert message['SiteId'] == 'site1' and message['Status'] == 'succeeded'
+        assert message['JobDuration'] == 120.5 and message['JobCompleted'] == 1
+        assert message['site_id'] == 'site1'
+    
+    @pytest.mark.asyncio
+    async def test_send_batch_emf_skips_put_metric_data(self, cloudwatch_config, sample_event):
+        """Test EMF mode sends log events only."""
+        cloudwatch_config.config['emf'] = True
+        integration = AWSCloudWatchIntegration(cloudwatch_config)
+        integration.cloudwatch_client = Mock()
+        integration.logs_client = Mock()
+        integration.logs_client.put_log_events.return_value = {'nextSequenceToken': 'tok'}
+        integration.log_stream_name = 'test-stream'
+        
+        result = await integration.send_batch([sample_event, sample_event])
+        
+        assert result['success'] == 2 and result['failed'] == 0
+        assert result['logs'] == {'success': 2, 'failed': 0}
+        integration.cloudwatch_client.put_metric_data.assert_not_called()
+        kwargs = integration.logs_client.put_log_events.call_args.kwargs
+        assert len(kwargs['logEvents']) == 2
+        assert integration._sequence_token == 'tok'
+        await integration.close()
+    
+    @pytest.mark.asyncio
+    async def test_send_batch_reports_metrics_and_logs_separately(self, cloudwatch_config, sample_event):
+        """Test failed logs do not resend the metrics that went out."""
+        integration = AWSCloudWatchIntegration(cloudwatch_config)
+        integration.cloudwatch_client = Mock()
+        integration.logs_client = Mock()
+        integration.logs_client.put_log_events.side_effect = [Exception('throttled'), {'nextSequenceToken': 'tok'}]
+        integration.log_stream_name = 'test-stream'
+        events = [{**sample_event, 'idempotency_key': f'k{i}'} for i in range(2)]
+        
+        result = await integration.send_batch(events)
+        
+        assert result['metrics'] == {'success': 2, 'failed': 0}
+        assert result['logs'] == {'success': 0, 'failed': 2}
+        assert result['failed'] == 2 and result['failed_indices'] == [0, 1]
+        assert integration.cloudwatch_client.put_metric_data.call_count == 1
+        
+        result = await integration.send_batch(events)
+        
+        assert result['success'] == 2 and result['failed'] == 0
+        assert integration.cloudwatch_client.put_metric_data.call_count == 1
+        assert len(integration.logs_client.put_log_events.call_args.kwargs['logEvents']) == 2
+        assert not integration._partial
+        await integration.close()
+    
+    def test_log_batches_respect_limits(self, cloudwatch_config):
+        """Test log batches are ordered and split by count, bytes and span."""
+        integration = AWSCloudWatchIntegration(cloudwatch_config)
+        hour_ms = 3600 * 1000
+        
+        events = [{'timestamp': t, 'message': 'x'} for t in (3, 1, 2)]
+        assert [[e['timestamp'] for e in b] for b in integration._log_batches(events)] == [[1, 2, 3]]
+        
+        events = [{'timestamp': 0, 'message': 'x'}, {'timestamp': 24 * hour_ms, 'message': 'y'}]
+        assert len(list(integration._log_batches(events))) == 2
+        
+        big = 'x' * (200 * 1024)
+        events = [{'timestamp': i, 'message': big} for i in range(6)]
+        batches = list(integration._log_batches(events))
+        assert [len(b) for b in batches] == [5, 1]
+        
+        events = [{'timestamp': i, 'message': ''} for i in range(10001)]
+        assert [len(b) for b in integration._log_batches(events)] == [10000, 1]
+        
+        events = [{'timestamp': 0, 'message': 'x' * (300 * 1024)}]
+        assert list(integration._log_batches(events)) == []
+    
+    @pytest.mark.asyncio
+    async def test_put_logs_retries_invalid_sequence_token(self, cloudwatch_config):
+        """Test a stale sequence token is replaced with the expected one."""
+        integration = AWSCloudWatchIntegration(cloudwatch_config)
+        integration.logs_client = Mock()
+        integration.log_stream_name = 'test-stream'
+        
+        error = Exception('invalid token')
+        error.response = {
+            'Error': {'Code': 'InvalidSequenceTokenException', 'Message': 'The next expected sequenceToken is: 42'}
+        }
+        integration.logs_client.put_log_events.side_effect = [error, {'nextSequenceToken': '43'}]
+        
+        await integration._put_logs([{'timestamp': 1, 'message': 'x'}])
+        
+        assert integration.logs_client.put_log_events.call_count == 2
+        assert integration.logs_client.put_log_events.call_args.kwargs['sequenceToken'] == '42'
+        assert integration._sequence_token == '43'
+        await integration.close()
 
 
 class TestAWSXRayIntegration:
@@ -0,0 +1,136 @@
+"""Unit tests for the benchmark harness statistics and baseline comparison."""
+import asyncio
+import json
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent / 'performance'))
+
+from harness import (
+    BenchResult, LatencyRecorder, compare, load_baseline, parse_docker_stats, parse_size,
+    percentile, save_result
+)
+from profiles import PROFILES, bench_sites, open_loop
+from bench import parse_overrides, profile_params
+
+
+class TestPercentile:
+    def test_nearest_rank(self):
+        values = [float(i) for i in range(1, 101)]
+        assert percentile(values, 0.50) == 50.0
+        assert percentile(values, 0.95) == 95.0
+        assert percentile(values, 0.99) == 99.0
+
+    def test_too_few_samples(self):
+        values = [float(i) for i in range(1, 101)]
+        assert percentile(values, 0.999) is None
+        assert percentile([], 0.5) is None
+
+    def test_p999_with_enough_samples(self):
+        values = [float(i) for i in range(1, 1001)]
+        assert percentile(values, 0.999) == 999.0
+
+
+class TestLatencyRecorder:
+    def test_summary_in_ms(self):
+        rec = LatencyRecorder()
+        for i in range(1, 101):
+            rec.record(i / 1000)
+        rec.error()
+        s = rec.summary()
+        assert s['latency_p50_ms'] == 50.0
+        assert s['latency_p99_ms'] == 99.0
+        assert s['latency_p999_ms'] is None
+        assert s['latency_max_ms'] == 100.0
+        assert s['latency_mean_ms'] == pytest.approx(50.5)
+        assert rec.count == 100 and rec.errors == 1
+
+    def test_prefix_and_empty(self):
+        s = LatencyRecorder().summary('delivery')
+        assert s['delivery_p50_ms'] is None
+        assert s['delivery_mean_ms'] is None
+
+
+class TestCompare:
+    def test_latency_regression(self):
+        regs = compare({'latency_p99_ms': 12.0}, {'latency_p99_ms': 10.0}, 0.10)
+        assert [r.metric for r in regs] == ['latency_p99_ms']
+        assert regs[0].change == pytest.approx(0.2)
+
+    def test_within_threshold(self):
+        assert compare({'latency_p99_ms': 10.5}, {'latency_p99_ms': 10.0}, 0.10) == []
+
+    def test_throughput_drop_is_regression(self):
+        regs = compare({'throughput_per_s': 80.0}, {'throughput_per_s': 100.0}, 0.10)
+        assert regs and regs[0].change == pytest.approx(0.2)
+
+    def test_improvements_pass(self):
+        current = {'throughput_per_s': 150.0, 'latency_p50_ms': 5.0, 'delivered_ratio': 1.0}
+        baseline = {'throughput_per_s': 100.0, 'latency_p50_ms': 10.0, 'delivered_ratio': 0.9}
+        assert compare(current, baseline, 0.10) == []
+
+    def test_missing_and_zero_skipped(self):
+        current = {'latency_p999_ms': None, 'error_ratio': 0.0, 'recovery_s': 99.0}
+        baseline = {'latency_p999_ms': 5.0, 'error_ratio': 0.0}
+        assert compare(current, baseline, 0.10) == []
+
+
+class TestBaselines:
+    def test_roundtrip_requires_same_params(self, tmp_path):
+        result = BenchResult('steady_ingest', {'rate_per_s': 10}, {'throughput_per_s': 10.0})
+        save_result(result, tmp_path / 'steady_ingest.json')
+        data = load_baseline('steady_ingest', {'rate_per_s': 10}, tmp_path)
+        assert data['metrics'] == {'throughput_per_s': 10.0}
+        assert load_baseline('steady_ingest', {'rate_per_s': 20}, tmp_path) is None
+        assert load_baseline('bursty_ingest', {}, tmp_path) is None
+
+    def test_result_is_json(self):
+        d = BenchResult('x', {}, {'a': 1.0}, duration_s=1.23456).to_dict()
+        assert json.loads(json.dumps(d))['duration_s'] == 1.235
+
+
+class TestDockerStats:
+    def test_parse_size(self):
+        assert parse_size('0B') == 0
+        assert parse_size('1.5kB') == 1500
+        assert parse_size('2MiB') == 2 * 1024 ** 2
+
+    def test_parse_line(self):
+        line = json.dumps({'CPUPerc': '37.50%', 'BlockIO': '1.2MB / 3GB'})
+        assert parse_docker_stats(line) == {
+            'cpu_pct': 37.5, 'block_read_bytes': 1.2e6, 'block_write_bytes': 3e9
+        }
+
+
+class TestProfiles:
+    def test_open_loop_sends_all_with_bounded_inflight(self):
+        inflight = peak = 0
+        sent = []
+
+        async def send(i):
+            nonlocal inflight, peak
+            inflight += 1
+            peak = max(peak, inflight)
+            await asyncio.sleep(0.001)
+            inflight -= 1
+            sent.append(i)
+
+        asyncio.run(open_loop(lambda i: 0.0, 50, send, max_inflight=4))
+        assert sorted(sent) == list(range(50))
+        assert peak == 4
+
+    def test_bench_sites(self):
+        sites = json.loads(bench_sites(3))
+        assert list(sites) == ['site0', 'site1', 'site2']
+        assert set(sites.values()) == {'http://local_api:18000'}
+
+    def test_overrides_apply_to_own_profile(self):
+        overrides = parse_overrides(['rate_per_s=50', 'subscribers=10', 'gb=0.1'])
+        assert overrides == {'rate_per_s': 50, 'subscribers': 10, 'gb': 0.1}
+        params = profile_params('steady_ingest', overrides)
+        assert params['rate_per_s'] == 50 and 'subscribers' not in params
+
+    def test_override_requires_key_value(self):
+        with pytest.raises(ValueError):
+            parse_overrides(['rate_per_s'])
@@ -0,0 +1,99 @@
+"""Unit tests for the micro-batching coalescer."""
+import asyncio
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.coalescer import BatchCoalescer
+
+
+class RecordingFlush:
+    """Flush function that records each batch and echoes items back."""
+
+    def __init__(self, result=None):
+        self.batches = []
+        self.result = result
+
+    async def __call__(self, items):
+        self.batches.append(list(items))
+        if self.result is not None:
+            return self.result(items)
+        return [item * 10 for item in items]
+
+
+class TestBatchCoalescer:
+    """Test suite for BatchCoalescer."""
+
+    @pytest.mark.asyncio
+    async def test_max_items_flushes_immediately(self):
+        flush = RecordingFlush()
+        coalescer = BatchCoalescer(flush, max_items=3, linger_s=60.0)
+
+        results = await asyncio.wait_for(
+            asyncio.gather(*(coalescer.submit(i) for i in range(3))), timeout=1.0
+        )
+
+        assert results == [0, 10, 20]
+        assert flush.batches == [[0, 1, 2]]
+
+    @pytest.mark.asyncio
+    async def test_linger_flushes_partial_batch(self):
+        flush = RecordingFlush()
+        coalescer = BatchCoalescer(flush, max_items=100, linger_s=0.01)
+
+        results = await asyncio.gather(coalescer.submit(1), coalescer.submit(2))
+
+        assert results == [10, 20]
+        assert flush.batches == [[1, 2]]
+
+    @pytest.mark.asyncio
+    async def test_exception_result_fails_only_its_item(self):
+        flush = RecordingFlush(lambda items: [ValueError('bad') if i == 2 else i for i in items])
+        coalescer = BatchCoalescer(flush, max_items=3)
+
+        results = await asyncio.gather(*(coalescer.submit(i) for i in range(1, 4)),
+                                       return_exceptions=True)
+
+        assert results[0] == 1 and results[2] == 3
+        assert isinstance(results[1], ValueError)
+
+    @pytest.mark.asyncio
+    async def test_raising_flush_fails_every_item(self):
+        async def flush(items):
+            raise ConnectionError('down')
+
+        coalescer = BatchCoalescer(flush, max_items=2)
+        results = await asyncio.gather(coalescer.submit(1), coalescer.submit(2),
+                                       return_exceptions=True)
+
+        assert all(isinstance(r, ConnectionError) for r in results)
+
+    @pytest.mark.asyncio
+    async def test_result_count_mismatch_fails_batch(self):
+        flush = RecordingFlush(lambda items: items[:1])
+        coalescer = BatchCoalescer(flush, max_items=2)
+
+        results = await asyncio.gather(coalescer.submit(1), coalescer.submit(2),
+                                       return_exceptions=True)
+
+        assert all(isinstance(r, RuntimeError) for r in results)
+
+    @pytest.mark.asyncio
+    async def test_close_flushes_pending_and_rejects_new_items(self):
+        flush = RecordingFlush()
+        coalescer = BatchCoalescer(flush, max_items=100, linger_s=60.0)
+
+        task = asyncio.ensure_future(coalescer.submit(1))
+        await asyncio.sleep(0)
+        assert coalescer.pending == 1
+        await coalescer.close()
+
+        assert await task == 10
+        with pytest.raises(RuntimeError):
+            await coalescer.submit(2)
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
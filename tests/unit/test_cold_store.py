@@ -0,0 +1,154 @@
+"""Unit tests for the Parquet archive read path."""
+import os
+import pytest
+from datetime import datetime, timedelta, timezone
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.archive import partition_key
+from shared_utils.cold_store import ColdStore, FileCache, cold_window, key_hour
+
+T0 = datetime(2025, 10, 19, tzinfo=timezone.utc)
+H = timedelta(hours=1)
+
+
+class FakePaginator:
+    def __init__(self, s3):
+        self.s3 = s3
+
+    def paginate(self, Bucket, Prefix):
+        self.s3.listed.append(Prefix)
+        keys = sorted(k for k in self.s3.objects if k.startswith(Prefix))
+        yield {'Contents': [{'Key': k} for k in keys]}
+
+
+class FakeS3:
+    """In-memory bucket supporting listing and downloads."""
+
+    def __init__(self, objects=None):
+        self.objects = dict(objects or {})
+        self.listed = []
+        self.downloads = []
+
+    def get_paginator(self, name):
+        assert name == 'list_objects_v2'
+        return FakePaginator(self)
+
+    def download_file(self, Bucket, Key, Filename):
+        self.downloads.append(Key)
+        with open(Filename, 'wb') as f:
+            f.write(self.objects[Key])
+
+
+class TestFileCache:
+    """Test suite for FileCache."""
+
+    def test_hit_and_eviction(self, tmp_path):
+        """Repeated keys are served locally; the least recently used file is evicted."""
+        calls = []
+
+        def download(key, path):
+            calls.append(key)
+            with open(path, 'wb') as f:
+                f.write(b'x' * 10)
+
+        cache = FileCache(str(tmp_path), max_bytes=25)
+        a = cache.get('a', download)
+        cache.get('b', download)
+        assert cache.get('a', download) == a
+        assert calls == ['a', 'b']
+        cache.get('c', download)  # evicts 'b', the least recently used
+        assert cache.size_bytes == 20 and (cache.hits, cache.misses) == (1, 3)
+        cache.get('b', download)
+        assert calls == ['a', 'b', 'c', 'b']
+        assert not [n for n in os.listdir(tmp_path) if n.endswith('.tmp')]
+
+    def test_failed_download_leaves_nothing(self, tmp_path):
+        """A download error does not leave a partial file in the cache."""
+        def download(key, path):
+            with open(path, 'wb') as f:
+                f.write(b'partial')
+            raise IOError('connection reset')
+
+        cache = FileCache(str(tmp_path / 'c'), max_bytes=100)
+        with pytest.raises(IOError):
+            cache.get('a', download)
+        assert cache.size_bytes == 0 and os.listdir(tmp_path / 'c') == []
+
+
+class TestColdStore:
+    """Test suite for ColdStore."""
+
+    def test_key_hour(self):
+        """Partition hours are parsed from the archiver's key layout."""
+        key = partition_key('monitoring/', 'fab1', 'job', T0 + 7 * H)
+        assert key_hour(key) == T0 + 7 * H
+        assert key_hour('monitoring/fab1/job/part.parquet') is None
+
+    def test_cold_window(self):
+        """The archived part ends at the cut; an inclusive 'to' before it is extended by 1us."""
+        cut = T0 + 10 * H
+        assert cold_window(T0 + 10 * H, None, cut) is None
+        assert cold_window(T0, None, cut) == (T0, cut)
+        assert cold_window(T0, T0 + 2 * H, cut) == (T0, T0 + 2 * H + timedelta(microseconds=1))
+
+    def test_cold_window_naive_timestamps_are_utc(self):
+        """Naive from/to (as parsed from query strings) compare with the aware cut."""
+        cut = T0 + 10 * H
+        naive = T0.replace(tzinfo=None)
+        assert cold_window(naive, naive + 20 * H, cut) == (T0, cut)
+        assert cold_window(naive + 12 * H, None, cut) is None
+
+    def test_partitions_pruned_by_path(self, tmp_path):
+        """Only days in range are listed and only hours in range are returned, newest first."""
+        objects = {partition_key('m/', 'fab1', 'job', T0 + i * H): b'' for i in range(-3, 30)}
+        objects[partition_key('m/', 'fab2', 'job', T0 + H)] = b''
+        s3 = FakeS3(objects)
+        store = ColdStore('bucket', 'm/', 'fab1', str(tmp_path), s3=s3)
+
+        found = store.partitions('job', T0 + 22 * H + timedelta(minutes=30), T0 + 26 * H)
+        assert [h for h, _ in found] == [T0 + 25 * H, T0 + 24 * H, T0 + 23 * H, T0 + 22 * H]
+        assert s3.listed == ['m/fab1/job/dt=2025/10/19/', 'm/fab1/job/dt=2025/10/20/']
+
+        store.partitions('job', T0 + 20 * H, T0 + 21 * H)
+        assert len(s3.listed) == 2  # listing reused within the TTL
+
+    def test_scan_latest_across_pages(self, tmp_path):
+        """Each entity's latest version is returned once, in keyset order, across pages."""
+        pa = pytest.importorskip('pyarrow')
+        pq = pytest.importorskip('pyarrow.parquet')
+
+        def parquet(rows):
+            sink = pa.BufferOutputStream()
+            pq.write_table(pa.Table.from_pylist(rows), sink)
+            return sink.getvalue().to_pybytes()
+
+        m = timedelta(minutes=1)
+        s3 = FakeS3({
+            partition_key('m/', 'fab1', 'job', T0): parquet([
+                {'job_id': 'a', 'status': 'running', 'inserted_at': T0 + 5 * m},
+                {'job_id': 'b', 'status': 'failed', 'inserted_at': T0 + 10 * m},
+                {'job_id': 'c', 'status': 'running', 'inserted_at': T0 + 20 * m},
+            ]),
+            partition_key('m/', 'fab1', 'job', T0 + H): parquet([
+                {'job_id': 'a', 'status': 'succeeded', 'inserted_at': T0 + H + 5 * m},
+                {'job_id': 'd', 'status': 'succeeded', 'inserted_at': T0 + H + 10 * m},
+            ]),
+        })
+        store = ColdStore('bucket', 'm/', 'fab1', str(tmp_path), s3=s3)
+
+        rows = list(store.scan_latest('job', 'job_id', T0, T0 + 2 * H))
+        assert [(r['job_id'], r['status']) for r in rows] == [
+            ('d', 'succeeded'), ('a', 'succeeded'), ('c', 'running'), ('b', 'failed')
+        ]
+
+        # Resuming after 'a' must not return its older version again
+        before = (rows[1]['inserted_at'], rows[1]['job_id'])
+        rest = list(store.scan_latest('job', 'job_id', T0, T0 + 2 * H, before=before))
+        assert [r['job_id'] for r in rest] == ['c', 'b']
+
+        failed = list(store.scan_latest('job', 'job_id', T0, T0 + 2 * H, status=['failed']))
+        assert [r['job_id'] for r in failed] == ['b']
+        assert len(s3.downloads) == 2
@@ -2,12 +2,14 @@
 import pytest
 from uuid import uuid4
 import time
+from types import SimpleNamespace
 
 import sys
 from pathlib import Path
 sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps' / 'monitoring_sdk'))
 
 from monitoring_sdk.context import Monitored
+from monitoring_sdk.emitter import default_emitter
 from monitoring_sdk.models import AppRef
 
 
@@ -21,6 +23,19 @@ class DummyEmitter:
         self.sent.append(ev)
 
 
+class FakeProcess:
+    """psutil.Process stand-in with controllable RSS."""
+
+    def __init__(self, rss_mb=100.0):
+        self.rss_mb = rss_mb
+
+    def memory_info(self):
+        return SimpleNamespace(rss=int(self.rss_mb * 1024 * 1024))
+
+    def cpu_times(self):
+        return SimpleNamespace(user=0.0, system=0.0)
+
+
 class TestMonitored:
     """Test suite for Monitored context manager."""
     
@@ -153,3 +168,73 @@ class TestMonitored:
         assert start_event.event.metadata['batch_id'] == '12345'
         assert start_event.event.metadata['priority'] == 'high'
 
+    def test_tick_min_interval_coalesces(self):
+        """Ticks within the minimum interval are merged into the exit flush."""
+        app = AppRef(app_id=uuid4(), name='test-app', version='1.0')
+        emitter = DummyEmitter()
+
+        with Monitored(
+            site_id='fab1',
+            app=app,
+            entity_type='job',
+            emitter=emitter,
+            enable_logging=False,
+            tick_min_interval_s=60.0
+        ) as ctx:
+            for i in range(100):
+                ctx.tick(extra_meta={'step': i, f'k{i % 2}': True})
+
+        progress_events = [e for e in emitter.sent if e.event.kind == 'progress']
+        assert len(progress_events) == 2
+        assert 'suppressed_ticks' not in progress_events[0].event.metadata
+        flushed = progress_events[1].event.metadata
+        assert flushed['suppressed_ticks'] == 99
+        assert flushed['step'] == 99
+        assert flushed['k0'] and flushed['k1']
+        assert emitter.sent[-1].event.kind == 'finished'
+        assert ctx.suppressed_ticks_total == 99
+
+    def test_tick_delta_thresholds(self):
+        """With thresholds set, ticks are emitted only on significant change."""
+        app = AppRef(app_id=uuid4(), name='test-app', version='1.0')
+        emitter = DummyEmitter()
+        proc = FakeProcess(100.0)
+
+        ctx = Monitored(
+            site_id='fab1',
+            app=app,
+            entity_type='job',
+            emitter=emitter,
+            enable_logging=False,
+            tick_mem_delta_mb=10.0,
+            tick_meta_delta=0.1
+        )
+        ctx.proc = proc
+        with ctx:
+            ctx.tick(extra_meta={'progress': 0.0})   # new key -> emitted
+            ctx.tick(extra_meta={'progress': 0.05})  # below threshold
+            proc.rss_mb = 105.0
+            ctx.tick()                               # below threshold
+            proc.rss_mb = 120.0
+            ctx.tick()                               # memory moved -> emitted
+            ctx.tick(extra_meta={'progress': 0.5})   # metadata moved -> emitted
+            ctx.tick(extra_meta={'progress': 0.52})  # below threshold, flushed on exit
+
+        progress = [e.event for e in emitter.sent if e.event.kind == 'progress']
+        assert len(progress) == 4
+        assert progress[1].metadata == {'progress': 0.05, 'suppressed_ticks': 2}
+        assert progress[1].metrics['mem_max_mb'] == pytest.approx(120.0)
+        assert progress[2].metadata == {'progress': 0.5}
+        assert progress[3].metadata == {'progress': 0.52, 'suppressed_ticks': 1}
+
+    def test_default_emitter_is_shared(self):
+        """Contexts without an emitter share one process-wide emitter."""
+        app = AppRef(app_id=uuid4(), name='test-app', version='1.0')
+        first = Monitored(site_id='fab1', app=app, entity_type='job', enable_logging=False)
+        second = Monitored(site_id='fab1', app=app, entity_type='job', enable_logging=False)
+        assert first.emitter is second.emitter is default_emitter()
+
+        first.emitter.close()
+        third = Monitored(site_id='fab1', app=app, entity_type='job', enable_logging=False)
+        assert third.emitter is not first.emitter
+        third.emitter.close()
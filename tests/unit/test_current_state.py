@@ -0,0 +1,47 @@
+"""Unit tests for the current-state table reduction."""
+import pytest
+
+import sys
+from pathlib import Path
+from types import SimpleNamespace
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.current_state import latest_per_entity
+
+
+JOB_ID = '6F1C4F0E-0000-4000-8000-000000000101'
+
+
+def event(kind, entity_id=JOB_ID, entity_type='job'):
+    return SimpleNamespace(kind=kind, entity={'type': entity_type, 'id': entity_id})
+
+
+class TestLatestPerEntity:
+    """Test suite for latest_per_entity."""
+
+    def test_most_recent_event_wins(self):
+        valid = [(event('ended'), 3), (event('started'), 1), (event('progress'), 2)]
+        assert [(ev.kind, at) for ev, at in latest_per_entity(valid, 'job')] == [('ended', 3)]
+
+    def test_later_item_wins_tie(self):
+        valid = [(event('progress'), 5), (event('ended'), 5)]
+        assert [ev.kind for ev, _ in latest_per_entity(valid, 'job')] == ['ended']
+
+    def test_ids_compare_case_insensitively(self):
+        valid = [(event('started', JOB_ID), 1), (event('ended', JOB_ID.lower()), 2)]
+        assert [ev.kind for ev, _ in latest_per_entity(valid, 'job')] == ['ended']
+
+    def test_one_row_per_entity_of_the_requested_type(self):
+        other = '6f1c4f0e-0000-4000-8000-000000000102'
+        valid = [
+            (event('started'), 1),
+            (event('started', other), 1),
+            (event('started', JOB_ID, 'subjob'), 2),
+        ]
+        assert len(latest_per_entity(valid, 'job')) == 2
+        assert [ev.kind for ev, _ in latest_per_entity(valid, 'subjob')] == ['started']
+        assert latest_per_entity([], 'job') == []
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
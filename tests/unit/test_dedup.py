@@ -0,0 +1,124 @@
+"""Unit tests for the idempotency-key dedup filter."""
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.dedup import DedupFilter, RotatingBloomFilter, first_occurrences
+
+
+class FakeClock:
+    def __init__(self):
+        self.t = 1000.0
+
+    def __call__(self):
+        return self.t
+
+
+class TestRotatingBloomFilter:
+    """Test suite for RotatingBloomFilter."""
+
+    def test_added_keys_are_members(self):
+        """No false negatives within the window."""
+        bloom = RotatingBloomFilter(capacity=1000)
+        keys = [f'key-{i}' for i in range(1000)]
+        for k in keys:
+            bloom.add(k)
+        assert all(k in bloom for k in keys)
+
+    def test_false_positive_rate(self):
+        """Unknown keys are rarely reported as members at capacity."""
+        bloom = RotatingBloomFilter(capacity=2000, error_rate=0.01)
+        for i in range(2000):
+            bloom.add(f'in-{i}')
+        false_positives = sum(1 for i in range(10000) if f'out-{i}' in bloom)
+        assert false_positives < 300
+
+    def test_keys_expire_after_two_windows(self):
+        """A key survives one rotation and is gone after the second."""
+        clock = FakeClock()
+        bloom = RotatingBloomFilter(capacity=100, window_s=10.0, clock=clock)
+        bloom.add('a')
+        clock.t += 10.0
+        assert 'a' in bloom
+        clock.t += 10.0
+        assert 'a' not in bloom
+
+    def test_long_idle_clears_both_generations(self):
+        clock = FakeClock()
+        bloom = RotatingBloomFilter(capacity=100, window_s=10.0, clock=clock)
+        bloom.add('a')
+        clock.t += 25.0
+        assert 'a' not in bloom
+
+
+class TestDedupFilter:
+    """Test suite for DedupFilter."""
+
+    def test_seen_after_add(self):
+        """Only added keys are duplicates, and duplicates are counted."""
+        dedup = DedupFilter(max_size=10)
+        assert not dedup.seen('a')
+        dedup.add('a')
+        assert dedup.seen('a')
+        assert not dedup.seen('b')
+        assert dedup.stats() == {'size': 1, 'duplicates': 1, 'suspected': 0}
+
+    def test_entries_expire_with_window(self):
+        """Keys older than the window are no longer duplicates."""
+        clock = FakeClock()
+        dedup = DedupFilter(max_size=10, window_s=60.0, clock=clock)
+        dedup.add('a')
+        clock.t += 59.0
+        assert dedup.seen('a')
+        clock.t += 2.0
+        assert not dedup.seen('a')
+
+    def test_evicted_keys_are_suspected_not_dropped(self):
+        """Past the LRU size a Bloom hit alone never drops an event."""
+        dedup = DedupFilter(max_size=2)
+        for k in ('a', 'b', 'c'):
+            dedup.add(k)
+        assert len(dedup) == 2
+        assert not dedup.seen('a')
+        assert dedup.suspected == 1
+        assert dedup.seen('c')
+
+    def test_expired_entries_are_pruned_on_add(self):
+        clock = FakeClock()
+        dedup = DedupFilter(max_size=10, window_s=60.0, clock=clock)
+        dedup.add_many(['a', 'b'])
+        clock.t += 61.0
+        dedup.add('c')
+        assert len(dedup) == 1
+        assert 'c' in dedup and 'a' not in dedup
+
+    def test_re_adding_refreshes(self):
+        """A key accepted again stays a duplicate for another window."""
+        clock = FakeClock()
+        dedup = DedupFilter(max_size=10, window_s=60.0, clock=clock)
+        dedup.add('a')
+        clock.t += 50.0
+        dedup.add('a')
+        clock.t += 50.0
+        assert dedup.seen('a')
+
+
+class TestFirstOccurrences:
+    """Test suite for first_occurrences."""
+
+    def test_repeats_within_batch_keep_first_position(self):
+        assert first_occurrences(['a', 'b', 'a', 'c', 'b']) == [0, 1, 3]
+
+    def test_seen_keys_are_skipped(self):
+        dedup = DedupFilter(max_size=10)
+        dedup.add('b')
+        assert first_occurrences(['a', 'b', 'c', 'a'], dedup.seen) == [0, 2]
+
+    def test_empty_batch(self):
+        assert first_occurrences([]) == []
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
@@ -0,0 +1,135 @@
+"""Unit tests for the incremental dashboard frame."""
+import pytest
+
+import sys
+from datetime import datetime, timedelta, timezone
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.delta import DeltaFrame
+
+
+class FakeClock:
+    def __init__(self):
+        self.t = 1000.0
+
+    def __call__(self):
+        return self.t
+
+
+def job(job_id, minutes_ago, status='running'):
+    at = datetime.now(timezone.utc) - timedelta(minutes=minutes_ago)
+    return {'job_id': job_id, 'status': status, 'inserted_at': at.isoformat()}
+
+
+class FakeAPI:
+    """Serves queued responses and records the parameters of each request."""
+
+    def __init__(self, *responses):
+        self.responses = list(responses)
+        self.calls = []
+
+    def __call__(self, params):
+        self.calls.append(params)
+        response = self.responses.pop(0)
+        if isinstance(response, Exception):
+            raise response
+        return response
+
+
+class TestDeltaFrame:
+    """Test suite for DeltaFrame."""
+
+    def test_first_page_then_deltas(self):
+        """Deltas merge by id and newer updates replace older ones."""
+        api = FakeAPI(
+            {'items': [job('a', 5), job('b', 10)], 'next': None, 'since': 't1'},
+            {'items': [job('b', 1, 'succeeded'), job('c', 0)], 'tombstones': [], 'since': 't2', 'more': False},
+        )
+        frame = DeltaFrame(api, 'job_id', {'status': 'running,succeeded'}, min_interval_s=0)
+        assert frame.refresh()
+        assert 'since' not in api.calls[0] and api.calls[0]['limit'] == 1000
+        assert frame.refresh()
+        assert api.calls[1]['since'] == 't1'
+        assert api.calls[1]['status'] == 'running,succeeded'
+        rows = frame.rows()
+        assert [r['job_id'] for r in rows] == ['c', 'b', 'a']
+        assert rows[1]['status'] == 'succeeded'
+
+    def test_tombstones_remove_rows(self):
+        api = FakeAPI(
+            {'items': [job('a', 5), job('b', 10)], 'since': 't1'},
+            {'items': [], 'tombstones': ['a'], 'since': 't2', 'more': False},
+        )
+        frame = DeltaFrame(api, 'job_id', min_interval_s=0)
+        frame.refresh()
+        frame.refresh()
+        assert [r['job_id'] for r in frame.rows()] == ['b']
+
+    def test_older_update_does_not_replace(self):
+        """A re-sent older version of a row never rolls it back."""
+        api = FakeAPI(
+            {'items': [job('a', 1, 'succeeded')], 'since': 't1'},
+            {'items': [job('a', 5, 'running')], 'tombstones': [], 'since': 't2'},
+        )
+        frame = DeltaFrame(api, 'job_id', min_interval_s=0)
+        frame.refresh()
+        frame.refresh()
+        assert frame.rows()[0]['status'] == 'succeeded'
+
+    def test_follows_more_pages(self):
+        api = FakeAPI(
+            {'items': [], 'since': 't1'},
+            {'items': [job('a', 3)], 'tombstones': [], 'since': 't2', 'more': True},
+            {'items': [job('b', 2)], 'tombstones': [], 'since': 't3', 'more': False},
+        )
+        frame = DeltaFrame(api, 'job_id', min_interval_s=0)
+        frame.refresh()
+        frame.refresh()
+        assert [c['since'] for c in api.calls[1:]] == ['t1', 't2']
+        assert len(frame) == 2
+
+    def test_window_and_size_limits(self):
+        """Rows older than the window are pruned; the newest max_rows are kept."""
+        api = FakeAPI({'items': [job('a', 1), job('b', 2), job('c', 3), job('old', 120)], 'since': 't1'})
+        frame = DeltaFrame(api, 'job_id', window=timedelta(hours=1), max_rows=2, min_interval_s=0)
+        frame.refresh()
+        assert 'from' in api.calls[0]
+        assert [r['job_id'] for r in frame.rows()] == ['a', 'b']
+
+    def test_refresh_is_throttled(self):
+        """Sessions sharing a frame cause at most one request per interval."""
+        clock = FakeClock()
+        api = FakeAPI({'items': [], 'since': 't1'}, {'items': [], 'since': 't2'})
+        frame = DeltaFrame(api, 'job_id', min_interval_s=10.0, clock=clock)
+        assert frame.refresh()
+        assert not frame.refresh()
+        clock.t += 10.0
+        assert frame.refresh()
+        assert frame.requests == 2
+
+    def test_failure_keeps_rows_and_token(self):
+        api = FakeAPI(
+            {'items': [job('a', 1)], 'since': 't1'},
+            RuntimeError('site down'),
+            {'items': [], 'tombstones': [], 'since': 't2'},
+        )
+        frame = DeltaFrame(api, 'job_id', min_interval_s=0)
+        frame.refresh()
+        assert not frame.refresh()
+        assert frame.error == 'site down' and len(frame) == 1
+        assert frame.refresh()
+        assert api.calls[2]['since'] == 't1' and frame.error is None
+
+    def test_reset_reloads_first_page(self):
+        api = FakeAPI({'items': [job('a', 1)], 'since': 't1'}, {'items': [job('b', 1)], 'since': 't2'})
+        frame = DeltaFrame(api, 'job_id', min_interval_s=0)
+        frame.refresh()
+        frame.reset()
+        frame.refresh()
+        assert 'since' not in api.calls[1]
+        assert [r['job_id'] for r in frame.rows()] == ['b']
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
@@ -0,0 +1,152 @@
+"""Unit tests for the spool drainer and the live-first concurrency gate."""
+import asyncio
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.drain import PriorityGate, SpoolDrainer
+from shared_utils.spool import SegmentedSpool, DEAD_LETTER_FILE
+
+
+class PermanentError(Exception):
+    pass
+
+
+class FakeSend:
+    """Answers each batch with outcomes from `answer(records)` and records the batches."""
+
+    def __init__(self, answer=None):
+        self.answer = answer or (lambda records: [None] * len(records))
+        self.batches = []
+
+    async def __call__(self, records):
+        self.batches.append([r['n'] for r in records])
+        return self.answer(records)
+
+
+def _spool(tmp_path, count: int) -> SegmentedSpool:
+    spool = SegmentedSpool(tmp_path)
+    for n in range(count):
+        spool.append({'n': n})
+    return spool
+
+
+class TestSpoolDrainer:
+    """Test suite for SpoolDrainer."""
+
+    @pytest.mark.asyncio
+    async def test_drains_in_batches(self, tmp_path):
+        """Every record is delivered once and the spool ends empty."""
+        spool = _spool(tmp_path, 5)
+        send = FakeSend()
+        drainer = SpoolDrainer(spool, send, batch_size=2)
+
+        assert await drainer.drain_once() == 5
+        assert sorted(n for b in send.batches for n in b) == [0, 1, 2, 3, 4]
+        assert spool.pending == 0
+        spool.close()
+
+    @pytest.mark.asyncio
+    async def test_checkpoint_stops_at_first_failure(self, tmp_path):
+        """Only the prefix before a failed record is committed."""
+        spool = _spool(tmp_path, 4)
+        send = FakeSend(lambda records: [None if r['n'] != 2 else RuntimeError('503') for r in records])
+        drainer = SpoolDrainer(spool, send, batch_size=4)
+
+        assert await drainer.drain_once() == 2
+        assert spool.pending == 2
+        assert [e.record['n'] for e in spool.read(10)] == [2, 3]
+        spool.close()
+
+    @pytest.mark.asyncio
+    async def test_outcome_count_mismatch_is_a_batch_error(self, tmp_path):
+        """A short outcome list commits nothing instead of acking unconfirmed records."""
+        spool = _spool(tmp_path, 3)
+        outcomes = []
+        drainer = SpoolDrainer(
+            spool, FakeSend(lambda records: [None]), batch_size=3,
+            on_outcome=lambda status, count: outcomes.append((status, count))
+        )
+
+        assert await drainer.drain_once() == 0
+        assert spool.pending == 3
+        assert outcomes == [('failed', 3)]
+        assert drainer.stats()['backoff_s'] > 0
+        spool.close()
+
+    @pytest.mark.asyncio
+    async def test_permanent_failures_are_dead_lettered(self, tmp_path):
+        """Permanent per-record failures are set aside and do not block the checkpoint."""
+        spool = _spool(tmp_path, 3)
+        send = FakeSend(lambda records: [PermanentError('400') if r['n'] == 1 else None for r in records])
+        drainer = SpoolDrainer(spool, send, batch_size=3, is_permanent=lambda e: isinstance(e, PermanentError))
+
+        assert await drainer.drain_once() == 3
+        assert spool.pending == 0
+        assert '"n": 1' in (tmp_path / DEAD_LETTER_FILE).read_text()
+        spool.close()
+
+    @pytest.mark.asyncio
+    async def test_dead_letters_only_within_committed_prefix(self, tmp_path):
+        """A permanent failure after an uncommitted batch is dead-lettered once, when it is committed."""
+        spool = _spool(tmp_path, 4)
+        down = {'n': 0}
+        send = FakeSend(lambda records: [
+            RuntimeError('503') if r['n'] == down['n'] else PermanentError('400') if r['n'] == 3 else None
+            for r in records
+        ])
+        drainer = SpoolDrainer(spool, send, batch_size=2, is_permanent=lambda e: isinstance(e, PermanentError))
+        drainer.limit = 2.0
+
+        assert await drainer.drain_once() == 0
+        assert not (tmp_path / DEAD_LETTER_FILE).exists()
+
+        down['n'] = None
+        drainer._resume_at = 0.0
+        assert await drainer.drain_once() == 4
+        assert (tmp_path / DEAD_LETTER_FILE).read_text().count('"n": 3') == 1
+        spool.close()
+
+    def test_backpressure_hysteresis(self, tmp_path):
+        """Backpressure engages at the high-water mark and releases at the low-water mark."""
+        spool = _spool(tmp_path, 3)
+        drainer = SpoolDrainer(spool, FakeSend(), high_water=3, low_water=1)
+
+        assert drainer.check_backpressure()
+        spool.commit(spool.read(1)[0].position, 1)
+        assert drainer.check_backpressure()
+        spool.commit(spool.read(1)[0].position, 1)
+        assert not drainer.check_backpressure()
+        spool.close()
+
+
+class TestPriorityGate:
+    """Test suite for PriorityGate."""
+
+    @pytest.mark.asyncio
+    async def test_live_waiters_go_first(self):
+        """A released slot goes to a waiting live acquirer before replay."""
+        gate = PriorityGate(1)
+        await gate.acquire()
+        order = []
+
+        async def take(live, name):
+            await gate.acquire(live)
+            order.append(name)
+            gate.release()
+
+        replay = asyncio.create_task(take(False, 'replay'))
+        await asyncio.sleep(0)
+        live = asyncio.create_task(take(True, 'live'))
+        await asyncio.sleep(0)
+        assert gate.live_waiting == 1
+
+        gate.release()
+        await asyncio.gather(replay, live)
+        assert order == ['live', 'replay']
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
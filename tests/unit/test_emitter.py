@@ -1,4 +1,6 @@
 """Unit tests for SidecarEmitter."""
+import json
+import threading
 import pytest
 from uuid import uuid4
 from unittest.mock import Mock, patch
@@ -91,3 +93,122 @@ class TestSidecarEmitter:
         # Should close cleanly
         assert True
 
+
+def _job_event(key: str = 'test') -> JobEvent:
+    app = AppRef(app_id=uuid4(), name='test-app', version='1.0')
+    entity = EntityRef(type='job', id=uuid4(), parent_id=None, business_key=key, sub_key=None)
+    return JobEvent.now('started', 'fab1', app, entity, status='running')
+
+
+class TestBackgroundDelivery:
+    """Test suite for SidecarEmitter async delivery mode."""
+
+    @patch('httpx.Client.post')
+    def test_send_enqueues_and_flush_batches(self, mock_post):
+        """Events sent in background mode are delivered as batches."""
+        mock_post.return_value = Mock(status_code=200)
+
+        emitter = SidecarEmitter(async_delivery=True, batch_size=10, flush_interval=0.05)
+        for i in range(5):
+            emitter.send(_job_event(f'job{i}'))
+
+        assert emitter.flush(timeout=5.0)
+        sent = sum(len(c[1]['json']) for c in mock_post.call_args_list)
+        assert sent == 5
+        assert all(c[0][0] == '/v1/ingest/events:batch' for c in mock_post.call_args_list)
+        assert emitter.stats['sent'] == 5
+        emitter.close()
+
+    @patch('httpx.Client.post')
+    def test_drop_oldest_when_queue_full(self, mock_post):
+        """With drop_oldest the oldest queued events give way to new ones."""
+        started, release = threading.Event(), threading.Event()
+
+        def slow_post(*args, **kwargs):
+            started.set()
+            release.wait(5.0)
+            return Mock(status_code=200)
+
+        mock_post.side_effect = slow_post
+        emitter = SidecarEmitter(async_delivery=True, queue_size=2, batch_size=1, flush_interval=0)
+
+        emitter.send(_job_event('first'))
+        assert started.wait(5.0)
+        for i in range(3):
+            emitter.send(_job_event(f'job{i}'))
+        release.set()
+
+        assert emitter.flush(timeout=5.0)
+        assert emitter.stats['dropped'] == 1
+        assert emitter.stats['sent'] == 3
+        emitter.close()
+
+    @patch('httpx.Client.post')
+    def test_undeliverable_batch_is_spilled(self, mock_post, tmp_path):
+        """Batches that fail after retries are appended to the spill file."""
+        mock_post.side_effect = httpx.NetworkError("Connection failed")
+        spill = tmp_path / 'spill.jsonl'
+
+        emitter = SidecarEmitter(async_delivery=True, flush_interval=0, spill_path=str(spill))
+        emitter.send(_job_event())
+        emitter.close()
+
+        lines = spill.read_text().splitlines()
+        assert len(lines) == 1
+        assert json.loads(lines[0])['entity']['business_key'] == 'test'
+        assert emitter.stats['spilled'] == 1
+
+    @patch('httpx.Client.close')
+    @patch('httpx.Client.post')
+    def test_close_timeout_spills_queue_and_keeps_client(self, mock_post, mock_close, tmp_path):
+        """A close() that times out spills the queue; the busy worker closes the client later."""
+        started, release = threading.Event(), threading.Event()
+
+        def slow_post(*args, **kwargs):
+            started.set()
+            release.wait(5.0)
+            return Mock(status_code=200)
+
+        mock_post.side_effect = slow_post
+        spill = tmp_path / 'spill.jsonl'
+        emitter = SidecarEmitter(async_delivery=True, batch_size=1, flush_interval=0,
+                                 close_timeout=0.05, spill_path=str(spill))
+        emitter.send(_job_event('inflight'))
+        assert started.wait(5.0)
+        emitter.send(_job_event('queued'))
+
+        emitter.close()
+        assert not mock_close.called
+        assert [json.loads(l)['entity']['business_key'] for l in spill.read_text().splitlines()] == ['queued']
+
+        release.set()
+        emitter._worker.join(5.0)
+        assert emitter.stats['sent'] == 1
+        assert mock_close.call_count == 1
+
+    def test_spill_policy_requires_path(self, monkeypatch):
+        """overflow='spill' without a spill file is rejected."""
+        monkeypatch.delenv('SIDECAR_SPILL_PATH', raising=False)
+        with pytest.raises(ValueError):
+            SidecarEmitter(async_delivery=True, overflow='spill')
+
+    def test_unknown_wire_format_rejected(self):
+        with pytest.raises(ValueError):
+            SidecarEmitter(wire_format='protobuf')
+
+    @patch('httpx.Client.post')
+    def test_compressed_batch_body(self, mock_post):
+        """json+zstd batches go out as a compressed body with Content-Encoding."""
+        zstandard = pytest.importorskip('zstandard')
+        mock_post.return_value = Mock(status_code=200)
+        emitter = SidecarEmitter(enable_retries=False, wire_format='json+zstd')
+        app = AppRef(app_id=uuid4(), name='test-app', version='1.0')
+        entity = EntityRef(type='job', id=uuid4(), parent_id=None, business_key='test', sub_key=None)
+        emitter.send_batch([JobEvent.now('started', 'fab1', app, entity, status='running')])
+
+        kwargs = mock_post.call_args[1]
+        assert kwargs['headers'] == {'Content-Type': 'application/json', 'Content-Encoding': 'zstd'}
+        with zstandard.ZstdDecompressor().stream_reader(kwargs['content']) as reader:
+            sent = json.loads(reader.read())
+        assert sent[0]['entity']['business_key'] == 'test'
+        emitter.close()
@@ -0,0 +1,214 @@
+"""Unit tests for the SSE event hub."""
+import json
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from datetime import datetime, timedelta, timezone
+
+from shared_utils.event_hub import EventHub, EventFilter, PgEventListener, batch_notification
+
+
+def _event(n: int, site: str = 'fab1', kind: str = 'progress') -> dict:
+    return {'n': n, 'site_id': site, 'kind': kind, 'entity_type': 'job', 'entity_id': f'id-{n}'}
+
+
+class TestEventHub:
+    """Test suite for EventHub."""
+
+    @pytest.mark.asyncio
+    async def test_fan_out_with_filters(self):
+        """Each subscriber only receives events matching its filter."""
+        hub = EventHub()
+        everything = hub.subscribe()
+        fab2_finished = hub.subscribe(EventFilter.parse(site='fab2', kind='finished,error'))
+
+        hub.publish(_event(1, site='fab1'))
+        hub.publish(_event(2, site='fab2', kind='finished'))
+        hub.publish(_event(3, site='fab2', kind='progress'))
+
+        got = [(await everything.get(0.1))[1]['n'] for _ in range(3)]
+        assert got == [1, 2, 3]
+        assert (await fab2_finished.get(0.1))[1]['n'] == 2
+        assert await fab2_finished.get(0.01) is None
+
+    @pytest.mark.asyncio
+    async def test_slow_subscriber_drops_oldest(self):
+        """A full ring buffer drops the oldest events and counts them."""
+        hub = EventHub(buffer_size=2)
+        sub = hub.subscribe()
+
+        for n in range(5):
+            hub.publish(_event(n))
+
+        assert sub.dropped == 3
+        assert [(await sub.get(0.1))[1]['n'] for _ in range(2)] == [3, 4]
+
+    @pytest.mark.asyncio
+    async def test_resume_from_last_event_id(self):
+        """Reconnecting with Last-Event-ID replays only newer buffered events."""
+        hub = EventHub(replay_size=10)
+        ids = [hub.publish(_event(n)) for n in range(4)]
+
+        sub = hub.subscribe(last_event_id=ids[1])
+
+        assert not sub.gap
+        replayed = [await sub.get(0.1) for _ in range(2)]
+        assert [eid for eid, _ in replayed] == ids[2:]
+        assert await sub.get(0.01) is None
+
+    def test_unknown_or_expired_id_is_a_gap(self):
+        """Ids from another process or evicted from replay are flagged."""
+        hub = EventHub(replay_size=2)
+        ids = [hub.publish(_event(n)) for n in range(5)]
+
+        assert hub.subscribe(last_event_id=ids[0]).gap
+        assert hub.subscribe(last_event_id='other-7').gap
+        assert not hub.subscribe(last_event_id=ids[2]).gap
+
+    def test_foreign_id_carries_cursor(self):
+        """Another worker's id leaves a gap with the cursor to backfill from."""
+        worker_a = EventHub(cursor=lambda ev: ev.get('at'))
+        worker_b = EventHub(cursor=lambda ev: ev.get('at'))
+        event_id = worker_a.publish({**_event(1), 'at': '2025-10-19T12:00:00+00:00'})
+        assert event_id.endswith('@2025-10-19T12:00:00+00:00')
+
+        sub = worker_b.subscribe(last_event_id=event_id)
+        assert sub.gap and sub.cursor == '2025-10-19T12:00:00+00:00'
+        assert worker_a.subscribe(last_event_id=event_id).cursor is None
+        assert worker_b.subscribe(last_event_id='other-7').cursor is None
+
+    def test_backfilled_id_is_not_replayed(self):
+        """Ids of events read back from the database resume from the database again."""
+        hub = EventHub(cursor=lambda ev: ev.get('at'))
+        hub.publish({**_event(1), 'at': '2025-10-19T12:00:00+00:00'})
+        event_id = hub.backfill_id({**_event(2), 'at': '2025-10-19T12:00:05+00:00'})
+
+        sub = hub.subscribe(last_event_id=event_id)
+        assert sub.gap and sub.cursor == '2025-10-19T12:00:05+00:00'
+
+    def test_unsubscribe(self):
+        """Closed subscriptions no longer receive events."""
+        hub = EventHub()
+        sub = hub.subscribe()
+        sub.close()
+
+        hub.publish(_event(1))
+
+        assert hub.subscriber_count == 0
+
+
+
+def _row(key: str, at: str = '2025-10-19T12:00:00+00:00') -> dict:
+    return {'idempotency_key': key, 'at': at, 'site_id': 'fab1', 'kind': 'progress',
+            'entity_type': 'job', 'entity_id': f'id-{key}', 'payload': {}}
+
+
+class FakeFetch:
+    """Serves rows by key or range and records the calls."""
+
+    def __init__(self, rows: list):
+        self.rows = rows
+        self.calls = []
+
+    async def __call__(self, keys, frm, to):
+        self.calls.append((keys, frm, to))
+        return [r for r in self.rows if keys is None or r['idempotency_key'] in keys]
+
+
+class TestPgEventListener:
+    """Test suite for compact notifications in PgEventListener."""
+
+    @pytest.mark.asyncio
+    async def test_keyed_notifications_fetched_together(self):
+        """Pending notifications with keys become one fetch, published in `at` order."""
+        fetch = FakeFetch([_row('b', '2025-10-19T12:00:02+00:00'), _row('a', '2025-10-19T12:00:01+00:00')])
+        hub = EventHub()
+        sub = hub.subscribe()
+        listener = PgEventListener('dsn', hub, fetch=fetch)
+
+        await listener._fetch_batch([
+            {'n': 1, 'from': 't1', 'to': 't1', 'ingested': 'i1', 'keys': ['a']},
+            {'n': 1, 'from': 't2', 'to': 't2', 'ingested': 'i2', 'keys': ['b']},
+        ])
+
+        assert fetch.calls == [(['a', 'b'], 't1', 't2')]
+        assert [(await sub.get(0.1))[1]['idempotency_key'] for _ in range(2)] == ['a', 'b']
+        assert listener.position == 'i2'
+
+    @pytest.mark.asyncio
+    async def test_range_notification_dedupes(self):
+        """A range fetch does not republish events already delivered."""
+        fetch = FakeFetch([_row('a'), _row('b')])
+        hub = EventHub()
+        sub = hub.subscribe()
+        listener = PgEventListener('dsn', hub, fetch=fetch)
+
+        await listener._fetch_batch([{'n': 1, 'from': 't1', 'to': 't1', 'keys': ['a']}])
+        await listener._fetch_batch([{'n': 2, 'from': 't1', 'to': 't2'}])
+
+        assert fetch.calls[-1] == (None, 't1', 't2')
+        assert hub.published == 2
+        assert [(await sub.get(0.1))[1]['idempotency_key'] for _ in range(2)] == ['a', 'b']
+
+    @pytest.mark.asyncio
+    async def test_no_fetch_without_subscribers(self):
+        """Rows are only fetched while someone is subscribed."""
+        fetch = FakeFetch([_row('a')])
+        listener = PgEventListener('dsn', EventHub(), fetch=fetch)
+
+        await listener._fetch_batch([{'n': 3, 'from': 't1', 'to': 't3', 'ingested': 'i3'}])
+
+        assert fetch.calls == []
+        assert listener.skipped == 3
+        assert listener.position == 'i3'
+
+    def test_position_is_ingest_time(self):
+        """A late event (old `at`) still advances the backfill position."""
+        listener = PgEventListener('dsn', EventHub())
+
+        listener._publish({**_row('a', '2025-10-19T12:00:05+00:00'), 'ingested_at': 'i1'})
+        listener._publish({**_row('b', '2025-10-18T00:00:00+00:00'), 'ingested_at': 'i2'})
+
+        assert listener.position == 'i2'
+
+    def test_compact_payload_is_queued_not_published(self):
+        """Compact notifications are never forwarded to subscribers as events."""
+        hub = EventHub()
+        listener = PgEventListener('dsn', hub)
+
+        listener._on_notify(None, 1, 'evt', '{"n": 1, "from": "t1", "to": "t1", "keys": ["a"]}')
+        listener._on_notify(None, 1, 'evt', '{"idempotency_key": "x", "at": "t0"}')
+
+        assert hub.published == 1
+
+
+
+class TestBatchNotification:
+    """Test suite for batch_notification."""
+
+    def test_keys_and_range(self):
+        t0 = datetime(2026, 1, 1, tzinfo=timezone.utc)
+        payload = batch_notification([('b', t0 + timedelta(seconds=5)), ('a', t0)])
+        assert json.loads(payload) == {
+            'n': 2, 'from': t0.isoformat(), 'to': (t0 + timedelta(seconds=5)).isoformat(), 'keys': ['b', 'a']
+        }
+
+    def test_keys_dropped_when_too_large(self):
+        t0 = datetime(2026, 1, 1, tzinfo=timezone.utc)
+        payload = json.loads(batch_notification([(f'key-{i:04d}', t0) for i in range(1000)]))
+        assert payload['n'] == 1000 and 'keys' not in payload
+
+    def test_ingest_position(self):
+        t0 = datetime(2026, 1, 1, tzinfo=timezone.utc)
+        payload = json.loads(batch_notification([('a', t0)], ingested=t0 + timedelta(hours=1)))
+        assert payload['ingested'] == (t0 + timedelta(hours=1)).isoformat()
+
+    def test_nothing_inserted(self):
+        assert batch_notification([]) is None
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
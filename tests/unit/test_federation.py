@@ -0,0 +1,73 @@
+"""Unit tests for cross-site result merging."""
+import pytest
+from datetime import datetime, timedelta, timezone
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.federation import (
+    SITE_DONE, merge_pages, next_site_cursors, encode_federated_cursor, decode_federated_cursor
+)
+from shared_utils.serialization import decode_cursor, CursorError
+
+T0 = datetime(2025, 10, 19, 12, 0, tzinfo=timezone.utc)
+
+
+def _rows(site: str, minutes: list) -> list:
+    """Rows in descending inserted_at order, as a Local API page returns them."""
+    return [
+        {'job_id': f'00000000-0000-0000-0000-{site[-1]}{m:011d}', 'site_id': site,
+         'inserted_at': (T0 + timedelta(minutes=m)).isoformat()}
+        for m in sorted(minutes, reverse=True)
+    ]
+
+
+class TestFederation:
+    """Test suite for shared_utils.federation."""
+
+    def test_merge_is_globally_ordered_and_limited(self):
+        """Pages from all sites interleave by recency up to the limit."""
+        pages = {'fab1': _rows('fab1', [9, 5, 1]), 'fab2': _rows('fab2', [8, 7, 2])}
+
+        items, consumed = merge_pages(pages, 'job_id', limit=4)
+
+        assert [i['inserted_at'] for i in items] == [
+            (T0 + timedelta(minutes=m)).isoformat() for m in (9, 8, 7, 5)
+        ]
+        assert consumed == {'fab1': 2, 'fab2': 2}
+
+    def test_next_cursors_resume_after_last_used_row(self):
+        """Each site resumes after its own last row that made the merged page."""
+        pages = {'fab1': _rows('fab1', [9, 5]), 'fab2': _rows('fab2', [8]), 'fab3': _rows('fab3', [1])}
+        items, consumed = merge_pages(pages, 'job_id', limit=2)
+
+        cursors = next_site_cursors(
+            pages, consumed,
+            has_more={'fab1': True, 'fab2': False, 'fab3': False},
+            previous={'fab3': 'prev-fab3'},
+            id_col='job_id'
+        )
+
+        at, _ = decode_cursor(cursors['fab1'])
+        assert at == T0 + timedelta(minutes=9)
+        assert cursors['fab2'] == SITE_DONE
+        assert cursors['fab3'] == 'prev-fab3'
+
+    def test_federated_cursor_round_trip(self):
+        """Per-site cursors survive packing; all-done means no next page."""
+        cursors = {'fab1': 'abc', 'fab2': SITE_DONE}
+
+        token = encode_federated_cursor(cursors)
+
+        assert decode_federated_cursor(token) == cursors
+        assert encode_federated_cursor({'fab1': SITE_DONE, 'fab2': SITE_DONE}) is None
+
+    def test_invalid_federated_cursor(self):
+        """Malformed tokens raise CursorError."""
+        with pytest.raises(CursorError):
+            decode_federated_cursor('%%%')
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
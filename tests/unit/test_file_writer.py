@@ -0,0 +1,150 @@
+"""Unit tests for the export integrations' rotating file writers."""
+import asyncio
+import gzip
+import zlib
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.integrations.file_writer import (
+    ParquetRotatingWriter, RotatingFileWriter, compression_codec
+)
+
+
+class TestRotatingFileWriter:
+    """Test suite for RotatingFileWriter."""
+
+    def test_buffered_until_flush(self, tmp_path):
+        """Records stay in memory until the buffer fills or it is flushed."""
+        w = RotatingFileWriter(tmp_path, 'ev', '.jsonl', rotation='none', buffer_bytes=10, header=b'h\n')
+        w.write([b'a\n'])
+        part = tmp_path / 'ev_events.part.jsonl'
+        assert part.read_bytes() == b''
+        w.write([b'bbbbbbbbbb\n'])
+        assert part.read_bytes() == b'h\na\nbbbbbbbbbb\n'
+        w.write([b'c\n'])
+        w.close()
+        assert not part.exists()
+        assert (tmp_path / 'ev_events.jsonl').read_bytes() == b'h\na\nbbbbbbbbbb\nc\n'
+        assert w.stats()['files_finalized'] == 1
+
+    def test_interval_flush(self, tmp_path):
+        """tick() writes out a buffer older than the flush interval."""
+        w = RotatingFileWriter(tmp_path, 'ev', '.csv', rotation='none', flush_interval_s=0.0)
+        w.write([b'x\n'])
+        w.tick()
+        assert (tmp_path / 'ev_events.part.csv').read_bytes() == b'x\n'
+        w.close()
+
+    def test_gzip_is_one_continuous_stream(self, tmp_path):
+        """Flushed data is readable while active; the final file is a single gzip member."""
+        w = RotatingFileWriter(tmp_path, 'ev', '.jsonl', rotation='none', compression='gzip', buffer_bytes=1)
+        for i in range(50):
+            w.write([b'{"n": %d}\n' % i])
+        expected = b''.join(b'{"n": %d}\n' % i for i in range(50))
+        # The unfinished stream decompresses up to the last flush
+        partial = zlib.decompressobj(wbits=31).decompress((tmp_path / 'ev_events.part.jsonl.gz').read_bytes())
+        assert partial == expected
+        w.close()
+        data = (tmp_path / 'ev_events.jsonl.gz').read_bytes()
+        assert gzip.decompress(data) == expected
+        assert data.count(b'\x1f\x8b\x08') == 1
+
+    def test_size_and_period_rotation(self, tmp_path):
+        """Files rotate at max_bytes and when the period changes, without overwriting."""
+        w = RotatingFileWriter(tmp_path, 'ev', '.csv', rotation='daily', max_bytes=10, buffer_bytes=1)
+        period = ['20251019']
+        w._period_key = lambda: period[0]
+        w.write([b'123456\n'])
+        w.write([b'123456\n'])  # reaches max_bytes: finalized
+        w.write([b'abc\n'])
+        period[0] = '20251020'
+        w.tick()  # period ended: finalized without new traffic
+        w.write([b'new\n'])
+        w.close()
+        names = sorted(p.name for p in tmp_path.iterdir())
+        assert names == ['ev_20251019.1.csv', 'ev_20251019.csv', 'ev_20251020.csv']
+        assert (tmp_path / 'ev_20251019.csv').read_bytes() == b'123456\n123456\n'
+        assert (tmp_path / 'ev_20251019.1.csv').read_bytes() == b'abc\n'
+
+    def test_max_age_finalizes_without_period(self, tmp_path):
+        """With rotation 'none' an old active file is still finalized."""
+        w = RotatingFileWriter(tmp_path, 'ev', '.jsonl', rotation='none')
+        assert w.max_age_s == 3600.0
+        w.max_age_s = 0.01
+        w.write([b'a\n'])
+        w.tick()
+        assert (tmp_path / 'ev_events.part.jsonl').exists()
+        w._opened_at -= 1.0
+        w.tick()
+        assert (tmp_path / 'ev_events.jsonl').read_bytes() == b'a\n'
+        w.write([b'b\n'])
+        w.close()
+        assert (tmp_path / 'ev_events.1.jsonl').read_bytes() == b'b\n'
+
+    def test_recover_finalizes_leftovers(self, tmp_path):
+        """Files left active by a crash are finalized on start."""
+        (tmp_path / 'ev_20251019.part.jsonl').write_bytes(b'a\n')
+        (tmp_path / 'ev_20251019.jsonl').write_bytes(b'old\n')
+        w = RotatingFileWriter(tmp_path, 'ev', '.jsonl')
+
+        async def run():
+            await w.start()
+            await w.write_async([b'b\n'])
+            await w.close_async()
+
+        asyncio.run(run())
+        assert (tmp_path / 'ev_20251019.1.jsonl').read_bytes() == b'a\n'
+        assert (tmp_path / 'ev_20251019.jsonl').read_bytes() == b'old\n'
+        assert not list(tmp_path.glob('*.part.*'))
+        assert w.stats()['records'] == 1
+
+    def test_compression_codec(self):
+        """Config values map to codecs."""
+        assert compression_codec(True) == 'gzip'
+        assert compression_codec(False) is None
+        with pytest.raises(ValueError):
+            compression_codec('lz4')
+
+    def test_zstd_codec(self):
+        pytest.importorskip('zstandard')
+        assert compression_codec('zstd') == 'zstd'
+
+
+class TestParquetRotatingWriter:
+    """Test suite for ParquetRotatingWriter."""
+
+    def test_row_groups_and_finalize(self, tmp_path):
+        """Rows are written in row groups of the configured size into one file per rotation."""
+        pa = pytest.importorskip('pyarrow')
+        pq = pytest.importorskip('pyarrow.parquet')
+        schema = pa.schema([('entity_id', pa.string()), ('duration_s', pa.float64())])
+        w = ParquetRotatingWriter(tmp_path, 'ev', schema, rotation='none', row_group_rows=2)
+        w.write([{'entity_id': 'a', 'duration_s': 1.0}, {'entity_id': 'b', 'duration_s': None}])
+        w.write([{'entity_id': 'c', 'duration_s': 3.0}])
+        w.close()
+        f = pq.ParquetFile(tmp_path / 'ev_events.parquet')
+        assert f.metadata.num_row_groups == 2
+        assert f.read().column('entity_id').to_pylist() == ['a', 'b', 'c']
+
+    def test_interval_flush_writes_row_group(self, tmp_path):
+        """An old buffer is written as a row group before it is full."""
+        pa = pytest.importorskip('pyarrow')
+        pq = pytest.importorskip('pyarrow.parquet')
+        schema = pa.schema([('entity_id', pa.string())])
+        w = ParquetRotatingWriter(tmp_path, 'ev', schema, rotation='none', row_group_rows=100, flush_interval_s=0.0)
+        w.write([{'entity_id': 'a'}])
+        w.tick()
+        w.write([{'entity_id': 'b'}])
+        w.close()
+        assert pq.ParquetFile(tmp_path / 'ev_events.parquet').metadata.num_row_groups == 2
+
+    def test_unreadable_leftover_set_aside(self, tmp_path):
+        """A Parquet file without footer is not finalized."""
+        pa = pytest.importorskip('pyarrow')
+        (tmp_path / 'ev_events.part.parquet').write_bytes(b'PAR1 truncated')
+        w = ParquetRotatingWriter(tmp_path, 'ev', pa.schema([('a', pa.string())]))
+        assert w.recover() == []
+        assert [p.name for p in tmp_path.iterdir()] == ['ev_events.part.parquet.unrecoverable']
@@ -2,6 +2,8 @@
 import pytest
 from unittest.mock import Mock, AsyncMock, patch
 import asyncio
+import json
+import time
 
 import sys
 from pathlib import Path
@@ -11,10 +13,46 @@ from shared_utils.integrations import (
     IntegrationContainer,
     IntegrationConfig,
     IntegrationType,
+    BaseIntegration,
     LocalAPIIntegration,
     CSVExportIntegration,
     JSONExportIntegration
 )
+from shared_utils.integrations.dispatch import IntegrationQueue
+from shared_utils.integrations.elk import BulkIndexer, ELKIntegration
+from shared_utils.integrations.zabbix import ZabbixIntegration, pack, read_packet
+from shared_utils.integrations.resilience import AdaptiveBatchSize, CircuitBreaker
+
+
+class FakeIntegration(BaseIntegration):
+    """Integration that records deliveries, optionally slowly or failing."""
+    
+    def __init__(self, name, delay=0.0, fail=False, **config):
+        super().__init__(IntegrationConfig(name=name, config=config))
+        self.delay = delay
+        self.fail = fail
+        self.received = []
+        self.batches = []
+    
+    async def initialize(self):
+        self._initialized = True
+    
+    async def send_event(self, event):
+        await asyncio.sleep(self.delay)
+        self.received.append(event)
+        return not self.fail
+    
+    async def send_batch(self, events):
+        await asyncio.sleep(self.delay)
+        self.batches.append(len(events))
+        self.received.extend(events)
+        return {'success': 0, 'failed': len(events)} if self.fail else {'success': len(events), 'failed': 0}
+    
+    async def health_check(self):
+        return {'status': 'healthy', 'integration': self.name}
+    
+    async def close(self):
+        pass
 
 
 @pytest.mark.asyncio
@@ -147,6 +185,186 @@ class TestIntegrationContainer:
         assert len(container.integrations) == 0
 
 
+@pytest.mark.asyncio
+class TestIntegrationQueue:
+    """Test suite for per-integration dispatch queues."""
+    
+    async def test_slow_integration_does_not_block_dispatch(self):
+        """Dispatch returns once events are enqueued; each backend drains on its own."""
+        container = IntegrationContainer()
+        slow, fast = FakeIntegration('slow', delay=0.5), FakeIntegration('fast')
+        container.integrations = {'slow': slow, 'fast': fast}
+        await container.initialize_all()
+        
+        start = time.monotonic()
+        results = await container.send_event({'n': 1})
+        assert results == {'slow': True, 'fast': True}
+        assert time.monotonic() - start < 0.1
+        
+        await asyncio.sleep(0.05)
+        assert fast.received == [{'n': 1}] and slow.received == []
+        assert container.queue_stats()['slow']['in_flight'] == 1
+        
+        await container.close_all()
+        assert slow.received == [{'n': 1}]
+    
+    async def test_overflow_policies(self):
+        """Full queues drop the oldest or the newest events; replay only uses free room."""
+        backend = FakeIntegration('b', delay=10)
+        dropped = IntegrationQueue(backend, max_events=3, overflow='drop_oldest')
+        for i in range(5):
+            assert await dropped.put([{'n': i}], single=True)
+        assert [e[1][0]['n'] for e in dropped._items] == [2, 3, 4]
+        assert dropped.stats()['dropped'] == 2
+        assert not await dropped.put([{'n': 5}], live=False)
+        
+        rejecting = IntegrationQueue(backend, max_events=2, overflow='drop_newest')
+        assert await rejecting.put([{'n': 0}, {'n': 1}])
+        assert not await rejecting.put([{'n': 2}])
+        assert rejecting.stats()['rejected'] == 1 and rejecting.depth == 2
+        
+        blocking = IntegrationQueue(backend, max_events=1, overflow='block', block_timeout_s=0.05)
+        assert await blocking.put([{'n': 0}])
+        start = time.monotonic()
+        assert not await blocking.put([{'n': 1}])
+        assert time.monotonic() - start >= 0.05
+        
+        with pytest.raises(ValueError):
+            IntegrationQueue(backend, overflow='drop_everything')
+    
+    async def test_overflow_is_spooled_with_on_failure(self):
+        """With a spool behind the queue, evicted and refused live events are kept, not lost."""
+        backend = FakeIntegration('b', delay=10)
+        kept = []
+        evicting = IntegrationQueue(backend, max_events=2, overflow='drop_oldest', on_failure=kept.extend)
+        for i in range(3):
+            assert await evicting.put([{'n': i}], single=True)
+        assert kept == [{'n': 0}] and evicting.stats()['dropped'] == 0
+        
+        kept.clear()
+        refusing = IntegrationQueue(backend, max_events=1, overflow='drop_newest', on_failure=kept.extend)
+        assert await refusing.put([{'n': 0}])
+        assert await refusing.put([{'n': 1}])
+        assert not await refusing.put([{'n': 2}], live=False)
+        assert kept == [{'n': 1}] and refusing.stats()['spooled'] == 1
+    
+    async def test_undelivered_events_are_handed_over(self):
+        """Failed deliveries and events left at close reach on_failure."""
+        failed = []
+        outcomes = []
+        container = IntegrationContainer(
+            on_outcome=lambda name, outcome, count: outcomes.append((name, outcome, count)),
+            on_failure=lambda name, events: failed.append((name, events))
+        )
+        container.integrations = {
+            'down': FakeIntegration('down', fail=True),
+            'stuck': FakeIntegration('stuck', delay=10, concurrency=1)
+        }
+        await container.initialize_all()
+        
+        results = await container.send_batch([{'n': 1}, {'n': 2}])
+        assert results['down'] == {'success': 2, 'failed': 0}
+        await container.send_batch([{'n': 3}], names=['stuck'])
+        await asyncio.sleep(0.05)
+        assert failed == [('down', [{'n': 1}, {'n': 2}])]
+        assert ('down', 'failed', 2) in outcomes
+        
+        await container.close_all(drain_timeout_s=0.05)
+        assert sorted(e['n'] for name, events in failed if name == 'stuck' for e in events) == [1, 2, 3]
+    
+    async def test_only_failed_events_are_handed_over(self):
+        """Rejected events are not kept; partial failures keep just the failed events."""
+        class Partial(FakeIntegration):
+            async def send_batch(self, events):
+                return {'success': 1, 'failed': 1, 'rejected': 1, 'failed_indices': [2]}
+        
+        handed = []
+        backend = Partial('partial')
+        queue = IntegrationQueue(backend, on_failure=handed.extend)
+        queue.start()
+        await queue.put([{'n': 0}, {'n': 1}, {'n': 2}])
+        await queue.close()
+        assert handed == [{'n': 2}]
+        assert queue.stats()['delivered'] == 2 and queue.stats()['failed'] == 1
+        assert backend.breaker.stats()['consecutive_failures'] == 1
+
+
+@pytest.mark.asyncio
+class TestResilience:
+    """Test suite for circuit breakers and adaptive batching."""
+    
+    async def test_circuit_breaker_half_open_probe(self):
+        """The breaker opens after repeated failures and lets one probe through after the timeout."""
+        breaker = CircuitBreaker(failure_threshold=2, reset_timeout_s=0.05)
+        for _ in range(2):
+            assert breaker.allow()
+            breaker.record(False)
+        assert breaker.state == 'open' and not breaker.accepting and not breaker.allow()
+        
+        await asyncio.sleep(0.06)
+        assert breaker.accepting
+        assert breaker.allow() and breaker.state == 'half_open'
+        assert not breaker.allow()  # one probe at a time
+        breaker.record(False)
+        assert breaker.state == 'open' and breaker.stats()['reset_timeout_s'] == 0.1
+        
+        await asyncio.sleep(0.11)
+        assert breaker.allow()
+        breaker.record(True)
+        assert breaker.state == 'closed' and breaker.allow()
+    
+    async def test_batch_size_follows_latency(self):
+        """Fast full batches grow the size; slow or failed ones shrink it."""
+        size = AdaptiveBatchSize(max_size=100, target_latency_s=0.1)
+        for _ in range(20):
+            size.observe(size.current, 0.01, True)
+        assert size.current == 100
+        size.observe(100, 0.5, True)
+        assert size.current == 70
+        size.observe(5, 0.01, True)  # not full: no evidence to grow
+        assert size.current == 70
+        size.observe(70, 0.01, False)
+        assert size.current == 35
+    
+    async def test_queue_coalesces_batches(self):
+        """With batching, queued single events are delivered in one send_batch call."""
+        backend = FakeIntegration('elk', batching=True, batch_linger_ms=20)
+        backend.batch_size.current = 10
+        queue = IntegrationQueue(backend)
+        for i in range(5):
+            await queue.put([{'n': i}], single=True)
+        queue.start()
+        await asyncio.sleep(0.1)
+        assert backend.batches == [5]
+        assert [e['n'] for e in backend.received] == list(range(5))
+        await queue.close()
+    
+    async def test_open_breaker_spools_per_integration(self, tmp_path):
+        """Events for a dead backend go to its own spool and are replayed once it recovers."""
+        container = IntegrationContainer(spool_dir=str(tmp_path), drain_interval_s=0.02)
+        dead = FakeIntegration('dead', fail=True, breaker_failure_threshold=1, breaker_reset_s=0.1)
+        live = FakeIntegration('live')
+        container.integrations = {'dead': dead, 'live': live}
+        await container.initialize_all()
+        
+        await container.send_event({'n': 0})
+        await asyncio.sleep(0.05)
+        assert dead.breaker.state == 'open'
+        
+        start = time.monotonic()
+        results = await container.send_event({'n': 1})
+        assert results == {'dead': True, 'live': True} and time.monotonic() - start < 0.05
+        assert container.spools['dead'].pending == 2
+        assert container.queue_stats()['dead']['spooled'] == 1
+        
+        dead.fail = False
+        await asyncio.sleep(0.5)
+        assert container.spools['dead'].pending == 0
+        assert [e['n'] for e in dead.received][-2:] == [0, 1]
+        assert [e['n'] for e in live.received] == [0, 1]
+        await container.close_all()
+
+
 @pytest.mark.asyncio
 class TestLocalAPIIntegration:
     """Test suite for LocalAPIIntegration."""
@@ -167,9 +385,35 @@ class TestLocalAPIIntegration:
         
         await integration.initialize()
         assert integration._initialized
-        
+        assert integration.wire_format == 'json'
+
         await integration.close()
 
+    async def test_rejected_items_do_not_fail_the_batch(self):
+        """Per-item validation rejections are 'rejected'; 5xx and transport errors are 'failed'."""
+        integration = LocalAPIIntegration(IntegrationConfig(type=IntegrationType.LOCAL_API, name='test'))
+        body = {'results': [{'index': 0, 'status': 'accepted'}, {'index': 1, 'status': 'rejected', 'error': 'bad'}]}
+        integration.client = AsyncMock()
+        integration.client.post.return_value = FakeBulkResponse(200, body)
+        assert await integration.send_batch([{}, {}]) == {'success': 1, 'failed': 0, 'rejected': 1}
+        
+        integration.client.post.return_value = FakeBulkResponse(422)
+        assert await integration.send_batch([{}, {}]) == {'success': 0, 'failed': 0, 'rejected': 2}
+        integration.client.post.return_value = FakeBulkResponse(503)
+        assert await integration.send_batch([{}, {}]) == {'success': 0, 'failed': 2, 'rejected': 0}
+        integration.client.post.side_effect = ConnectionError('down')
+        assert await integration.send_batch([{}, {}]) == {'success': 0, 'failed': 2, 'rejected': 0}
+    
+    async def test_unknown_wire_format_rejected(self):
+        config = IntegrationConfig(
+            type=IntegrationType.LOCAL_API,
+            name='test',
+            enabled=True,
+            config={'base_url': 'http://test:18000', 'wire_format': 'protobuf'}
+        )
+        with pytest.raises(ValueError):
+            LocalAPIIntegration(config)
+
 
 @pytest.mark.asyncio
 class TestCSVExportIntegration:
@@ -247,6 +491,178 @@ class TestJSONExportIntegration:
         await integration.close()
 
 
+class FakeBulkResponse:
+    def __init__(self, status_code, body=None):
+        self.status_code = status_code
+        self._body = body or {}
+        self.text = json.dumps(self._body)
+    
+    def json(self):
+        return self._body
+
+
+class FakeESClient:
+    """Answers _bulk requests with scripted per-item statuses, keyed by document id."""
+    
+    def __init__(self, statuses):
+        self.statuses = statuses  # id -> list of statuses, popped per attempt
+        self.requests = []
+    
+    async def post(self, url, content, headers):
+        lines = content.decode().splitlines()
+        ids = [json.loads(a)['index']['_id'] for a in lines[::2]]
+        self.requests.append(ids)
+        items = [{'index': {'status': (self.statuses.get(i) or [201]).pop(0), 'error': {'type': 'x'}}} for i in ids]
+        return FakeBulkResponse(200, {'errors': any(it['index']['status'] >= 300 for it in items), 'items': items})
+
+
+@pytest.mark.asyncio
+class TestELKBulkIndexer:
+    """Test suite for ELK BulkIndexer."""
+    
+    async def test_only_retryable_items_are_retried(self):
+        """429/5xx items are resent, permanent rejections are not."""
+        client = FakeESClient({'b': [429, 201], 'c': [400], 'd': [503, 503, 503]})
+        indexer = BulkIndexer(client, 'http://es', max_retries=2, backoff_s=0.0)
+        items = [BulkIndexer.encode('idx', {'n': i}, i) for i in 'abcd']
+        
+        result = await indexer.index(items)
+        
+        assert result == {'success': 2, 'failed': 1, 'rejected': 1, 'failed_indices': [3]}
+        assert client.requests == [['a', 'b', 'c', 'd'], ['b', 'd'], ['d']]
+        assert indexer.counts['retried'] == 3
+    
+    async def test_requests_split_by_size_and_count(self):
+        """Bodies stay within max_docs and max_bytes."""
+        client = FakeESClient({})
+        items = [BulkIndexer.encode('idx', {'pad': 'x' * 50}, str(i)) for i in range(7)]
+        indexer = BulkIndexer(client, 'http://es', max_bytes=len(items[0]) * 2, max_docs=3)
+        
+        assert (await indexer.index(items))['success'] == 7
+        assert [len(r) for r in client.requests] == [2, 2, 2, 1]
+        
+        client.requests.clear()
+        indexer.max_bytes = 10 ** 6
+        await indexer.index(items)
+        assert [len(r) for r in client.requests] == [3, 3, 1]
+    
+    async def test_index_follows_event_time(self):
+        """Documents are routed by the event's own timestamp."""
+        integration = ELKIntegration(IntegrationConfig(name='elk', config={'index_prefix': 'wm'}))
+        assert integration._get_index_name('2025-10-19T23:59:00Z') == 'wm-2025.10.19'
+        assert integration._get_index_name('2025-10-20T01:00:00+02:00') == 'wm-2025.10.19'
+        assert integration._get_index_name('garbage').startswith('wm-')
+
+
+class FakeZabbixTrapper:
+    """Local TCP server speaking the sender protocol; closes after each response like Zabbix."""
+    
+    def __init__(self, known_keys=None):
+        self.known_keys = known_keys
+        self.requests = []
+    
+    async def handle(self, reader, writer):
+        request = await read_packet(reader)
+        self.requests.append(request)
+        data = request['data']
+        failed = 0 if self.known_keys is None else sum(1 for d in data if d['key'] not in self.known_keys)
+        info = f"processed: {len(data) - failed}; failed: {failed}; total: {len(data)}; seconds spent: 0.0001"
+        writer.write(pack({'response': 'success', 'info': info}))
+        await writer.drain()
+        writer.close()
+    
+    async def __aenter__(self):
+        self.server = await asyncio.start_server(self.handle, '127.0.0.1', 0)
+        self.port = self.server.sockets[0].getsockname()[1]
+        return self
+    
+    async def __aexit__(self, *exc):
+        self.server.close()
+        await self.server.wait_closed()
+
+
+def zabbix_event(kind, duration=1.5):
+    return {
+        'entity': {'type': 'job', 'id': 'job-1'},
+        'event': {'kind': kind, 'at': '2025-10-19T12:00:00+00:00', 'metrics': {'duration_s': duration}}
+    }
+
+
+@pytest.mark.asyncio
+class TestZabbixIntegration:
+    """Test suite for ZabbixIntegration."""
+    
+    async def test_batches_over_native_protocol(self):
+        """Values are sent in requests of at most max_items_per_request; rejected values are reported."""
+        async with FakeZabbixTrapper(known_keys={'wafer.job.finished'}) as trapper:
+            integration = ZabbixIntegration(IntegrationConfig(name='zbx', config={
+                'zabbix_server': f'http://127.0.0.1:{trapper.port}', 'max_items_per_request': 2
+            }))
+            await integration.initialize()
+            
+            events = [zabbix_event('finished')] * 4 + [zabbix_event('started')]
+            result = await integration.send_batch(events)
+            
+            assert result == {'success': 4, 'failed': 0, 'rejected': 1}
+            assert sorted(len(r['data']) for r in trapper.requests) == [1, 2, 2]
+            assert trapper.requests[0]['request'] == 'sender data'
+            assert trapper.requests[0]['data'][0]['value'] == '1.5'
+            # The server closes after each response, so every request reconnects
+            assert integration.sender.connects == 3
+            await integration.close()
+    
+    async def test_low_level_discovery(self):
+        """New item keys are registered through the discovery rule before their values."""
+        async with FakeZabbixTrapper() as trapper:
+            integration = ZabbixIntegration(IntegrationConfig(name='zbx', config={
+                'zabbix_server': f'127.0.0.1:{trapper.port}', 'lld': True
+            }))
+            
+            await integration.send_batch([zabbix_event('started'), zabbix_event('finished')])
+            await integration.send_batch([zabbix_event('finished')])
+            
+            discovery = trapper.requests[0]['data'][0]
+            assert discovery['key'] == 'wafer.discovery'
+            assert json.loads(discovery['value'])['data'] == [
+                {'{#ENTITY_TYPE}': 'job', '{#EVENT_KIND}': 'finished'},
+                {'{#ENTITY_TYPE}': 'job', '{#EVENT_KIND}': 'started'},
+            ]
+            # Values of newly discovered keys go in one request per key
+            assert sorted(d['key'] for r in trapper.requests[1:3] for d in r['data']) == [
+                'wafer.event[job,finished]', 'wafer.event[job,started]'
+            ]
+            assert len(trapper.requests) == 4  # no new keys: no second discovery
+    
+    async def test_new_lld_keys_are_deferred_until_created(self):
+        """Refused values of a just-discovered key are redelivered, not rejected."""
+        async with FakeZabbixTrapper(known_keys={'wafer.discovery', 'wafer.event[job,finished]'}) as trapper:
+            integration = ZabbixIntegration(IntegrationConfig(name='zbx', config={
+                'zabbix_server': f'127.0.0.1:{trapper.port}', 'lld': True
+            }))
+            events = [zabbix_event('finished'), zabbix_event('started'), zabbix_event('started')]
+            
+            result = await integration.send_batch(events)
+            assert result == {'success': 1, 'failed': 2, 'rejected': 0, 'failed_indices': [1, 2], 'deferred': 2}
+            assert await integration.deliver(events) == events[1:]
+            assert integration.breaker.state == 'closed'
+            
+            # Once the server has created the item the values go through
+            trapper.known_keys.add('wafer.event[job,started]')
+            assert await integration.send_batch(events[1:]) == {'success': 2, 'failed': 0, 'rejected': 0}
+            
+            # After lld_delay_s, refusals are rejections again
+            integration.lld_delay_s = 0
+            assert (await integration.send_batch([zabbix_event('error')]))['rejected'] == 1
+            await integration.close()
+    
+    async def test_unreachable_server_fails_batch(self):
+        """Transport errors count every value as failed."""
+        integration = ZabbixIntegration(IntegrationConfig(name='zbx', config={
+            'zabbix_server': '127.0.0.1:1', 'timeout_s': 1.0
+        }))
+        assert await integration.send_batch([zabbix_event('finished')]) == {'success': 0, 'failed': 1}
+
+
 if __name__ == '__main__':
     pytest.main([__file__, '-v'])
 
@@ -0,0 +1,134 @@
+"""Unit tests for hot-path metrics helpers and the sampling profiler."""
+import threading
+import time
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.metrics import MetricsCollector, NULL_STAGE_TIMER, route_template, prepare_multiprocess_dir
+from shared_utils.profiler import SamplingProfiler
+
+
+class FakeRoute:
+    def __init__(self, path):
+        self.path = path
+
+
+class FakeRequest:
+    def __init__(self, scope):
+        self.scope = scope
+
+
+class TestMetricsCollector:
+    """Test suite for MetricsCollector hot-path helpers."""
+
+    def test_route_template(self):
+        """The matched route's template is the endpoint label; unmatched paths share one."""
+        assert route_template(FakeRequest({'route': FakeRoute('/v1/jobs/{job_id}'), 'path': '/v1/jobs/42'})) == '/v1/jobs/{job_id}'
+        assert route_template(FakeRequest({'path': '/nope/1'})) == 'unmatched'
+
+    def test_bound_children_reused(self):
+        """Label children are created once per label values."""
+        m = MetricsCollector('test')
+        a = m.bound(m.db_operations_total, 'insert', 'event', 'success')
+        assert m.bound(m.db_operations_total, 'insert', 'event', 'success') is a
+        assert m.bound(m.db_operations_total, 'insert', 'job', 'success') is not a
+        assert m.bound(m.db_operation_duration_seconds, 'insert', 'event') is not a
+
+    def test_stage_timer(self):
+        """Consecutive marks observe non-overlapping stage durations."""
+        m = MetricsCollector('test')
+        timer = m.stage_timer('single')
+        time.sleep(0.01)
+        timer.mark('validate')
+        timer.mark('insert_event')
+
+        def sample(suffix, stage):
+            labels = {'path': 'single', 'stage': stage}
+            return m.registry.get_sample_value(f'ingest_stage_duration_seconds_{suffix}', labels)
+
+        assert sample('count', 'validate') == 1 and sample('count', 'insert_event') == 1
+        assert sample('sum', 'validate') >= 0.01 > sample('sum', 'insert_event')
+        NULL_STAGE_TIMER.mark('validate')  # no-op
+
+    def test_openmetrics_negotiation(self):
+        """OpenMetrics (which carries exemplars) is served when the scraper accepts it."""
+        m = MetricsCollector('test')
+        accept = 'application/openmetrics-text;version=1.0.0,text/plain;q=0.5'
+        assert m.get_content_type(accept).startswith('application/openmetrics-text')
+        assert m.get_content_type('text/plain').startswith('text/plain')
+        assert m.get_content_type().startswith('text/plain')
+
+
+class TestMultiprocessMetrics:
+    """Test suite for metrics shared by worker processes."""
+
+    def _sample(self, collector, name, **labels):
+        from prometheus_client.parser import text_string_to_metric_families
+        for family in text_string_to_metric_families(collector.get_metrics().decode()):
+            for sample in family.samples:
+                if sample.name == name and all(sample.labels.get(k) == v for k, v in labels.items()):
+                    return sample.value
+        return None
+
+    def test_workers_are_summed(self, tmp_path, monkeypatch):
+        """Any worker's scrape reports the counters of all workers."""
+        from prometheus_client import values
+        monkeypatch.setenv('PROMETHEUS_MULTIPROC_DIR', str(tmp_path))
+        collectors = []
+        for pid in (101, 102):
+            monkeypatch.setattr(values, 'ValueClass', values.MultiProcessValue(lambda pid=pid: pid))
+            collectors.append(MetricsCollector('test', multiprocess_dir=str(tmp_path)))
+        for c in collectors:
+            c.record_db_operation('insert', 'event', 'success', 0.01)
+            c.update_pool_metrics(size=3, available=1)
+        assert self._sample(collectors[0], 'db_operations_total', operation='insert', table='event') == 2
+        assert self._sample(collectors[1], 'db_pool_size') == 6
+
+    def test_prepare_empties_directory(self, tmp_path, monkeypatch):
+        """Files of an earlier run are not summed into the next one."""
+        monkeypatch.setenv('PROMETHEUS_MULTIPROC_DIR', str(tmp_path))
+        (tmp_path / 'counter_1.db').write_bytes(b'stale')
+        assert prepare_multiprocess_dir() == str(tmp_path)
+        assert list(tmp_path.iterdir()) == []
+
+
+class TestSamplingProfiler:
+    """Test suite for SamplingProfiler."""
+
+    def test_samples_target_thread(self):
+        """Stacks of the target thread are counted, outermost frame first."""
+        stop = threading.Event()
+
+        def busy_worker():
+            while not stop.is_set():
+                sum(range(1000))
+
+        t = threading.Thread(target=busy_worker)
+        t.start()
+        try:
+            profiler = SamplingProfiler(thread_id=t.ident)
+            counts = profiler.sample(0.1, interval_s=0.002)
+        finally:
+            stop.set()
+            t.join()
+        assert sum(counts.values()) > 5
+        assert all('busy_worker' in stack for stack in counts)
+        top = SamplingProfiler.collapsed(counts).splitlines()[0]
+        stack, n = top.rsplit(' ', 1)
+        assert stack.split(';')[-1].startswith('busy_worker') and int(n) == max(counts.values())
+
+    def test_one_profile_at_a_time(self):
+        """A second concurrent profile is refused."""
+        profiler = SamplingProfiler()
+        t = threading.Thread(target=profiler.sample, args=(0.2,))
+        t.start()
+        time.sleep(0.05)
+        try:
+            with pytest.raises(RuntimeError):
+                profiler.sample(0.01)
+        finally:
+            t.join()
+        assert not profiler.running
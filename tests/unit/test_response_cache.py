@@ -0,0 +1,90 @@
+"""Unit tests for the Central API response cache."""
+import asyncio
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.response_cache import ResponseCache, NOT_MODIFIED, cache_key
+
+
+class CountingFetcher:
+    """Fetcher that records calls and the ETag it was given."""
+
+    def __init__(self, delay: float = 0.0, not_modified: bool = False):
+        self.calls = 0
+        self.etags = []
+        self.delay = delay
+        self.not_modified = not_modified
+
+    async def __call__(self, etag):
+        self.calls += 1
+        self.etags.append(etag)
+        await asyncio.sleep(self.delay)
+        if etag and self.not_modified:
+            return NOT_MODIFIED
+        return {'n': self.calls}, f'"v{self.calls}"'
+
+
+class TestResponseCache:
+    """Test suite for ResponseCache."""
+
+    def test_cache_key_ignores_param_order_and_empty_values(self):
+        """Equivalent query strings share one key."""
+        a = cache_key('fab1', '/v1/jobs', params={'limit': '10', 'status': 'failed', 'app_name': ''})
+        b = cache_key('fab1', '/v1/jobs', params={'status': 'failed', 'limit': '10'})
+        assert a == b
+
+    @pytest.mark.asyncio
+    async def test_fresh_entries_are_hits(self):
+        """Within the TTL the origin is not called again."""
+        cache = ResponseCache(ttl_s=60)
+        fetch = CountingFetcher()
+
+        assert await cache.get('k', fetch) == ({'n': 1}, 'miss')
+        assert await cache.get('k', fetch) == ({'n': 1}, 'hit')
+        assert fetch.calls == 1
+
+    @pytest.mark.asyncio
+    async def test_concurrent_misses_are_coalesced(self):
+        """Identical concurrent requests share a single fetch."""
+        cache = ResponseCache(ttl_s=60)
+        fetch = CountingFetcher(delay=0.05)
+
+        results = await asyncio.gather(*(cache.get('k', fetch) for _ in range(10)))
+
+        assert fetch.calls == 1
+        assert all(value == {'n': 1} for value, _ in results)
+        assert cache.stats['coalesced'] == 9
+
+    @pytest.mark.asyncio
+    async def test_stale_served_while_revalidating_with_etag(self):
+        """Stale entries are returned immediately and revalidated in the background."""
+        cache = ResponseCache(ttl_s=0, stale_s=60)
+        fetch = CountingFetcher(not_modified=True)
+
+        await cache.get('k', fetch)
+        value, status = await cache.get('k', fetch)
+        await asyncio.sleep(0.01)
+
+        assert (value, status) == ({'n': 1}, 'stale')
+        assert fetch.etags == [None, '"v1"']
+        assert cache.stats['revalidated'] == 1
+
+    @pytest.mark.asyncio
+    async def test_lru_bound(self):
+        """The least recently used key is evicted beyond max_entries."""
+        cache = ResponseCache(ttl_s=60, max_entries=2)
+        fetch = CountingFetcher()
+
+        for key in ('a', 'b', 'a', 'c'):
+            await cache.get(key, fetch)
+
+        assert len(cache) == 2
+        assert (await cache.get('a', fetch))[1] == 'hit'
+        assert (await cache.get('b', fetch))[1] == 'miss'
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
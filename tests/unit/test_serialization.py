@@ -0,0 +1,55 @@
+"""Unit tests for JSON encoding and pagination cursors."""
+import json
+import pytest
+from datetime import datetime, timezone
+from decimal import Decimal
+from uuid import uuid4
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.serialization import (
+    dumps, ndjson_lines, encode_cursor, decode_cursor, CursorError
+)
+
+
+class TestSerialization:
+    """Test suite for shared_utils.serialization."""
+
+    def test_dumps_handles_database_types(self):
+        """UUIDs, timestamps and decimals returned by asyncpg are encoded."""
+        job_id = uuid4()
+        at = datetime(2025, 10, 19, 12, 0, tzinfo=timezone.utc)
+
+        data = json.loads(dumps({'job_id': job_id, 'at': at, 'duration_s': Decimal('1.5')}))
+
+        assert data['job_id'] == str(job_id)
+        assert datetime.fromisoformat(data['at']) == at
+        assert data['duration_s'] == 1.5
+
+    def test_ndjson_lines(self):
+        """Each row becomes one JSON document per line."""
+        out = ndjson_lines([{'n': 1}, {'n': 2}])
+        lines = out.decode().splitlines()
+        assert [json.loads(line)['n'] for line in lines] == [1, 2]
+        assert out.endswith(b'\n')
+
+    def test_cursor_round_trip(self):
+        """A cursor decodes back to the keyset values it was built from."""
+        job_id = uuid4()
+        at = datetime(2025, 10, 19, 12, 0, 0, 123456, tzinfo=timezone.utc)
+
+        token = encode_cursor(at, job_id)
+
+        assert '=' not in token
+        assert decode_cursor(token) == (at, job_id)
+
+    def test_invalid_cursor_rejected(self):
+        """Tampered or garbage cursors raise CursorError."""
+        with pytest.raises(CursorError):
+            decode_cursor('not-a-cursor')
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
@@ -0,0 +1,75 @@
+"""Unit tests for the multi-integration sidecar's batch ingest endpoint."""
+import importlib
+import json
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+
+def make_event(i):
+    return {
+        'idempotency_key': f'k{i}',
+        'site_id': 'fab1',
+        'app': {'app_id': '6f1c4f0e-0000-4000-8000-000000000001', 'name': 'app', 'version': '1.0'},
+        'entity': {'type': 'job', 'id': f'6f1c4f0e-0000-4000-8000-00000000010{i}'},
+        'event': {'kind': 'started', 'at': '2026-01-01T00:00:00+00:00', 'status': 'running'},
+    }
+
+
+class FakeRequest:
+    """The parts of a Starlette request read_batch uses."""
+
+    def __init__(self, items):
+        self._body = json.dumps(items).encode()
+        self.headers = {'content-type': 'application/json'}
+
+    async def body(self):
+        return self._body
+
+
+@pytest.fixture
+def sidecar(tmp_path, monkeypatch):
+    """main_multi_integration with its spools under tmp_path and a recording send_batch."""
+    pytest.importorskip('fastapi')
+    pytest.importorskip('pydantic_settings')
+    monkeypatch.setenv('SPOOL_DIR', str(tmp_path / 'spool'))
+    monkeypatch.setenv('INTEGRATION_SPOOL_DIR', str(tmp_path / 'integrations'))
+    module = importlib.import_module('sidecar_agent.main_multi_integration')
+    sent = []
+
+    async def send_batch(events, names=None, live=True):
+        sent.append([ev['idempotency_key'] for ev in events])
+        return {'local_api': {'success': len(events), 'failed': 0}}
+
+    monkeypatch.setattr(module.container, 'send_batch', send_batch)
+    monkeypatch.setattr(module, 'dedup', module.DedupFilter(1000, 600.0))
+    module.sent = sent
+    return module
+
+
+class TestIngestBatch:
+    """Test suite for POST /v1/ingest/events:batch."""
+
+    @pytest.mark.asyncio
+    async def test_new_batch_is_forwarded_and_remembered(self, sidecar):
+        response = await sidecar.ingest_batch(FakeRequest([make_event(i) for i in range(3)]))
+
+        assert response.status_code == 200
+        body = json.loads(response.body)
+        assert (body['total'], body['duplicates']) == (3, 0)
+        assert sidecar.sent == [['k0', 'k1', 'k2']]
+        assert all(sidecar.dedup.seen(f'k{i}') for i in range(3))
+
+    @pytest.mark.asyncio
+    async def test_repeats_are_dropped(self, sidecar):
+        await sidecar.ingest_batch(FakeRequest([make_event(0)]))
+        response = await sidecar.ingest_batch(FakeRequest([make_event(0), make_event(1), make_event(1)]))
+
+        assert json.loads(response.body)['duplicates'] == 2
+        assert sidecar.sent == [['k0'], ['k1']]
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
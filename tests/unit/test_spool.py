@@ -0,0 +1,101 @@
+"""Unit tests for the segmented spool log."""
+import json
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.spool import SegmentedSpool
+
+
+class TestSegmentedSpool:
+    """Test suite for SegmentedSpool."""
+
+    def test_append_read_commit_in_order(self, tmp_path):
+        """Records come back in append order and commit reduces pending."""
+        spool = SegmentedSpool(tmp_path)
+        for i in range(5):
+            spool.append({'n': i})
+
+        assert spool.pending == 5
+
+        entries = spool.read(3)
+        assert [e.record['n'] for e in entries] == [0, 1, 2]
+
+        spool.commit(entries[-1].position, len(entries))
+        assert spool.pending == 2
+        assert [e.record['n'] for e in spool.read(10)] == [3, 4]
+        spool.close()
+
+    def test_uncommitted_records_are_reread(self, tmp_path):
+        """Reading without committing does not consume records."""
+        spool = SegmentedSpool(tmp_path)
+        spool.append({'n': 1})
+
+        assert [e.record['n'] for e in spool.read(10)] == [1]
+        assert [e.record['n'] for e in spool.read(10)] == [1]
+        assert spool.pending == 1
+        spool.close()
+
+    def test_checkpoint_survives_reopen(self, tmp_path):
+        """Committed position and pending count are recovered after restart."""
+        spool = SegmentedSpool(tmp_path)
+        for i in range(4):
+            spool.append({'n': i})
+        entries = spool.read(2)
+        spool.commit(entries[-1].position, 2)
+        spool.close()
+
+        reopened = SegmentedSpool(tmp_path)
+        assert reopened.pending == 2
+        assert [e.record['n'] for e in reopened.read(10)] == [2, 3]
+        reopened.close()
+
+    def test_rotation_and_drained_segment_deletion(self, tmp_path):
+        """Segments rotate by size and are deleted once fully drained."""
+        spool = SegmentedSpool(tmp_path, segment_max_bytes=64)
+        for i in range(20):
+            spool.append({'n': i})
+
+        assert len(list(tmp_path.glob('*.seg'))) > 1
+
+        entries = spool.read(100)
+        assert [e.record['n'] for e in entries] == list(range(20))
+        spool.commit(entries[-1].position, len(entries))
+
+        assert spool.pending == 0
+        assert len(list(tmp_path.glob('*.seg'))) == 1
+        spool.close()
+
+    def test_torn_tail_is_truncated(self, tmp_path):
+        """A partial record left by a crash is dropped on reopen."""
+        spool = SegmentedSpool(tmp_path)
+        spool.append({'n': 1})
+        spool.close()
+
+        segment = next(tmp_path.glob('*.seg'))
+        with open(segment, 'ab') as f:
+            f.write(b'\x00\x00\x00\x20partial')
+
+        reopened = SegmentedSpool(tmp_path)
+        assert reopened.pending == 1
+        reopened.append({'n': 2})
+        assert [e.record['n'] for e in reopened.read(10)] == [1, 2]
+        reopened.close()
+
+    def test_legacy_files_migrated_in_spool_order(self, tmp_path):
+        """Legacy one-file-per-event spools are imported by spool timestamp."""
+        for key, ts in [('c', 300), ('a', 100), ('b', 200)]:
+            (tmp_path / f'{key}_{ts}.json').write_text(json.dumps({'ts': ts}))
+
+        spool = SegmentedSpool(tmp_path)
+
+        assert spool.pending == 3
+        assert [e.record['ts'] for e in spool.read(10)] == [100, 200, 300]
+        assert list(tmp_path.glob('*_*.json')) == []
+        spool.close()
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
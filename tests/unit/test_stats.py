@@ -0,0 +1,131 @@
+"""Unit tests for mergeable job/event statistics."""
+import math
+import pytest
+from datetime import datetime, timedelta, timezone
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.stats import (
+    HIST_BUCKETS, HIST_MIN_LOG10, HIST_MAX_LOG10, choose_granularity, parse_group_by,
+    job_partial_from_row, merge_job_buckets, merge_event_buckets, merge_failures, histogram_quantile
+)
+
+T0 = datetime(2025, 10, 19, 12, 0, tzinfo=timezone.utc)
+
+
+def _hist(durations: list) -> list:
+    """Histogram with the same layout as the SQL `histogram(log10(duration_s), ...)`."""
+    hist = [0] * (HIST_BUCKETS + 2)
+    width = (HIST_MAX_LOG10 - HIST_MIN_LOG10) / HIST_BUCKETS
+    for d in durations:
+        x = math.log10(max(d, 0.001))
+        if x < HIST_MIN_LOG10:
+            hist[0] += 1
+        elif x >= HIST_MAX_LOG10:
+            hist[-1] += 1
+        else:
+            hist[1 + int((x - HIST_MIN_LOG10) / width)] += 1
+    return hist
+
+
+def _agg_row(status: str, durations: list, app_name: str = 'etl', bucket: datetime = T0) -> dict:
+    """One continuous-aggregate row for a set of job durations."""
+    return {
+        'bucket': bucket,
+        'app_name': app_name,
+        'status': status,
+        'job_count': len(durations),
+        'avg_duration_s': sum(durations) / len(durations),
+        'min_duration_s': min(durations),
+        'max_duration_s': max(durations),
+        'avg_cpu_s': 2.0,
+        'avg_mem_mb': 100.0,
+        'max_mem_mb': 150.0,
+        'duration_hist': _hist(durations),
+    }
+
+
+def _partials(rows: list) -> list:
+    return [{'bucket': r['bucket'], 'app_name': r['app_name'], 'status': r['status'], **job_partial_from_row(r)}
+            for r in rows]
+
+
+class TestStats:
+    """Test suite for shared_utils.stats."""
+
+    def test_granularity_switches_by_range(self):
+        """Short ranges use hourly buckets, long ranges daily ones."""
+        assert choose_granularity(T0, T0 + timedelta(hours=24)) == 'hour'
+        assert choose_granularity(T0, T0 + timedelta(days=30)) == 'day'
+        assert choose_granularity(T0, T0 + timedelta(days=30), 'hour') == 'hour'
+        assert choose_granularity(T0, T0 + timedelta(hours=10), 'auto', hourly_max_hours=6) == 'day'
+        with pytest.raises(ValueError):
+            choose_granularity(T0, T0 + timedelta(hours=1), 'minute')
+
+    def test_group_by_validation(self):
+        """Only allowed fields can be grouped by; duplicates collapse."""
+        assert parse_group_by('status, app_name,status', ('app_name', 'status')) == ['status', 'app_name']
+        assert parse_group_by(None, ('status',)) == []
+        with pytest.raises(ValueError):
+            parse_group_by('kind', ('status',))
+
+    def test_bucket_merges_statuses(self):
+        """Rates and averages are weighted by count across status rows."""
+        rows = [_agg_row('succeeded', [10.0, 20.0, 30.0]), _agg_row('failed', [100.0])]
+        (bucket,) = merge_job_buckets(_partials(rows))
+        assert bucket['job_count'] == 4
+        assert bucket['succeeded'] == 3 and bucket['failed'] == 1
+        assert bucket['success_rate'] == 0.75
+        assert bucket['avg_duration_s'] == pytest.approx(40.0)
+        assert bucket['min_duration_s'] == 10.0 and bucket['max_duration_s'] == 100.0
+
+    def test_percentiles_from_histogram(self):
+        """Histogram percentiles stay within one bucket width of the exact value."""
+        durations = [float(d) for d in range(1, 1001)]
+        (bucket,) = merge_job_buckets(_partials([_agg_row('succeeded', durations)]))
+        ratio = 10 ** ((HIST_MAX_LOG10 - HIST_MIN_LOG10) / HIST_BUCKETS)
+        for name, exact in (('p50_duration_s', 500.0), ('p95_duration_s', 950.0), ('p99_duration_s', 990.0)):
+            assert exact / ratio <= bucket[name] <= exact * ratio
+        assert histogram_quantile([0] * (HIST_BUCKETS + 2), 0.5) is None
+
+    def test_cross_site_merge_matches_single_merge(self):
+        """Re-aggregating per-site buckets gives the same result as aggregating all rows at once."""
+        site1 = [_agg_row('succeeded', [1.0, 2.0, 4.0]), _agg_row('failed', [50.0])]
+        site2 = [_agg_row('succeeded', [8.0] * 20), _agg_row('succeeded', [3.0], bucket=T0 + timedelta(hours=1))]
+
+        per_site = []
+        for site, rows in (('fab1', site1), ('fab2', site2)):
+            per_site += [dict(b, site_id=site) for b in merge_job_buckets(_partials(rows))]
+        federated = merge_job_buckets(per_site)
+        direct = merge_job_buckets(_partials(site1 + site2))
+
+        assert [b['bucket'] for b in federated] == [T0.isoformat(), (T0 + timedelta(hours=1)).isoformat()]
+        for fed, exp in zip(federated, direct):
+            for field in ('job_count', 'success_rate', 'avg_duration_s', 'p50_duration_s', 'p95_duration_s',
+                          'max_duration_s', 'duration_hist'):
+                assert fed[field] == exp[field]
+        # A plain mean of the per-site success rates would be 0.875
+        assert federated[0]['success_rate'] == pytest.approx(23 / 24, abs=1e-4)
+
+        by_site = merge_job_buckets(per_site, ['site_id'])
+        assert [(b['bucket'], b['site_id']) for b in by_site][:2] == [(T0.isoformat(), 'fab1'), (T0.isoformat(), 'fab2')]
+
+    def test_event_and_failure_merges(self):
+        """Event counts are summed; failure durations are re-weighted by count."""
+        events = merge_event_buckets([
+            {'bucket': T0, 'kind': 'started', 'event_count': 5},
+            {'bucket': T0.isoformat(), 'kind': 'started', 'event_count': 7},
+            {'bucket': T0, 'kind': 'failed', 'event_count': 1},
+        ], ['kind'])
+        assert [(e['kind'], e['event_count']) for e in events] == [('failed', 1), ('started', 12)]
+
+        failures = merge_failures([
+            {'app_name': 'etl', 'error_type': 'Timeout', 'failure_count': 3, 'avg_duration_before_failure': 10.0},
+            {'app_name': 'etl', 'error_type': 'Timeout', 'failure_count': 1, 'avg_duration_before_failure': 50.0},
+            {'app_name': 'ml', 'error_type': 'OOM', 'failure_count': 2, 'avg_duration_before_failure': 5.0},
+        ])
+        assert failures[0] == {'app_name': 'etl', 'error_type': 'Timeout', 'failure_count': 4,
+                               'avg_duration_before_failure': 20.0}
+        assert failures[1]['app_name'] == 'ml'
@@ -0,0 +1,104 @@
+"""Unit tests for the batch wire formats."""
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.wire import (
+    JSON_TYPE, MSGPACK_TYPE, WireBatch, WireFormatError, decode_batch, encode_batch, json_errors, parse_format
+)
+
+
+EVENTS = [
+    {
+        'idempotency_key': f'k{i}',
+        'site_id': 'fab1',
+        'app': {'app_id': '6f1c4f0e-0000-4000-8000-000000000001', 'name': 'app', 'version': '1.0'},
+        'entity': {'type': 'job', 'id': f'6f1c4f0e-0000-4000-8000-00000000010{i}'},
+        'event': {'kind': 'started', 'at': '2026-01-01T00:00:00+00:00', 'status': 'running', 'metrics': {'n': i}},
+    }
+    for i in range(3)
+]
+
+
+class TestWireFormats:
+    """Test suite for encode_batch/decode_batch."""
+
+    def test_parse_format(self):
+        assert parse_format('json') == (JSON_TYPE, False)
+        assert parse_format('MSGPACK+zstd') == (MSGPACK_TYPE, True)
+        with pytest.raises(ValueError):
+            parse_format('protobuf')
+
+    def test_json_roundtrip(self):
+        body, headers = encode_batch(EVENTS)
+        assert headers == {'Content-Type': JSON_TYPE}
+        assert decode_batch(body, 'application/json; charset=utf-8') == EVENTS
+
+    def test_missing_content_type_is_json(self):
+        body, _ = encode_batch(EVENTS)
+        assert decode_batch(body, None) == EVENTS
+
+    def test_msgpack_roundtrip(self):
+        pytest.importorskip('msgpack')
+        body, headers = encode_batch(EVENTS, 'msgpack')
+        assert headers == {'Content-Type': MSGPACK_TYPE}
+        assert len(body) < len(encode_batch(EVENTS)[0])
+        assert decode_batch(body, 'application/x-msgpack') == EVENTS
+
+    def test_zstd_roundtrip(self):
+        pytest.importorskip('zstandard')
+        body, headers = encode_batch(EVENTS, 'json+zstd')
+        assert headers['Content-Encoding'] == 'zstd'
+        assert decode_batch(body, headers['Content-Type'], headers['Content-Encoding']) == EVENTS
+
+    def test_decompressed_size_is_bounded(self, monkeypatch):
+        pytest.importorskip('zstandard')
+        monkeypatch.setattr('shared_utils.wire.MAX_DECOMPRESSED_BYTES', 64)
+        body, headers = encode_batch(EVENTS, 'json+zstd')
+        with pytest.raises(WireFormatError) as e:
+            decode_batch(body, JSON_TYPE, 'zstd')
+        assert e.value.status_code == 413
+
+    def test_unsupported_media_type_and_encoding(self):
+        with pytest.raises(WireFormatError) as e:
+            decode_batch(b'<xml/>', 'application/xml')
+        assert e.value.status_code == 415
+        with pytest.raises(WireFormatError) as e:
+            decode_batch(b'[]', JSON_TYPE, 'br')
+        assert e.value.status_code == 415
+
+    def test_invalid_body(self):
+        with pytest.raises(WireFormatError) as e:
+            decode_batch(b'[{', JSON_TYPE)
+        assert e.value.status_code == 400
+
+    def test_json_documents_have_no_errors(self):
+        assert json_errors(EVENTS) == []
+
+    def test_non_json_values_are_located(self):
+        """msgpack bin values and non-string keys are reported per item."""
+        items = [
+            EVENTS[0],
+            {**EVENTS[1], 'event': {**EVENTS[1]['event'], 'metrics': {'blob': b'\x00\x01'}}},
+            {**EVENTS[2], 'entity': {1: 'x'}},
+        ]
+        errors = json_errors(items)
+        assert [e['loc'] for e in errors] == [('body', 1, 'event', 'metrics', 'blob'), ('body', 2, 'entity')]
+        assert 'bytes' in errors[0]['msg']
+
+    def test_msgpack_bin_is_found(self):
+        msgpack = pytest.importorskip('msgpack')
+        body = msgpack.packb([{**EVENTS[0], 'event': {'kind': 'started', 'raw': b'abc'}}], use_bin_type=True)
+        assert json_errors(decode_batch(body, MSGPACK_TYPE))[0]['loc'] == ('body', 0, 'event', 'raw')
+
+    def test_passthrough_headers(self):
+        """A received body is forwarded with the headers it arrived with."""
+        batch = WireBatch(b'...', MSGPACK_TYPE, 'zstd', [])
+        assert batch.headers() == {'Content-Type': MSGPACK_TYPE, 'Content-Encoding': 'zstd'}
+        assert WireBatch(b'[]', JSON_TYPE, None, []).headers() == {'Content-Type': JSON_TYPE}
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])
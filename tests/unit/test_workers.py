@@ -0,0 +1,53 @@
+"""Unit tests for the pre-fork worker helpers."""
+import socket
+import pytest
+
+import sys
+from pathlib import Path
+sys.path.insert(0, str(Path(__file__).parent.parent.parent / 'apps'))
+
+from shared_utils.workers import pool_sizes, reuseport_socket, worker_index
+
+
+class TestPoolSizes:
+    """Test suite for pool_sizes."""
+
+    def test_single_worker_keeps_config(self):
+        assert pool_sizes(2, 10, 1) == (2, 10)
+
+    def test_budget_split_across_workers(self):
+        """N workers together never exceed DB_POOL_MAX_SIZE."""
+        assert pool_sizes(2, 10, 4) == (2, 2)
+        assert pool_sizes(5, 20, 2) == (5, 10)
+
+    def test_min_capped_by_max(self):
+        assert pool_sizes(8, 10, 4) == (2, 2)
+
+    def test_at_least_one_connection(self):
+        assert pool_sizes(2, 3, 8) == (1, 1)
+        assert pool_sizes(2, 10, 0) == (2, 10)
+
+
+class TestReuseportSocket:
+    """Test suite for reuseport_socket."""
+
+    def test_workers_bind_same_port(self):
+        """Several workers can bind one port; none listens until started."""
+        first = reuseport_socket('127.0.0.1', 0)
+        try:
+            port = first.getsockname()[1]
+            second = reuseport_socket('127.0.0.1', port)
+            try:
+                assert second.getsockname()[1] == port
+                assert second.getsockopt(socket.SOL_SOCKET, socket.SO_ACCEPTCONN) == 0
+            finally:
+                second.close()
+        finally:
+            first.close()
+
+    def test_single_process_index(self):
+        assert worker_index() == 0
+
+
+if __name__ == '__main__':
+    pytest.main([__file__, '-v'])